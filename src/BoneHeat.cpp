@@ -0,0 +1,664 @@
+#include "BoneHeat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#include "MeshBVH.h"
+#include "Parallel.h"
+
+using namespace std;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	double secondsSince( Clock::time_point start )
+	{
+		return std::chrono::duration< double >( Clock::now() - start ).count();
+	}
+
+	// Bones and offsets shorter than this fraction of the mesh's bounding
+	// box diagonal count as zero length.
+	const float kMinBoneLength = 1e-5f;
+
+	// Visibility rays start and stop this fraction of their length away
+	// from the vertex and the bone, so they do not hit the faces around
+	// the vertex or a surface the bone touches.
+	const float kVisibilityOffset = 1e-3f;
+
+	// Conjugate gradients stop at this residual relative to the right-hand side.
+	const double kSolverTolerance = 1e-5;
+
+	// Segment from start to start + direction, or the ray from start along
+	// direction if it is unbounded.
+	struct Bone
+	{
+		unsigned joint;
+		Vector3f start;
+		Vector3f direction;
+		bool unbounded;
+	};
+
+	Vector3f closestPointOnBone( const Bone& bone, const Vector3f& point )
+	{
+		const float lengthSquared = bone.direction.absSquared();
+		if( lengthSquared == 0 )
+		{
+			return bone.start;
+		}
+
+		float t = Vector3f::dot( point - bone.start, bone.direction ) / lengthSquared;
+		t = max( t, 0.0f );
+		if( !bone.unbounded )
+		{
+			t = min( t, 1.0f );
+		}
+		return bone.start + t * bone.direction;
+	}
+
+	// Bones of every joint below a root: one per child that is not at the
+	// same place, or a ray if there is none.
+	void buildBones( const vector< Vector3f >& jointPositions, const vector< int >& jointParents,
+		float minLength, vector< Bone >& bones )
+	{
+		const unsigned numJoints = jointPositions.size();
+
+		vector< bool > hasBone( numJoints, false );
+		for( unsigned c = 0; c < numJoints; c++ )
+		{
+			const int j = jointParents[ c ];
+			if( j < 0 || jointParents[ j ] < 0 )
+			{
+				continue;
+			}
+
+			const Vector3f direction = jointPositions[ c ] - jointPositions[ j ];
+			if( direction.abs() >= minLength )
+			{
+				Bone bone = { (unsigned)j, jointPositions[ j ], direction, false };
+				bones.push_back( bone );
+				hasBone[ j ] = true;
+			}
+		}
+
+		const unsigned numSegments = bones.size();
+		for( unsigned j = 0; j < numJoints; j++ )
+		{
+			if( jointParents[ j ] < 0 || hasBone[ j ] )
+			{
+				continue;
+			}
+
+			// Continue the nearest ancestor bone that has a length.
+			Vector3f direction( 0, 0, 0 );
+			for( int a = jointParents[ j ]; a >= 0 && direction.abs() < minLength; a = jointParents[ a ] )
+			{
+				direction = jointPositions[ j ] - jointPositions[ a ];
+			}
+
+			// A joint at the root's place (e.g. a neck above a pelvis root)
+			// points away from the bones leaving the same place.
+			if( direction.abs() < minLength )
+			{
+				direction = Vector3f( 0, 0, 0 );
+				for( unsigned b = 0; b < numSegments; b++ )
+				{
+					if( ( bones[ b ].start - jointPositions[ j ] ).abs() < minLength )
+					{
+						direction -= bones[ b ].direction.normalized();
+					}
+				}
+			}
+
+			Bone bone = { j, jointPositions[ j ], Vector3f( 0, 0, 0 ), true };
+			if( direction.abs() >= minLength )
+			{
+				bone.direction = direction.normalized();
+			}
+			bones.push_back( bone );
+		}
+	}
+
+	// Systems solved together by one thread. Their vectors are interleaved
+	// (entry i of system s at [ i * kBatchSize + s ]), so every matrix entry
+	// read feeds kBatchSize independent multiply-add chains.
+	const unsigned kBatchSize = 4;
+
+	// Symmetric sparse matrix, full rows in compressed sparse row form.
+	struct SparseMatrix
+	{
+		vector< unsigned > rowStarts;
+		vector< unsigned > columns;
+		vector< double > values;
+		vector< double > diagonal;
+
+		// y = A x for a batch of interleaved vectors
+		void multiply( const vector< double >& x, vector< double >& y ) const
+		{
+			const unsigned n = diagonal.size();
+			for( unsigned i = 0; i < n; i++ )
+			{
+				double sum[ kBatchSize ] = {};
+				for( unsigned k = rowStarts[ i ]; k < rowStarts[ i + 1 ]; k++ )
+				{
+					const double value = values[ k ];
+					const double* column = &x[ columns[ k ] * kBatchSize ];
+					for( unsigned s = 0; s < kBatchSize; s++ )
+					{
+						sum[ s ] += value * column[ s ];
+					}
+				}
+				for( unsigned s = 0; s < kBatchSize; s++ )
+				{
+					y[ i * kBatchSize + s ] = sum[ s ];
+				}
+			}
+		}
+	};
+
+	// Builds the cotangent Laplacian L with the positive semi-definite sign
+	// (positive diagonal) and the lumped vertex areas.
+	void buildLaplacian( const vector< Vector3f >& vertices, const vector< Tuple3u >& faces,
+		SparseMatrix& matrix, vector< double >& mass )
+	{
+		const unsigned n = vertices.size();
+
+		// half cotangent of the opposite angle for each face edge, i < j
+		struct Entry
+		{
+			unsigned i, j;
+			double weight;
+
+			bool operator < ( const Entry& other ) const
+			{
+				return i < other.i || ( i == other.i && j < other.j );
+			}
+		};
+
+		vector< Entry > entries;
+		entries.reserve( 3 * faces.size() );
+		mass.assign( n, 0.0 );
+		for( unsigned f = 0; f < faces.size(); f++ )
+		{
+			const Tuple3u& face = faces[ f ];
+			const Vector3f& a = vertices[ face[ 0 ] ];
+			const Vector3f& b = vertices[ face[ 1 ] ];
+			const Vector3f& c = vertices[ face[ 2 ] ];
+			const double twiceArea = Vector3f::cross( b - a, c - a ).abs();
+			if( twiceArea <= 0 )
+			{
+				continue;
+			}
+
+			for( int k = 0; k < 3; k++ )
+			{
+				mass[ face[ k ] ] += twiceArea / 6.0;
+
+				// angle at corner k is opposite the edge of the other two
+				const unsigned corner = face[ k ];
+				const unsigned i = face[ ( k + 1 ) % 3 ];
+				const unsigned j = face[ ( k + 2 ) % 3 ];
+				const double cotangent = Vector3f::dot( vertices[ i ] - vertices[ corner ], vertices[ j ] - vertices[ corner ] ) / twiceArea;
+				Entry entry = { min( i, j ), max( i, j ), 0.5 * cotangent };
+				entries.push_back( entry );
+			}
+		}
+
+		sort( entries.begin(), entries.end() );
+
+		// Merge the two faces of each edge. Negative weights (obtuse
+		// angles) are clamped, which keeps the weights in [0, 1].
+		vector< Entry > edges;
+		for( unsigned k = 0; k < entries.size(); k++ )
+		{
+			if( !edges.empty() && edges.back().i == entries[ k ].i && edges.back().j == entries[ k ].j )
+			{
+				edges.back().weight += entries[ k ].weight;
+			}
+			else
+			{
+				edges.push_back( entries[ k ] );
+			}
+		}
+
+		vector< unsigned > counts( n + 1, 0 );
+		matrix.diagonal.assign( n, 0.0 );
+		for( unsigned e = 0; e < edges.size(); e++ )
+		{
+			edges[ e ].weight = max( edges[ e ].weight, 0.0 );
+			counts[ edges[ e ].i + 1 ]++;
+			counts[ edges[ e ].j + 1 ]++;
+			matrix.diagonal[ edges[ e ].i ] += edges[ e ].weight;
+			matrix.diagonal[ edges[ e ].j ] += edges[ e ].weight;
+		}
+
+		// one diagonal entry per row, stored first
+		matrix.rowStarts.assign( n + 1, 0 );
+		for( unsigned i = 0; i < n; i++ )
+		{
+			matrix.rowStarts[ i + 1 ] = matrix.rowStarts[ i ] + counts[ i + 1 ] + 1;
+		}
+
+		matrix.columns.resize( matrix.rowStarts[ n ] );
+		matrix.values.resize( matrix.rowStarts[ n ] );
+		vector< unsigned > next( matrix.rowStarts.begin(), matrix.rowStarts.end() - 1 );
+		for( unsigned i = 0; i < n; i++ )
+		{
+			matrix.columns[ next[ i ]++ ] = i;
+		}
+		for( unsigned e = 0; e < edges.size(); e++ )
+		{
+			const unsigned i = edges[ e ].i;
+			const unsigned j = edges[ e ].j;
+			matrix.columns[ next[ i ] ] = j;
+			matrix.values[ next[ i ]++ ] = -edges[ e ].weight;
+			matrix.columns[ next[ j ] ] = i;
+			matrix.values[ next[ j ]++ ] = -edges[ e ].weight;
+		}
+	}
+
+	// Zero fill-in incomplete Cholesky factor A ~ L L^T with the sparsity of
+	// A's lower triangle. A is an M-matrix (positive diagonal, negative
+	// couplings, diagonally dominant), for which the factorization exists.
+	struct IncompleteCholesky
+	{
+		// strictly lower part of L by rows, columns ascending
+		vector< unsigned > rowStarts;
+		vector< unsigned > columns;
+		vector< double > values;
+		vector< double > diagonal;
+
+		void factor( const SparseMatrix& matrix )
+		{
+			const unsigned n = matrix.diagonal.size();
+			rowStarts.assign( 1, 0 );
+			columns.clear();
+			values.clear();
+			diagonal.resize( n );
+			for( unsigned i = 0; i < n; i++ )
+			{
+				// rows list the diagonal first, then ascending columns
+				for( unsigned k = matrix.rowStarts[ i ] + 1; k < matrix.rowStarts[ i + 1 ] && matrix.columns[ k ] < i; k++ )
+				{
+					const unsigned j = matrix.columns[ k ];
+
+					// L_ij = ( A_ij - sum_m L_im L_jm ) / L_jj over the columns m < j of both rows
+					double sum = matrix.values[ k ];
+					unsigned a = rowStarts[ i ];
+					unsigned b = rowStarts[ j ];
+					while( a < columns.size() && b < rowStarts[ j + 1 ] )
+					{
+						if( columns[ a ] < columns[ b ] )
+						{
+							a++;
+						}
+						else if( columns[ b ] < columns[ a ] )
+						{
+							b++;
+						}
+						else
+						{
+							sum -= values[ a++ ] * values[ b++ ];
+						}
+					}
+					columns.push_back( j );
+					values.push_back( sum / diagonal[ j ] );
+				}
+
+				double d = matrix.diagonal[ i ];
+				for( unsigned k = rowStarts[ i ]; k < columns.size(); k++ )
+				{
+					d -= values[ k ] * values[ k ];
+				}
+				diagonal[ i ] = sqrt( max( d, 1e-12 * matrix.diagonal[ i ] ) );
+				rowStarts.push_back( columns.size() );
+			}
+		}
+
+		// z = ( L L^T )^-1 r for a batch of interleaved vectors
+		void solve( const vector< double >& r, vector< double >& z ) const
+		{
+			const unsigned n = diagonal.size();
+			for( unsigned i = 0; i < n; i++ )
+			{
+				double sum[ kBatchSize ];
+				for( unsigned s = 0; s < kBatchSize; s++ )
+				{
+					sum[ s ] = r[ i * kBatchSize + s ];
+				}
+				for( unsigned k = rowStarts[ i ]; k < rowStarts[ i + 1 ]; k++ )
+				{
+					const double* column = &z[ columns[ k ] * kBatchSize ];
+					for( unsigned s = 0; s < kBatchSize; s++ )
+					{
+						sum[ s ] -= values[ k ] * column[ s ];
+					}
+				}
+				for( unsigned s = 0; s < kBatchSize; s++ )
+				{
+					z[ i * kBatchSize + s ] = sum[ s ] / diagonal[ i ];
+				}
+			}
+
+			for( unsigned i = n; i-- > 0; )
+			{
+				double* row = &z[ i * kBatchSize ];
+				for( unsigned s = 0; s < kBatchSize; s++ )
+				{
+					row[ s ] /= diagonal[ i ];
+				}
+				for( unsigned k = rowStarts[ i ]; k < rowStarts[ i + 1 ]; k++ )
+				{
+					double* column = &z[ columns[ k ] * kBatchSize ];
+					for( unsigned s = 0; s < kBatchSize; s++ )
+					{
+						column[ s ] -= values[ k ] * row[ s ];
+					}
+				}
+			}
+		}
+	};
+
+	// Preconditioned conjugate gradients for a batch of systems
+	// A x_s = b_s, starting from x. Each system stops on its own; sets its
+	// number of iterations and final |r| / |b|.
+	void solveConjugateGradients( const SparseMatrix& matrix, const IncompleteCholesky& preconditioner,
+		const vector< double >& b, vector< double >& x, unsigned* iterations, double* residuals )
+	{
+		const unsigned n = matrix.diagonal.size();
+		vector< double > r( n * kBatchSize ), z( n * kBatchSize ), p( n * kBatchSize ), q( n * kBatchSize );
+
+		double bNorm[ kBatchSize ] = {}, rz[ kBatchSize ] = {}, rr[ kBatchSize ] = {};
+		matrix.multiply( x, q );
+		for( unsigned k = 0; k < n * kBatchSize; k++ )
+		{
+			r[ k ] = b[ k ] - q[ k ];
+		}
+		preconditioner.solve( r, z );
+		for( unsigned k = 0; k < n * kBatchSize; k++ )
+		{
+			p[ k ] = z[ k ];
+			bNorm[ k % kBatchSize ] += b[ k ] * b[ k ];
+			rz[ k % kBatchSize ] += r[ k ] * z[ k ];
+			rr[ k % kBatchSize ] += r[ k ] * r[ k ];
+		}
+
+		bool active[ kBatchSize ];
+		unsigned numActive = 0;
+		for( unsigned s = 0; s < kBatchSize; s++ )
+		{
+			bNorm[ s ] = sqrt( bNorm[ s ] );
+			iterations[ s ] = 0;
+			active[ s ] = ( bNorm[ s ] > 0 && sqrt( rr[ s ] ) > kSolverTolerance * bNorm[ s ] );
+			numActive += active[ s ];
+
+			// nothing heated: the solution is 0
+			if( bNorm[ s ] == 0 )
+			{
+				for( unsigned i = 0; i < n; i++ )
+				{
+					x[ i * kBatchSize + s ] = 0;
+				}
+			}
+		}
+
+		while( numActive > 0 )
+		{
+			matrix.multiply( p, q );
+
+			double alpha[ kBatchSize ], pq[ kBatchSize ] = {};
+			for( unsigned k = 0; k < n * kBatchSize; k++ )
+			{
+				pq[ k % kBatchSize ] += p[ k ] * q[ k ];
+			}
+			for( unsigned s = 0; s < kBatchSize; s++ )
+			{
+				alpha[ s ] = active[ s ] ? rz[ s ] / pq[ s ] : 0.0;
+			}
+
+			for( unsigned s = 0; s < kBatchSize; s++ )
+			{
+				rr[ s ] = 0;
+			}
+			for( unsigned k = 0; k < n * kBatchSize; k++ )
+			{
+				x[ k ] += alpha[ k % kBatchSize ] * p[ k ];
+				r[ k ] -= alpha[ k % kBatchSize ] * q[ k ];
+				rr[ k % kBatchSize ] += r[ k ] * r[ k ];
+			}
+
+			preconditioner.solve( r, z );
+			double rzNext[ kBatchSize ] = {};
+			for( unsigned k = 0; k < n * kBatchSize; k++ )
+			{
+				rzNext[ k % kBatchSize ] += r[ k ] * z[ k ];
+			}
+
+			double beta[ kBatchSize ];
+			for( unsigned s = 0; s < kBatchSize; s++ )
+			{
+				beta[ s ] = active[ s ] ? rzNext[ s ] / rz[ s ] : 0.0;
+				rz[ s ] = rzNext[ s ];
+			}
+			for( unsigned k = 0; k < n * kBatchSize; k++ )
+			{
+				p[ k ] = z[ k ] + beta[ k % kBatchSize ] * p[ k ];
+			}
+
+			for( unsigned s = 0; s < kBatchSize; s++ )
+			{
+				if( active[ s ] && ( ++iterations[ s ] >= n || sqrt( rr[ s ] ) <= kSolverTolerance * bNorm[ s ] ) )
+				{
+					active[ s ] = false;
+					numActive--;
+				}
+			}
+		}
+
+		for( unsigned s = 0; s < kBatchSize; s++ )
+		{
+			residuals[ s ] = ( bNorm[ s ] > 0 ) ? sqrt( rr[ s ] ) / bNorm[ s ] : 0.0;
+		}
+	}
+}
+
+void computeBoneHeatWeights( const Mesh& mesh, const std::vector< Vector3f >& jointPositions,
+	const std::vector< int >& jointParents, std::vector< std::vector< float > >& attachments,
+	BoneHeatStats& stats, unsigned numThreads )
+{
+	if( numThreads == 0 )
+	{
+		numThreads = defaultThreadCount();
+	}
+
+	const vector< Vector3f >& vertices = mesh.bindVertices;
+	const unsigned numVertices = vertices.size();
+	const unsigned numJoints = jointPositions.size();
+
+	Vector3f boxMin( 1e30f, 1e30f, 1e30f ), boxMax( -1e30f, -1e30f, -1e30f );
+	for( unsigned i = 0; i < numVertices; i++ )
+	{
+		for( int a = 0; a < 3; a++ )
+		{
+			boxMin[ a ] = min( boxMin[ a ], vertices[ i ][ a ] );
+			boxMax[ a ] = max( boxMax[ a ], vertices[ i ][ a ] );
+		}
+	}
+	const float minLength = kMinBoneLength * ( boxMax - boxMin ).abs();
+
+	vector< Bone > bones;
+	buildBones( jointPositions, jointParents, minLength, bones );
+
+	stats.numBones = bones.size();
+	stats.invisibleVertices = 0;
+	stats.maxIterations = 0;
+	stats.maxResidual = 0;
+
+	attachments.assign( numVertices, vector< float >( numJoints, 0.0f ) );
+	if( bones.empty() || numVertices == 0 )
+	{
+		stats.visibilitySeconds = stats.assemblySeconds = stats.solveSeconds = 0;
+		return;
+	}
+
+	// Nearest visible bone and heat of each vertex. Vertices that see no
+	// bone get no heat, and fall back to the nearest bone where the
+	// diffusion does not reach them.
+	Clock::time_point start = Clock::now();
+	MeshBVH bvh;
+	bvh.build( vertices, mesh.faces, numThreads );
+
+	vector< unsigned > nearestBone( numVertices );
+	vector< double > heat( numVertices );
+	std::atomic< unsigned > invisible( 0 );
+	parallelFor( numVertices, numThreads, [&]( unsigned begin, unsigned end )
+	{
+		vector< pair< float, unsigned > > candidates( bones.size() );
+		unsigned invisibleHere = 0;
+		for( unsigned i = begin; i < end; i++ )
+		{
+			for( unsigned b = 0; b < bones.size(); b++ )
+			{
+				candidates[ b ] = make_pair( ( closestPointOnBone( bones[ b ], vertices[ i ] ) - vertices[ i ] ).abs(), b );
+			}
+			sort( candidates.begin(), candidates.end() );
+
+			nearestBone[ i ] = candidates[ 0 ].second;
+			heat[ i ] = 0;
+			for( unsigned c = 0; c < candidates.size(); c++ )
+			{
+				const Bone& bone = bones[ candidates[ c ].second ];
+				const Vector3f target = closestPointOnBone( bone, vertices[ i ] );
+				const Vector3f origin = vertices[ i ] + kVisibilityOffset * ( target - vertices[ i ] );
+				MeshBVH::RayHit hit;
+				if( !bvh.raycast( vertices, origin, target - origin, hit, 1.0f - kVisibilityOffset ) )
+				{
+					nearestBone[ i ] = candidates[ c ].second;
+					heat[ i ] = 1.0 / max( candidates[ c ].first * candidates[ c ].first, minLength * minLength );
+					break;
+				}
+			}
+			if( heat[ i ] == 0 )
+			{
+				invisibleHere++;
+			}
+		}
+		invisible += invisibleHere;
+	} );
+	stats.invisibleVertices = invisible;
+	stats.visibilitySeconds = secondsSince( start );
+
+	// ( L + M H ) w_j = M H p_j. Vertices whose row is empty (no face with
+	// an area, no heat) are not coupled to any other, so their row becomes
+	// w = p, their nearest bone.
+	start = Clock::now();
+	SparseMatrix matrix;
+	vector< double > mass;
+	buildLaplacian( vertices, mesh.faces, matrix, mass );
+
+	vector< bool > fixed( numVertices, false );
+	for( unsigned i = 0; i < numVertices; i++ )
+	{
+		matrix.diagonal[ i ] += mass[ i ] * heat[ i ];
+		if( matrix.diagonal[ i ] <= 0 )
+		{
+			fixed[ i ] = true;
+			matrix.diagonal[ i ] = 1;
+		}
+		matrix.values[ matrix.rowStarts[ i ] ] = matrix.diagonal[ i ];
+	}
+
+	IncompleteCholesky preconditioner;
+	preconditioner.factor( matrix );
+	stats.assemblySeconds = secondsSince( start );
+
+	// One system per joint with bones. The threads take batches of them
+	// in turn, smaller than kBatchSize if that leaves threads idle.
+	start = Clock::now();
+	vector< unsigned > boneJoints;
+	for( unsigned b = 0; b < bones.size(); b++ )
+	{
+		if( find( boneJoints.begin(), boneJoints.end(), bones[ b ].joint ) == boneJoints.end() )
+		{
+			boneJoints.push_back( bones[ b ].joint );
+		}
+	}
+
+	const unsigned numSystems = boneJoints.size();
+	const unsigned batchSize = max( 1u, min( kBatchSize, ( numSystems + numThreads - 1 ) / numThreads ) );
+	const unsigned numBatches = ( numSystems + batchSize - 1 ) / batchSize;
+
+	vector< vector< float > > weights( numSystems, vector< float >( numVertices ) );
+	vector< unsigned > iterations( numBatches * kBatchSize );
+	vector< double > residuals( numBatches * kBatchSize );
+	std::atomic< unsigned > nextBatch( 0 );
+	runOnThreads( min( numThreads, numBatches ), [&]( unsigned )
+	{
+		vector< double > b( numVertices * kBatchSize ), x( numVertices * kBatchSize );
+		for( unsigned batch = nextBatch++; batch < numBatches; batch = nextBatch++ )
+		{
+			const unsigned first = batch * batchSize;
+			for( unsigned i = 0; i < numVertices; i++ )
+			{
+				const unsigned joint = bones[ nearestBone[ i ] ].joint;
+				for( unsigned s = 0; s < kBatchSize; s++ )
+				{
+					const double p = ( s < batchSize && first + s < numSystems && joint == boneJoints[ first + s ] ) ? 1.0 : 0.0;
+					b[ i * kBatchSize + s ] = fixed[ i ] ? p : mass[ i ] * heat[ i ] * p;
+					x[ i * kBatchSize + s ] = p;
+				}
+			}
+
+			solveConjugateGradients( matrix, preconditioner, b, x, &iterations[ batch * kBatchSize ], &residuals[ batch * kBatchSize ] );
+
+			for( unsigned s = 0; s < batchSize && first + s < numSystems; s++ )
+			{
+				for( unsigned i = 0; i < numVertices; i++ )
+				{
+					weights[ first + s ][ i ] = x[ i * kBatchSize + s ];
+				}
+			}
+		}
+	} );
+
+	for( unsigned k = 0; k < iterations.size(); k++ )
+	{
+		stats.maxIterations = max( stats.maxIterations, iterations[ k ] );
+		stats.maxResidual = max( stats.maxResidual, residuals[ k ] );
+	}
+
+	// Drop negligible weights and normalize.
+	parallelFor( numVertices, numThreads, [&]( unsigned begin, unsigned end )
+	{
+		for( unsigned i = begin; i < end; i++ )
+		{
+			vector< float >& attachment = attachments[ i ];
+			float sum = 0;
+			for( unsigned k = 0; k < boneJoints.size(); k++ )
+			{
+				const float w = weights[ k ][ i ];
+				if( w >= kMinBoneHeatWeight )
+				{
+					attachment[ boneJoints[ k ] ] = w;
+					sum += w;
+				}
+			}
+
+			if( sum > 0 )
+			{
+				for( unsigned j = 0; j < numJoints; j++ )
+				{
+					attachment[ j ] /= sum;
+				}
+			}
+			else
+			{
+				attachment[ bones[ nearestBone[ i ] ].joint ] = 1;
+			}
+		}
+	} );
+	stats.solveSeconds = secondsSince( start );
+}
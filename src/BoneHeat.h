@@ -0,0 +1,47 @@
+#ifndef BONE_HEAT_H
+#define BONE_HEAT_H
+
+#include <vector>
+#include <vecmath.h>
+
+#include "Mesh.h"
+
+// Automatic skinning weights by bone heat diffusion (Baran and Popovic,
+// "Automatic Rigging and Animation of 3D Characters").
+//
+// Every joint except the root owns the bones from it to its children; a
+// joint without any owns a ray continuing its parent bone. Each vertex is
+// heated by the nearest bone it can see (tested with rays against a
+// MeshBVH), with heat 1 / distance^2. The weights of joint j then solve
+//     ( L + M H ) w_j = M H p_j
+// where L is the cotangent Laplacian of the faces (negative cotangents
+// clamped to zero), M the lumped vertex areas, H the heat and p_j is 1 at
+// the vertices whose nearest visible bone is j's. The matrix is sparse,
+// symmetric and positive definite and the same for every joint, so it and
+// its incomplete Cholesky factor are built once, then the threads take the
+// joints in batches of up to four, each solved by preconditioned conjugate
+// gradients starting from p_j. Solving a batch together reads the matrix
+// once for all of its joints.
+//
+// Fills attachments with one weight per joint for every vertex (the root's
+// always 0, as Mesh::loadAttachments() assumes), normalized to sum to 1
+// with weights below kMinBoneHeatWeight dropped.
+
+struct BoneHeatStats
+{
+	unsigned numBones;
+	unsigned invisibleVertices; // vertices that see no bone, so get no heat
+	unsigned maxIterations;     // most conjugate gradient iterations of any joint
+	double maxResidual;         // largest final relative residual of any joint
+	double visibilitySeconds;
+	double assemblySeconds;
+	double solveSeconds;
+};
+
+void computeBoneHeatWeights( const Mesh& mesh, const std::vector< Vector3f >& jointPositions,
+	const std::vector< int >& jointParents, std::vector< std::vector< float > >& attachments,
+	BoneHeatStats& stats, unsigned numThreads = 0 );
+
+const float kMinBoneHeatWeight = 1e-4f;
+
+#endif // BONE_HEAT_H
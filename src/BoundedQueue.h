@@ -0,0 +1,75 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Fixed capacity FIFO shared between threads.
+// push() blocks while the queue is full, which gives the producer
+// backpressure; pop() blocks while it is empty.
+// After close(), push() fails and pop() drains what is left.
+template< typename T >
+class BoundedQueue
+{
+public:
+
+	explicit BoundedQueue( size_t capacity ) :
+		m_capacity( capacity ),
+		m_closed( false )
+	{
+	}
+
+	// Returns false if the queue was closed.
+	bool push( T item )
+	{
+		std::unique_lock< std::mutex > lock( m_mutex );
+		m_notFull.wait( lock, [this] { return m_closed || m_items.size() < m_capacity; } );
+
+		if( m_closed )
+		{
+			return false;
+		}
+
+		m_items.push_back( std::move( item ) );
+		m_notEmpty.notify_one();
+		return true;
+	}
+
+	// Returns false once the queue is closed and empty.
+	bool pop( T& item )
+	{
+		std::unique_lock< std::mutex > lock( m_mutex );
+		m_notEmpty.wait( lock, [this] { return m_closed || !m_items.empty(); } );
+
+		if( m_items.empty() )
+		{
+			return false;
+		}
+
+		item = std::move( m_items.front() );
+		m_items.pop_front();
+		m_notFull.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_closed = true;
+		m_notFull.notify_all();
+		m_notEmpty.notify_all();
+	}
+
+private:
+
+	size_t m_capacity;
+	bool m_closed;
+	std::deque< T > m_items;
+
+	std::mutex m_mutex;
+	std::condition_variable m_notFull;
+	std::condition_variable m_notEmpty;
+};
+
+#endif // BOUNDED_QUEUE_H
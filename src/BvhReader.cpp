@@ -0,0 +1,484 @@
+#include "BvhReader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "InverseKinematics.h"
+
+using namespace std;
+
+namespace
+{
+	const float kRadiansPerDegree = 3.14159265358979f / 180.0f;
+
+	const Vector3f kAxes[ 3 ] = { Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 1) };
+
+	const char* const kChannelNames[ 6 ] = { "Xposition", "Yposition", "Zposition", "Xrotation", "Yrotation", "Zrotation" };
+
+	// exactly representable as doubles
+	const double kPowersOf10[ 23 ] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	bool isSpace( char c )
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	bool isDigit( char c )
+	{
+		return (unsigned)(c - '0') < 10;
+	}
+
+	// Next whitespace separated token of [ p, end ), moving p past it.
+	// Empty at the end.
+	string nextToken( const char*& p, const char* end )
+	{
+		while (p < end && isSpace(*p))
+		{
+			p++;
+		}
+		const char* start = p;
+		while (p < end && !isSpace(*p))
+		{
+			p++;
+		}
+		return string(start, p);
+	}
+
+	// Parses a decimal number ("-12.5", "3e-4") after whitespace in
+	// [ p, end ) and moves p past it, never reading past end (the file is
+	// mapped, not a terminated string). Keeps 19 significant digits in an
+	// integer and scales it once by a power of ten, which is accurate to
+	// the last bit of a float.
+	bool parseNumber( const char*& p, const char* end, float& value )
+	{
+		while (p < end && isSpace(*p))
+		{
+			p++;
+		}
+
+		const char* q = p;
+		const bool negative = (q < end && *q == '-');
+		if (q < end && (*q == '-' || *q == '+'))
+		{
+			q++;
+		}
+
+		unsigned long long mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any = false;
+		for (; q < end && isDigit(*q); q++)
+		{
+			any = true;
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*q - '0');
+				digits += (mantissa != 0);
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if (q < end && *q == '.')
+		{
+			for (q++; q < end && isDigit(*q); q++)
+			{
+				any = true;
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*q - '0');
+					digits += (mantissa != 0);
+					exponent--;
+				}
+			}
+		}
+		if (!any)
+		{
+			return false;
+		}
+
+		if (q < end && (*q == 'e' || *q == 'E'))
+		{
+			const char* r = q + 1;
+			const bool negativeExponent = (r < end && *r == '-');
+			if (r < end && (*r == '-' || *r == '+'))
+			{
+				r++;
+			}
+			if (r < end && isDigit(*r))
+			{
+				int e = 0;
+				for (; r < end && isDigit(*r); r++)
+				{
+					e = std::min(e * 10 + (*r - '0'), 1000);
+				}
+				exponent += negativeExponent ? -e : e;
+				q = r;
+			}
+		}
+
+		double result = (double)mantissa;
+		for (; exponent > 22; exponent -= 22)
+		{
+			result *= kPowersOf10[22];
+		}
+		for (; exponent < -22; exponent += 22)
+		{
+			result /= kPowersOf10[22];
+		}
+		result = exponent >= 0 ? result * kPowersOf10[exponent] : result / kPowersOf10[-exponent];
+
+		value = (float)(negative ? -result : result);
+		p = q;
+		return true;
+	}
+
+	string trim( const string& s )
+	{
+		const size_t first = s.find_first_not_of(" \t\r");
+		if (first == string::npos)
+		{
+			return string();
+		}
+		return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+	}
+}
+
+BvhReader::BvhReader() :
+	m_data(nullptr),
+	m_size(0),
+	m_numChannels(0),
+	m_numFrames(0),
+	m_frameTime(0),
+	m_nextFrame(0)
+{
+}
+
+BvhReader::~BvhReader()
+{
+	close();
+}
+
+bool BvhReader::open( const char* filename )
+{
+	close();
+
+	const int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		std::cerr << "Error: File could not be opened [in BvhReader::open()]!" << std::endl;
+		return false;
+	}
+
+	struct stat status;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &status) == 0 && status.st_size > 0)
+	{
+		data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "Error: " << filename << " could not be mapped [in BvhReader::open()]!" << std::endl;
+		return false;
+	}
+
+	// frames are read front to back: let the kernel read ahead and
+	// drop the pages behind
+	madvise(data, status.st_size, MADV_SEQUENTIAL);
+	m_data = static_cast< const char* >(data);
+	m_size = status.st_size;
+
+	const char* p = m_data;
+	if (!parseHeader(p, m_data + m_size))
+	{
+		std::cerr << "Error: " << filename << " has no valid BVH hierarchy [in BvhReader::open()]!" << std::endl;
+		close();
+		return false;
+	}
+
+	m_frameStarts.assign(1, p - m_data);
+	m_nextFrame = 0;
+	return true;
+}
+
+bool BvhReader::parseHeader( const char*& p, const char* end )
+{
+	if (nextToken(p, end) != "HIERARCHY")
+	{
+		return false;
+	}
+
+	// joints whose block is open, innermost last; -1 for an End Site
+	vector< int > open;
+	string token;
+	while (!(token = nextToken(p, end)).empty() && token != "MOTION")
+	{
+		if (token == "ROOT" || token == "JOINT")
+		{
+			if ((token == "ROOT") != open.empty() || (!open.empty() && open.back() < 0))
+			{
+				return false;
+			}
+
+			Joint joint;
+			joint.name = nextToken(p, end);
+			joint.parent = open.empty() ? -1 : open.back();
+			joint.offset = Vector3f(0, 0, 0);
+			joint.firstChannel = m_numChannels;
+			if (nextToken(p, end) != "{")
+			{
+				return false;
+			}
+			open.push_back(m_joints.size());
+			m_joints.push_back(joint);
+		}
+		else if (token == "End")
+		{
+			if (open.empty() || nextToken(p, end) != "Site" || nextToken(p, end) != "{")
+			{
+				return false;
+			}
+			open.push_back(-1);
+		}
+		else if (token == "OFFSET")
+		{
+			float xyz[ 3 ];
+			if (open.empty() || !parseNumber(p, end, xyz[0]) || !parseNumber(p, end, xyz[1]) || !parseNumber(p, end, xyz[2]))
+			{
+				return false;
+			}
+			if (open.back() >= 0)
+			{
+				m_joints[open.back()].offset = Vector3f(xyz[0], xyz[1], xyz[2]);
+			}
+		}
+		else if (token == "CHANNELS")
+		{
+			const int count = atoi(nextToken(p, end).c_str());
+			if (open.empty() || open.back() < 0 || count < 0 || count > 6)
+			{
+				return false;
+			}
+
+			Joint& joint = m_joints[open.back()];
+			joint.firstChannel = m_numChannels;
+			joint.channels.clear();
+			for (int c = 0; c < count; c++)
+			{
+				const string name = nextToken(p, end);
+				int channel = 0;
+				while (channel < 6 && name != kChannelNames[channel])
+				{
+					channel++;
+				}
+				if (channel == 6)
+				{
+					return false;
+				}
+				joint.channels.push_back(Channel(channel));
+			}
+			m_numChannels += count;
+		}
+		else if (token == "}")
+		{
+			if (open.empty())
+			{
+				return false;
+			}
+			open.pop_back();
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	if (token != "MOTION" || !open.empty() || m_joints.empty())
+	{
+		return false;
+	}
+
+	// "Frames: N" and "Frame Time: t"
+	float frameTime;
+	if (nextToken(p, end) != "Frames:")
+	{
+		return false;
+	}
+	m_numFrames = strtoul(nextToken(p, end).c_str(), NULL, 10);
+	if (nextToken(p, end) != "Frame" || nextToken(p, end) != "Time:" || !parseNumber(p, end, frameTime))
+	{
+		return false;
+	}
+	m_frameTime = frameTime;
+	return true;
+}
+
+void BvhReader::close()
+{
+	if (m_data)
+	{
+		munmap(const_cast< char* >(m_data), m_size);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_joints.clear();
+	m_numChannels = 0;
+	m_numFrames = 0;
+	m_frameTime = 0;
+	m_frameStarts.clear();
+	m_nextFrame = 0;
+}
+
+int BvhReader::findJoint( const string& name ) const
+{
+	for (unsigned j = 0; j < m_joints.size(); j++)
+	{
+		if (m_joints[j].name == name)
+		{
+			return j;
+		}
+	}
+	return -1;
+}
+
+bool BvhReader::readFrame( vector< float >& channels )
+{
+	if (!m_data)
+	{
+		return false;
+	}
+
+	const char* p = m_data + m_frameStarts[m_nextFrame];
+	const char* end = m_data + m_size;
+	channels.resize(m_numChannels);
+	for (unsigned c = 0; c < m_numChannels; c++)
+	{
+		if (!parseNumber(p, end, channels[c]))
+		{
+			return false;
+		}
+	}
+
+	m_nextFrame++;
+	if (m_nextFrame == m_frameStarts.size())
+	{
+		m_frameStarts.push_back(p - m_data);
+	}
+	return true;
+}
+
+bool BvhReader::seekFrame( unsigned frame )
+{
+	if (!m_data)
+	{
+		return false;
+	}
+
+	if (frame < m_frameStarts.size())
+	{
+		m_nextFrame = frame;
+		return true;
+	}
+
+	m_nextFrame = m_frameStarts.size() - 1;
+	vector< float > channels;
+	while (m_nextFrame < frame)
+	{
+		if (!readFrame(channels))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+Quat4f BvhReader::jointRotation( unsigned joint, const vector< float >& channels ) const
+{
+	const Joint& j = m_joints[joint];
+	Quat4f rotation(1, 0, 0, 0);
+	for (unsigned k = 0; k < j.channels.size(); k++)
+	{
+		if (j.channels[k] < kXrotation)
+		{
+			continue;
+		}
+
+		Quat4f turn;
+		turn.setAxisAngle(channels[j.firstChannel + k] * kRadiansPerDegree, kAxes[j.channels[k] - kXrotation]);
+		rotation = rotation * turn;
+	}
+	return rotation;
+}
+
+bool loadBvhJointMap( const char* filename, const BvhReader& bvh, const vector< string >& rigJointNames,
+	vector< int >& bvhJoints )
+{
+	bvhJoints.assign(rigJointNames.size(), -1);
+
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cerr << "Error: File could not be opened [in loadBvhJointMap()]!" << std::endl;
+		return false;
+	}
+
+	bool ok = true;
+	string line;
+	while (std::getline(file, line))
+	{
+		line = trim(line);
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		const size_t equals = line.find('=');
+		const string rigName = trim(line.substr(0, equals));
+		const string bvhName = (equals == string::npos) ? string() : trim(line.substr(equals + 1));
+
+		unsigned rigJoint = 0;
+		while (rigJoint < rigJointNames.size() && rigJointNames[rigJoint] != rigName)
+		{
+			rigJoint++;
+		}
+		const int bvhJoint = bvh.findJoint(bvhName);
+		if (rigJoint == rigJointNames.size() || bvhJoint < 0)
+		{
+			std::cerr << "Error: No joints for \"" << line << "\" [in loadBvhJointMap()]!" << std::endl;
+			ok = false;
+			continue;
+		}
+		bvhJoints[rigJoint] = bvhJoint;
+	}
+	return ok;
+}
+
+void retargetBvhFrame( const BvhReader& bvh, const vector< int >& bvhJoints, const vector< float >& channels,
+	vector< Quat4f >& rotations )
+{
+	rotations.assign(bvhJoints.size(), Quat4f(1, 0, 0, 0));
+	for (unsigned j = 0; j < bvhJoints.size(); j++)
+	{
+		if (bvhJoints[j] >= 0)
+		{
+			rotations[j] = bvh.jointRotation(bvhJoints[j], channels);
+		}
+	}
+}
+
+Vector3f rigJointAngles( const Quat4f& rotation )
+{
+	return InverseKinematics::eulerAngles(Matrix3f::rotation(rotation));
+}
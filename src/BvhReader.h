@@ -0,0 +1,114 @@
+#ifndef BVH_READER_H
+#define BVH_READER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <vecmath.h>
+
+// Streaming reader for Biovision BVH motion capture files.
+//
+// The HIERARCHY section (joint names, offsets and channels) is parsed by
+// open(). The MOTION section is read one frame at a time straight from a
+// read-only memory map of the file, with a parser for plain decimal
+// numbers that does not go through strtof(), so captures of hundreds of
+// megabytes are never loaded or parsed as a whole. The offset of every
+// frame read so far is kept, so seeking back is immediate and seeking
+// forward parses only the frames skipped over for the first time.
+class BvhReader
+{
+public:
+
+	enum Channel
+	{
+		kXposition, kYposition, kZposition,
+		kXrotation, kYrotation, kZrotation
+	};
+
+	struct Joint
+	{
+		std::string name;
+		int parent; // -1 for the root
+		Vector3f offset;
+
+		// the joint's channels of a frame are
+		// [ firstChannel, firstChannel + channels.size() )
+		unsigned firstChannel;
+		std::vector< Channel > channels;
+	};
+
+	BvhReader();
+	~BvhReader();
+
+	BvhReader( const BvhReader& ) = delete;
+	BvhReader& operator = ( const BvhReader& ) = delete;
+
+	// Closes the open file, if any, first. Returns false, leaving the
+	// reader closed, if the file is missing or its hierarchy malformed.
+	bool open( const char* filename );
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+	size_t fileSize() const { return m_size; }
+
+	unsigned numJoints() const { return m_joints.size(); }
+	const Joint& joint( unsigned index ) const { return m_joints[ index ]; }
+	int findJoint( const std::string& name ) const; // -1 if there is none
+
+	unsigned numChannels() const { return m_numChannels; }
+	unsigned numFrames() const { return m_numFrames; } // as declared by the file
+	float frameTime() const { return m_frameTime; }    // seconds
+
+	// Reads the channels of the next frame, in degrees for rotations.
+	// Returns false at the end of the motion or on a malformed frame.
+	bool readFrame( std::vector< float >& channels );
+
+	// Makes frame the next one readFrame() reads. Returns false if the
+	// motion ends before it.
+	bool seekFrame( unsigned frame );
+	unsigned nextFrame() const { return m_nextFrame; }
+
+	// Local rotation of joint for a frame of channels: its rotation
+	// channels composed in the order the file lists them.
+	Quat4f jointRotation( unsigned joint, const std::vector< float >& channels ) const;
+
+private:
+
+	// Parses HIERARCHY and the MOTION header from p, leaving p at the
+	// start of the first frame. Returns false if they are malformed.
+	bool parseHeader( const char*& p, const char* end );
+
+	const char* m_data;
+	size_t m_size;
+
+	std::vector< Joint > m_joints;
+	unsigned m_numChannels;
+	unsigned m_numFrames;
+	float m_frameTime;
+
+	// m_frameStarts[ f ] is the file offset of frame f, known for the
+	// frames read so far and the one after them
+	std::vector< size_t > m_frameStarts;
+	unsigned m_nextFrame;
+};
+
+// Reads a joint map: one line per driven rig joint,
+//     Rig joint name = BVH joint name
+// e.g. "Left knee = LeftLeg", with blank lines and lines starting with '#'
+// skipped. Fills bvhJoints with the index of the BVH joint driving each
+// of rigJointNames (-1 for none). Returns false if the file is missing or
+// a line names a joint that does not exist; the other lines still apply.
+bool loadBvhJointMap( const char* filename, const BvhReader& bvh, const std::vector< std::string >& rigJointNames,
+	std::vector< int >& bvhJoints );
+
+// Per rig joint, the local rotation of the BVH joint mapped to it in a
+// frame of channels (identity for joints without one). Rotations are
+// copied as they are, so the rig's rest pose should match the capture's;
+// root translation is dropped, as the rig has none.
+void retargetBvhFrame( const BvhReader& bvh, const std::vector< int >& bvhJoints, const std::vector< float >& channels,
+	std::vector< Quat4f >& rotations );
+
+// (rX, rY, rZ) for SkeletalModel::setJointTransform() from a rotation.
+Vector3f rigJointAngles( const Quat4f& rotation );
+
+#endif // BVH_READER_H
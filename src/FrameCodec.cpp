@@ -0,0 +1,196 @@
+#include "FrameCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+	// Writes value at p and returns the position after it (at most 5 bytes)
+	unsigned char* putVarint( unsigned value, unsigned char* p )
+	{
+		while (value >= 0x80)
+		{
+			*p++ = (unsigned char)(value | 0x80);
+			value >>= 7;
+		}
+		*p++ = (unsigned char)value;
+		return p;
+	}
+
+	// Returns false if the varint runs past end
+	bool getVarint( const unsigned char*& p, const unsigned char* end, unsigned& value )
+	{
+		value = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			if (p == end)
+			{
+				return false;
+			}
+
+			const unsigned char byte = *p++;
+			value |= (unsigned)(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// getVarint() for when at least 5 bytes are left, so the end needs
+	// no checks. Most deltas take one byte, which is the first branch.
+	unsigned getVarintUnchecked( const unsigned char*& p )
+	{
+		unsigned value = *p++;
+		if (value < 0x80)
+		{
+			return value;
+		}
+
+		value &= 0x7f;
+		for (int shift = 7; shift < 35; shift += 7)
+		{
+			const unsigned char byte = *p++;
+			value |= (unsigned)(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				break;
+			}
+		}
+		return value;
+	}
+
+	unsigned char* putFloat( float f, unsigned char* p )
+	{
+		memcpy(p, &f, sizeof(float));
+		return p + sizeof(float);
+	}
+
+	// map signed deltas to small unsigned values: 0, -1, 1, -2, 2 ...
+	unsigned zigzag( int v )
+	{
+		return ((unsigned)v << 1) ^ (unsigned)(v >> 31);
+	}
+
+	int unzigzag( unsigned v )
+	{
+		return (int)(v >> 1) ^ -(int)(v & 1);
+	}
+}
+
+void encodeFrame( const vector< Vector3f >& vertices, vector< unsigned char >& out )
+{
+	// Reserve the worst case up front and trim at the end
+	const size_t start = out.size();
+	out.resize(start + 5 + 6 * sizeof(float) + 15 * vertices.size());
+	unsigned char* p = &out[start];
+
+	p = putVarint(vertices.size(), p);
+
+	Vector3f lo(0, 0, 0);
+	Vector3f hi(0, 0, 0);
+	if (!vertices.empty())
+	{
+		lo = hi = vertices[0];
+	}
+	for (const Vector3f& v : vertices)
+	{
+		const float* xyz = v;
+		for (int k = 0; k < 3; k++)
+		{
+			lo[k] = std::min(lo[k], xyz[k]);
+			hi[k] = std::max(hi[k], xyz[k]);
+		}
+	}
+
+	for (int k = 0; k < 3; k++)
+	{
+		p = putFloat(lo[k], p);
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		p = putFloat(hi[k], p);
+	}
+
+	const float origin[ 3 ] = { lo[0], lo[1], lo[2] };
+	float toQuantized[ 3 ];
+	for (int k = 0; k < 3; k++)
+	{
+		toQuantized[k] = (hi[k] > lo[k]) ? 65535.0f / (hi[k] - lo[k]) : 0.0f;
+	}
+
+	int previous[ 3 ] = { 0, 0, 0 };
+	for (const Vector3f& v : vertices)
+	{
+		const float* xyz = v;
+		for (int k = 0; k < 3; k++)
+		{
+			// xyz >= origin, so truncation rounds to nearest
+			const int q = (int)((xyz[k] - origin[k]) * toQuantized[k] + 0.5f);
+			p = putVarint(zigzag(q - previous[k]), p);
+			previous[k] = q;
+		}
+	}
+
+	out.resize(p - &out[0]);
+}
+
+size_t decodeFrame( const unsigned char* data, size_t size, vector< Vector3f >& vertices )
+{
+	const unsigned char* p = data;
+	const unsigned char* end = data + size;
+
+	unsigned numVertices;
+	if (!getVarint(p, end, numVertices) || (size_t)(end - p) < 6 * sizeof(float))
+	{
+		return 0;
+	}
+
+	float bounds[ 6 ];
+	memcpy(bounds, p, sizeof(bounds));
+	p += sizeof(bounds);
+
+	float scale[ 3 ];
+	for (int k = 0; k < 3; k++)
+	{
+		scale[k] = (bounds[3 + k] - bounds[k]) / 65535.0f;
+	}
+
+	vertices.resize(numVertices);
+
+	int previous[ 3 ] = { 0, 0, 0 };
+	unsigned i = 0;
+
+	// while a whole vertex (3 varints of at most 5 bytes) is surely left
+	for (; i < numVertices && end - p >= 15; i++)
+	{
+		float* xyz = vertices[i];
+		for (int k = 0; k < 3; k++)
+		{
+			previous[k] += unzigzag(getVarintUnchecked(p));
+			xyz[k] = bounds[k] + previous[k] * scale[k];
+		}
+	}
+
+	for (; i < numVertices; i++)
+	{
+		float* xyz = vertices[i];
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned delta;
+			if (!getVarint(p, end, delta))
+			{
+				return 0;
+			}
+
+			previous[k] += unzigzag(delta);
+			xyz[k] = bounds[k] + previous[k] * scale[k];
+		}
+	}
+
+	return p - data;
+}
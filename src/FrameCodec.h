@@ -0,0 +1,27 @@
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <cstddef>
+#include <vector>
+#include <vecmath.h>
+
+// Lossy compression for one frame of deformed vertex positions.
+//
+// Layout of an encoded frame:
+//   varint  number of vertices
+//   float   AABB min x, y, z
+//   float   AABB max x, y, z
+//   varint  per component: zigzag( q[i] - q[i-1] )
+// where q is the position quantized to 16 bits per axis against the
+// frame's AABB. Neighbouring vertices are close in space (especially
+// after optimizeMeshLayout()), so most deltas fit in one or two bytes.
+// Every frame is self-contained, so frames can be decoded in any order.
+
+// Appends the encoded frame to out.
+void encodeFrame( const std::vector< Vector3f >& vertices, std::vector< unsigned char >& out );
+
+// Decodes a frame written by encodeFrame() into vertices.
+// Returns the number of bytes consumed, or 0 if the data is malformed.
+size_t decodeFrame( const unsigned char* data, size_t size, std::vector< Vector3f >& vertices );
+
+#endif // FRAME_CODEC_H
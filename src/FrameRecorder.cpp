@@ -0,0 +1,299 @@
+#ifndef WIN32
+// glGenBuffers and friends are exported directly by libGL
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include "FrameRecorder.h"
+#include "bitmap.h"
+
+#include <GL/glext.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace
+{
+	// PPM rows go top to bottom, GL rows bottom to top.
+	// Returns false if the file could not be written.
+	bool writePPM( const char* filename, int width, int height, const unsigned char* data )
+	{
+		FILE* file = fopen(filename, "wb");
+		if (!file)
+		{
+			return false;
+		}
+
+		bool written = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+		for (int y = height - 1; y >= 0 && written; y--)
+		{
+			written = fwrite(data + 3 * width * y, 1, 3 * width, file) == size_t(3 * width);
+		}
+		return fclose(file) == 0 && written;
+	}
+}
+
+FrameRecorder::FrameRecorder() :
+	m_recording(false),
+	m_pboBytes(0),
+	m_captured(0),
+	m_queue(NULL),
+	m_written(0),
+	m_failed(0),
+	m_dropped(0)
+{
+	for (int i = 0; i < kNumPBOs; i++)
+	{
+		m_pbos[i] = 0;
+		m_pending[i] = false;
+	}
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	// No GL context may be current any more: the owner calls stop() while
+	// its context is, and only the writer thread is left to end here.
+	if (m_recording)
+	{
+		stopWriter();
+	}
+}
+
+void FrameRecorder::start( const string& prefix, const string& extension )
+{
+	if (m_recording)
+	{
+		stop();
+	}
+
+	m_prefix = prefix;
+	m_extension = extension;
+	m_captured = 0;
+	m_written = 0;
+	m_failed = 0;
+	m_dropped = 0;
+
+	m_freeBuffers.clear();
+	for (int i = 0; i < kPoolSize; i++)
+	{
+		m_freeBuffers.push_back(&m_pool[i]);
+	}
+
+	// Never blocks: there are never more frames in flight than pool buffers
+	m_queue = new BoundedQueue< Frame >(kPoolSize);
+	m_writer = std::thread(&FrameRecorder::writeLoop, this);
+
+	m_recording = true;
+	cout << "recording frames to " << m_prefix << "_*." << m_extension << endl;
+}
+
+void FrameRecorder::stop()
+{
+	if (!m_recording)
+	{
+		return;
+	}
+
+	// Collect what is still in flight, oldest first
+	for (int i = 0; i < kNumPBOs; i++)
+	{
+		const int slot = (m_captured + i) % kNumPBOs;
+		if (m_pending[slot])
+		{
+			collect(slot);
+		}
+	}
+
+#ifndef WIN32
+	if (m_pbos[0] != 0)
+	{
+		glDeleteBuffers(kNumPBOs, m_pbos);
+	}
+#endif
+	for (int i = 0; i < kNumPBOs; i++)
+	{
+		m_pbos[i] = 0;
+	}
+	m_pboBytes = 0;
+
+	stopWriter();
+}
+
+void FrameRecorder::stopWriter()
+{
+	m_queue->close();
+	m_writer.join();
+	delete m_queue;
+	m_queue = NULL;
+
+	m_recording = false;
+	cout << "recording stopped: " << m_written << " frames written, " << m_dropped << " skipped";
+	if (m_failed > 0)
+	{
+		cout << ", " << m_failed << " failed to write";
+	}
+	cout << endl;
+}
+
+void FrameRecorder::capture( int width, int height )
+{
+	if (!m_recording)
+	{
+		return;
+	}
+
+	const int slot = m_captured % kNumPBOs;
+	const int bytes = 3 * width * height;
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_PACK_ROW_LENGTH, width);
+	glReadBuffer(GL_BACK);
+
+#ifdef WIN32
+	// No PBOs without an extension loader: read synchronously into a pool buffer.
+	m_pending[slot] = true;
+	m_pendingWidth[slot] = width;
+	m_pendingHeight[slot] = height;
+	collect(slot);
+#else
+	if (m_pbos[0] == 0)
+	{
+		glGenBuffers(kNumPBOs, m_pbos);
+	}
+
+	// The window was resized: drain the ring before reallocating it
+	if (bytes > m_pboBytes)
+	{
+		for (int i = 0; i < kNumPBOs; i++)
+		{
+			const int pending = (slot + i) % kNumPBOs;
+			if (m_pending[pending])
+			{
+				collect(pending);
+			}
+		}
+
+		for (int i = 0; i < kNumPBOs; i++)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		}
+		m_pboBytes = bytes;
+	}
+
+	// This slot was filled kNumPBOs frames ago, its transfer is done by now
+	if (m_pending[slot])
+	{
+		collect(slot);
+	}
+
+	// Start the asynchronous transfer of this frame
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_pending[slot] = true;
+	m_pendingWidth[slot] = width;
+	m_pendingHeight[slot] = height;
+#endif
+
+	m_captured++;
+}
+
+void FrameRecorder::collect( int slot )
+{
+	m_pending[slot] = false;
+
+	const int width = m_pendingWidth[slot];
+	const int height = m_pendingHeight[slot];
+
+	std::vector< unsigned char >* buffer = NULL;
+	{
+		std::lock_guard< std::mutex > lock(m_freeMutex);
+		if (!m_freeBuffers.empty())
+		{
+			buffer = m_freeBuffers.back();
+			m_freeBuffers.pop_back();
+		}
+	}
+
+	if (buffer == NULL)
+	{
+		// The writer is behind; skip the frame instead of stalling the viewer.
+		m_dropped++;
+		return;
+	}
+
+	// + 3: writeBMP() reads whole 4-byte padded rows
+	buffer->resize(3 * width * height + 3);
+
+#ifdef WIN32
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &(*buffer)[0]);
+#else
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+	const void* pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if (pixels)
+	{
+		memcpy(&(*buffer)[0], pixels, 3 * width * height);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (!pixels)
+	{
+		releaseBuffer(buffer);
+		m_dropped++;
+		return;
+	}
+#endif
+
+	Frame frame;
+	frame.pixels = buffer;
+	frame.width = width;
+	frame.height = height;
+	m_queue->push(frame);
+}
+
+void FrameRecorder::releaseBuffer( std::vector< unsigned char >* buffer )
+{
+	std::lock_guard< std::mutex > lock(m_freeMutex);
+	m_freeBuffers.push_back(buffer);
+}
+
+void FrameRecorder::writeLoop()
+{
+	Frame frame;
+	while (m_queue->pop(frame))
+	{
+		// Number frames in the order they are written so the sequence has no gaps
+		char filename[ 1024 ];
+		snprintf(filename, sizeof(filename), "%s_%05u.%s", m_prefix.c_str(), m_written, m_extension.c_str());
+
+		bool written;
+		if (m_extension == "ppm")
+		{
+			written = writePPM(filename, frame.width, frame.height, &(*frame.pixels)[0]);
+		}
+		else
+		{
+			written = writeBMP(filename, frame.width, frame.height, &(*frame.pixels)[0]);
+		}
+
+		// a failed frame's number is reused by the next one
+		if (written)
+		{
+			m_written++;
+		}
+		else
+		{
+			if (m_failed == 0)
+			{
+				std::cerr << "Error: Could not write " << filename << " [in FrameRecorder::writeLoop()]!" << std::endl;
+			}
+			m_failed++;
+		}
+		releaseBuffer(frame.pixels);
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <GL/gl.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+
+// Records every frame drawn by the view to a numbered image sequence
+// (prefix_00000.bmp, prefix_00001.bmp, ... or .ppm).
+//
+// capture() only issues an asynchronous glReadPixels into one of a small
+// ring of pixel buffer objects and collects the one issued kNumPBOs frames
+// earlier, which has finished transferring by then. The pixels are copied
+// into a buffer from a fixed pool and handed to a background thread that
+// writes the image file, so the render thread never waits on the GPU or
+// the disk. If the writer falls behind and the pool is empty the frame
+// is skipped rather than stalling the viewer; skipped frames are reported
+// by stop().
+class FrameRecorder
+{
+public:
+
+	FrameRecorder();
+	~FrameRecorder();
+
+	// extension is "bmp" or "ppm"
+	void start( const std::string& prefix, const std::string& extension );
+
+	// Collects outstanding frames, waits for the writer and prints a summary.
+	// The GL context used for capture() must be current. The destructor
+	// only stops the writer, dropping frames still on the GPU, so call
+	// stop() before the context goes away.
+	void stop();
+
+	bool recording() const { return m_recording; }
+
+	// Call after the frame is drawn, before the buffers are swapped,
+	// with the view's GL context current.
+	void capture( int width, int height );
+
+private:
+
+	enum { kNumPBOs = 3, kPoolSize = 8 };
+
+	struct Frame
+	{
+		std::vector< unsigned char >* pixels;
+		int width;
+		int height;
+	};
+
+	void collect( int slot );
+	void stopWriter();
+	void writeLoop();
+	void releaseBuffer( std::vector< unsigned char >* buffer );
+
+	bool m_recording;
+	std::string m_prefix;
+	std::string m_extension;
+
+	// pixel buffer objects, and the size of the frame pending in each
+	GLuint m_pbos[ kNumPBOs ];
+	bool m_pending[ kNumPBOs ];
+	int m_pendingWidth[ kNumPBOs ];
+	int m_pendingHeight[ kNumPBOs ];
+	int m_pboBytes;
+	unsigned m_captured;
+
+	// recycled pixel buffers
+	std::vector< unsigned char > m_pool[ kPoolSize ];
+	std::vector< std::vector< unsigned char >* > m_freeBuffers;
+	std::mutex m_freeMutex;
+
+	BoundedQueue< Frame >* m_queue;
+	std::thread m_writer;
+
+	// frames written and frames that failed to write; only touched by
+	// the writer thread while recording
+	unsigned m_written;
+	unsigned m_failed;
+
+	// frames skipped by capture() and collect(); only touched by the
+	// GL thread
+	unsigned m_dropped;
+};
+
+#endif // FRAME_RECORDER_H
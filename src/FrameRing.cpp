@@ -0,0 +1,292 @@
+#include "FrameRing.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+	const unsigned kMagic = 0x52445353; // "SSDR", unlike FrameWriter's "SSDF" files
+	const unsigned kVersion = 1;
+	const size_t kAlignment = 64;
+
+	// shm_open() names start with a slash
+	string sharedMemoryName(const char* name)
+	{
+		return name[0] == '/' ? string(name) : "/" + string(name);
+	}
+
+	unsigned long long steadyNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+// The magic is stored last, so a reader that sees it sees the rest.
+struct FrameRingHeader
+{
+	std::atomic<unsigned> magic;
+	unsigned version;
+	unsigned numVertices;
+	unsigned numSlots;
+	unsigned slotSize;
+	std::atomic<unsigned> closed;
+	std::atomic<unsigned long long> published;
+	char padding[ 32 ];
+};
+
+struct FrameRingSlot
+{
+	std::atomic<unsigned long long> sequence;
+	std::atomic<unsigned long long> publishTime;
+	char padding[ 48 ];
+
+	// the vertices follow the slot header
+	float* vertices() { return reinterpret_cast<float*>(this + 1); }
+	const float* vertices() const { return reinterpret_cast<const float*>(this + 1); }
+};
+
+static_assert(sizeof(FrameRingHeader) == kAlignment && sizeof(FrameRingSlot) == kAlignment,
+	"frame ring headers must match the layout in FrameRing.h");
+
+FrameRingWriter::FrameRingWriter() :
+	m_header(nullptr),
+	m_size(0),
+	m_numVertices(0),
+	m_nextFrame(0)
+{
+}
+
+FrameRingWriter::~FrameRingWriter()
+{
+	close();
+}
+
+bool FrameRingWriter::create(const char* name, unsigned numVertices, unsigned numSlots)
+{
+	close();
+
+	// the writer fills the slot of the oldest frame, so a single slot
+	// would leave readers no frame that is not being overwritten
+	if (numSlots < 2)
+	{
+		std::cerr << "Error: A ring needs at least 2 slots, not " << numSlots << " [in FrameRingWriter::create()]!" << std::endl;
+		return false;
+	}
+
+	const size_t slotSize = (sizeof(FrameRingSlot) + numVertices * 3 * sizeof(float) + kAlignment - 1) / kAlignment * kAlignment;
+	const size_t size = sizeof(FrameRingHeader) + numSlots * slotSize;
+
+	// a new object rather than truncating an old one, which would fault
+	// in the readers that still map it
+	const string sharedName = sharedMemoryName(name);
+	shm_unlink(sharedName.c_str());
+	const int fd = shm_open(sharedName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0 || ftruncate(fd, size) != 0)
+	{
+		std::cerr << "Error: Could not create shared memory " << sharedName << ": " << strerror(errno)
+			<< " [in FrameRingWriter::create()]!" << std::endl;
+		if (fd >= 0)
+		{
+			::close(fd);
+			shm_unlink(sharedName.c_str());
+		}
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "Error: Could not map shared memory " << sharedName << " [in FrameRingWriter::create()]!" << std::endl;
+		shm_unlink(sharedName.c_str());
+		return false;
+	}
+
+	// ftruncate() zero filled the ring, so every slot starts at sequence 0,
+	// which matches no frame
+	m_name = sharedName;
+	m_header = static_cast<FrameRingHeader*>(data);
+	m_size = size;
+	m_numVertices = numVertices;
+	m_nextFrame = 0;
+
+	m_header->version = kVersion;
+	m_header->numVertices = numVertices;
+	m_header->numSlots = numSlots;
+	m_header->slotSize = slotSize;
+	m_header->magic.store(kMagic, std::memory_order_release);
+	return true;
+}
+
+void FrameRingWriter::close()
+{
+	if (!m_header)
+	{
+		return;
+	}
+
+	m_header->closed.store(1, std::memory_order_release);
+	munmap(m_header, m_size);
+	shm_unlink(m_name.c_str());
+	m_header = nullptr;
+	m_size = 0;
+}
+
+FrameRingSlot* FrameRingWriter::slot(unsigned long long frame) const
+{
+	char* slots = reinterpret_cast<char*>(m_header + 1);
+	return reinterpret_cast<FrameRingSlot*>(slots + (frame % m_header->numSlots) * m_header->slotSize);
+}
+
+bool FrameRingWriter::publish(const vector<Vector3f>& vertices)
+{
+	if (!m_header || vertices.size() != m_numVertices)
+	{
+		std::cerr << "Error: Frame of " << vertices.size() << " vertices for a ring of " << m_numVertices
+			<< " [in FrameRingWriter::publish()]!" << std::endl;
+		return false;
+	}
+
+	memcpy(beginFrame(), &vertices[0], m_numVertices * 3 * sizeof(float));
+	endFrame();
+	return true;
+}
+
+float* FrameRingWriter::beginFrame()
+{
+	// odd while the slot is being written; the fence keeps the writes
+	// below from becoming visible before it
+	FrameRingSlot* s = slot(m_nextFrame);
+	s->sequence.store(2 * m_nextFrame + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	return s->vertices();
+}
+
+void FrameRingWriter::endFrame()
+{
+	FrameRingSlot* s = slot(m_nextFrame);
+	s->publishTime.store(steadyNanoseconds(), std::memory_order_relaxed);
+	s->sequence.store(2 * m_nextFrame + 2, std::memory_order_release);
+	m_nextFrame++;
+	m_header->published.store(m_nextFrame, std::memory_order_release);
+}
+
+FrameRingReader::FrameRingReader() :
+	m_header(nullptr),
+	m_size(0)
+{
+}
+
+FrameRingReader::~FrameRingReader()
+{
+	close();
+}
+
+bool FrameRingReader::open(const char* name)
+{
+	close();
+
+	const int fd = shm_open(sharedMemoryName(name).c_str(), O_RDONLY, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(FrameRingHeader))
+	{
+		data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const FrameRingHeader* header = static_cast<const FrameRingHeader*>(data);
+	if (header->magic.load(std::memory_order_acquire) != kMagic || header->version != kVersion ||
+		size_t(info.st_size) < sizeof(FrameRingHeader) + size_t(header->numSlots) * header->slotSize ||
+		header->slotSize < sizeof(FrameRingSlot) + header->numVertices * 3 * sizeof(float))
+	{
+		munmap(data, info.st_size);
+		return false;
+	}
+
+	m_header = header;
+	m_size = info.st_size;
+	return true;
+}
+
+void FrameRingReader::close()
+{
+	if (m_header)
+	{
+		munmap(const_cast<FrameRingHeader*>(m_header), m_size);
+		m_header = nullptr;
+		m_size = 0;
+	}
+}
+
+unsigned FrameRingReader::numVertices() const
+{
+	return m_header ? m_header->numVertices : 0;
+}
+
+unsigned FrameRingReader::numSlots() const
+{
+	return m_header ? m_header->numSlots : 0;
+}
+
+unsigned long long FrameRingReader::framesPublished() const
+{
+	return m_header ? m_header->published.load(std::memory_order_acquire) : 0;
+}
+
+bool FrameRingReader::isClosed() const
+{
+	return !m_header || m_header->closed.load(std::memory_order_acquire) != 0;
+}
+
+const FrameRingSlot* FrameRingReader::slot(unsigned long long frame) const
+{
+	const char* slots = reinterpret_cast<const char*>(m_header + 1);
+	return reinterpret_cast<const FrameRingSlot*>(slots + (frame % m_header->numSlots) * m_header->slotSize);
+}
+
+const float* FrameRingReader::frame(unsigned long long frame) const
+{
+	if (!m_header || frame >= framesPublished())
+	{
+		return nullptr;
+	}
+
+	const FrameRingSlot* s = slot(frame);
+	return s->sequence.load(std::memory_order_acquire) == 2 * frame + 2 ? s->vertices() : nullptr;
+}
+
+bool FrameRingReader::isValid(unsigned long long frame) const
+{
+	if (!m_header)
+	{
+		return false;
+	}
+
+	// the reads of the frame's data come before the sequence check
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot(frame)->sequence.load(std::memory_order_relaxed) == 2 * frame + 2;
+}
+
+unsigned long long FrameRingReader::publishTime(unsigned long long frame) const
+{
+	return m_header ? slot(frame)->publishTime.load(std::memory_order_relaxed) : 0;
+}
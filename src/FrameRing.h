@@ -0,0 +1,120 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <vecmath.h>
+
+// Ring of deformed frames in POSIX shared memory (shm_open()), so that
+// other processes on the machine, a renderer or a recorder, can read the
+// skinned vertices in place instead of receiving copies over a socket or
+// through a file. SkeletalModel::setFrameRing() publishes every mesh
+// update to a ring; skinringreader is an example reader.
+//
+// One writer, any number of readers, no locks. Frame n (counting from 0)
+// goes to slot n % slot count. Each slot carries a sequence number, odd
+// while the writer fills the slot and 2n + 2 once frame n is complete,
+// and the header counts the frames published. A reader that falls more
+// than a ring behind loses frames; it never blocks the writer. Since a
+// slot can be overwritten while it is being read, a reader checks after
+// reading a frame that the frame is still there (isValid()).
+//
+// Layout: a 64 byte header ("SSDR", uint32 version, vertex count, slot
+// count, slot size, closed flag, uint64 frames published), then the slots,
+// each a 64 byte header (uint64 sequence, uint64 publish time in ns on the
+// steady clock) and the x, y, z floats of the vertices, padded to 64 bytes.
+
+struct FrameRingHeader;
+struct FrameRingSlot;
+
+// Creates the ring and publishes frames to it. The shared memory object
+// is removed by close() (or the destructor); readers that have it open
+// keep their mapping.
+class FrameRingWriter
+{
+public:
+
+	FrameRingWriter();
+	~FrameRingWriter();
+
+	FrameRingWriter( const FrameRingWriter& ) = delete;
+	FrameRingWriter& operator = ( const FrameRingWriter& ) = delete;
+
+	// Creates the shared memory object name ("/name"), replacing any
+	// left behind, for frames of numVertices. Returns false, leaving the
+	// ring closed, if it could not be created or numSlots is less than 2.
+	bool create( const char* name, unsigned numVertices, unsigned numSlots = 8 );
+
+	// Marks the ring closed for the readers and removes it.
+	void close();
+
+	bool isOpen() const { return m_header != nullptr; }
+	unsigned numVertices() const { return m_numVertices; }
+	unsigned long long framesPublished() const { return m_nextFrame; }
+
+	// Copies vertices to the next slot and publishes it. Returns false if
+	// the ring is closed or vertices is not a frame of the ring's size.
+	bool publish( const std::vector< Vector3f >& vertices );
+
+	// For writing a frame in place: beginFrame() returns the slot's
+	// 3 x numVertices() floats, and endFrame() publishes them.
+	float* beginFrame();
+	void endFrame();
+
+private:
+
+	FrameRingSlot* slot( unsigned long long frame ) const;
+
+	std::string m_name;
+	FrameRingHeader* m_header;
+	size_t m_size;
+	unsigned m_numVertices;
+	unsigned long long m_nextFrame;
+};
+
+// Read only mapping of a ring created by a FrameRingWriter.
+class FrameRingReader
+{
+public:
+
+	FrameRingReader();
+	~FrameRingReader();
+
+	FrameRingReader( const FrameRingReader& ) = delete;
+	FrameRingReader& operator = ( const FrameRingReader& ) = delete;
+
+	// Returns false, leaving the reader closed, if there is no ring name
+	// or it is not (yet) initialized.
+	bool open( const char* name );
+	void close();
+
+	bool isOpen() const { return m_header != nullptr; }
+	unsigned numVertices() const;
+	unsigned numSlots() const;
+
+	// Number of frames published so far; the newest is framesPublished() - 1.
+	unsigned long long framesPublished() const;
+
+	// True once the writer has closed the ring; no frames will follow.
+	bool isClosed() const;
+
+	// The 3 x numVertices() floats of frame, read in place, or NULL if
+	// frame has not been published or has been overwritten. Use the
+	// data, then check isValid( frame ): if false, it was overwritten
+	// meanwhile and what was read may be torn.
+	const float* frame( unsigned long long frame ) const;
+	bool isValid( unsigned long long frame ) const;
+
+	// Steady clock time at which frame was published, in nanoseconds.
+	unsigned long long publishTime( unsigned long long frame ) const;
+
+private:
+
+	const FrameRingSlot* slot( unsigned long long frame ) const;
+
+	const FrameRingHeader* m_header;
+	size_t m_size;
+};
+
+#endif // FRAME_RING_H
@@ -0,0 +1,57 @@
+#include "Frustum.h"
+
+Frustum::Frustum()
+{
+	// accepts everything until set() is called
+	for (int i = 0; i < 6; i++)
+	{
+		m_planes[i][0] = m_planes[i][1] = m_planes[i][2] = 0;
+		m_planes[i][3] = 1;
+	}
+}
+
+Frustum::Frustum( const Matrix4f& viewProjection )
+{
+	set(viewProjection);
+}
+
+void Frustum::set( const Matrix4f& viewProjection )
+{
+	// In clip space a point is inside when -w <= x, y, z <= w,
+	// so each plane is row 3 plus or minus row 0, 1 or 2.
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			float* plane = m_planes[2 * axis + side];
+			const float sign = side ? -1.0f : 1.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				plane[c] = viewProjection(3, c) + sign * viewProjection(axis, c);
+			}
+		}
+	}
+}
+
+bool Frustum::intersects( const Vector3f& boxMin, const Vector3f& boxMax ) const
+{
+	const float* lo = boxMin;
+	const float* hi = boxMax;
+
+	for (int i = 0; i < 6; i++)
+	{
+		const float* plane = m_planes[i];
+
+		// the corner furthest along the plane normal
+		const float x = plane[0] >= 0 ? hi[0] : lo[0];
+		const float y = plane[1] >= 0 ? hi[1] : lo[1];
+		const float z = plane[2] >= 0 ? hi[2] : lo[2];
+
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
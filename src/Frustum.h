@@ -0,0 +1,27 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vecmath.h>
+
+// The six clip planes of a view frustum, extracted from a combined
+// projection * view matrix (Gribb and Hartmann), for culling boxes.
+class Frustum
+{
+public:
+
+	Frustum();
+	explicit Frustum( const Matrix4f& viewProjection );
+
+	void set( const Matrix4f& viewProjection );
+
+	// False only if the box is certainly outside: it lies entirely behind
+	// one of the planes. Boxes near a frustum corner may pass anyway.
+	bool intersects( const Vector3f& boxMin, const Vector3f& boxMax ) const;
+
+private:
+
+	// a * x + b * y + c * z + d >= 0 inside
+	float m_planes[ 6 ][ 4 ];
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,374 @@
+#include "GltfExport.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "SkeletalModel.h"
+#include "JointNames.h"
+
+using namespace std;
+
+// the model's arrays are written as they are
+static_assert(sizeof(Vector3f) == 3 * sizeof(float), "Vector3f is not 3 packed floats");
+static_assert(sizeof(Matrix4f) == 16 * sizeof(float), "Matrix4f is not 16 packed floats");
+static_assert(sizeof(Tuple3u) == 3 * sizeof(unsigned), "Tuple3u is not 3 packed indices");
+
+namespace
+{
+	const unsigned kGlbVersion = 2;
+	const unsigned kJsonChunk = 0x4E4F534A; // "JSON"
+	const unsigned kBinChunk = 0x004E4942;  // "BIN\0"
+
+	// accessor component types and buffer view targets
+	const unsigned kUnsignedByte = 5121;
+	const unsigned kUnsignedShort = 5123;
+	const unsigned kUnsignedInt = 5125;
+	const unsigned kFloat = 5126;
+	const unsigned kArrayBuffer = 34962;
+	const unsigned kElementArrayBuffer = 34963;
+
+	size_t align4( size_t size )
+	{
+		return (size + 3) & ~size_t(3);
+	}
+
+	// The binary chunk and the accessors over it. Each accessor gets its
+	// own buffer view, starting on a 4 byte boundary.
+	class GlbBuffer
+	{
+	public:
+
+		GlbBuffer() : m_size(0) {}
+
+		// Adds count elements of type ("SCALAR", "VEC3", ...) at data and
+		// returns the accessor's index. data must stay valid until
+		// write(). bounds is "" or the accessor's "min"/"max" members.
+		unsigned add( const void* data, size_t size, unsigned componentType, size_t count, const char* type,
+			unsigned target = 0, const string& bounds = string() )
+		{
+			ostringstream view;
+			view << "{\"buffer\":0,\"byteOffset\":" << m_size << ",\"byteLength\":" << size;
+			if (target)
+			{
+				view << ",\"target\":" << target;
+			}
+			view << "}";
+
+			ostringstream accessor;
+			accessor << "{\"bufferView\":" << m_views.size() << ",\"componentType\":" << componentType << ",\"count\":" << count
+				<< ",\"type\":\"" << type << "\"" << bounds << "}";
+
+			m_views.push_back(view.str());
+			m_accessors.push_back(accessor.str());
+			m_sections.push_back(Section{ data, size });
+			m_size = align4(m_size + size);
+			return m_accessors.size() - 1;
+		}
+
+		size_t size() const { return m_size; }
+
+		// "bufferViews" and "accessors" members of the JSON
+		void writeJson( ostream& json ) const
+		{
+			json << "\"buffers\":[{\"byteLength\":" << m_size << "}],\"bufferViews\":[";
+			for (unsigned i = 0; i < m_views.size(); i++)
+			{
+				json << (i ? "," : "") << m_views[i];
+			}
+			json << "],\"accessors\":[";
+			for (unsigned i = 0; i < m_accessors.size(); i++)
+			{
+				json << (i ? "," : "") << m_accessors[i];
+			}
+			json << "]";
+		}
+
+		// The sections in order, each padded with zeros to 4 bytes.
+		bool write( FILE* file ) const
+		{
+			const char padding[ 4 ] = { 0, 0, 0, 0 };
+			for (const Section& section : m_sections)
+			{
+				if (fwrite(section.data, 1, section.size, file) != section.size ||
+					fwrite(padding, 1, align4(section.size) - section.size, file) != align4(section.size) - section.size)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+
+		struct Section
+		{
+			const void* data;
+			size_t size;
+		};
+
+		vector< Section > m_sections;
+		vector< string > m_views;
+		vector< string > m_accessors;
+		size_t m_size;
+	};
+
+	string bounds( const float* minimum, const float* maximum, unsigned components )
+	{
+		ostringstream s;
+		s << setprecision(9) << ",\"min\":[";
+		for (unsigned c = 0; c < components; c++)
+		{
+			s << (c ? "," : "") << minimum[c];
+		}
+		s << "],\"max\":[";
+		for (unsigned c = 0; c < components; c++)
+		{
+			s << (c ? "," : "") << maximum[c];
+		}
+		s << "]";
+		return s.str();
+	}
+
+	// The 4 largest weights of a vertex, renormalized to sum to 1, and
+	// their joints (0 with weight 0 for missing ones).
+	template< typename Index >
+	void topInfluences( const vector< float >& weights, Index* joints, float* topWeights )
+	{
+		unsigned order[ 4 ] = { 0, 0, 0, 0 };
+		float largest[ 4 ] = { 0, 0, 0, 0 };
+		for (unsigned j = 0; j < weights.size(); j++)
+		{
+			// insert into the sorted top 4
+			float w = weights[j];
+			unsigned joint = j;
+			for (unsigned i = 0; i < 4 && w > 0; i++)
+			{
+				if (w > largest[i])
+				{
+					std::swap(w, largest[i]);
+					std::swap(joint, order[i]);
+				}
+			}
+		}
+
+		const float total = largest[0] + largest[1] + largest[2] + largest[3];
+		for (unsigned i = 0; i < 4; i++)
+		{
+			joints[i] = largest[i] > 0 ? order[i] : 0;
+			topWeights[i] = total > 0 ? largest[i] / total : (i == 0 ? 1.0f : 0.0f);
+		}
+	}
+}
+
+bool saveGlb( const char* filename, const SkeletalModel& model, const vector< vector< Vector3f > >& poses, float frameTime )
+{
+	const Mesh& mesh = model.mesh();
+	const unsigned numJoints = model.numJoints();
+	const unsigned numVertices = mesh.bindVertices.size();
+	if (numVertices == 0 || mesh.faces.empty() || mesh.attachments.size() != numVertices)
+	{
+		std::cerr << "Error: No skinned mesh to export [in saveGlb()]!" << std::endl;
+		return false;
+	}
+
+	GlbBuffer buffer;
+
+	float boxMin[ 3 ] = { mesh.bindVertices[0].x(), mesh.bindVertices[0].y(), mesh.bindVertices[0].z() };
+	float boxMax[ 3 ] = { boxMin[0], boxMin[1], boxMin[2] };
+	for (const Vector3f& v : mesh.bindVertices)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			boxMin[c] = std::min(boxMin[c], v[c]);
+			boxMax[c] = std::max(boxMax[c], v[c]);
+		}
+	}
+	const unsigned positions = buffer.add(&mesh.bindVertices[0], numVertices * sizeof(Vector3f), kFloat, numVertices, "VEC3",
+		kArrayBuffer, bounds(boxMin, boxMax, 3));
+
+	const bool hasNormals = (mesh.bindNormals.size() == numVertices);
+	const unsigned normals = hasNormals ?
+		buffer.add(&mesh.bindNormals[0], numVertices * sizeof(Vector3f), kFloat, numVertices, "VEC3", kArrayBuffer) : 0;
+
+	// 8 bit joint indices when they fit
+	vector< unsigned char > joints8;
+	vector< unsigned short > joints16;
+	vector< float > weights(4 * numVertices);
+	unsigned joints;
+	if (numJoints <= 256)
+	{
+		joints8.resize(4 * numVertices);
+		for (unsigned i = 0; i < numVertices; i++)
+		{
+			topInfluences(mesh.attachments[i], &joints8[4 * i], &weights[4 * i]);
+		}
+		joints = buffer.add(&joints8[0], joints8.size(), kUnsignedByte, numVertices, "VEC4", kArrayBuffer);
+	}
+	else
+	{
+		joints16.resize(4 * numVertices);
+		for (unsigned i = 0; i < numVertices; i++)
+		{
+			topInfluences(mesh.attachments[i], &joints16[4 * i], &weights[4 * i]);
+		}
+		joints = buffer.add(&joints16[0], joints16.size() * sizeof(unsigned short), kUnsignedShort, numVertices, "VEC4",
+			kArrayBuffer);
+	}
+	const unsigned weightsAccessor = buffer.add(&weights[0], weights.size() * sizeof(float), kFloat, numVertices, "VEC4",
+		kArrayBuffer);
+
+	const unsigned indices = buffer.add(&mesh.faces[0], mesh.faces.size() * sizeof(Tuple3u), kUnsignedInt, 3 * mesh.faces.size(),
+		"SCALAR", kElementArrayBuffer);
+
+	vector< Matrix4f > inverseBindMatrices(numJoints);
+	for (unsigned j = 0; j < numJoints; j++)
+	{
+		inverseBindMatrices[j] = model.jointBindWorldToJoint(j);
+	}
+	const unsigned inverseBind = buffer.add(&inverseBindMatrices[0], numJoints * sizeof(Matrix4f), kFloat, numJoints, "MAT4");
+
+	// one rotation track per joint, sampled at the same times
+	const unsigned numFrames = poses.size();
+	vector< float > times(numFrames);
+	vector< float > rotations(4 * numFrames * numJoints);
+	unsigned firstTrack = 0;
+	unsigned timeAccessor = 0;
+	if (numFrames > 0)
+	{
+		const Vector3f axes[ 3 ] = { Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 1) };
+		for (unsigned f = 0; f < numFrames; f++)
+		{
+			times[f] = f * frameTime;
+			for (unsigned j = 0; j < numJoints; j++)
+			{
+				// rotateX(rX) * rotateY(rY) * rotateZ(rZ), as setJointTransform()
+				Quat4f q(1, 0, 0, 0);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					Quat4f turn;
+					turn.setAxisAngle(j < poses[f].size() ? poses[f][j][axis] : 0.0f, axes[axis]);
+					q = q * turn;
+				}
+				q.normalize();
+
+				// glTF stores x, y, z, w
+				float* rotation = &rotations[4 * (j * numFrames + f)];
+				rotation[0] = q.x();
+				rotation[1] = q.y();
+				rotation[2] = q.z();
+				rotation[3] = q.w();
+			}
+		}
+
+		const float timeMin = times[0];
+		const float timeMax = times[numFrames - 1];
+		timeAccessor = buffer.add(&times[0], numFrames * sizeof(float), kFloat, numFrames, "SCALAR", 0,
+			bounds(&timeMin, &timeMax, 1));
+		for (unsigned j = 0; j < numJoints; j++)
+		{
+			const unsigned track = buffer.add(&rotations[4 * j * numFrames], 4 * numFrames * sizeof(float), kFloat, numFrames, "VEC4");
+			firstTrack = (j == 0) ? track : firstTrack;
+		}
+	}
+
+	// JSON: the joint nodes, then the mesh node
+	ostringstream json;
+	json << setprecision(9) << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"SSD saveGlb\"},\"scene\":0,\"scenes\":[{\"nodes\":[";
+	unsigned roots = 0;
+	for (unsigned j = 0; j < numJoints; j++)
+	{
+		if (model.jointParent(j) < 0)
+		{
+			json << (roots++ ? "," : "") << j;
+		}
+	}
+	json << (roots ? "," : "") << numJoints << "]}],\"nodes\":[";
+	for (unsigned j = 0; j < numJoints; j++)
+	{
+		const Vector3f offset = model.jointOffset(j);
+		json << "{\"name\":\"";
+		if (numJoints == kNumRigJoints)
+		{
+			json << kRigJointNames[j];
+		}
+		else
+		{
+			json << "Joint " << j;
+		}
+		json << "\",\"translation\":[" << offset.x() << "," << offset.y() << "," << offset.z() << "]";
+
+		unsigned children = 0;
+		for (unsigned k = j + 1; k < numJoints; k++)
+		{
+			if (model.jointParent(k) == (int)j)
+			{
+				json << (children++ ? "," : ",\"children\":[") << k;
+			}
+		}
+		json << (children ? "]},": "},");
+	}
+	json << "{\"name\":\"Mesh\",\"mesh\":0,\"skin\":0}],";
+
+	json << "\"skins\":[{\"inverseBindMatrices\":" << inverseBind << ",\"joints\":[";
+	for (unsigned j = 0; j < numJoints; j++)
+	{
+		json << (j ? "," : "") << j;
+	}
+	json << "]}],";
+
+	json << "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":" << positions;
+	if (hasNormals)
+	{
+		json << ",\"NORMAL\":" << normals;
+	}
+	json << ",\"JOINTS_0\":" << joints << ",\"WEIGHTS_0\":" << weightsAccessor << "},\"indices\":" << indices << ",\"mode\":4}]}],";
+
+	if (numFrames > 0)
+	{
+		json << "\"animations\":[{\"samplers\":[";
+		for (unsigned j = 0; j < numJoints; j++)
+		{
+			json << (j ? "," : "") << "{\"input\":" << timeAccessor << ",\"output\":" << firstTrack + j << ",\"interpolation\":\"LINEAR\"}";
+		}
+		json << "],\"channels\":[";
+		for (unsigned j = 0; j < numJoints; j++)
+		{
+			json << (j ? "," : "") << "{\"sampler\":" << j << ",\"target\":{\"node\":" << j << ",\"path\":\"rotation\"}}";
+		}
+		json << "]}],";
+	}
+
+	buffer.writeJson(json);
+	json << "}";
+
+	// the JSON chunk is padded with spaces, the binary one with zeros
+	string jsonChunk = json.str();
+	jsonChunk.resize(align4(jsonChunk.size()), ' ');
+
+	FILE* file = fopen(filename, "wb");
+	if (!file)
+	{
+		std::cerr << "Error: File could not be opened [in saveGlb()]!" << std::endl;
+		return false;
+	}
+
+	const unsigned header[ 4 ] = { kGlbVersion, unsigned(12 + 8 + jsonChunk.size() + 8 + buffer.size()), unsigned(jsonChunk.size()),
+		kJsonChunk };
+	const unsigned binHeader[ 2 ] = { unsigned(buffer.size()), kBinChunk };
+	fwrite("glTF", 1, 4, file);
+	fwrite(header, sizeof(unsigned), 4, file);
+	fwrite(jsonChunk.data(), 1, jsonChunk.size(), file);
+	fwrite(binHeader, sizeof(binHeader), 1, file);
+	bool ok = buffer.write(file);
+	ok = !ferror(file) && ok;
+	ok = (fclose(file) == 0) && ok;
+	if (!ok)
+	{
+		std::cerr << "Error: Could not write " << filename << " [in saveGlb()]!" << std::endl;
+	}
+	return ok;
+}
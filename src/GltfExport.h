@@ -0,0 +1,32 @@
+#ifndef GLTF_EXPORT_H
+#define GLTF_EXPORT_H
+
+#include <vector>
+#include <vecmath.h>
+
+class SkeletalModel;
+
+// Binary glTF 2.0 (.glb) export of a rig, for engines and tools that do
+// not read .skel/.obj/.attach.
+//
+// The file holds one node per joint in the skeleton's hierarchy, at the
+// joint offsets of the bind pose, and the full mesh in the bind pose as a
+// skinned mesh: POSITION (and NORMAL if the mesh has bind normals),
+// JOINTS_0 / WEIGHTS_0 with the 4 largest attachment weights of each
+// vertex renormalized, triangle indices, and inverse bind matrices taken
+// from the joints' bind world to joint transforms.
+//
+// poses, if not empty, is added as an animation sampled every frameTime
+// seconds: one (rX, rY, rZ) triple per joint and frame, with the meaning
+// of SkeletalModel::setJointTransform(), stored as linearly interpolated
+// joint rotations.
+//
+// The layout of the binary chunk is worked out first, so the JSON chunk
+// can be written ahead of it and the data is then written once, in
+// order, from the model's own arrays where they already have the glTF
+// layout. Returns false if the model has no mesh or the file could not
+// be written.
+bool saveGlb( const char* filename, const SkeletalModel& model,
+	const std::vector< std::vector< Vector3f > >& poses = std::vector< std::vector< Vector3f > >(), float frameTime = 1.0f / 30.0f );
+
+#endif // GLTF_EXPORT_H
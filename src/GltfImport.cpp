@@ -0,0 +1,959 @@
+#include "GltfImport.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Parallel.h"
+
+using namespace std;
+
+namespace
+{
+	// accessor component types
+	const unsigned kByte = 5120;
+	const unsigned kUnsignedByte = 5121;
+	const unsigned kShort = 5122;
+	const unsigned kUnsignedShort = 5123;
+	const unsigned kUnsignedInt = 5125;
+	const unsigned kFloat = 5126;
+
+	const unsigned kTriangles = 4;
+
+	// deeper JSON is rejected rather than recursed into
+	const int kMaxJsonDepth = 64;
+
+	// A parsed JSON value. Arrays keep their items in elements, objects
+	// their values in elements and the matching keys in keys.
+	struct JsonValue
+	{
+		enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+		JsonValue() : type(kNull), number(0) {}
+
+		// nullptr if this is not an object or has no such member
+		const JsonValue* member( const char* key ) const
+		{
+			for (unsigned i = 0; type == kObject && i < keys.size(); i++)
+			{
+				if (keys[i] == key)
+				{
+					return &elements[i];
+				}
+			}
+			return nullptr;
+		}
+
+		// the member's number, or fallback if it is missing or no number
+		double numberOr( const char* key, double fallback ) const
+		{
+			const JsonValue* value = member(key);
+			return (value && value->type == kNumber) ? value->number : fallback;
+		}
+
+		unsigned size() const { return (type == kArray) ? elements.size() : 0; }
+
+		Type type;
+		double number;
+		string text;
+		vector< JsonValue > elements;
+		vector< string > keys;
+	};
+
+	// Recursive descent over [ p, end ), which need not be terminated.
+	class JsonParser
+	{
+	public:
+
+		JsonParser( const char* begin, const char* end ) : m_p(begin), m_end(end) {}
+
+		// The whole input as one value.
+		bool parse( JsonValue& value )
+		{
+			return parseValue(value, 0) && (skipSpace(), m_p == m_end);
+		}
+
+	private:
+
+		void skipSpace()
+		{
+			while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+			{
+				m_p++;
+			}
+		}
+
+		bool consume( char c )
+		{
+			skipSpace();
+			if (m_p < m_end && *m_p == c)
+			{
+				m_p++;
+				return true;
+			}
+			return false;
+		}
+
+		bool consumeWord( const char* word )
+		{
+			const size_t length = strlen(word);
+			if ((size_t)(m_end - m_p) >= length && memcmp(m_p, word, length) == 0)
+			{
+				m_p += length;
+				return true;
+			}
+			return false;
+		}
+
+		bool parseValue( JsonValue& value, int depth )
+		{
+			skipSpace();
+			if (m_p == m_end || depth > kMaxJsonDepth)
+			{
+				return false;
+			}
+
+			switch (*m_p)
+			{
+			case '{':
+				value.type = JsonValue::kObject;
+				m_p++;
+				if (consume('}'))
+				{
+					return true;
+				}
+				do
+				{
+					value.keys.push_back(string());
+					value.elements.push_back(JsonValue());
+					if (!(skipSpace(), parseString(value.keys.back())) || !consume(':') ||
+						!parseValue(value.elements.back(), depth + 1))
+					{
+						return false;
+					}
+				}
+				while (consume(','));
+				return consume('}');
+
+			case '[':
+				value.type = JsonValue::kArray;
+				m_p++;
+				if (consume(']'))
+				{
+					return true;
+				}
+				do
+				{
+					value.elements.push_back(JsonValue());
+					if (!parseValue(value.elements.back(), depth + 1))
+					{
+						return false;
+					}
+				}
+				while (consume(','));
+				return consume(']');
+
+			case '"':
+				value.type = JsonValue::kString;
+				return parseString(value.text);
+
+			case 't':
+			case 'f':
+				value.type = JsonValue::kBool;
+				value.number = (*m_p == 't');
+				return consumeWord(*m_p == 't' ? "true" : "false");
+
+			case 'n':
+				return consumeWord("null");
+
+			default:
+				value.type = JsonValue::kNumber;
+				return parseNumber(value.number);
+			}
+		}
+
+		bool parseNumber( double& number )
+		{
+			// strtod() needs a terminated copy
+			char digits[ 64 ];
+			size_t length = 0;
+			while (m_p + length < m_end && length + 1 < sizeof(digits) && strchr("+-.0123456789eE", m_p[length]) && m_p[length])
+			{
+				digits[length] = m_p[length];
+				length++;
+			}
+			digits[length] = '\0';
+
+			char* last;
+			number = strtod(digits, &last);
+			if (length == 0 || last != digits + length)
+			{
+				return false;
+			}
+			m_p += length;
+			return true;
+		}
+
+		// Appends code point c to text as UTF-8.
+		static void appendUtf8( unsigned c, string& text )
+		{
+			if (c < 0x80)
+			{
+				text += char(c);
+			}
+			else if (c < 0x800)
+			{
+				text += char(0xC0 | (c >> 6));
+				text += char(0x80 | (c & 0x3F));
+			}
+			else if (c < 0x10000)
+			{
+				text += char(0xE0 | (c >> 12));
+				text += char(0x80 | ((c >> 6) & 0x3F));
+				text += char(0x80 | (c & 0x3F));
+			}
+			else
+			{
+				text += char(0xF0 | (c >> 18));
+				text += char(0x80 | ((c >> 12) & 0x3F));
+				text += char(0x80 | ((c >> 6) & 0x3F));
+				text += char(0x80 | (c & 0x3F));
+			}
+		}
+
+		bool parseHex4( unsigned& c )
+		{
+			if (m_end - m_p < 4)
+			{
+				return false;
+			}
+			c = 0;
+			for (int i = 0; i < 4; i++, m_p++)
+			{
+				const char h = *m_p;
+				const int digit = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 :
+					(h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+				if (digit < 0)
+				{
+					return false;
+				}
+				c = c * 16 + digit;
+			}
+			return true;
+		}
+
+		bool parseString( string& text )
+		{
+			if (m_p == m_end || *m_p != '"')
+			{
+				return false;
+			}
+			for (m_p++; m_p < m_end && *m_p != '"'; m_p++)
+			{
+				if (*m_p != '\\')
+				{
+					text += *m_p;
+					continue;
+				}
+
+				if (++m_p == m_end)
+				{
+					return false;
+				}
+				switch (*m_p)
+				{
+				case 'b': text += '\b'; break;
+				case 'f': text += '\f'; break;
+				case 'n': text += '\n'; break;
+				case 'r': text += '\r'; break;
+				case 't': text += '\t'; break;
+				case 'u':
+					{
+						unsigned c;
+						m_p++;
+						if (!parseHex4(c))
+						{
+							return false;
+						}
+						// a surrogate pair is two escapes
+						if (c >= 0xD800 && c < 0xDC00 && m_end - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u')
+						{
+							const char* next = m_p;
+							unsigned low;
+							m_p += 2;
+							if (parseHex4(low) && low >= 0xDC00 && low < 0xE000)
+							{
+								c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+							}
+							else
+							{
+								// not a low surrogate: parse the next escape on its own
+								m_p = next;
+							}
+						}
+						appendUtf8(c, text);
+						m_p--;
+					}
+					break;
+				default: text += *m_p; break; // '"', '\\' and '/'
+				}
+			}
+			if (m_p == m_end)
+			{
+				return false;
+			}
+			m_p++;
+			return true;
+		}
+
+		const char* m_p;
+		const char* m_end;
+	};
+
+	// A read-only private mapping of a whole file, unmapped on destruction.
+	class MappedFile
+	{
+	public:
+
+		MappedFile() : m_data(nullptr), m_size(0) {}
+		~MappedFile()
+		{
+			if (m_data)
+			{
+				munmap(const_cast< unsigned char* >(m_data), m_size);
+			}
+		}
+
+		MappedFile( const MappedFile& ) = delete;
+		MappedFile& operator = ( const MappedFile& ) = delete;
+
+		bool open( const char* filename )
+		{
+			const int fd = ::open(filename, O_RDONLY);
+			if (fd < 0)
+			{
+				std::cerr << "Error: " << filename << " could not be opened [in loadGltf()]!" << std::endl;
+				return false;
+			}
+
+			struct stat status;
+			void* data = MAP_FAILED;
+			if (fstat(fd, &status) == 0 && status.st_size > 0)
+			{
+				data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			}
+			::close(fd);
+			if (data == MAP_FAILED)
+			{
+				std::cerr << "Error: " << filename << " could not be mapped [in loadGltf()]!" << std::endl;
+				return false;
+			}
+			m_data = static_cast< const unsigned char* >(data);
+			m_size = status.st_size;
+			return true;
+		}
+
+		const unsigned char* data() const { return m_data; }
+		size_t size() const { return m_size; }
+
+	private:
+
+		const unsigned char* m_data;
+		size_t m_size;
+	};
+
+	struct Buffer
+	{
+		const unsigned char* data;
+		size_t size;
+	};
+
+	// The JSON of a .glb or .gltf and, if asked for, its buffers.
+	struct Document
+	{
+		MappedFile file;
+		vector< unique_ptr< MappedFile > > bufferFiles;
+		JsonValue json;
+		vector< Buffer > buffers;
+	};
+
+	unsigned readUnsigned( const unsigned char* p )
+	{
+		unsigned value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	bool openDocument( const char* filename, bool withBuffers, Document& document )
+	{
+		if (!document.file.open(filename))
+		{
+			return false;
+		}
+		const unsigned char* data = document.file.data();
+		const size_t size = document.file.size();
+
+		// a .glb: header, JSON chunk, optional binary chunk
+		const char* jsonBegin = reinterpret_cast< const char* >(data);
+		const char* jsonEnd = jsonBegin + size;
+		Buffer binaryChunk = { nullptr, 0 };
+		if (size >= 12 && memcmp(data, "glTF", 4) == 0)
+		{
+			const size_t length = readUnsigned(data + 8);
+			const size_t jsonLength = (size >= 20) ? readUnsigned(data + 12) : 0;
+			if (readUnsigned(data + 4) != 2 || length > size || jsonLength == 0 || 20 + jsonLength > length ||
+				readUnsigned(data + 16) != 0x4E4F534A)
+			{
+				std::cerr << "Error: " << filename << " is not a glTF 2.0 binary file [in loadGltf()]!" << std::endl;
+				return false;
+			}
+			jsonBegin = reinterpret_cast< const char* >(data + 20);
+			jsonEnd = jsonBegin + jsonLength;
+
+			const size_t binaryStart = 20 + ((jsonLength + 3) & ~size_t(3));
+			if (binaryStart + 8 <= length && readUnsigned(data + binaryStart + 4) == 0x004E4942 &&
+				readUnsigned(data + binaryStart) <= length - binaryStart - 8)
+			{
+				binaryChunk.data = data + binaryStart + 8;
+				binaryChunk.size = readUnsigned(data + binaryStart);
+			}
+		}
+
+		if (!JsonParser(jsonBegin, jsonEnd).parse(document.json) || document.json.type != JsonValue::kObject)
+		{
+			std::cerr << "Error: " << filename << " has malformed JSON [in loadGltf()]!" << std::endl;
+			return false;
+		}
+
+		const JsonValue* buffers = document.json.member("buffers");
+		for (unsigned b = 0; withBuffers && buffers && b < buffers->size(); b++)
+		{
+			const JsonValue& buffer = buffers->elements[b];
+			const JsonValue* uri = buffer.member("uri");
+			const size_t byteLength = buffer.numberOr("byteLength", 0);
+
+			Buffer mapped = binaryChunk;
+			if (uri && uri->type == JsonValue::kString)
+			{
+				if (uri->text.compare(0, 5, "data:") == 0)
+				{
+					std::cerr << "Error: " << filename << " embeds a buffer as a data URI, which is not supported [in loadGltf()]!"
+						<< std::endl;
+					return false;
+				}
+
+				// relative to the .gltf
+				const string name = filename;
+				const size_t slash = name.find_last_of('/');
+				const string path = (slash == string::npos) ? uri->text : name.substr(0, slash + 1) + uri->text;
+				document.bufferFiles.push_back(unique_ptr< MappedFile >(new MappedFile()));
+				if (!document.bufferFiles.back()->open(path.c_str()))
+				{
+					return false;
+				}
+				mapped.data = document.bufferFiles.back()->data();
+				mapped.size = document.bufferFiles.back()->size();
+			}
+			else if (b != 0)
+			{
+				mapped.data = nullptr;
+				mapped.size = 0;
+			}
+
+			if (byteLength > mapped.size)
+			{
+				std::cerr << "Error: buffer " << b << " of " << filename << " is shorter than its byteLength [in loadGltf()]!"
+					<< std::endl;
+				return false;
+			}
+			mapped.size = byteLength;
+			document.buffers.push_back(mapped);
+		}
+		return true;
+	}
+
+	// element index of array member key of value, or nullptr
+	const JsonValue* element( const JsonValue& value, const char* key, double index )
+	{
+		const JsonValue* array = value.member(key);
+		return (array && index >= 0 && index < array->size()) ? &array->elements[(unsigned)index] : nullptr;
+	}
+
+	unsigned componentSize( unsigned componentType )
+	{
+		switch (componentType)
+		{
+		case kByte: case kUnsignedByte: return 1;
+		case kShort: case kUnsignedShort: return 2;
+		case kUnsignedInt: case kFloat: return 4;
+		default: return 0;
+		}
+	}
+
+	unsigned componentCount( const string& type )
+	{
+		return type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : type == "MAT4" ? 16 : 0;
+	}
+
+	// Component of type componentType at p as a float, scaled to [ 0, 1 ]
+	// ([ -1, 1 ] if signed) if normalized.
+	float readComponent( const unsigned char* p, unsigned componentType, bool normalized )
+	{
+		switch (componentType)
+		{
+		case kByte:
+			{
+				const float c = *reinterpret_cast< const signed char* >(p);
+				return normalized ? std::max(c / 127.0f, -1.0f) : c;
+			}
+		case kUnsignedByte:
+			return normalized ? *p / 255.0f : *p;
+		case kShort:
+			{
+				short c;
+				memcpy(&c, p, sizeof(c));
+				return normalized ? std::max(c / 32767.0f, -1.0f) : c;
+			}
+		case kUnsignedShort:
+			{
+				unsigned short c;
+				memcpy(&c, p, sizeof(c));
+				return normalized ? c / 65535.0f : c;
+			}
+		case kUnsignedInt:
+			return readUnsigned(p);
+		default:
+			{
+				float c;
+				memcpy(&c, p, sizeof(c));
+				return c;
+			}
+		}
+	}
+
+	// Reads accessor index, of components components per element, into
+	// values. Integer accessors that are not normalized are read exactly
+	// into unsigned values and converted otherwise. Returns false if the
+	// accessor is missing, sparse, of another size, or outside its buffer.
+	template< typename T >
+	bool readAccessor( const Document& document, double index, unsigned components, vector< T >& values )
+	{
+		const JsonValue* accessor = element(document.json, "accessors", index);
+		const JsonValue* type = accessor ? accessor->member("type") : nullptr;
+		const JsonValue* view = accessor ? element(document.json, "bufferViews", accessor->numberOr("bufferView", -1)) : nullptr;
+		if (!type || !view || accessor->member("sparse") || componentCount(type->text) != components)
+		{
+			std::cerr << "Error: accessor " << index << " is missing, sparse or not of " << components << " components [in loadGltf()]!"
+				<< std::endl;
+			return false;
+		}
+
+		const unsigned componentType = accessor->numberOr("componentType", 0);
+		const JsonValue* normalizedMember = accessor->member("normalized");
+		const bool normalized = normalizedMember && normalizedMember->number != 0;
+		const size_t count = accessor->numberOr("count", 0);
+		const size_t elementSize = components * componentSize(componentType);
+		const size_t stride = view->numberOr("byteStride", elementSize);
+		const size_t viewStart = view->numberOr("byteOffset", 0);
+		const size_t viewLength = view->numberOr("byteLength", 0);
+		const size_t start = viewStart + (size_t)accessor->numberOr("byteOffset", 0);
+		const double bufferIndex = view->numberOr("buffer", -1);
+		const Buffer* buffer = (bufferIndex >= 0 && bufferIndex < document.buffers.size()) ? &document.buffers[(unsigned)bufferIndex] : nullptr;
+		// count is checked against the view before (count - 1) * stride can wrap
+		if (!buffer || !buffer->data || elementSize == 0 || stride < elementSize ||
+			(count > 0 && (count > viewLength / stride + 1 || start > buffer->size ||
+			start + (count - 1) * stride + elementSize > viewStart + viewLength ||
+			start + (count - 1) * stride + elementSize > buffer->size)))
+		{
+			std::cerr << "Error: accessor " << index << " is outside its buffer [in loadGltf()]!" << std::endl;
+			return false;
+		}
+
+		values.resize(count * components);
+		const unsigned char* p = buffer->data + start;
+		const unsigned size = componentSize(componentType);
+		for (size_t i = 0; i < count; i++, p += stride)
+		{
+			for (unsigned c = 0; c < components; c++)
+			{
+				values[i * components + c] = (T)readComponent(p + c * size, componentType, normalized);
+			}
+		}
+		return true;
+	}
+
+	Matrix4f nodeTransform( const JsonValue& node )
+	{
+		const JsonValue* matrix = node.member("matrix");
+		if (matrix && matrix->size() == 16)
+		{
+			// column major
+			Matrix4f m;
+			for (unsigned k = 0; k < 16; k++)
+			{
+				m(k % 4, k / 4) = matrix->elements[k].number;
+			}
+			return m;
+		}
+
+		Vector3f translation(0, 0, 0);
+		Vector3f scale(1, 1, 1);
+		Quat4f rotation(1, 0, 0, 0);
+		const JsonValue* t = node.member("translation");
+		const JsonValue* r = node.member("rotation");
+		const JsonValue* s = node.member("scale");
+		if (t && t->size() == 3)
+		{
+			translation = Vector3f(t->elements[0].number, t->elements[1].number, t->elements[2].number);
+		}
+		if (r && r->size() == 4)
+		{
+			// stored x, y, z, w
+			rotation = Quat4f(r->elements[3].number, r->elements[0].number, r->elements[1].number, r->elements[2].number);
+			rotation.normalize();
+		}
+		if (s && s->size() == 3)
+		{
+			scale = Vector3f(s->elements[0].number, s->elements[1].number, s->elements[2].number);
+		}
+		return Matrix4f::translation(translation) * Matrix4f::rotation(rotation) * Matrix4f::scaling(scale.x(), scale.y(), scale.z());
+	}
+
+	// The rig of a document: the first node with a mesh and a skin.
+	struct Skeleton
+	{
+		vector< int > parents;
+		vector< Vector3f > offsets;
+
+		// per joint of the skin: its index in parents
+		vector< unsigned > rigJoints;
+		// per joint of the skin: its world transform in the file times
+		// its inverse bind matrix, which puts the mesh in the bind pose
+		vector< Matrix4f > bindTransforms;
+
+		const JsonValue* mesh;
+	};
+
+	bool readSkeleton( const Document& document, bool withBindTransforms, Skeleton& skeleton )
+	{
+		const JsonValue* nodes = document.json.member("nodes");
+		const unsigned numNodes = nodes ? nodes->size() : 0;
+
+		const JsonValue* rigNode = nullptr;
+		for (unsigned n = 0; n < numNodes && !rigNode; n++)
+		{
+			if (nodes->elements[n].member("mesh") && nodes->elements[n].member("skin"))
+			{
+				rigNode = &nodes->elements[n];
+			}
+		}
+		const JsonValue* skin = rigNode ? element(document.json, "skins", rigNode->numberOr("skin", -1)) : nullptr;
+		skeleton.mesh = rigNode ? element(document.json, "meshes", rigNode->numberOr("mesh", -1)) : nullptr;
+		const JsonValue* skinJoints = skin ? skin->member("joints") : nullptr;
+		const unsigned numJoints = skinJoints ? skinJoints->size() : 0;
+		if (!skeleton.mesh || numJoints == 0)
+		{
+			std::cerr << "Error: No node with a mesh and a skin [in loadGltf()]!" << std::endl;
+			return false;
+		}
+
+		// parents of all nodes, and world transforms in order from the roots
+		vector< int > nodeParents(numNodes, -1);
+		for (unsigned n = 0; n < numNodes; n++)
+		{
+			const JsonValue* children = nodes->elements[n].member("children");
+			for (unsigned c = 0; children && c < children->size(); c++)
+			{
+				const double child = children->elements[c].number;
+				if (child < 0 || child >= numNodes || nodeParents[(unsigned)child] >= 0)
+				{
+					std::cerr << "Error: node " << n << " has a bad child [in loadGltf()]!" << std::endl;
+					return false;
+				}
+				nodeParents[(unsigned)child] = n;
+			}
+		}
+		vector< Matrix4f > world(numNodes);
+		vector< char > done(numNodes, 0);
+		for (unsigned n = 0; n < numNodes; n++)
+		{
+			// the chain up to the first node done, then down it
+			vector< unsigned > chain;
+			for (int m = n; m >= 0 && !done[m]; m = nodeParents[m])
+			{
+				chain.push_back(m);
+				if (chain.size() > numNodes)
+				{
+					std::cerr << "Error: The node hierarchy has a cycle [in loadGltf()]!" << std::endl;
+					return false;
+				}
+			}
+			for (unsigned i = chain.size(); i-- > 0; )
+			{
+				const unsigned m = chain[i];
+				const int parent = nodeParents[m];
+				world[m] = (parent >= 0 ? world[parent] : Matrix4f::identity()) * nodeTransform(nodes->elements[m]);
+				done[m] = 1;
+			}
+		}
+
+		// each joint's parent is its nearest ancestor in the skin
+		vector< int > skinIndex(numNodes, -1);
+		vector< unsigned > jointNodes(numJoints);
+		for (unsigned j = 0; j < numJoints; j++)
+		{
+			const double node = skinJoints->elements[j].number;
+			if (node < 0 || node >= numNodes || skinIndex[(unsigned)node] >= 0)
+			{
+				std::cerr << "Error: skin joint " << j << " is not a distinct node [in loadGltf()]!" << std::endl;
+				return false;
+			}
+			jointNodes[j] = node;
+			skinIndex[jointNodes[j]] = j;
+		}
+
+		vector< int > skinParents(numJoints, -1);
+		unsigned roots = 0;
+		for (unsigned j = 0; j < numJoints; j++)
+		{
+			int ancestor = nodeParents[jointNodes[j]];
+			while (ancestor >= 0 && skinIndex[ancestor] < 0)
+			{
+				ancestor = nodeParents[ancestor];
+			}
+			skinParents[j] = (ancestor >= 0) ? skinIndex[ancestor] : -1;
+			roots += (ancestor < 0);
+		}
+		if (roots != 1)
+		{
+			std::cerr << "Error: The skin has " << roots << " root joints, the rig needs one [in loadGltf()]!" << std::endl;
+			return false;
+		}
+
+		// In the skin's order, except that a joint listed before its parent
+		// moves after it: a skin that already has parents first (as
+		// saveGlb() writes) keeps its joint numbers.
+		skeleton.parents.clear();
+		skeleton.offsets.clear();
+		skeleton.rigJoints.assign(numJoints, numJoints);
+		vector< Vector3f > positions;
+		vector< unsigned > chain;
+		for (unsigned j = 0; j < numJoints; j++)
+		{
+			// j and its ancestors not placed yet, placed from the top
+			chain.clear();
+			for (int k = j; k >= 0 && skeleton.rigJoints[k] == numJoints; k = skinParents[k])
+			{
+				chain.push_back(k);
+			}
+			for (unsigned i = chain.size(); i-- > 0; )
+			{
+				const unsigned k = chain[i];
+				const int parent = (skinParents[k] >= 0) ? (int)skeleton.rigJoints[skinParents[k]] : -1;
+				const Vector3f position = world[jointNodes[k]].getCol(3).xyz();
+				skeleton.rigJoints[k] = skeleton.parents.size();
+				skeleton.parents.push_back(parent);
+				skeleton.offsets.push_back(parent >= 0 ? position - positions[parent] : position);
+				positions.push_back(position);
+			}
+		}
+
+		if (!withBindTransforms)
+		{
+			return true;
+		}
+
+		vector< float > inverseBind;
+		if (skin->member("inverseBindMatrices") &&
+			(!readAccessor(document, skin->numberOr("inverseBindMatrices", -1), 16, inverseBind) || inverseBind.size() != 16 * numJoints))
+		{
+			return false;
+		}
+		skeleton.bindTransforms.resize(numJoints);
+		for (unsigned j = 0; j < numJoints; j++)
+		{
+			Matrix4f m = Matrix4f::identity();
+			for (unsigned k = 0; !inverseBind.empty() && k < 16; k++)
+			{
+				m(k % 4, k / 4) = inverseBind[16 * j + k];
+			}
+			skeleton.bindTransforms[j] = world[jointNodes[j]] * m;
+		}
+		return true;
+	}
+}
+
+bool isGltfFile( const char* filename )
+{
+	const char* dot = strrchr(filename, '.');
+	return dot && (strcmp(dot, ".glb") == 0 || strcmp(dot, ".gltf") == 0);
+}
+
+bool loadGltfSkeleton( const char* filename, vector< int >& parents, vector< Vector3f >& offsets )
+{
+	Document document;
+	Skeleton skeleton;
+	if (!openDocument(filename, false, document) || !readSkeleton(document, false, skeleton))
+	{
+		return false;
+	}
+	parents.swap(skeleton.parents);
+	offsets.swap(skeleton.offsets);
+	return true;
+}
+
+bool loadGltf( const char* filename, vector< int >& parents, vector< Vector3f >& offsets, Mesh& mesh )
+{
+	Document document;
+	Skeleton skeleton;
+	if (!openDocument(filename, true, document) || !readSkeleton(document, true, skeleton))
+	{
+		return false;
+	}
+
+	const unsigned numJoints = skeleton.parents.size();
+	const JsonValue* primitives = skeleton.mesh->member("primitives");
+
+	mesh.bindVertices.clear();
+	mesh.faces.clear();
+	mesh.attachments.clear();
+
+	vector< float > positions;
+	vector< unsigned > indices;
+	vector< vector< unsigned > > joints;
+	vector< vector< float > > weights;
+	for (unsigned p = 0; primitives && p < primitives->size(); p++)
+	{
+		const JsonValue& primitive = primitives->elements[p];
+		const JsonValue* attributes = primitive.member("attributes");
+		if (primitive.numberOr("mode", kTriangles) != kTriangles || !attributes || !attributes->member("POSITION"))
+		{
+			continue;
+		}
+
+		if (!readAccessor(document, attributes->numberOr("POSITION", -1), 3, positions))
+		{
+			return false;
+		}
+		const unsigned first = mesh.bindVertices.size();
+		const unsigned count = positions.size() / 3;
+
+		// JOINTS_0 / WEIGHTS_0, JOINTS_1 / WEIGHTS_1, ...
+		joints.clear();
+		weights.clear();
+		for (unsigned set = 0; ; set++)
+		{
+			const string index = std::to_string(set);
+			const double jointsAccessor = attributes->numberOr(("JOINTS_" + index).c_str(), -1);
+			const double weightsAccessor = attributes->numberOr(("WEIGHTS_" + index).c_str(), -1);
+			if (jointsAccessor < 0 || weightsAccessor < 0)
+			{
+				break;
+			}
+			joints.push_back(vector< unsigned >());
+			weights.push_back(vector< float >());
+			if (!readAccessor(document, jointsAccessor, 4, joints.back()) || !readAccessor(document, weightsAccessor, 4, weights.back()) ||
+				joints.back().size() != 4 * count || weights.back().size() != 4 * count)
+			{
+				std::cerr << "Error: primitive " << p << " has bad joints or weights [in loadGltf()]!" << std::endl;
+				return false;
+			}
+		}
+
+		// the weights, and the positions put into the bind pose by them
+		mesh.bindVertices.resize(first + count);
+		mesh.attachments.resize(first + count);
+		// cleared by any worker that meets an unknown joint
+		std::atomic< bool > jointsValid(true);
+		parallelFor(count, defaultThreadCount(), [&]( unsigned begin, unsigned end )
+		{
+			for (unsigned i = begin; i < end; i++)
+			{
+				vector< float >& attachment = mesh.attachments[first + i];
+				attachment.assign(numJoints, 0.0f);
+
+				float total = 0;
+				for (unsigned set = 0; set < weights.size(); set++)
+				{
+					for (unsigned k = 4 * i; k < 4 * i + 4; k++)
+					{
+						total += weights[set][k];
+					}
+				}
+
+				// normalized, as the rig skins with the weights as they are
+				const Vector4f position(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2], 1.0f);
+				Vector4f bound(0.0f);
+				for (unsigned set = 0; set < joints.size() && total > 0; set++)
+				{
+					for (unsigned k = 4 * i; k < 4 * i + 4; k++)
+					{
+						const unsigned joint = joints[set][k];
+						const float weight = weights[set][k] / total;
+						if (weight == 0)
+						{
+							continue;
+						}
+						if (joint >= numJoints)
+						{
+							jointsValid = false;
+							continue;
+						}
+						attachment[skeleton.rigJoints[joint]] += weight;
+						bound = bound + weight * (skeleton.bindTransforms[joint] * position);
+					}
+				}
+				mesh.bindVertices[first + i] = (total > 0) ? bound.xyz() : position.xyz();
+			}
+		});
+		if (!jointsValid)
+		{
+			std::cerr << "Error: primitive " << p << " has weights for joints outside the skin [in loadGltf()]!" << std::endl;
+			return false;
+		}
+
+		// unindexed primitives list their vertices in order
+		if (primitive.member("indices"))
+		{
+			if (!readAccessor(document, primitive.numberOr("indices", -1), 1, indices))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			indices.resize(count);
+			for (unsigned i = 0; i < count; i++)
+			{
+				indices[i] = i;
+			}
+		}
+		for (unsigned i = 0; i + 2 < indices.size(); i += 3)
+		{
+			if (indices[i] >= count || indices[i + 1] >= count || indices[i + 2] >= count)
+			{
+				std::cerr << "Error: primitive " << p << " has an index outside its vertices [in loadGltf()]!" << std::endl;
+				return false;
+			}
+			mesh.faces.push_back(Tuple3u(first + indices[i], first + indices[i + 1], first + indices[i + 2]));
+		}
+	}
+
+	if (mesh.faces.empty())
+	{
+		std::cerr << "Error: " << filename << " has no skinned triangles [in loadGltf()]!" << std::endl;
+		return false;
+	}
+
+	mesh.currentVertices = mesh.bindVertices;
+	parents.swap(skeleton.parents);
+	offsets.swap(skeleton.offsets);
+	return true;
+}
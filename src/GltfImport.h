@@ -0,0 +1,39 @@
+#ifndef GLTF_IMPORT_H
+#define GLTF_IMPORT_H
+
+#include <vector>
+#include <vecmath.h>
+
+#include "Mesh.h"
+
+// glTF 2.0 (.glb or .gltf) import of a skinned mesh, an alternative to the
+// .skel/.obj/.attach files: SkeletalModel::load() and loadSkeleton() read
+// a glTF file when given one (see isGltfFile()).
+//
+// The rig is the first node with both a mesh and a skin. Its skin's joints
+// become the skeleton, ordered so parents come before children; they must
+// have a single root. Joints of the assignment's skeletons carry no rest
+// rotation, so the joints' own orientations are dropped: each joint keeps
+// its bind pose position, as an offset from its parent's, and the mesh is
+// put into the bind pose of the file (its vertices skinned by the node
+// transforms and inverse bind matrices), which is what the rig skins from.
+//
+// The JSON is parsed once; the binary chunk of a .glb, or the buffer
+// files of a .gltf, are memory mapped and the accessors read from them
+// directly. Triangles from all the mesh's triangle list primitives are
+// loaded, with weights from every JOINTS_n / WEIGHTS_n pair.
+
+// True if filename ends in .glb or .gltf.
+bool isGltfFile( const char* filename );
+
+// Reads only the skeleton: parents[ j ] (-1 for the root, parents before
+// children) and offsets[ j ], the position relative to the parent (the
+// world position for the root). Returns false if the file has no skinned
+// mesh or is malformed.
+bool loadGltfSkeleton( const char* filename, std::vector< int >& parents, std::vector< Vector3f >& offsets );
+
+// Reads the skeleton and fills mesh's bindVertices, currentVertices,
+// faces and attachments (one weight per joint of the skeleton).
+bool loadGltf( const char* filename, std::vector< int >& parents, std::vector< Vector3f >& offsets, Mesh& mesh );
+
+#endif // GLTF_IMPORT_H
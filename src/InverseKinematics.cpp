@@ -0,0 +1,320 @@
+#include "InverseKinematics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Parallel.h"
+
+using namespace std;
+
+namespace
+{
+	// Directions shorter than this, and turns smaller than this many
+	// radians, are skipped.
+	const float kMinLength = 1e-6f;
+	const float kMinAngle = 1e-6f;
+
+	Matrix3f eulerRotation( const Vector3f& angles )
+	{
+		return Matrix3f::rotateX( angles.x() ) * Matrix3f::rotateY( angles.y() ) * Matrix3f::rotateZ( angles.z() );
+	}
+
+	// Shortest rotation turning direction from onto direction to.
+	// Returns false if either is too short or they already point the same way.
+	bool alignment( const Vector3f& from, const Vector3f& to, Matrix3f& rotation )
+	{
+		if( from.abs() < kMinLength || to.abs() < kMinLength )
+		{
+			return false;
+		}
+
+		Vector3f axis = Vector3f::cross( from, to );
+		const float angle = atan2( axis.abs(), Vector3f::dot( from, to ) );
+		if( angle < kMinAngle )
+		{
+			return false;
+		}
+
+		// opposite directions: any perpendicular axis will do
+		if( axis.abs() < kMinLength * from.abs() * to.abs() )
+		{
+			axis = Vector3f::cross( from, fabs( from.x() ) < fabs( from.y() ) ? Vector3f( 1, 0, 0 ) : Vector3f( 0, 1, 0 ) );
+		}
+
+		rotation = Matrix3f::rotation( axis, angle );
+		return true;
+	}
+
+	// A goal's chain in world space: the joints from the base down to the
+	// effector's parent, then the effector.
+	struct Chain
+	{
+		std::vector< unsigned > joints;
+
+		// per joint, its rotation relative to its parent and its offset
+		// from its parent; offsets has the effector's offset last
+		std::vector< Matrix3f > local;
+		std::vector< Vector3f > offsets;
+
+		// per joint, its world rotation and position; positions has the
+		// effector's position last
+		std::vector< Matrix3f > world;
+		std::vector< Vector3f > positions;
+
+		// world transform of the base's parent
+		Matrix3f parentRotation;
+		Vector3f parentPosition;
+
+		// scratch for FABRIK
+		std::vector< Vector3f > reached;
+
+		unsigned size() const { return joints.size(); }
+		const Vector3f& effector() const { return positions.back(); }
+
+		const Matrix3f& rotationAbove( unsigned i ) const { return i == 0 ? parentRotation : world[ i - 1 ]; }
+		const Vector3f& positionAbove( unsigned i ) const { return i == 0 ? parentPosition : positions[ i - 1 ]; }
+
+		// Recomputes the world transforms of joint i and below.
+		void updateFrom( unsigned i )
+		{
+			for( ; i < size(); i++ )
+			{
+				positions[ i ] = positionAbove( i ) + rotationAbove( i ) * offsets[ i ];
+				world[ i ] = rotationAbove( i ) * local[ i ];
+			}
+			positions.back() = positions[ size() - 1 ] + world[ size() - 1 ] * offsets.back();
+		}
+
+		// Applies a world space rotation to joint i.
+		void turn( unsigned i, const Matrix3f& rotation )
+		{
+			const Matrix3f& above = rotationAbove( i );
+			local[ i ] = above.transposed() * rotation * above * local[ i ];
+			updateFrom( i );
+		}
+	};
+
+	// Fills chain from the pose. Returns false if the goal's effector is
+	// not below its base.
+	bool buildChain( const vector< int >& parents, const vector< Vector3f >& offsets, const InverseKinematics::Goal& goal,
+		const vector< Vector3f >& jointAngles, Chain& chain )
+	{
+		if( goal.effectorJoint >= parents.size() || goal.baseJoint >= parents.size() )
+		{
+			return false;
+		}
+
+		chain.joints.clear();
+		for( int j = parents[ goal.effectorJoint ]; ; j = parents[ j ] )
+		{
+			if( j < 0 )
+			{
+				return false;
+			}
+			chain.joints.push_back( j );
+			if( j == (int)goal.baseJoint )
+			{
+				break;
+			}
+		}
+		reverse( chain.joints.begin(), chain.joints.end() );
+
+		// the base's ancestors are fixed
+		chain.parentRotation = Matrix3f::identity();
+		chain.parentPosition = Vector3f( 0, 0, 0 );
+		vector< unsigned > ancestors;
+		for( int j = parents[ goal.baseJoint ]; j >= 0; j = parents[ j ] )
+		{
+			ancestors.push_back( j );
+		}
+		for( unsigned k = ancestors.size(); k-- > 0; )
+		{
+			const unsigned j = ancestors[ k ];
+			chain.parentPosition = chain.parentPosition + chain.parentRotation * offsets[ j ];
+			chain.parentRotation = chain.parentRotation * eulerRotation( jointAngles[ j ] );
+		}
+
+		const unsigned n = chain.size();
+		chain.local.resize( n );
+		chain.offsets.resize( n + 1 );
+		chain.world.resize( n );
+		chain.positions.resize( n + 1 );
+		for( unsigned i = 0; i < n; i++ )
+		{
+			chain.local[ i ] = eulerRotation( jointAngles[ chain.joints[ i ] ] );
+			chain.offsets[ i ] = offsets[ chain.joints[ i ] ];
+		}
+		chain.offsets[ n ] = offsets[ goal.effectorJoint ];
+		chain.updateFrom( 0 );
+		return true;
+	}
+
+	void iterateCCD( Chain& chain, const Vector3f& target )
+	{
+		for( unsigned i = chain.size(); i-- > 0; )
+		{
+			Matrix3f turn;
+			if( alignment( chain.effector() - chain.positions[ i ], target - chain.positions[ i ], turn ) )
+			{
+				chain.turn( i, turn );
+			}
+		}
+	}
+
+	void iterateFABRIK( Chain& chain, const Vector3f& target )
+	{
+		const unsigned n = chain.size();
+		vector< Vector3f >& reached = chain.reached;
+		reached = chain.positions;
+
+		// backward: pin the effector to the target, pull the joints after it
+		reached[ n ] = target;
+		for( unsigned i = n; i-- > 0; )
+		{
+			const Vector3f direction = reached[ i ] - reached[ i + 1 ];
+			if( direction.abs() >= kMinLength )
+			{
+				reached[ i ] = reached[ i + 1 ] + chain.offsets[ i + 1 ].abs() * direction.normalized();
+			}
+		}
+
+		// forward: pin the base back to its place, push the joints after it
+		reached[ 0 ] = chain.positions[ 0 ];
+		for( unsigned i = 0; i < n; i++ )
+		{
+			const Vector3f direction = reached[ i + 1 ] - reached[ i ];
+			if( direction.abs() >= kMinLength )
+			{
+				reached[ i + 1 ] = reached[ i ] + chain.offsets[ i + 1 ].abs() * direction.normalized();
+			}
+		}
+
+		// Turn each bone onto its new direction, base first, so every joint
+		// starts from where its parents have put it.
+		for( unsigned i = 0; i < n; i++ )
+		{
+			Matrix3f turn;
+			if( alignment( chain.positions[ i + 1 ] - chain.positions[ i ], reached[ i + 1 ] - chain.positions[ i ], turn ) )
+			{
+				chain.turn( i, turn );
+			}
+		}
+	}
+
+	bool solveGoal( const vector< int >& parents, const vector< Vector3f >& offsets, InverseKinematics::Method method,
+		const InverseKinematics::Goal& goal, vector< Vector3f >& jointAngles, unsigned maxIterations, float tolerance,
+		Chain& chain, InverseKinematics::Result& result )
+	{
+		if( !buildChain( parents, offsets, goal, jointAngles, chain ) )
+		{
+			result.iterations = 0;
+			result.distance = -1;
+			return false;
+		}
+
+		result.iterations = 0;
+		result.distance = ( chain.effector() - goal.target ).abs();
+		while( result.iterations < maxIterations && result.distance > tolerance )
+		{
+			if( method == InverseKinematics::kCCD )
+			{
+				iterateCCD( chain, goal.target );
+			}
+			else
+			{
+				iterateFABRIK( chain, goal.target );
+			}
+			result.iterations++;
+			result.distance = ( chain.effector() - goal.target ).abs();
+		}
+
+		for( unsigned i = 0; i < chain.size(); i++ )
+		{
+			jointAngles[ chain.joints[ i ] ] = InverseKinematics::eulerAngles( chain.local[ i ] );
+		}
+		return true;
+	}
+}
+
+InverseKinematics::InverseKinematics()
+{
+}
+
+void InverseKinematics::setSkeleton( const std::vector< int >& parents, const std::vector< Vector3f >& offsets )
+{
+	m_parents = parents;
+	m_offsets = offsets;
+}
+
+unsigned InverseKinematics::chainBase( unsigned effector, unsigned length ) const
+{
+	unsigned base = effector;
+	for( unsigned k = 0; k < length && m_parents[ base ] >= 0 && m_parents[ m_parents[ base ] ] >= 0; k++ )
+	{
+		base = m_parents[ base ];
+	}
+	return base;
+}
+
+Vector3f InverseKinematics::jointPosition( const std::vector< Vector3f >& jointAngles, unsigned joint ) const
+{
+	Vector3f position = m_offsets[ joint ];
+	for( int j = m_parents[ joint ]; j >= 0; j = m_parents[ j ] )
+	{
+		position = m_offsets[ j ] + eulerRotation( jointAngles[ j ] ) * position;
+	}
+	return position;
+}
+
+bool InverseKinematics::solve( Method method, const Goal& goal, std::vector< Vector3f >& jointAngles, unsigned maxIterations,
+	float tolerance, Result& result ) const
+{
+	Chain chain;
+	if( !solveGoal( m_parents, m_offsets, method, goal, jointAngles, maxIterations, tolerance, chain, result ) )
+	{
+		std::cerr << "Error: joint " << goal.effectorJoint << " is not below joint " << goal.baseJoint
+			<< " [in InverseKinematics::solve()]!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void InverseKinematics::solve( Method method, std::vector< Task >& tasks, unsigned maxIterations, float tolerance,
+	unsigned numThreads ) const
+{
+	if( numThreads == 0 )
+	{
+		numThreads = defaultThreadCount();
+	}
+
+	parallelFor( tasks.size(), numThreads, [&]( unsigned begin, unsigned end )
+	{
+		Chain chain;
+		for( unsigned t = begin; t < end; t++ )
+		{
+			Task& task = tasks[ t ];
+			task.results.resize( task.goals.size() );
+			for( unsigned g = 0; g < task.goals.size(); g++ )
+			{
+				solveGoal( m_parents, m_offsets, method, task.goals[ g ], *task.jointAngles, maxIterations, tolerance,
+					chain, task.results[ g ] );
+			}
+		}
+	} );
+}
+
+// static
+Vector3f InverseKinematics::eulerAngles( const Matrix3f& rotation )
+{
+	// Rx( a ) * Ry( b ) * Rz( c ) has sin( b ) in row 0, column 2
+	const float sineY = max( -1.0f, min( 1.0f, rotation( 0, 2 ) ) );
+	const float y = asin( sineY );
+	if( fabs( sineY ) < 1.0f - 1e-6f )
+	{
+		return Vector3f( atan2( -rotation( 1, 2 ), rotation( 2, 2 ) ), y, atan2( -rotation( 0, 1 ), rotation( 0, 0 ) ) );
+	}
+
+	// gimbal lock: only rX + rZ (or rX - rZ) is determined
+	return Vector3f( atan2( rotation( 2, 1 ), rotation( 1, 1 ) ), y, 0.0f );
+}
@@ -0,0 +1,94 @@
+#ifndef INVERSE_KINEMATICS_H
+#define INVERSE_KINEMATICS_H
+
+#include <vector>
+#include <vecmath.h>
+
+// Inverse kinematics on the flattened joint hierarchy of a SkeletalModel
+// (parent indices and each joint's offset from its parent).
+//
+// A goal asks for the effector joint to reach a world space target by
+// rotating the chain of joints from the base joint down to the effector's
+// parent. Poses are per joint (rX, rY, rZ) Euler angles, as passed to
+// SkeletalModel::setJointTransform(); only the chain's angles change.
+//
+// Two solvers:
+//     kCCD     cyclic coordinate descent: each iteration turns every chain
+//              joint, effector end first, to point the effector at the target
+//     kFABRIK  forward and backward reaching (Aristidou and Lasenby): each
+//              iteration moves the joint positions along the chain and back,
+//              then turns every joint onto its new bone direction
+// Both stop after maxIterations or once the effector is within tolerance.
+//
+// solve() takes a batch of independent tasks (e.g. characters), each with
+// its own pose and goals, and spreads the tasks over threads.
+class InverseKinematics
+{
+public:
+
+	enum Method
+	{
+		kCCD,
+		kFABRIK
+	};
+
+	struct Goal
+	{
+		unsigned baseJoint;     // topmost joint to rotate
+		unsigned effectorJoint; // joint to move, a descendant of baseJoint
+		Vector3f target;        // world space
+	};
+
+	struct Result
+	{
+		unsigned iterations;
+		float distance; // from the effector to the target after solving
+	};
+
+	// One pose and the goals to reach with it, solved in order.
+	// Every task of a batch must have its own jointAngles.
+	struct Task
+	{
+		std::vector< Vector3f >* jointAngles;
+		std::vector< Goal > goals;
+		std::vector< Result > results; // filled by solve(), one per goal
+	};
+
+	InverseKinematics();
+
+	// parents[ j ] is the index of joint j's parent (-1 for the root, and
+	// parents before children), offsets[ j ] its position in the parent's
+	// space (in world space for the root).
+	void setSkeleton( const std::vector< int >& parents, const std::vector< Vector3f >& offsets );
+
+	unsigned numJoints() const { return m_parents.size(); }
+	int parent( unsigned joint ) const { return m_parents[ joint ]; }
+
+	// Base for a goal moving effector with up to length joints, stopping
+	// below the root. Returns effector if its parent is the root.
+	unsigned chainBase( unsigned effector, unsigned length ) const;
+
+	// World position of joint in the pose.
+	Vector3f jointPosition( const std::vector< Vector3f >& jointAngles, unsigned joint ) const;
+
+	// Returns false, leaving jointAngles alone, if the goal's effector is
+	// not below its base.
+	bool solve( Method method, const Goal& goal, std::vector< Vector3f >& jointAngles, unsigned maxIterations,
+		float tolerance, Result& result ) const;
+
+	// numThreads = 0 uses one thread per hardware thread.
+	// Goals that cannot be solved get no iterations and a negative distance.
+	void solve( Method method, std::vector< Task >& tasks, unsigned maxIterations, float tolerance,
+		unsigned numThreads = 0 ) const;
+
+	// Euler angles (rX, rY, rZ) with Rx * Ry * Rz = rotation, as
+	// setJointTransform() composes them.
+	static Vector3f eulerAngles( const Matrix3f& rotation );
+
+private:
+
+	std::vector< int > m_parents;
+	std::vector< Vector3f > m_offsets;
+};
+
+#endif // INVERSE_KINEMATICS_H
@@ -0,0 +1,14 @@
+#ifndef JOINT_NAMES_H
+#define JOINT_NAMES_H
+
+// Joints of the assignment's 18 joint rigs, in .skel order: the slider
+// labels, and the rig side of a BVH joint map (see BvhReader.h).
+const unsigned kNumRigJoints = 18;
+const char* const kRigJointNames[ kNumRigJoints ] =
+{
+	"Root", "Chest", "Waist", "Neck", "Right hip", "Right leg", "Right knee", "Right foot", "Left hip", "Left leg",
+	"Left knee", "Left foot", "Right collarbone", "Right shoulder", "Right elbow", "Left collarbone", "Left shoulder",
+	"Left elbow"
+};
+
+#endif // JOINT_NAMES_H
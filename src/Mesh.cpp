@@ -2,43 +2,360 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <sys/stat.h>
+
+#include "Parallel.h"
 
 using namespace std;
 
-void Mesh::load( const char* filename )
+namespace
 {
-	// 2.1.1. load() should populate bindVertices, currentVertices, and faces
-	
-	std::ifstream inputFile(filename);
-	if (!inputFile) 
+	// Keep the 4 largest weights, renormalize them to sum to maxValue
+	// and round. Returns the largest absolute error over all joints.
+	template< typename Packed >
+	float packInfluences( const vector< float >& weights, float maxValue, Packed& packed )
+	{
+		vector< unsigned > order(weights.size());
+		for (unsigned j = 0; j < order.size(); j++)
+		{
+			order[j] = j;
+		}
+
+		const unsigned count = std::min< unsigned >(4, order.size());
+		std::partial_sort(order.begin(), order.begin() + count, order.end(),
+			[&]( unsigned a, unsigned b ) { return weights[a] > weights[b]; });
+
+		float total = 0;
+		for (unsigned i = 0; i < count; i++)
+		{
+			total += weights[order[i]];
+		}
+
+		float quantized[ 4 ] = { 0, 0, 0, 0 };
+		if (total > 0)
+		{
+			float sum = 0;
+			for (unsigned i = 0; i < count; i++)
+			{
+				quantized[i] = floorf(weights[order[i]] / total * maxValue + 0.5f);
+				sum += quantized[i];
+			}
+
+			// push the rounding error onto the largest weight so they sum to exactly 1
+			quantized[0] += maxValue - sum;
+		}
+
+		for (unsigned i = 0; i < 4; i++)
+		{
+			packed.joints[i] = (i < count) ? order[i] : 0;
+			packed.weights[i] = quantized[i];
+		}
+
+		// error against the float reference, including the dropped influences
+		vector< float > decoded(weights.size(), 0);
+		for (unsigned i = 0; i < count; i++)
+		{
+			decoded[order[i]] = quantized[i] / maxValue;
+		}
+
+		float maxError = 0;
+		for (unsigned j = 0; j < weights.size(); j++)
+		{
+			maxError = std::max(maxError, fabsf(decoded[j] - weights[j]));
+		}
+		return maxError;
+	}
+
+	// offsets shorter than this are dropped when a morph target is loaded
+	const float kMinMorphDelta = 1e-6f;
+
+	// runs closer than this many vertices in the same block are joined,
+	// storing zero offsets for the vertices between them
+	const unsigned kMaxMorphRunGap = 2;
+
+	// Lays out sparse offsets (sorted by vertex) as runs in blocks.
+	void buildMorphRuns( MorphTarget& target, const vector< unsigned >& vertices, const vector< Vector3f >& deltas,
+		unsigned numVertices )
+	{
+		target.runStarts.clear();
+		target.runLengths.clear();
+		target.runOffsets.clear();
+		target.deltas.clear();
+		target.maxDelta = 0;
+
+		for (unsigned n = 0; n < vertices.size(); n++)
+		{
+			const unsigned v = vertices[n];
+			bool extend = false;
+			if (!target.runStarts.empty())
+			{
+				const unsigned start = target.runStarts.back();
+				const unsigned end = start + target.runLengths.back();
+				extend = (v - end <= kMaxMorphRunGap) && (v / kMorphBlockSize == start / kMorphBlockSize);
+			}
+
+			if (extend)
+			{
+				const unsigned end = target.runStarts.back() + target.runLengths.back();
+				target.deltas.resize(target.deltas.size() + 3 * (v - end), 0.0f);
+				target.runLengths.back() += v - end;
+			}
+			else
+			{
+				target.runStarts.push_back(v);
+				target.runLengths.push_back(0);
+				target.runOffsets.push_back(target.deltas.size() / 3);
+			}
+
+			target.deltas.push_back(deltas[n].x());
+			target.deltas.push_back(deltas[n].y());
+			target.deltas.push_back(deltas[n].z());
+			target.runLengths.back()++;
+			target.maxDelta = std::max(target.maxDelta, deltas[n].abs());
+		}
+
+		// runs never cross a block boundary, so each block's runs are contiguous
+		const unsigned numBlocks = (numVertices + kMorphBlockSize - 1) / kMorphBlockSize;
+		target.blockRuns.assign(numBlocks + 1, 0);
+		unsigned r = 0;
+		for (unsigned b = 0; b < numBlocks; b++)
+		{
+			target.blockRuns[b] = r;
+			while (r < target.runStarts.size() && target.runStarts[r] < (b + 1) * kMorphBlockSize)
+			{
+				r++;
+			}
+		}
+		target.blockRuns[numBlocks] = r;
+	}
+
+	// Identifies the attachment file an influence bucket cache was built from.
+	struct FileStamp
+	{
+		long long size;
+		long long modified;
+	};
+
+	bool stampFile( const char* filename, FileStamp& stamp )
 	{
-        std::cerr << "Error: File could not be opened [in Mesh::load()]!" << std::endl;
-        return;
-    }
+		struct stat status;
+		if (stat(filename, &status) != 0)
+		{
+			return false;
+		}
+		stamp.size = status.st_size;
+		stamp.modified = status.st_mtime;
+		return true;
+	}
+
+	const unsigned kInfluenceCacheVersion = 1;
 
-	std::string line;
-	while (std::getline(inputFile, line))
+	// files are only split into ranges of at least this many bytes
+	const size_t kMinParseBytes = 64 * 1024;
+
+	bool readFile( const char* filename, string& text )
 	{
-		std::istringstream iss(line);
+		std::ifstream file(filename, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
 
-		char type;
-		iss >> type;
+		file.seekg(0, std::ios::end);
+		text.resize(file.tellg());
+		file.seekg(0, std::ios::beg);
+		if (!text.empty())
+		{
+			file.read(&text[0], text.size());
+		}
+		return true;
+	}
+
+	// Splits text into ranges of whole lines for up to numThreads threads:
+	// range r is [ starts[ r ], starts[ r + 1 ] ).
+	vector< size_t > splitLines( const string& text, unsigned numThreads )
+	{
+		if (numThreads == 0)
+		{
+			numThreads = defaultThreadCount();
+		}
+		const size_t count = std::max< size_t >(1, std::min< size_t >(numThreads, text.size() / kMinParseBytes));
 
-		if (type == 'v') // vertex
+		vector< size_t > starts(1, 0);
+		for (size_t r = 1; r < count; r++)
 		{
-			float x, y, z;
-			iss >> x >> y >> z;
+			const size_t newline = text.find('\n', std::max(text.size() * r / count, starts.back()));
+			if (newline == string::npos)
+			{
+				break;
+			}
+			starts.push_back(newline + 1);
+		}
+		starts.push_back(text.size());
+		return starts;
+	}
+
+	bool isBlank( char c )
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
 
-			bindVertices.push_back(Vector3f(x,y,z));
+	const char* lineEnd( const char* p, const char* end )
+	{
+		const char* newline = static_cast< const char* >(memchr(p, '\n', end - p));
+		return newline ? newline : end;
+	}
+
+	// Parse the next number of the line [ p, end ) and move p past it.
+	bool parseFloat( const char*& p, const char* end, float& value )
+	{
+		while (p < end && isBlank(*p))
+		{
+			p++;
 		}
-		else // face
+		char* next;
+		value = (p < end) ? strtof(p, &next) : 0;
+		if (p == end || next == p)
 		{
-			unsigned int i, j, k; // one-index
-			iss >> i >> j >> k;
+			return false;
+		}
+		p = next;
+		return true;
+	}
 
-			// Make zero-index based 
-			faces.push_back(Tuple3u(i - 1, j - 1, k - 1));
+	// Also skips the rest of an OBJ face corner ("7/3/5").
+	bool parseIndex( const char*& p, const char* end, unsigned& value )
+	{
+		while (p < end && isBlank(*p))
+		{
+			p++;
 		}
+		char* next;
+		value = (p < end) ? strtoul(p, &next, 10) : 0;
+		if (p == end || next == p)
+		{
+			return false;
+		}
+		for (p = next; p < end && !isBlank(*p); p++)
+		{
+		}
+		return true;
+	}
+
+	struct ObjRange
+	{
+		vector< Vector3f > vertices;
+		vector< Tuple3u > faces;
+	};
+
+	// "v x y z" and "f i j k" lines; anything else is skipped.
+	void parseObjLines( const char* p, const char* end, ObjRange& range )
+	{
+		for (const char* e; p < end; p = e + 1)
+		{
+			e = lineEnd(p, end);
+			if (e - p < 2 || !isBlank(p[1]))
+			{
+				continue;
+			}
+
+			const char type = *p++;
+			if (type == 'v')
+			{
+				float x, y, z;
+				if (parseFloat(p, e, x) && parseFloat(p, e, y) && parseFloat(p, e, z))
+				{
+					range.vertices.push_back(Vector3f(x, y, z));
+				}
+			}
+			else if (type == 'f')
+			{
+				unsigned i, j, k; // one-indexed
+				if (parseIndex(p, e, i) && parseIndex(p, e, j) && parseIndex(p, e, k))
+				{
+					range.faces.push_back(Tuple3u(i - 1, j - 1, k - 1));
+				}
+			}
+		}
+	}
+
+	// One line per vertex with the weights of joints 1 .. numJoints - 1;
+	// missing weights are 0 and blank lines are skipped.
+	void parseAttachmentLines( const char* p, const char* end, unsigned numJoints, vector< vector< float > >& attachments )
+	{
+		for (const char* e; p < end; p = e + 1)
+		{
+			e = lineEnd(p, end);
+			const char* q = p;
+			while (q < e && isBlank(*q))
+			{
+				q++;
+			}
+			if (q == e)
+			{
+				continue;
+			}
+
+			vector< float > weights(numJoints, 0.0f); // weight of root is 0
+			for (unsigned j = 1; j < numJoints && parseFloat(p, e, weights[j]); j++)
+			{
+			}
+			attachments.push_back(std::move(weights));
+		}
+	}
+
+	// Per vertex, the sum of the (area weighted) normals of its faces,
+	// normalized.
+	void computeVertexNormals(const vector< Vector3f >& vertices, const vector< Tuple3u >& faces, vector< Vector3f >& normals)
+	{
+		normals.assign(vertices.size(), Vector3f(0, 0, 0));
+		for (const Tuple3u& f : faces)
+		{
+			const Vector3f& A = vertices[f[0]];
+			const Vector3f areaNormal = Vector3f::cross(vertices[f[1]] - A, vertices[f[2]] - A);
+			normals[f[0]] += areaNormal;
+			normals[f[1]] += areaNormal;
+			normals[f[2]] += areaNormal;
+		}
+
+		for (Vector3f& n : normals)
+		{
+			const float length = n.abs();
+			if (length > 0)
+			{
+				n *= 1.0f / length;
+			}
+		}
+	}
+}
+
+void Mesh::load( const char* filename, unsigned numThreads )
+{
+	// 2.1.1. load() should populate bindVertices, currentVertices, and faces
+
+	string text;
+	if (!readFile(filename, text))
+	{
+		std::cerr << "Error: File could not be opened [in Mesh::load()]!" << std::endl;
+		return;
+	}
+
+	const vector< size_t > starts = splitLines(text, numThreads);
+	vector< ObjRange > ranges(starts.size() - 1);
+	runOnThreads(ranges.size(), [&]( unsigned r )
+	{
+		parseObjLines(text.data() + starts[r], text.data() + starts[r + 1], ranges[r]);
+	});
+
+	for (const ObjRange& range : ranges)
+	{
+		bindVertices.insert(bindVertices.end(), range.vertices.begin(), range.vertices.end());
+		faces.insert(faces.end(), range.faces.begin(), range.faces.end());
 	}
 
 	// make a copy of the bind vertices as the current vertices
@@ -47,6 +364,22 @@ void Mesh::load( const char* filename )
 
 void Mesh::draw()
 {
+	if (currentNormals.size() == currentVertices.size())
+	{
+		// smooth shading with the per-vertex normals
+		glBegin(GL_TRIANGLES);
+		for (const Tuple3u& f : faces)
+		{
+			for (unsigned k = 0; k < 3; k++)
+			{
+				glNormal3fv(currentNormals[f[k]]);
+				glVertex3fv(currentVertices[f[k]]);
+			}
+		}
+		glEnd();
+		return;
+	}
+
 	// Since these meshes don't have normals
 	// be sure to generate a normal per triangle.
 	// Notice that since we have per-triangle normals
@@ -76,34 +409,530 @@ void Mesh::draw()
 	}
 }
 
-void Mesh::loadAttachments( const char* filename, int numJoints )
+unsigned long long Mesh::computeLayoutHash() const
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char* bytes = reinterpret_cast< const unsigned char* >(bindVertices.data());
+	const size_t size = bindVertices.size() * sizeof(Vector3f);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+void Mesh::computeBindNormals()
+{
+	computeVertexNormals(bindVertices, faces, bindNormals);
+	currentNormals = bindNormals;
+}
+
+void Mesh::computeCurrentNormals()
+{
+	computeVertexNormals(currentVertices, faces, currentNormals);
+}
+
+void Mesh::loadAttachments( const char* filename, int numJoints, unsigned numThreads )
 {
 	// 2.2. Implement this method to load the per-vertex attachment weights
 	// this method should update m_mesh.attachments
 
-	std::ifstream inputFile(filename);
-	if (!inputFile) 
+	string text;
+	if (!readFile(filename, text))
+	{
+		std::cerr << "Error: File could not be opened [in Mesh::loadAttachments()]!" << std::endl;
+		return;
+	}
+
+	if (numJoints <= 0)
+	{
+		// the root plus one per weight on the first line
+		const char* p = text.data();
+		const char* e = lineEnd(p, p + text.size());
+		float w;
+		for (numJoints = 1; parseFloat(p, e, w); numJoints++)
+		{
+		}
+	}
+
+	const vector< size_t > starts = splitLines(text, numThreads);
+	vector< vector< vector< float > > > ranges(starts.size() - 1);
+	runOnThreads(ranges.size(), [&]( unsigned r )
+	{
+		parseAttachmentLines(text.data() + starts[r], text.data() + starts[r + 1], numJoints, ranges[r]);
+	});
+
+	for (vector< vector< float > >& range : ranges)
+	{
+		std::move(range.begin(), range.end(), std::back_inserter(attachments));
+	}
+}
+
+void Mesh::save( const char* filename ) const
+{
+	std::ofstream outputFile(filename);
+	if (!outputFile)
+	{
+		std::cerr << "Error: File could not be opened [in Mesh::save()]!" << std::endl;
+		return;
+	}
+
+	for (const Vector3f& v : bindVertices)
+	{
+		outputFile << "v " << v.x() << ' ' << v.y() << ' ' << v.z() << '\n';
+	}
+
+	// one-indexed
+	for (const Tuple3u& f : faces)
+	{
+		outputFile << "f " << f[0] + 1 << ' ' << f[1] + 1 << ' ' << f[2] + 1 << '\n';
+	}
+}
+
+void Mesh::saveAttachments( const char* filename ) const
+{
+	std::ofstream outputFile(filename);
+	if (!outputFile)
+	{
+		std::cerr << "Error: File could not be opened [in Mesh::saveAttachments()]!" << std::endl;
+		return;
+	}
+
+	// the root's weight is implied, as in loadAttachments()
+	for (const vector<float>& weights : attachments)
+	{
+		for (unsigned j = 1; j < weights.size(); j++)
+		{
+			outputFile << weights[j] << ' ';
+		}
+		outputFile << '\n';
+	}
+}
+
+bool Mesh::bucketInfluences()
+{
+	influenceBuckets.clear();
+	if (attachments.empty())
+	{
+		return true;
+	}
+	if (attachments[0].size() > 256)
+	{
+		std::cerr << "Error: Mesh::bucketInfluences() supports at most 256 joints!" << std::endl;
+		return false;
+	}
+
+	vector< unsigned > counts(attachments.size(), 0);
+	unsigned maxCount = 0;
+	for (unsigned i = 0; i < attachments.size(); i++)
+	{
+		for (float w : attachments[i])
+		{
+			counts[i] += (w != 0);
+		}
+		maxCount = std::max(maxCount, counts[i]);
+	}
+
+	influenceBuckets.resize(kNumInfluenceBucketSizes);
+	for (unsigned b = 0; b < kNumInfluenceBucketSizes; b++)
+	{
+		influenceBuckets[b].maxInfluences = kInfluenceBucketSizes[b];
+	}
+	const unsigned largest = kInfluenceBucketSizes[kNumInfluenceBucketSizes - 1];
+	if (maxCount > largest)
+	{
+		influenceBuckets.resize(kNumInfluenceBucketSizes + 1);
+		influenceBuckets.back().maxInfluences = maxCount;
+	}
+
+	// a vertex without weights gets a single zero weight
+	for (unsigned i = 0; i < attachments.size(); i++)
+	{
+		unsigned b = 0;
+		while (b + 1 < influenceBuckets.size() && counts[i] > influenceBuckets[b].maxInfluences)
+		{
+			b++;
+		}
+
+		InfluenceBucket& bucket = influenceBuckets[b];
+		bucket.vertices.push_back(i);
+		const vector< float >& weights = attachments[i];
+		for (unsigned j = 0; j < weights.size(); j++)
+		{
+			if (weights[j] != 0)
+			{
+				bucket.joints.push_back(j);
+				bucket.weights.push_back(weights[j]);
+			}
+		}
+		bucket.joints.resize(bucket.vertices.size() * bucket.maxInfluences, 0);
+		bucket.weights.resize(bucket.vertices.size() * bucket.maxInfluences, 0.0f);
+	}
+
+	return true;
+}
+
+bool Mesh::saveInfluenceBuckets( const char* filename, const char* attachmentsFile ) const
+{
+	FileStamp stamp;
+	if (!stampFile(attachmentsFile, stamp))
+	{
+		std::cerr << "Error: " << attachmentsFile << " could not be found [in Mesh::saveInfluenceBuckets()]!" << std::endl;
+		return false;
+	}
+
+	FILE* file = fopen(filename, "wb");
+	if (!file)
 	{
-        std::cerr << "Error: File could not be opened [in Mesh::load()]!" << std::endl;
-        return;
-    }
+		std::cerr << "Error: File could not be opened [in Mesh::saveInfluenceBuckets()]!" << std::endl;
+		return false;
+	}
+
+	const unsigned numJoints = attachments.empty() ? 0 : attachments[0].size();
+	const unsigned header[ 4 ] = { kInfluenceCacheVersion, (unsigned)bindVertices.size(), numJoints, (unsigned)influenceBuckets.size() };
+	bool written = fwrite("SSDI", 1, 4, file) == 4 &&
+		fwrite(header, sizeof(header), 1, file) == 1 &&
+		fwrite(&stamp, sizeof(stamp), 1, file) == 1;
+
+	for (unsigned b = 0; b < influenceBuckets.size() && written; b++)
+	{
+		const InfluenceBucket& bucket = influenceBuckets[b];
+		const unsigned sizes[ 2 ] = { bucket.maxInfluences, (unsigned)bucket.vertices.size() };
+		written = fwrite(sizes, sizeof(sizes), 1, file) == 1;
+		if (written && !bucket.vertices.empty())
+		{
+			written = fwrite(&bucket.vertices[0], sizeof(unsigned), bucket.vertices.size(), file) == bucket.vertices.size() &&
+				fwrite(&bucket.joints[0], 1, bucket.joints.size(), file) == bucket.joints.size() &&
+				fwrite(&bucket.weights[0], sizeof(float), bucket.weights.size(), file) == bucket.weights.size();
+		}
+	}
+
+	if (fclose(file) != 0 || !written)
+	{
+		std::cerr << "Error: " << filename << " could not be written [in Mesh::saveInfluenceBuckets()]!" << std::endl;
+		remove(filename);
+		return false;
+	}
+	return true;
+}
+
+bool Mesh::loadInfluenceBuckets( const char* filename, const char* attachmentsFile )
+{
+	influenceBuckets.clear();
+
+	FileStamp stamp;
+	FILE* file = fopen(filename, "rb");
+	if (!file || !stampFile(attachmentsFile, stamp))
+	{
+		if (file)
+		{
+			fclose(file);
+		}
+		return false;
+	}
+
+	const unsigned numJoints = attachments.empty() ? 0 : attachments[0].size();
+	char magic[ 4 ];
+	unsigned header[ 4 ];
+	FileStamp saved;
+	bool valid = fread(magic, 1, 4, file) == 4 && memcmp(magic, "SSDI", 4) == 0 &&
+		fread(header, sizeof(header), 1, file) == 1 && header[0] == kInfluenceCacheVersion &&
+		header[1] == bindVertices.size() && header[2] == numJoints &&
+		fread(&saved, sizeof(saved), 1, file) == 1 && saved.size == stamp.size && saved.modified == stamp.modified &&
+		(header[3] == kNumInfluenceBucketSizes || header[3] == kNumInfluenceBucketSizes + 1);
 
-	std::string line;
-	while (std::getline(inputFile, line))
+	unsigned numBucketed = 0;
+	if (valid)
+	{
+		influenceBuckets.resize(header[3]);
+	}
+	for (unsigned b = 0; b < influenceBuckets.size() && valid; b++)
+	{
+		InfluenceBucket& bucket = influenceBuckets[b];
+		unsigned sizes[ 2 ];
+		// skinning picks each bucket's kernel by its index, so the
+		// strides must be those bucketInfluences() gives the buckets
+		const unsigned largest = kInfluenceBucketSizes[kNumInfluenceBucketSizes - 1];
+		valid = fread(sizes, sizeof(sizes), 1, file) == 1 && sizes[1] <= bindVertices.size() - numBucketed &&
+			(b < kNumInfluenceBucketSizes ? sizes[0] == kInfluenceBucketSizes[b] : sizes[0] >= largest);
+		if (!valid)
+		{
+			break;
+		}
+
+		bucket.maxInfluences = sizes[0];
+		bucket.vertices.resize(sizes[1]);
+		bucket.joints.resize(sizes[1] * sizes[0]);
+		bucket.weights.resize(sizes[1] * sizes[0]);
+		numBucketed += sizes[1];
+		if (!bucket.vertices.empty())
+		{
+			valid = fread(&bucket.vertices[0], sizeof(unsigned), bucket.vertices.size(), file) == bucket.vertices.size() &&
+				fread(&bucket.joints[0], 1, bucket.joints.size(), file) == bucket.joints.size() &&
+				fread(&bucket.weights[0], sizeof(float), bucket.weights.size(), file) == bucket.weights.size();
+		}
+		for (unsigned i = 0; i < bucket.vertices.size() && valid; i++)
+		{
+			valid = bucket.vertices[i] < bindVertices.size();
+		}
+		for (unsigned k = 0; k < bucket.joints.size() && valid; k++)
+		{
+			valid = bucket.joints[k] < numJoints;
+		}
+	}
+	fclose(file);
+
+	if (!valid || numBucketed != bindVertices.size())
+	{
+		influenceBuckets.clear();
+		return false;
+	}
+	return true;
+}
+
+void Mesh::remapInfluenceBuckets( const vector< unsigned >& remap )
+{
+	for (InfluenceBucket& bucket : influenceBuckets)
 	{
-		std::istringstream iss(line);
+		const unsigned n = bucket.maxInfluences;
+		vector< unsigned > order(bucket.vertices.size());
+		for (unsigned i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(),
+			[&]( unsigned a, unsigned b ) { return remap[bucket.vertices[a]] < remap[bucket.vertices[b]]; });
+
+		InfluenceBucket remapped;
+		remapped.maxInfluences = n;
+		remapped.vertices.resize(order.size());
+		remapped.joints.resize(bucket.joints.size());
+		remapped.weights.resize(bucket.weights.size());
+		for (unsigned i = 0; i < order.size(); i++)
+		{
+			remapped.vertices[i] = remap[bucket.vertices[order[i]]];
+			std::copy(&bucket.joints[n * order[i]], &bucket.joints[n * order[i]] + n, &remapped.joints[n * i]);
+			std::copy(&bucket.weights[n * order[i]], &bucket.weights[n * order[i]] + n, &remapped.weights[n * i]);
+		}
+		bucket.vertices.swap(remapped.vertices);
+		bucket.joints.swap(remapped.joints);
+		bucket.weights.swap(remapped.weights);
+	}
+}
+
+bool Mesh::loadMorphTarget( const char* filename )
+{
+	MorphTarget target;
+
+	// the file name without directory and extension
+	string name = filename;
+	const size_t slash = name.find_last_of("/\\");
+	if (slash != string::npos)
+	{
+		name = name.substr(slash + 1);
+	}
+	target.name = name.substr(0, name.find_last_of('.'));
+
+	Mesh shape;
+	shape.load(filename);
+
+	vector< unsigned > vertices;
+	vector< Vector3f > deltas;
+	const bool matches = (shape.bindVertices.size() == bindVertices.size());
+	if (!matches)
+	{
+		std::cerr << "Error: morph target " << filename << " has " << shape.bindVertices.size() << " vertices, expected "
+			<< bindVertices.size() << " [in Mesh::loadMorphTarget()]!" << std::endl;
+	}
+	else
+	{
+		for (unsigned i = 0; i < bindVertices.size(); i++)
+		{
+			const Vector3f delta = shape.bindVertices[i] - bindVertices[i];
+			if (delta.absSquared() > kMinMorphDelta * kMinMorphDelta)
+			{
+				vertices.push_back(i);
+				deltas.push_back(delta);
+			}
+		}
+	}
+
+	buildMorphRuns(target, vertices, deltas, bindVertices.size());
+	morphTargets.push_back(target);
+	return matches;
+}
+
+bool Mesh::accumulateMorphTargets( const vector< float >& weights, vector< Vector3f >& offsets,
+	vector< unsigned >* written ) const
+{
+	vector< unsigned > active;
+	for (unsigned s = 0; s < weights.size() && s < morphTargets.size(); s++)
+	{
+		if (weights[s] != 0 && !morphTargets[s].runStarts.empty())
+		{
+			active.push_back(s);
+		}
+	}
+	if (active.empty())
+	{
+		return false;
+	}
+
+	// Vector3f is three floats, so the offsets are one float array
+	float* out = offsets[0];
+
+	const unsigned numBlocks = (bindVertices.size() + kMorphBlockSize - 1) / kMorphBlockSize;
+	for (unsigned b = 0; b < numBlocks; b++)
+	{
+		for (unsigned s : active)
+		{
+			const MorphTarget& target = morphTargets[s];
+			const float w = weights[s];
+
+			for (unsigned r = target.blockRuns[b]; r < target.blockRuns[b + 1]; r++)
+			{
+				float* dst = out + 3 * target.runStarts[r];
+				const float* src = &target.deltas[3 * target.runOffsets[r]];
+				const unsigned count = 3 * target.runLengths[r];
+				for (unsigned i = 0; i < count; i++)
+				{
+					dst[i] += w * src[i];
+				}
+			}
+		}
+	}
+
+	if (written && written->size() < offsets.size())
+	{
+		for (unsigned s : active)
+		{
+			const MorphTarget& target = morphTargets[s];
+			for (unsigned r = 0; r < target.runStarts.size(); r++)
+			{
+				for (unsigned i = 0; i < target.runLengths[r]; i++)
+				{
+					written->push_back(target.runStarts[r] + i);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+void Mesh::remapMorphTargets( const vector< unsigned >& remap )
+{
+	for (MorphTarget& target : morphTargets)
+	{
+		// back to sparse (vertex, offset) pairs under the new numbering
+		vector< std::pair< unsigned, Vector3f > > moved;
+		for (unsigned r = 0; r < target.runStarts.size(); r++)
+		{
+			for (unsigned i = 0; i < target.runLengths[r]; i++)
+			{
+				const float* d = &target.deltas[3 * (target.runOffsets[r] + i)];
+				if (d[0] != 0 || d[1] != 0 || d[2] != 0)
+				{
+					moved.push_back(std::make_pair(remap[target.runStarts[r] + i], Vector3f(d[0], d[1], d[2])));
+				}
+			}
+		}
+		std::sort(moved.begin(), moved.end(),
+			[]( const std::pair< unsigned, Vector3f >& a, const std::pair< unsigned, Vector3f >& b ) { return a.first < b.first; });
+
+		vector< unsigned > vertices(moved.size());
+		vector< Vector3f > deltas(moved.size());
+		for (unsigned n = 0; n < moved.size(); n++)
+		{
+			vertices[n] = moved[n].first;
+			deltas[n] = moved[n].second;
+		}
+		buildMorphRuns(target, vertices, deltas, remap.size());
+	}
+}
+
+void Mesh::quantize( int weightBits, bool quantizePositions )
+{
+	packedInfluences8.clear();
+	packedInfluences16.clear();
+	quantizedPositions.clear();
+
+	if (attachments.size() != bindVertices.size() || attachments.empty())
+	{
+		std::cerr << "Error: Mesh::quantize() needs one attachment per vertex!" << std::endl;
+		return;
+	}
+	if (attachments[0].size() > 256)
+	{
+		std::cerr << "Error: Mesh::quantize() supports at most 256 joints!" << std::endl;
+		return;
+	}
+
+	// Weights
+	float maxWeightError = 0;
+	double sumWeightError = 0;
+	if (weightBits == 8)
+	{
+		packedInfluences8.resize(attachments.size());
+		for (unsigned i = 0; i < attachments.size(); i++)
+		{
+			const float e = packInfluences(attachments[i], 255.0f, packedInfluences8[i]);
+			maxWeightError = std::max(maxWeightError, e);
+			sumWeightError += e;
+		}
+	}
+	else
+	{
+		weightBits = 16;
+		packedInfluences16.resize(attachments.size());
+		for (unsigned i = 0; i < attachments.size(); i++)
+		{
+			const float e = packInfluences(attachments[i], 65535.0f, packedInfluences16[i]);
+			maxWeightError = std::max(maxWeightError, e);
+			sumWeightError += e;
+		}
+	}
+
+	cout << "quantized weights: 4 x " << weightBits << " bit, 8 bit joint indices\n";
+	cout << "  weight error: max " << maxWeightError << ", mean (per-vertex max) " << sumWeightError / attachments.size() << '\n';
+
+	// Positions
+	if (quantizePositions)
+	{
+		Vector3f lo = bindVertices[0];
+		Vector3f hi = bindVertices[0];
+		for (const Vector3f& v : bindVertices)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				lo[k] = std::min(lo[k], v[k]);
+				hi[k] = std::max(hi[k], v[k]);
+			}
+		}
 
-		std::vector<float> weights;
-		weights.push_back(0); // weight of root
+		quantizedOrigin = lo;
+		quantizedScale = (hi - lo) / 65535.0f;
 
-		for (unsigned i = 0; i < numJoints - 1; i++)
+		float maxPositionError = 0;
+		double sumPositionError = 0;
+		quantizedPositions.resize(bindVertices.size());
+		for (unsigned i = 0; i < bindVertices.size(); i++)
 		{
-			float w;
-			iss >> w;
+			Vector3f decoded;
+			for (int k = 0; k < 3; k++)
+			{
+				const float q = (quantizedScale[k] > 0) ? floorf((bindVertices[i][k] - lo[k]) / quantizedScale[k] + 0.5f) : 0;
+				quantizedPositions[i].xyz[k] = q;
+				decoded[k] = lo[k] + q * quantizedScale[k];
+			}
 
-			weights.push_back(w);
+			const float e = (decoded - bindVertices[i]).abs();
+			maxPositionError = std::max(maxPositionError, e);
+			sumPositionError += e;
 		}
 
-		attachments.push_back(weights);
+		cout << "quantized positions: 3 x 16 bit\n";
+		cout << "  position error: max " << maxPositionError << ", mean " << sumPositionError / bindVertices.size()
+			<< " (AABB diagonal " << (hi - lo).abs() << ")\n";
 	}
 }
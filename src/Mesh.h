@@ -1,6 +1,7 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <string>
 #include <vector>
 #include <vecmath.h>
 #include <cstdlib>
@@ -16,6 +17,68 @@
 
 typedef tuple< unsigned, 3 > Tuple3u;
 
+// Up to 4 joint influences per vertex with 8-bit joint indices and
+// normalized weights (weight = w / 255). 8 bytes per vertex.
+struct PackedInfluences8
+{
+	unsigned char joints[ 4 ];
+	unsigned char weights[ 4 ];
+};
+
+// Same as PackedInfluences8 with 16-bit weights (weight = w / 65535).
+struct PackedInfluences16
+{
+	unsigned char joints[ 4 ];
+	unsigned short weights[ 4 ];
+};
+
+// Bind position quantized to 16 bits per axis relative to the mesh AABB:
+// p = Mesh::quantizedOrigin + q * Mesh::quantizedScale
+struct QuantizedPosition
+{
+	unsigned short xyz[ 3 ];
+};
+
+// Blend shape stored as sparse offsets from Mesh::bindVertices.
+// The moved vertices are grouped into runs of consecutive indices, each
+// inside one block of kMorphBlockSize vertices, and the offsets of a run
+// are contiguous x, y, z floats, so adding a run is one multiply-add loop.
+struct MorphTarget
+{
+	std::string name;
+
+	// run r covers vertices [ runStarts[ r ], runStarts[ r ] + runLengths[ r ] )
+	// and its offsets start at deltas[ 3 * runOffsets[ r ] ]
+	std::vector< unsigned > runStarts;
+	std::vector< unsigned > runLengths;
+	std::vector< unsigned > runOffsets;
+	std::vector< float > deltas;
+
+	// runs of block b are [ blockRuns[ b ], blockRuns[ b + 1 ] )
+	std::vector< unsigned > blockRuns;
+
+	// longest offset, for bounds
+	float maxDelta;
+};
+
+const unsigned kMorphBlockSize = 4096;
+
+// Vertices with the same number of joint influences, for skinning them
+// with a loop of fixed length. Each vertex has maxInfluences joints and
+// weights, the non-zero weights first, padded with joint 0 and weight 0.
+struct InfluenceBucket
+{
+	unsigned maxInfluences;
+	std::vector< unsigned > vertices; // ascending
+	std::vector< unsigned char > joints;
+	std::vector< float > weights;
+};
+
+// Bucket sizes of bucketInfluences(). Vertices with more influences than
+// the last one go to a final bucket sized for the largest count.
+const unsigned kNumInfluenceBucketSizes = 4;
+const unsigned kInfluenceBucketSizes[ kNumInfluenceBucketSizes ] = { 1, 2, 4, 8 };
+
 struct Mesh
 {
 	// list of vertices from the OBJ file
@@ -29,20 +92,108 @@ struct Mesh
 	// current vertex positions after animation
 	std::vector< Vector3f > currentVertices;
 
+	// Optional per-vertex normals, see computeBindNormals(). While
+	// currentNormals has one per current vertex, draw() shades smoothly
+	// with them instead of with face normals.
+	std::vector< Vector3f > bindNormals;
+	std::vector< Vector3f > currentNormals;
+
 	// list of vertex to joint attachments
 	// each element of attachments is a vector< float > containing
 	// one attachment weight per joint
 	std::vector< std::vector< float > > attachments;
 
+	// Optional compact skinning data, filled in by quantize().
+	// Only one of the two influence arrays is populated.
+	std::vector< PackedInfluences8 > packedInfluences8;
+	std::vector< PackedInfluences16 > packedInfluences16;
+	// empty unless positions are quantized too
+	std::vector< QuantizedPosition > quantizedPositions;
+	Vector3f quantizedOrigin;
+	Vector3f quantizedScale;
+
+	// Optional sparse attachments, filled in by bucketInfluences() or
+	// loadInfluenceBuckets(). Every vertex is in exactly one bucket.
+	std::vector< InfluenceBucket > influenceBuckets;
+
+	// blend shapes, see loadMorphTarget()
+	std::vector< MorphTarget > morphTargets;
+
 	// 2.1.1. load() should populate bindVertices, currentVertices, and faces
-	void load(const char *filename);
+	// The file is read at once, split into ranges of whole lines, and the
+	// ranges are parsed by up to numThreads threads (0: one per hardware
+	// thread), keeping the order of the file.
+	void load(const char *filename, unsigned numThreads = 0);
 
 	// 2.1.2. draw the current mesh.
 	void draw();
 
+	// Area weighted averages of the normals of the faces around each
+	// vertex: of the bind pose into bindNormals (and currentNormals), or
+	// of currentVertices into currentNormals, which is how normals are
+	// recomputed after skinning when they are not skinned themselves.
+	void computeBindNormals();
+	void computeCurrentNormals();
+
+	// Hash (64 bit FNV-1a) of bindVertices in their order, which tells
+	// apart meshes and vertex orders, e.g. with and without
+	// optimizeMeshLayout().
+	unsigned long long computeLayoutHash() const;
+
 	// 2.2. Implement this method to load the per-vertex attachment weights
 	// this method should update m_mesh.attachments
-	void loadAttachments( const char* filename, int numJoints );
+	// Parsed like load(). numJoints = 0 takes the joint count from the
+	// first line, for loading before the skeleton is known.
+	void loadAttachments( const char* filename, int numJoints, unsigned numThreads = 0 );
+
+	// Write bindVertices and faces, and the attachments, in the formats
+	// load() and loadAttachments() read.
+	void save( const char* filename ) const;
+	void saveAttachments( const char* filename ) const;
+
+	// Build the compact encoding from bindVertices and attachments:
+	// the 4 largest weights of each vertex are renormalized and stored
+	// with weightBits (8 or 16) bits, and if quantizePositions is set the
+	// bind positions are stored as 16-bit offsets within the AABB.
+	// Prints the quantization error against the float data.
+	void quantize( int weightBits, bool quantizePositions );
+
+	// Sorts the vertices by their number of non-zero attachment weights
+	// into the smallest bucket of kInfluenceBucketSizes that holds them.
+	// Returns false, leaving no buckets, if there are more than 256 joints.
+	bool bucketInfluences();
+
+	// Binary cache of the buckets, stamped with the size and modification
+	// time of the attachment file they were built from. loadInfluenceBuckets()
+	// returns false, leaving no buckets, if the file is missing, stale or
+	// does not match the mesh.
+	bool saveInfluenceBuckets( const char* filename, const char* attachmentsFile ) const;
+	bool loadInfluenceBuckets( const char* filename, const char* attachmentsFile );
+
+	// Renumbers the buckets' vertices after the vertices were reordered
+	// (remap[ old ] = new).
+	void remapInfluenceBuckets( const std::vector< unsigned >& remap );
+
+	// Adds a morph target from an OBJ file with the same vertices as this
+	// mesh in the target shape, named after the file. Only the vertices
+	// that move are kept. If the file cannot be used, an empty target is
+	// added anyway so that targets keep the order of the files.
+	// Returns false in that case.
+	bool loadMorphTarget( const char* filename );
+
+	// Adds weights[ s ] * morphTargets[ s ] to offsets (one per vertex) for
+	// the targets with a non-zero weight. Works one block of vertices at a
+	// time, so the block of offsets stays in cache while the active targets
+	// are added to it; inactive targets are not touched. If written is
+	// given and has fewer entries than offsets, the vertices of the active
+	// targets' runs are appended to it.
+	// Returns false if no target is active and offsets was left alone.
+	bool accumulateMorphTargets( const std::vector< float >& weights, std::vector< Vector3f >& offsets,
+		std::vector< unsigned >* written = nullptr ) const;
+
+	// Renumbers the morph targets' vertices after the vertices were
+	// reordered (remap[ old ] = new).
+	void remapMorphTargets( const std::vector< unsigned >& remap );
 };
 
 #endif
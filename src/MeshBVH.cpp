@@ -0,0 +1,648 @@
+#include "MeshBVH.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+const float MeshBVH::kRebuildRatio = 2.0f;
+
+namespace
+{
+	inline float dot( const float* a, const float* b )
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	inline void sub( const float* a, const float* b, float* out )
+	{
+		out[0] = a[0] - b[0];
+		out[1] = a[1] - b[1];
+		out[2] = a[2] - b[2];
+	}
+
+	inline void cross( const float* a, const float* b, float* out )
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	// half the surface area of a box, enough for comparing SAH costs
+	inline float halfArea( const float* min, const float* max )
+	{
+		const float dx = max[0] - min[0];
+		const float dy = max[1] - min[1];
+		const float dz = max[2] - min[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	inline void growBox( float* min, float* max, const float* p )
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			min[k] = std::min(min[k], p[k]);
+			max[k] = std::max(max[k], p[k]);
+		}
+	}
+
+	inline void emptyBox( float* min, float* max )
+	{
+		min[0] = min[1] = min[2] = FLT_MAX;
+		max[0] = max[1] = max[2] = -FLT_MAX;
+	}
+
+	// Entry distance of the ray into the box, if it enters before tMax
+	inline bool intersectBox( const float* min, const float* max, const float* origin, const float* invDirection,
+		float tMax, float& tEntry )
+	{
+		float t0 = 0;
+		float t1 = tMax;
+		for (int k = 0; k < 3; k++)
+		{
+			float tNear = (min[k] - origin[k]) * invDirection[k];
+			float tFar = (max[k] - origin[k]) * invDirection[k];
+			if (tNear > tFar)
+			{
+				std::swap(tNear, tFar);
+			}
+			// written so that NaN (ray in the slab's plane) keeps the old bound
+			t0 = tNear > t0 ? tNear : t0;
+			t1 = tFar < t1 ? tFar : t1;
+		}
+		tEntry = t0;
+		return t0 <= t1;
+	}
+
+	// Moller-Trumbore, both sides
+	inline bool intersectTriangle( const float* a, const float* b, const float* c, const float* origin,
+		const float* direction, float& t, float& u, float& v )
+	{
+		float e1[ 3 ], e2[ 3 ], p[ 3 ], s[ 3 ], q[ 3 ];
+		sub(b, a, e1);
+		sub(c, a, e2);
+		cross(direction, e2, p);
+
+		const float det = dot(e1, p);
+		if (fabsf(det) < 1e-12f)
+		{
+			return false;
+		}
+		const float invDet = 1.0f / det;
+
+		sub(origin, a, s);
+		u = dot(s, p) * invDet;
+		if (u < 0 || u > 1)
+		{
+			return false;
+		}
+
+		cross(s, e1, q);
+		v = dot(direction, q) * invDet;
+		if (v < 0 || u + v > 1)
+		{
+			return false;
+		}
+
+		t = dot(e2, q) * invDet;
+		return true;
+	}
+
+	// Closest point to p on triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+	void closestPointOnTriangle( const float* p, const float* a, const float* b, const float* c, float* out )
+	{
+		float ab[ 3 ], ac[ 3 ], ap[ 3 ];
+		sub(b, a, ab);
+		sub(c, a, ac);
+		sub(p, a, ap);
+
+		const float d1 = dot(ab, ap);
+		const float d2 = dot(ac, ap);
+		if (d1 <= 0 && d2 <= 0)
+		{
+			out[0] = a[0]; out[1] = a[1]; out[2] = a[2];
+			return;
+		}
+
+		float bp[ 3 ];
+		sub(p, b, bp);
+		const float d3 = dot(ab, bp);
+		const float d4 = dot(ac, bp);
+		if (d3 >= 0 && d4 <= d3)
+		{
+			out[0] = b[0]; out[1] = b[1]; out[2] = b[2];
+			return;
+		}
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		{
+			const float v = d1 / (d1 - d3);
+			for (int k = 0; k < 3; k++) out[k] = a[k] + v * ab[k];
+			return;
+		}
+
+		float cp[ 3 ];
+		sub(p, c, cp);
+		const float d5 = dot(ab, cp);
+		const float d6 = dot(ac, cp);
+		if (d6 >= 0 && d5 <= d6)
+		{
+			out[0] = c[0]; out[1] = c[1]; out[2] = c[2];
+			return;
+		}
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		{
+			const float w = d2 / (d2 - d6);
+			for (int k = 0; k < 3; k++) out[k] = a[k] + w * ac[k];
+			return;
+		}
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		{
+			const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			for (int k = 0; k < 3; k++) out[k] = b[k] + w * (c[k] - b[k]);
+			return;
+		}
+
+		const float denom = 1.0f / (va + vb + vc);
+		const float v = vb * denom;
+		const float w = vc * denom;
+		for (int k = 0; k < 3; k++) out[k] = a[k] + ab[k] * v + ac[k] * w;
+	}
+
+	inline float boxDistanceSquared( const float* min, const float* max, const float* p )
+	{
+		float d = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const float e = std::max(std::max(min[k] - p[k], 0.0f), p[k] - max[k]);
+			d += e * e;
+		}
+		return d;
+	}
+}
+
+MeshBVH::MeshBVH() :
+	m_numThreads(1),
+	m_buildCost(0)
+{
+}
+
+void MeshBVH::build( const vector< Vector3f >& vertices, const vector< Tuple3u >& faces, unsigned numThreads )
+{
+	m_numThreads = numThreads ? numThreads : defaultThreadCount();
+	m_nodes.clear();
+	m_faces.clear();
+	m_faceIndices.clear();
+
+	const unsigned numFaces = faces.size();
+	if (numFaces == 0)
+	{
+		return;
+	}
+
+	// per face centroid and box
+	vector< float > centroids(3 * numFaces);
+	vector< float > bounds(6 * numFaces);
+	vector< unsigned > order(numFaces);
+	for (unsigned f = 0; f < numFaces; f++)
+	{
+		float* min = &bounds[6 * f];
+		float* max = min + 3;
+		emptyBox(min, max);
+		for (int i = 0; i < 3; i++)
+		{
+			growBox(min, max, vertices[faces[f][i]]);
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			centroids[3 * f + k] = 0.5f * (min[k] + max[k]);
+		}
+		order[f] = f;
+	}
+
+	m_nodes.reserve(2 * numFaces / kMaxLeafSize + 1);
+	buildNode(0, numFaces, centroids, bounds, order);
+
+	m_faces.resize(numFaces);
+	m_faceIndices = order;
+	for (unsigned i = 0; i < numFaces; i++)
+	{
+		m_faces[i] = faces[order[i]];
+	}
+
+	planRefit();
+	m_buildCost = cost();
+}
+
+unsigned MeshBVH::buildNode( unsigned begin, unsigned end, vector< float >& centroids,
+	vector< float >& bounds, vector< unsigned >& order )
+{
+	const unsigned index = m_nodes.size();
+	m_nodes.push_back(Node());
+
+	Node node;
+	float centroidMin[ 3 ], centroidMax[ 3 ];
+	emptyBox(node.min, node.max);
+	emptyBox(centroidMin, centroidMax);
+	for (unsigned i = begin; i < end; i++)
+	{
+		const unsigned f = order[i];
+		growBox(node.min, node.max, &bounds[6 * f]);
+		growBox(node.min, node.max, &bounds[6 * f + 3]);
+		growBox(centroidMin, centroidMax, &centroids[3 * f]);
+	}
+
+	const unsigned count = end - begin;
+	if (count <= kMaxLeafSize)
+	{
+		node.start = begin;
+		node.count = count;
+		m_nodes[index] = node;
+		return index;
+	}
+
+	// Binned SAH: sort the centroids into kNumBins slabs per axis and
+	// pick the boundary that minimizes area * count on both sides.
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0)
+		{
+			continue;
+		}
+		const float binScale = kNumBins / extent;
+
+		unsigned binCount[ kNumBins ] = { 0 };
+		float binMin[ kNumBins ][ 3 ], binMax[ kNumBins ][ 3 ];
+		for (int b = 0; b < kNumBins; b++)
+		{
+			emptyBox(binMin[b], binMax[b]);
+		}
+
+		for (unsigned i = begin; i < end; i++)
+		{
+			const unsigned f = order[i];
+			const int b = std::min(kNumBins - 1, (int)((centroids[3 * f + axis] - centroidMin[axis]) * binScale));
+			binCount[b]++;
+			growBox(binMin[b], binMax[b], &bounds[6 * f]);
+			growBox(binMin[b], binMax[b], &bounds[6 * f + 3]);
+		}
+
+		// sweep from the right to get the cost of every right side
+		float rightCost[ kNumBins ];
+		float min[ 3 ], max[ 3 ];
+		unsigned n = 0;
+		emptyBox(min, max);
+		for (int b = kNumBins - 1; b > 0; b--)
+		{
+			n += binCount[b];
+			if (binCount[b] > 0)
+			{
+				growBox(min, max, binMin[b]);
+				growBox(min, max, binMax[b]);
+			}
+			rightCost[b] = n ? halfArea(min, max) * n : 0;
+		}
+
+		n = 0;
+		emptyBox(min, max);
+		for (int b = 0; b < kNumBins - 1; b++)
+		{
+			n += binCount[b];
+			if (binCount[b] > 0)
+			{
+				growBox(min, max, binMin[b]);
+				growBox(min, max, binMax[b]);
+			}
+			const float splitCost = (n ? halfArea(min, max) * n : 0) + rightCost[b + 1];
+			if (n > 0 && n < count && splitCost < bestCost)
+			{
+				bestCost = splitCost;
+				bestAxis = axis;
+				bestSplit = b + 1;
+			}
+		}
+	}
+
+	unsigned middle;
+	if (bestAxis >= 0)
+	{
+		const float binScale = kNumBins / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		const float axisMin = centroidMin[bestAxis];
+		middle = std::partition(order.begin() + begin, order.begin() + end, [&]( unsigned f )
+		{
+			return std::min(kNumBins - 1, (int)((centroids[3 * f + bestAxis] - axisMin) * binScale)) < bestSplit;
+		}) - order.begin();
+	}
+	else
+	{
+		// all centroids coincide: any split is as good as another
+		middle = begin + count / 2;
+	}
+
+	// the left child is always index + 1
+	buildNode(begin, middle, centroids, bounds, order);
+	const unsigned right = buildNode(middle, end, centroids, bounds, order);
+
+	node.start = right;
+	node.count = 0;
+	m_nodes[index] = node;
+	return index;
+}
+
+void MeshBVH::planRefit()
+{
+	m_subtreeFirst.clear();
+	m_subtreeEnd.clear();
+	m_topNodes.clear();
+
+	// Split the tree breadth first until there are a few subtrees per
+	// thread, so the threads get similar amounts of work.
+	vector< unsigned > frontier(1, 0);
+	const unsigned target = (m_numThreads > 1) ? 4 * m_numThreads : 1;
+
+	while (frontier.size() < target)
+	{
+		vector< unsigned > next;
+		for (unsigned i = 0; i < frontier.size(); i++)
+		{
+			const Node& node = m_nodes[frontier[i]];
+			if (node.count == 0)
+			{
+				m_topNodes.push_back(frontier[i]);
+				next.push_back(frontier[i] + 1);
+				next.push_back(node.start);
+			}
+			else
+			{
+				next.push_back(frontier[i]);
+			}
+		}
+
+		if (next.size() == frontier.size())
+		{
+			break;
+		}
+		frontier.swap(next);
+	}
+
+	// nodes are in depth first order, so a subtree is a contiguous range
+	// that ends after its rightmost leaf
+	for (unsigned i = 0; i < frontier.size(); i++)
+	{
+		unsigned last = frontier[i];
+		while (m_nodes[last].count == 0)
+		{
+			last = m_nodes[last].start;
+		}
+		m_subtreeFirst.push_back(frontier[i]);
+		m_subtreeEnd.push_back(last + 1);
+	}
+}
+
+void MeshBVH::refitNode( unsigned index, const vector< Vector3f >& vertices )
+{
+	Node& node = m_nodes[index];
+
+	if (node.count > 0)
+	{
+		emptyBox(node.min, node.max);
+		for (unsigned i = node.start; i < node.start + node.count; i++)
+		{
+			const Tuple3u& face = m_faces[i];
+			growBox(node.min, node.max, vertices[face[0]]);
+			growBox(node.min, node.max, vertices[face[1]]);
+			growBox(node.min, node.max, vertices[face[2]]);
+		}
+	}
+	else
+	{
+		const Node& left = m_nodes[index + 1];
+		const Node& right = m_nodes[node.start];
+		for (int k = 0; k < 3; k++)
+		{
+			node.min[k] = std::min(left.min[k], right.min[k]);
+			node.max[k] = std::max(left.max[k], right.max[k]);
+		}
+	}
+}
+
+bool MeshBVH::refit( const vector< Vector3f >& vertices )
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	parallelFor(m_subtreeFirst.size(), m_numThreads, [&]( unsigned begin, unsigned end )
+	{
+		for (unsigned s = begin; s < end; s++)
+		{
+			// children come after their parent, so walk backwards
+			for (unsigned n = m_subtreeEnd[s]; n-- > m_subtreeFirst[s]; )
+			{
+				refitNode(n, vertices);
+			}
+		}
+	});
+
+	for (unsigned i = m_topNodes.size(); i-- > 0; )
+	{
+		refitNode(m_topNodes[i], vertices);
+	}
+
+	if (cost() <= kRebuildRatio * m_buildCost)
+	{
+		return false;
+	}
+
+	vector< Tuple3u > faces(m_faces.size());
+	for (unsigned i = 0; i < m_faces.size(); i++)
+	{
+		faces[m_faceIndices[i]] = m_faces[i];
+	}
+	build(vertices, faces, m_numThreads);
+	return true;
+}
+
+float MeshBVH::cost() const
+{
+	if (m_nodes.empty())
+	{
+		return 0;
+	}
+
+	double sum = 0;
+	for (unsigned i = 0; i < m_nodes.size(); i++)
+	{
+		const Node& node = m_nodes[i];
+		sum += halfArea(node.min, node.max) * (node.count ? node.count : 1);
+	}
+
+	const float rootArea = halfArea(m_nodes[0].min, m_nodes[0].max);
+	return rootArea > 0 ? (float)(sum / (rootArea * m_faces.size())) : 0;
+}
+
+bool MeshBVH::raycast( const vector< Vector3f >& vertices, const Vector3f& origin, const Vector3f& direction,
+	RayHit& hit, float maxT ) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	const float* o = origin;
+	const float* d = direction;
+	const float invDirection[ 3 ] = { 1.0f / d[0], 1.0f / d[1], 1.0f / d[2] };
+
+	bool found = false;
+	float tMax = maxT;
+	float tEntry;
+
+	vector< unsigned > stack;
+	stack.reserve(64);
+	if (intersectBox(m_nodes[0].min, m_nodes[0].max, o, invDirection, tMax, tEntry))
+	{
+		stack.push_back(0);
+	}
+
+	while (!stack.empty())
+	{
+		const unsigned index = stack.back();
+		const Node& node = m_nodes[index];
+		stack.pop_back();
+
+		if (node.count > 0)
+		{
+			for (unsigned i = node.start; i < node.start + node.count; i++)
+			{
+				const Tuple3u& face = m_faces[i];
+				float t, u, v;
+				if (intersectTriangle(vertices[face[0]], vertices[face[1]], vertices[face[2]], o, d, t, u, v)
+					&& t >= 0 && t <= tMax)
+				{
+					tMax = t;
+					hit.t = t;
+					hit.face = m_faceIndices[i];
+					hit.u = u;
+					hit.v = v;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first so tMax shrinks early
+		const unsigned left = index + 1;
+		const unsigned right = node.start;
+		float tLeft, tRight;
+		const bool hitLeft = intersectBox(m_nodes[left].min, m_nodes[left].max, o, invDirection, tMax, tLeft);
+		const bool hitRight = intersectBox(m_nodes[right].min, m_nodes[right].max, o, invDirection, tMax, tRight);
+
+		if (hitLeft && hitRight)
+		{
+			if (tLeft < tRight)
+			{
+				stack.push_back(right);
+				stack.push_back(left);
+			}
+			else
+			{
+				stack.push_back(left);
+				stack.push_back(right);
+			}
+		}
+		else if (hitLeft)
+		{
+			stack.push_back(left);
+		}
+		else if (hitRight)
+		{
+			stack.push_back(right);
+		}
+	}
+
+	return found;
+}
+
+bool MeshBVH::closestPoint( const vector< Vector3f >& vertices, const Vector3f& point,
+	ClosestPoint& result, float maxDistance ) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	const float* p = point;
+	float best = maxDistance * maxDistance;
+	bool found = false;
+
+	vector< unsigned > stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		const unsigned index = stack.back();
+		const Node& node = m_nodes[index];
+		stack.pop_back();
+
+		if (boxDistanceSquared(node.min, node.max, p) > best)
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (unsigned i = node.start; i < node.start + node.count; i++)
+			{
+				const Tuple3u& face = m_faces[i];
+				float q[ 3 ], e[ 3 ];
+				closestPointOnTriangle(p, vertices[face[0]], vertices[face[1]], vertices[face[2]], q);
+				sub(q, p, e);
+				const float distanceSquared = dot(e, e);
+				if (distanceSquared <= best)
+				{
+					best = distanceSquared;
+					result.point = Vector3f(q[0], q[1], q[2]);
+					result.face = m_faceIndices[i];
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first
+		const unsigned left = index + 1;
+		const unsigned right = node.start;
+		const float dLeft = boxDistanceSquared(m_nodes[left].min, m_nodes[left].max, p);
+		const float dRight = boxDistanceSquared(m_nodes[right].min, m_nodes[right].max, p);
+		if (dLeft < dRight)
+		{
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+		else
+		{
+			stack.push_back(left);
+			stack.push_back(right);
+		}
+	}
+
+	if (found)
+	{
+		result.distance = sqrtf(best);
+	}
+	return found;
+}
@@ -0,0 +1,101 @@
+#ifndef MESH_BVH_H
+#define MESH_BVH_H
+
+#include <vector>
+#include <vecmath.h>
+
+#include "Mesh.h"
+
+// Bounding volume hierarchy over the triangles of a deforming mesh.
+//
+// The tree topology is built once (binned SAH) on the bind pose. After
+// the vertices move, refit() recomputes the boxes bottom-up without
+// changing the topology: the subtrees below a small top part of the tree
+// are refitted on separate threads, then the top part serially. Skinning
+// keeps neighbouring triangles together, so the refitted tree stays good;
+// if its SAH cost grows past kRebuildRatio times the cost after the last
+// build, it is rebuilt from the current vertices instead.
+//
+// The tree keeps its own copy of the faces in leaf order but not the
+// vertices, which are passed to every call.
+class MeshBVH
+{
+public:
+
+	// Nearest intersection along a ray.
+	struct RayHit
+	{
+		float t;       // hit point = origin + t * direction
+		unsigned face; // index into the faces passed to build()
+		float u, v;    // barycentric weights of the face's 2nd and 3rd vertex
+	};
+
+	// Point of the mesh closest to a query point.
+	struct ClosestPoint
+	{
+		Vector3f point;
+		float distance;
+		unsigned face;
+	};
+
+	MeshBVH();
+
+	// numThreads = 0 uses one thread per hardware thread for refit()
+	void build( const std::vector< Vector3f >& vertices, const std::vector< Tuple3u >& faces, unsigned numThreads = 0 );
+
+	// Updates the boxes for moved vertices (same faces as build()).
+	// Returns true if the tree had degraded and was rebuilt instead.
+	bool refit( const std::vector< Vector3f >& vertices );
+
+	// Nearest hit with t in [0, maxT]; triangles are hit from both sides.
+	bool raycast( const std::vector< Vector3f >& vertices, const Vector3f& origin, const Vector3f& direction,
+		RayHit& hit, float maxT = 1e30f ) const;
+
+	// Closest point on the mesh within maxDistance of point.
+	bool closestPoint( const std::vector< Vector3f >& vertices, const Vector3f& point,
+		ClosestPoint& result, float maxDistance = 1e30f ) const;
+
+	bool empty() const { return m_nodes.empty(); }
+	unsigned numNodes() const { return m_nodes.size(); }
+
+	// SAH cost of the tree relative to one leaf holding every triangle
+	float cost() const;
+
+	static const float kRebuildRatio;
+
+private:
+
+	enum { kMaxLeafSize = 4, kNumBins = 12 };
+
+	// 32 bytes. Leaves hold m_faces[ start, start + count ).
+	// Internal nodes have count == 0, their left child is the next node
+	// and their right child is node start.
+	struct Node
+	{
+		float min[ 3 ];
+		unsigned start;
+		float max[ 3 ];
+		unsigned count;
+	};
+
+	unsigned buildNode( unsigned begin, unsigned end, std::vector< float >& centroids,
+		std::vector< float >& bounds, std::vector< unsigned >& order );
+	void planRefit();
+	void refitNode( unsigned node, const std::vector< Vector3f >& vertices );
+
+	std::vector< Node > m_nodes;
+	// faces in leaf order and their index in the faces passed to build()
+	std::vector< Tuple3u > m_faces;
+	std::vector< unsigned > m_faceIndices;
+
+	// refit schedule: subtrees [ first, end ) refitted in parallel, then
+	// the nodes above them, children before parents
+	std::vector< unsigned > m_subtreeFirst;
+	std::vector< unsigned > m_subtreeEnd;
+	std::vector< unsigned > m_topNodes;
+
+	unsigned m_numThreads;
+	float m_buildCost;
+};
+
+#endif // MESH_BVH_H
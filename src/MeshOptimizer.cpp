@@ -0,0 +1,338 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+using namespace std;
+
+namespace
+{
+	// Size of the simulated LRU cache used to score vertices.
+	const int kCacheSize = 32;
+
+	// Forsyth's tuning constants.
+	const float kCacheDecayPower = 1.5f;
+	const float kLastTriScore = 0.75f;
+	const float kValenceBoostScale = 2.0f;
+	const float kValenceBoostPower = 0.5f;
+
+	float vertexScore( int cachePosition, int remainingValence )
+	{
+		// No triangles left that use this vertex, never pick it.
+		if (remainingValence == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// Used by the triangle that was just emitted. Give it a fixed
+				// score so we don't favour the immediately previous triangle too much.
+				score = kLastTriScore;
+			}
+			else
+			{
+				const float scale = 1.0f / (kCacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3) * scale, kCacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few triangles left, so lone triangles get cleared out.
+		score += kValenceBoostScale * powf((float)remainingValence, -kValenceBoostPower);
+
+		return score;
+	}
+
+	// Returns the triangle order that minimizes post-transform cache misses.
+	vector< unsigned > forsythTriangleOrder( const vector< Tuple3u >& faces, unsigned numVertices )
+	{
+		const unsigned numFaces = faces.size();
+
+		// vertex --> triangles adjacency. The first valence[v] entries starting
+		// at triangleOffsets[v] are the triangles not yet emitted.
+		vector< int > valence(numVertices, 0);
+		for (const Tuple3u& f : faces)
+		{
+			valence[f[0]]++;
+			valence[f[1]]++;
+			valence[f[2]]++;
+		}
+
+		vector< unsigned > triangleOffsets(numVertices + 1, 0);
+		for (unsigned v = 0; v < numVertices; v++)
+		{
+			triangleOffsets[v + 1] = triangleOffsets[v] + valence[v];
+		}
+
+		vector< unsigned > triangles(triangleOffsets[numVertices]);
+		{
+			vector< unsigned > fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (unsigned t = 0; t < numFaces; t++)
+			{
+				for (unsigned k = 0; k < 3; k++)
+				{
+					triangles[fill[faces[t][k]]++] = t;
+				}
+			}
+		}
+
+		vector< int > cachePosition(numVertices, -1);
+		vector< float > vScore(numVertices);
+		for (unsigned v = 0; v < numVertices; v++)
+		{
+			vScore[v] = vertexScore(-1, valence[v]);
+		}
+
+		vector< float > tScore(numFaces);
+		vector< bool > emitted(numFaces, false);
+		for (unsigned t = 0; t < numFaces; t++)
+		{
+			tScore[t] = vScore[faces[t][0]] + vScore[faces[t][1]] + vScore[faces[t][2]];
+		}
+
+		vector< unsigned > order;
+		order.reserve(numFaces);
+
+		vector< unsigned > cache;
+		vector< unsigned > newCache;
+		cache.reserve(kCacheSize + 3);
+		newCache.reserve(kCacheSize + 3);
+
+		int bestTriangle = -1;
+		unsigned scanCursor = 0;
+
+		while (order.size() < numFaces)
+		{
+			if (bestTriangle < 0)
+			{
+				// Nothing useful in the cache, fall back to the best remaining triangle.
+				while (emitted[scanCursor])
+				{
+					scanCursor++;
+				}
+
+				bestTriangle = scanCursor;
+				for (unsigned t = scanCursor + 1; t < numFaces; t++)
+				{
+					if (!emitted[t] && tScore[t] > tScore[bestTriangle])
+					{
+						bestTriangle = t;
+					}
+				}
+			}
+
+			const Tuple3u& f = faces[bestTriangle];
+			order.push_back(bestTriangle);
+			emitted[bestTriangle] = true;
+
+			// Remove the triangle from the active lists of its vertices.
+			for (unsigned k = 0; k < 3; k++)
+			{
+				const unsigned v = f[k];
+				unsigned* first = &triangles[triangleOffsets[v]];
+				unsigned* last = first + valence[v];
+				unsigned* found = std::find(first, last, (unsigned)bestTriangle);
+				std::swap(*found, *(last - 1));
+				valence[v]--;
+			}
+
+			// Move the triangle's vertices to the front of the LRU cache.
+			newCache.clear();
+			newCache.push_back(f[0]);
+			newCache.push_back(f[1]);
+			newCache.push_back(f[2]);
+			for (unsigned v : cache)
+			{
+				if (v != f[0] && v != f[1] && v != f[2])
+				{
+					newCache.push_back(v);
+				}
+			}
+
+			// Rescore everything that was in or has just fallen out of the cache.
+			for (unsigned i = 0; i < newCache.size(); i++)
+			{
+				const unsigned v = newCache[i];
+				cachePosition[v] = (i < (unsigned)kCacheSize) ? (int)i : -1;
+				vScore[v] = vertexScore(cachePosition[v], valence[v]);
+			}
+
+			bestTriangle = -1;
+			float bestScore = -1.0f;
+			for (unsigned v : newCache)
+			{
+				for (int i = 0; i < valence[v]; i++)
+				{
+					const unsigned t = triangles[triangleOffsets[v] + i];
+					const Tuple3u& g = faces[t];
+					tScore[t] = vScore[g[0]] + vScore[g[1]] + vScore[g[2]];
+
+					if (cachePosition[v] >= 0 && tScore[t] > bestScore)
+					{
+						bestScore = tScore[t];
+						bestTriangle = t;
+					}
+				}
+			}
+
+			if (newCache.size() > (unsigned)kCacheSize)
+			{
+				newCache.resize(kCacheSize);
+			}
+			cache.swap(newCache);
+		}
+
+		return order;
+	}
+
+	unsigned dominantJoint( const vector< float >& weights )
+	{
+		unsigned best = 0;
+		for (unsigned j = 1; j < weights.size(); j++)
+		{
+			if (weights[j] > weights[best])
+			{
+				best = j;
+			}
+		}
+		return best;
+	}
+}
+
+void optimizeMeshLayout( Mesh& mesh, vector< unsigned >* vertexRemap )
+{
+	const unsigned numVertices = mesh.bindVertices.size();
+	const bool hasAttachments = (mesh.attachments.size() == numVertices);
+
+	// 1. Reorder triangles for the post-transform cache.
+	const vector< unsigned > triangleOrder = forsythTriangleOrder(mesh.faces, numVertices);
+
+	vector< Tuple3u > faces;
+	faces.reserve(mesh.faces.size());
+	for (unsigned t : triangleOrder)
+	{
+		faces.push_back(mesh.faces[t]);
+	}
+
+	// 2. Reorder vertices: cluster by dominant joint, and within a cluster
+	// by first use in the new triangle order. Unreferenced vertices go last.
+	vector< unsigned > firstUse(numVertices, UINT_MAX);
+	for (unsigned t = 0; t < faces.size(); t++)
+	{
+		for (unsigned k = 0; k < 3; k++)
+		{
+			firstUse[faces[t][k]] = std::min(firstUse[faces[t][k]], 3 * t + k);
+		}
+	}
+
+	vector< unsigned > dominant(numVertices, 0);
+	if (hasAttachments)
+	{
+		for (unsigned v = 0; v < numVertices; v++)
+		{
+			dominant[v] = dominantJoint(mesh.attachments[v]);
+		}
+	}
+
+	vector< unsigned > vertexOrder(numVertices);
+	for (unsigned v = 0; v < numVertices; v++)
+	{
+		vertexOrder[v] = v;
+	}
+	std::stable_sort(vertexOrder.begin(), vertexOrder.end(),
+		[&]( unsigned a, unsigned b )
+		{
+			if (dominant[a] != dominant[b])
+			{
+				return dominant[a] < dominant[b];
+			}
+			return firstUse[a] < firstUse[b];
+		});
+
+	// old index --> new index
+	vector< unsigned > remap(numVertices);
+	for (unsigned i = 0; i < numVertices; i++)
+	{
+		remap[vertexOrder[i]] = i;
+	}
+
+	// 3. Apply the permutation to everything indexed by vertex.
+	for (Tuple3u& f : faces)
+	{
+		f = Tuple3u(remap[f[0]], remap[f[1]], remap[f[2]]);
+	}
+	mesh.faces.swap(faces);
+
+	vector< Vector3f > bindVertices(numVertices);
+	vector< Vector3f > currentVertices(numVertices);
+	for (unsigned i = 0; i < numVertices; i++)
+	{
+		bindVertices[i] = mesh.bindVertices[vertexOrder[i]];
+		currentVertices[i] = mesh.currentVertices[vertexOrder[i]];
+	}
+	mesh.bindVertices.swap(bindVertices);
+	mesh.currentVertices.swap(currentVertices);
+
+	if (hasAttachments)
+	{
+		vector< vector< float > > attachments(numVertices);
+		for (unsigned i = 0; i < numVertices; i++)
+		{
+			attachments[i].swap(mesh.attachments[vertexOrder[i]]);
+		}
+		mesh.attachments.swap(attachments);
+	}
+
+	mesh.remapMorphTargets(remap);
+	mesh.remapInfluenceBuckets(remap);
+
+	if (vertexRemap != nullptr)
+	{
+		vertexRemap->swap(remap);
+	}
+}
+
+float computeACMR( const vector< Tuple3u >& faces, unsigned numVertices, unsigned cacheSize )
+{
+	if (faces.empty())
+	{
+		return 0.0f;
+	}
+
+	// A vertex is in the FIFO cache iff fewer than cacheSize misses
+	// have happened since it was inserted.
+	vector< int > insertedAt(numVertices, INT_MIN / 2);
+	int misses = 0;
+
+	for (const Tuple3u& f : faces)
+	{
+		for (unsigned k = 0; k < 3; k++)
+		{
+			if (misses - insertedAt[f[k]] > (int)cacheSize)
+			{
+				insertedAt[f[k]] = misses;
+				misses++;
+			}
+		}
+	}
+
+	return (float)misses / faces.size();
+}
+
+unsigned countDominantJointSwitches( const Mesh& mesh )
+{
+	unsigned switches = 0;
+	for (unsigned v = 1; v < mesh.attachments.size(); v++)
+	{
+		if (dominantJoint(mesh.attachments[v]) != dominantJoint(mesh.attachments[v - 1]))
+		{
+			switches++;
+		}
+	}
+	return switches;
+}
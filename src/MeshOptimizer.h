@@ -0,0 +1,29 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include "Mesh.h"
+
+// Load-time layout optimization for a skinned mesh.
+//
+// Triangles are reordered for post-transform vertex cache locality
+// (Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"), then vertices
+// are renumbered so that vertices sharing the same dominant joint are
+// contiguous, in the order they are first referenced by the new triangle
+// order. faces, bindVertices, currentVertices, attachments, influence
+// buckets and morph targets are all remapped consistently. If vertexRemap
+// is given, it receives the new index of every old vertex, for other data
+// indexed by vertex.
+void optimizeMeshLayout( Mesh& mesh, std::vector< unsigned >* vertexRemap = nullptr );
+
+// Average number of post-transform cache misses per triangle (ACMR)
+// for a FIFO vertex cache holding cacheSize vertices.
+// 0.5 is the optimum for a regular grid, 3 is the worst case.
+float computeACMR( const std::vector< Tuple3u >& faces, unsigned numVertices, unsigned cacheSize );
+
+// Number of times the dominant joint changes between consecutive
+// vertices in memory order. Lower values mean the skinning loop
+// touches the same joint matrices for longer runs of vertices.
+unsigned countDominantJointSwitches( const Mesh& mesh );
+
+#endif // MESH_OPTIMIZER_H
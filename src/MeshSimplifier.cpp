@@ -0,0 +1,597 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+	// Open boundary edges get a constraint plane this many times
+	// stronger than the surface, so the outline does not shrink.
+	const double kBoundaryWeight = 100.0;
+
+	// Reject collapses that rotate a face normal by more than about 85 degrees.
+	const double kMinNormalCosine = 0.1;
+
+	typedef vector< pair< unsigned, float > > SparseWeights;
+
+	// Symmetric 4x4 matrix sum of squared distances to planes,
+	// stored as its upper triangle: a2 ab ac ad b2 bc bd c2 cd d2
+	struct Quadric
+	{
+		double m[ 10 ];
+
+		Quadric() { std::fill(m, m + 10, 0.0); }
+
+		void addPlane( double a, double b, double c, double d, double weight )
+		{
+			m[0] += weight * a * a; m[1] += weight * a * b; m[2] += weight * a * c; m[3] += weight * a * d;
+			m[4] += weight * b * b; m[5] += weight * b * c; m[6] += weight * b * d;
+			m[7] += weight * c * c; m[8] += weight * c * d;
+			m[9] += weight * d * d;
+		}
+
+		Quadric& operator += ( const Quadric& q )
+		{
+			for (int i = 0; i < 10; i++)
+			{
+				m[i] += q.m[i];
+			}
+			return *this;
+		}
+
+		double evaluate( const double* p ) const
+		{
+			const double x = p[0], y = p[1], z = p[2];
+			return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+				+ m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+				+ m[7] * z * z + 2 * m[8] * z
+				+ m[9];
+		}
+
+		// Position with the smallest error, unless the system is singular
+		// (flat or straight neighbourhoods)
+		bool minimize( double* p ) const
+		{
+			const double a = m[0], b = m[1], c = m[2];
+			const double e = m[4], f = m[5], i = m[7];
+			const double det = a * (e * i - f * f) - b * (b * i - f * c) + c * (b * f - e * c);
+			const double scale = a + e + i;
+			if (fabs(det) <= 1e-12 * scale * scale * scale)
+			{
+				return false;
+			}
+
+			// A p = -( ad, bd, cd ) by Cramer's rule
+			const double rx = -m[3], ry = -m[6], rz = -m[8];
+			p[0] = (rx * (e * i - f * f) - b * (ry * i - f * rz) + c * (ry * f - e * rz)) / det;
+			p[1] = (a * (ry * i - f * rz) - rx * (b * i - f * c) + c * (b * rz - ry * c)) / det;
+			p[2] = (a * (e * rz - ry * f) - b * (b * rz - ry * c) + rx * (b * f - e * c)) / det;
+			return true;
+		}
+	};
+
+	struct Collapse
+	{
+		double cost;
+		unsigned keep;
+		unsigned remove;
+		unsigned keepVersion;
+		unsigned removeVersion;
+		double position[ 3 ];
+		float t; // position along the edge from keep (0) to remove (1), for the weights
+
+		// cheapest first in a std::priority_queue
+		bool operator < ( const Collapse& other ) const { return cost > other.cost; }
+	};
+
+	inline void faceNormal( const double* a, const double* b, const double* c, double* n )
+	{
+		const double e1[ 3 ] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const double e2[ 3 ] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	class Simplifier
+	{
+	public:
+
+		Simplifier( const Mesh& mesh );
+		void run( unsigned targetFaces );
+		void output( unsigned numJoints, Mesh& simplified ) const;
+
+	private:
+
+		void addBoundaryPlanes();
+		void neighbours( unsigned v, vector< unsigned >& result ) const;
+		void computeCollapse( unsigned keep, unsigned remove, Collapse& collapse ) const;
+		bool isValid( const Collapse& collapse ) const;
+		void apply( const Collapse& collapse );
+		void pushCollapses( unsigned v, bool allEdges );
+
+		vector< double > m_positions;
+		vector< Quadric > m_quadrics;
+		vector< SparseWeights > m_weights;
+		vector< unsigned > m_versions;
+		vector< bool > m_vertexAlive;
+
+		vector< Tuple3u > m_faces;
+		vector< bool > m_faceAlive;
+		vector< vector< unsigned > > m_vertexFaces;
+		unsigned m_numFaces;
+
+		priority_queue< Collapse > m_queue;
+	};
+
+	Simplifier::Simplifier( const Mesh& mesh ) :
+		m_faces(mesh.faces),
+		m_numFaces(mesh.faces.size())
+	{
+		const unsigned numVertices = mesh.bindVertices.size();
+
+		m_positions.resize(3 * numVertices);
+		m_quadrics.resize(numVertices);
+		m_weights.resize(numVertices);
+		m_versions.assign(numVertices, 0);
+		m_vertexAlive.assign(numVertices, true);
+		m_faceAlive.assign(m_faces.size(), true);
+		m_vertexFaces.resize(numVertices);
+
+		for (unsigned v = 0; v < numVertices; v++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				m_positions[3 * v + k] = mesh.bindVertices[v][k];
+			}
+
+			if (v < mesh.attachments.size())
+			{
+				const vector< float >& weights = mesh.attachments[v];
+				for (unsigned j = 0; j < weights.size(); j++)
+				{
+					if (weights[j] > 0)
+					{
+						m_weights[v].push_back(make_pair(j, weights[j]));
+					}
+				}
+			}
+		}
+
+		// every vertex starts with the planes of its faces, weighted by area
+		for (unsigned f = 0; f < m_faces.size(); f++)
+		{
+			const Tuple3u& face = m_faces[f];
+			double n[ 3 ];
+			faceNormal(&m_positions[3 * face[0]], &m_positions[3 * face[1]], &m_positions[3 * face[2]], n);
+			const double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length > 0)
+			{
+				const double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+				const double* p = &m_positions[3 * face[0]];
+				const double d = -(a * p[0] + b * p[1] + c * p[2]);
+				for (int i = 0; i < 3; i++)
+				{
+					m_quadrics[face[i]].addPlane(a, b, c, d, 0.5 * length);
+				}
+			}
+
+			for (int i = 0; i < 3; i++)
+			{
+				m_vertexFaces[face[i]].push_back(f);
+			}
+		}
+
+		addBoundaryPlanes();
+
+		for (unsigned v = 0; v < numVertices; v++)
+		{
+			pushCollapses(v, false);
+		}
+	}
+
+	void Simplifier::addBoundaryPlanes()
+	{
+		// edges used by a single face, as ( min, max, face )
+		vector< pair< pair< unsigned, unsigned >, unsigned > > edges;
+		edges.reserve(3 * m_faces.size());
+		for (unsigned f = 0; f < m_faces.size(); f++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				const unsigned a = m_faces[f][i];
+				const unsigned b = m_faces[f][(i + 1) % 3];
+				edges.push_back(make_pair(make_pair(std::min(a, b), std::max(a, b)), f));
+			}
+		}
+		sort(edges.begin(), edges.end());
+
+		for (unsigned i = 0; i < edges.size(); i++)
+		{
+			const bool shared = (i > 0 && edges[i - 1].first == edges[i].first)
+				|| (i + 1 < edges.size() && edges[i + 1].first == edges[i].first);
+			if (shared)
+			{
+				continue;
+			}
+
+			const unsigned a = edges[i].first.first;
+			const unsigned b = edges[i].first.second;
+			const Tuple3u& face = m_faces[edges[i].second];
+
+			double n[ 3 ];
+			faceNormal(&m_positions[3 * face[0]], &m_positions[3 * face[1]], &m_positions[3 * face[2]], n);
+			const double* pa = &m_positions[3 * a];
+			const double* pb = &m_positions[3 * b];
+			const double e[ 3 ] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+
+			// plane through the edge, perpendicular to the face
+			double p[ 3 ] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+			const double length = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+			if (length == 0)
+			{
+				continue;
+			}
+			p[0] /= length;
+			p[1] /= length;
+			p[2] /= length;
+			const double d = -(p[0] * pa[0] + p[1] * pa[1] + p[2] * pa[2]);
+			const double weight = kBoundaryWeight * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+
+			m_quadrics[a].addPlane(p[0], p[1], p[2], d, weight);
+			m_quadrics[b].addPlane(p[0], p[1], p[2], d, weight);
+		}
+	}
+
+	void Simplifier::neighbours( unsigned v, vector< unsigned >& result ) const
+	{
+		result.clear();
+		for (unsigned i = 0; i < m_vertexFaces[v].size(); i++)
+		{
+			const unsigned f = m_vertexFaces[v][i];
+			if (!m_faceAlive[f])
+			{
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				if (m_faces[f][k] != v)
+				{
+					result.push_back(m_faces[f][k]);
+				}
+			}
+		}
+		sort(result.begin(), result.end());
+		result.erase(unique(result.begin(), result.end()), result.end());
+	}
+
+	void Simplifier::computeCollapse( unsigned keep, unsigned remove, Collapse& collapse ) const
+	{
+		Quadric q = m_quadrics[keep];
+		q += m_quadrics[remove];
+
+		const double* p0 = &m_positions[3 * keep];
+		const double* p1 = &m_positions[3 * remove];
+
+		double best[ 3 ];
+		if (!q.minimize(best))
+		{
+			// the better of the endpoints and the midpoint
+			const double middle[ 3 ] = { 0.5 * (p0[0] + p1[0]), 0.5 * (p0[1] + p1[1]), 0.5 * (p0[2] + p1[2]) };
+			const double* candidates[ 3 ] = { p0, p1, middle };
+			double bestCost = -1;
+			for (int c = 0; c < 3; c++)
+			{
+				const double cost = q.evaluate(candidates[c]);
+				if (bestCost < 0 || cost < bestCost)
+				{
+					bestCost = cost;
+					std::copy(candidates[c], candidates[c] + 3, best);
+				}
+			}
+		}
+
+		const double e[ 3 ] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		const double lengthSquared = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+		double t = 0.5;
+		if (lengthSquared > 0)
+		{
+			t = ((best[0] - p0[0]) * e[0] + (best[1] - p0[1]) * e[1] + (best[2] - p0[2]) * e[2]) / lengthSquared;
+			t = std::min(1.0, std::max(0.0, t));
+		}
+
+		collapse.cost = std::max(0.0, q.evaluate(best));
+		collapse.keep = keep;
+		collapse.remove = remove;
+		collapse.keepVersion = m_versions[keep];
+		collapse.removeVersion = m_versions[remove];
+		std::copy(best, best + 3, collapse.position);
+		collapse.t = (float)t;
+	}
+
+	bool Simplifier::isValid( const Collapse& collapse ) const
+	{
+		const unsigned keep = collapse.keep;
+		const unsigned remove = collapse.remove;
+
+		// Link condition: the two vertices may only share the neighbours
+		// opposite the edge, otherwise the collapse pinches the surface.
+		vector< unsigned > keepNeighbours, removeNeighbours, common;
+		neighbours(keep, keepNeighbours);
+		neighbours(remove, removeNeighbours);
+		set_intersection(keepNeighbours.begin(), keepNeighbours.end(),
+			removeNeighbours.begin(), removeNeighbours.end(), back_inserter(common));
+
+		unsigned sharedFaces = 0;
+		for (unsigned i = 0; i < m_vertexFaces[keep].size(); i++)
+		{
+			const unsigned f = m_vertexFaces[keep][i];
+			if (m_faceAlive[f] && (m_faces[f][0] == remove || m_faces[f][1] == remove || m_faces[f][2] == remove))
+			{
+				sharedFaces++;
+			}
+		}
+		if (common.size() != sharedFaces)
+		{
+			return false;
+		}
+
+		// No face around either vertex may flip over
+		const unsigned ends[ 2 ] = { keep, remove };
+		for (int end = 0; end < 2; end++)
+		{
+			const vector< unsigned >& faces = m_vertexFaces[ends[end]];
+			for (unsigned i = 0; i < faces.size(); i++)
+			{
+				const unsigned f = faces[i];
+				if (!m_faceAlive[f])
+				{
+					continue;
+				}
+
+				const Tuple3u& face = m_faces[f];
+				const double* before[ 3 ];
+				const double* after[ 3 ];
+				bool collapsing = false;
+				for (int k = 0; k < 3; k++)
+				{
+					before[k] = &m_positions[3 * face[k]];
+					after[k] = before[k];
+					if (face[k] == keep || face[k] == remove)
+					{
+						after[k] = collapse.position;
+						collapsing = collapsing || face[k] == ends[1 - end];
+					}
+				}
+				// faces on the edge disappear
+				if (collapsing)
+				{
+					continue;
+				}
+
+				double n0[ 3 ], n1[ 3 ];
+				faceNormal(before[0], before[1], before[2], n0);
+				faceNormal(after[0], after[1], after[2], n1);
+				const double d = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+				const double l0 = sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+				const double l1 = sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+				if (d < kMinNormalCosine * l0 * l1)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void Simplifier::apply( const Collapse& collapse )
+	{
+		const unsigned keep = collapse.keep;
+		const unsigned remove = collapse.remove;
+
+		std::copy(collapse.position, collapse.position + 3, &m_positions[3 * keep]);
+		m_quadrics[keep] += m_quadrics[remove];
+
+		// weights interpolated along the edge, largest influences kept
+		const float t = collapse.t;
+		SparseWeights merged;
+		const SparseWeights& a = m_weights[keep];
+		const SparseWeights& b = m_weights[remove];
+		float sum = 0;
+		for (unsigned i = 0; i < a.size(); i++)
+		{
+			merged.push_back(make_pair(a[i].first, (1 - t) * a[i].second));
+			sum += merged.back().second;
+		}
+		for (unsigned i = 0; i < b.size(); i++)
+		{
+			SparseWeights::iterator it = merged.begin();
+			while (it != merged.end() && it->first != b[i].first)
+			{
+				++it;
+			}
+			if (it == merged.end())
+			{
+				merged.push_back(make_pair(b[i].first, 0.0f));
+				it = merged.end() - 1;
+			}
+			it->second += t * b[i].second;
+			sum += t * b[i].second;
+		}
+		sort(merged.begin(), merged.end(), []( const pair< unsigned, float >& x, const pair< unsigned, float >& y )
+		{
+			return x.second > y.second;
+		});
+		while (!merged.empty() && merged.back().second <= 0)
+		{
+			merged.pop_back();
+		}
+		if (merged.size() > kMaxSimplifiedInfluences)
+		{
+			merged.resize(kMaxSimplifiedInfluences);
+			float kept = 0;
+			for (unsigned i = 0; i < merged.size(); i++)
+			{
+				kept += merged[i].second;
+			}
+			// keep the original total weight
+			for (unsigned i = 0; i < merged.size(); i++)
+			{
+				merged[i].second *= sum / kept;
+			}
+		}
+		m_weights[keep].swap(merged);
+		m_weights[remove].clear();
+
+		// move the removed vertex's faces over, dropping the ones on the edge
+		const vector< unsigned >& removedFaces = m_vertexFaces[remove];
+		for (unsigned i = 0; i < removedFaces.size(); i++)
+		{
+			const unsigned f = removedFaces[i];
+			if (!m_faceAlive[f])
+			{
+				continue;
+			}
+
+			Tuple3u& face = m_faces[f];
+			if (face[0] == keep || face[1] == keep || face[2] == keep)
+			{
+				m_faceAlive[f] = false;
+				m_numFaces--;
+				continue;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				if (face[k] == remove)
+				{
+					face[k] = keep;
+				}
+			}
+			m_vertexFaces[keep].push_back(f);
+		}
+		m_vertexFaces[remove].clear();
+		m_vertexAlive[remove] = false;
+
+		// forget dead faces
+		vector< unsigned >& keptFaces = m_vertexFaces[keep];
+		unsigned alive = 0;
+		for (unsigned i = 0; i < keptFaces.size(); i++)
+		{
+			if (m_faceAlive[keptFaces[i]])
+			{
+				keptFaces[alive++] = keptFaces[i];
+			}
+		}
+		keptFaces.resize(alive);
+
+		m_versions[keep]++;
+		m_versions[remove]++;
+		pushCollapses(keep, true);
+	}
+
+	// Queues the edges of v, or only those to higher numbered vertices
+	// so that the initial pass queues every edge once.
+	void Simplifier::pushCollapses( unsigned v, bool allEdges )
+	{
+		vector< unsigned > adjacent;
+		neighbours(v, adjacent);
+		for (unsigned i = 0; i < adjacent.size(); i++)
+		{
+			if (allEdges || adjacent[i] > v)
+			{
+				Collapse collapse;
+				computeCollapse(v, adjacent[i], collapse);
+				m_queue.push(collapse);
+			}
+		}
+	}
+
+	void Simplifier::run( unsigned targetFaces )
+	{
+		while (m_numFaces > targetFaces && !m_queue.empty())
+		{
+			const Collapse collapse = m_queue.top();
+			m_queue.pop();
+
+			// skip entries made before either end last changed
+			if (!m_vertexAlive[collapse.keep] || !m_vertexAlive[collapse.remove]
+				|| collapse.keepVersion != m_versions[collapse.keep]
+				|| collapse.removeVersion != m_versions[collapse.remove])
+			{
+				continue;
+			}
+
+			if (isValid(collapse))
+			{
+				apply(collapse);
+			}
+		}
+	}
+
+	void Simplifier::output( unsigned numJoints, Mesh& simplified ) const
+	{
+		const unsigned numVertices = m_vertexAlive.size();
+		vector< unsigned > remap(numVertices, 0);
+
+		simplified.bindVertices.clear();
+		simplified.faces.clear();
+		simplified.attachments.clear();
+
+		for (unsigned v = 0; v < numVertices; v++)
+		{
+			if (!m_vertexAlive[v] || m_vertexFaces[v].empty())
+			{
+				continue;
+			}
+
+			remap[v] = simplified.bindVertices.size();
+			const double* p = &m_positions[3 * v];
+			simplified.bindVertices.push_back(Vector3f((float)p[0], (float)p[1], (float)p[2]));
+
+			vector< float > weights(numJoints, 0.0f);
+			for (unsigned i = 0; i < m_weights[v].size(); i++)
+			{
+				weights[m_weights[v][i].first] = m_weights[v][i].second;
+			}
+			simplified.attachments.push_back(weights);
+		}
+
+		for (unsigned f = 0; f < m_faces.size(); f++)
+		{
+			if (m_faceAlive[f])
+			{
+				const Tuple3u& face = m_faces[f];
+				simplified.faces.push_back(Tuple3u(remap[face[0]], remap[face[1]], remap[face[2]]));
+			}
+		}
+
+		simplified.currentVertices = simplified.bindVertices;
+	}
+}
+
+void simplifyMesh( const Mesh& mesh, unsigned targetFaces, Mesh& simplified )
+{
+	const unsigned numJoints = mesh.attachments.empty() ? 0 : mesh.attachments[0].size();
+
+	Simplifier simplifier(mesh);
+	simplifier.run(targetFaces);
+	simplifier.output(numJoints, simplified);
+}
+
+string levelOfDetailFileName( const string& filename, unsigned level )
+{
+	const string suffix = ".lod" + to_string(level);
+	const size_t dot = filename.find_last_of('.');
+	const size_t slash = filename.find_last_of("/\\");
+	if (dot == string::npos || (slash != string::npos && dot < slash))
+	{
+		return filename + suffix;
+	}
+	return filename.substr(0, dot) + suffix + filename.substr(dot);
+}
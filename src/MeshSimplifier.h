@@ -0,0 +1,26 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <string>
+#include "Mesh.h"
+
+// Level of detail generation for a skinned mesh.
+//
+// Edges are collapsed in order of quadric error (Garland and Heckbert,
+// "Surface Simplification Using Quadric Error Metrics") until at most
+// targetFaces faces remain. Each collapse moves the surviving vertex to
+// the position minimizing the error and gives it the skinning weights
+// interpolated along the edge at that position, keeping at most
+// kMaxSimplifiedInfluences joints. Collapses that would flip a face or
+// pinch the surface are skipped, and open boundaries are preserved.
+//
+// Fills simplified.bindVertices, currentVertices, faces and attachments.
+void simplifyMesh( const Mesh& mesh, unsigned targetFaces, Mesh& simplified );
+
+const unsigned kMaxSimplifiedInfluences = 8;
+
+// Name of the file holding a level of detail next to the original:
+// levelOfDetailFileName( "data/Model1.obj", 2 ) is "data/Model1.lod2.obj".
+std::string levelOfDetailFileName( const std::string& filename, unsigned level );
+
+#endif // MESH_SIMPLIFIER_H
@@ -1,6 +1,8 @@
 #include "ModelerView.h"
 #include "camera.h"
 #include "modelerapp.h"
+#include "JointNames.h"
+#include "GltfImport.h"
 
 #include <FL/Fl.H>
 #include <FL/Fl_Gl_Window.H>
@@ -12,6 +14,15 @@
 // We use a macro VAL() to shorten it.
 #define VAL(x) ( static_cast< float >( ModelerApplication::Instance()->GetControlValue( x ) ) )
 
+// how often the load progress is redrawn while the mesh loads
+static const double kLoadPollSeconds = 0.05;
+
+// point cache playback rate
+static const double kCacheFramesPerSecond = 30.0;
+
+// BVH playback rate when the file's frame time is missing
+static const double kDefaultMotionFrameTime = 1.0 / 30.0;
+
 ModelerView::ModelerView(int x, int y, int w, int h,
 			 const char *label):Fl_Gl_Window(x, y, w, h, label)
 {
@@ -23,6 +34,17 @@ ModelerView::ModelerView(int x, int y, int w, int h,
 
 	m_drawAxes = true;
 	m_drawSkeleton = true;
+
+	m_pickedJoint = -1;
+	m_pickedVertex = -1;
+	m_draggingJoint = false;
+	m_meshLoaded = false;
+
+	m_playingCache = false;
+	m_cacheRunning = false;
+	m_cacheFrame = 0;
+	m_shownCacheFrame = -1;
+	m_motionRunning = false;
 }
 
 // If you want to load files, etc, do that here.
@@ -35,15 +57,249 @@ void ModelerView::loadModel(int argc, char* argv[])
 	string skeletonFile = prefix + ".skel";
 	string meshFile = prefix + ".obj";
 	string attachmentsFile = prefix + ".attach";
+	if (isGltfFile(prefix.c_str()))
+	{
+		// one file holds the whole rig
+		skeletonFile = meshFile = attachmentsFile = prefix;
+	}
+
+	// Optional flags after the prefix
+	LoadOptions options;
+	for (int i = 2; i < argc; i++)
+	{
+		string flag = argv[ i ];
+		if (flag == "-optimize")
+		{
+			options.optimizeMeshLayout = true;
+		}
+		else if (flag == "-quantize8")
+		{
+			options.quantizedWeightBits = 8;
+		}
+		else if (flag == "-quantize16")
+		{
+			options.quantizedWeightBits = 16;
+		}
+		else if (flag == "-quantizepos")
+		{
+			options.quantizePositions = true;
+		}
+		else if (flag == "-lod")
+		{
+			options.levelsOfDetail = 3;
+		}
+		else if (flag == "-psd")
+		{
+			options.correctivesFile = prefix + ".correctives";
+		}
+		else if (flag == "-morph" && i + 1 < argc)
+		{
+			options.morphTargetFiles.push_back( argv[ ++i ] );
+		}
+		else if (flag == "-normals")
+		{
+			options.skinNormals = true;
+		}
+		else if (flag == "-cache" && i + 1 < argc)
+		{
+			if( m_pointCache.open( argv[ ++i ] ) )
+			{
+				cout << "point cache: " << m_pointCache.numFrames() << " frames of " << m_pointCache.numVertices()
+					<< " vertices, press 'c' to play it" << endl;
+			}
+		}
+		else if (flag == "-bvh" && i + 2 < argc)
+		{
+			const char* motionFile = argv[ ++i ];
+			const char* mapFile = argv[ ++i ];
+			if( m_motion.open( motionFile ) )
+			{
+				vector< string > rigJointNames( kRigJointNames, kRigJointNames + kNumRigJoints );
+				loadBvhJointMap( mapFile, m_motion, rigJointNames, m_motionJoints );
+				cout << "BVH motion: " << m_motion.numFrames() << " frames of " << m_motion.numJoints()
+					<< " joints, press 'm' to play it" << endl;
+			}
+		}
+		else if (flag == "-ring" && i + 1 < argc)
+		{
+			m_frameRingName = argv[ ++i ];
+		}
+		else
+		{
+			cerr << "Warning: unknown option " << flag << endl;
+		}
+	}
+
+	// positions are only quantized together with the weights
+	if (options.quantizePositions && options.quantizedWeightBits == 0)
+	{
+		options.quantizedWeightBits = 16;
+	}
+
+	// The skeleton is tiny: load it now so the first frame shows it, and
+	// load the mesh and everything else in the background.
+	model.loadSkeletonOnly(skeletonFile.c_str());
 
-	model.load(skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str());
+	// main() makes sliders for the assignment's joints only, so other
+	// rigs (a .glb or .gltf can have any joints) cannot be posed
+	if (model.numJoints() != kNumRigJoints)
+	{
+		cerr << "Error: " << prefix << " has " << model.numJoints() << " joints, the viewer needs " << kNumRigJoints
+			<< " [in ModelerView::loadModel()]!" << endl;
+		model.clearSkeleton();
+		m_loadProgress.stage = "failed";
+		return;
+	}
+
+	options.progress = &m_loadProgress;
+	m_loadThread = std::thread( [this, skeletonFile, meshFile, attachmentsFile, options]()
+	{
+		m_loadingModel.load(skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str(), options);
+	} );
+	Fl::add_timeout( kLoadPollSeconds, pollLoad, this );
+
+	vector< int > parents( model.numJoints() );
+	vector< Vector3f > offsets( model.numJoints() );
+	for (unsigned j = 0; j < model.numJoints(); j++)
+	{
+		parents[ j ] = model.jointParent( j );
+		offsets[ j ] = model.jointOffset( j );
+	}
+	m_inverseKinematics.setSkeleton( parents, offsets );
 }
 
 ModelerView::~ModelerView()
 {
+	Fl::remove_timeout( pollLoad, this );
+	Fl::remove_timeout( advanceCacheFrame, this );
+	Fl::remove_timeout( advanceMotionFrame, this );
+	if( m_loadThread.joinable() )
+	{
+		m_loadThread.join();
+	}
+	// the recorder's pixel buffers belong to this view's context
+	if( m_recorder.recording() )
+	{
+		make_current();
+		m_recorder.stop();
+	}
     delete m_camera;
 }
 
+// static
+void ModelerView::pollLoad( void* data )
+{
+	ModelerView* view = static_cast< ModelerView* >( data );
+	if( !view->m_loadProgress.done )
+	{
+		view->redraw();
+		Fl::repeat_timeout( kLoadPollSeconds, pollLoad, data );
+		return;
+	}
+
+	view->m_loadThread.join();
+	if( !view->model.takeMesh( view->m_loadingModel ) )
+	{
+		// only the skeleton view stays available
+		cerr << "Error: The mesh could not be loaded [in ModelerView::pollLoad()]!" << endl;
+		view->m_loadProgress.stage = "failed";
+		view->redraw();
+		return;
+	}
+	view->m_meshLoaded = true;
+	cout << "mesh loaded, press 's' to show it" << endl;
+
+	if( !view->m_frameRingName.empty() && view->m_frameRing.create( view->m_frameRingName.c_str(), view->model.numVertices() ) )
+	{
+		view->model.setFrameRing( &view->m_frameRing );
+		cout << "publishing the skinned mesh to shared memory " << view->m_frameRingName << endl;
+	}
+
+	// pose the new mesh like the skeleton
+	view->update();
+	view->redraw();
+}
+
+void ModelerView::setCachePlayback( bool playing )
+{
+	m_playingCache = playing;
+	m_shownCacheFrame = -1;
+	if( playing )
+	{
+		m_drawSkeleton = false;
+	}
+	else
+	{
+		setCacheRunning( false );
+	}
+	cout << "point cache playback is now: " << m_playingCache << endl;
+}
+
+void ModelerView::setCacheRunning( bool running )
+{
+	m_cacheRunning = running;
+	Fl::remove_timeout( advanceCacheFrame, this );
+	if( running )
+	{
+		Fl::add_timeout( 1.0 / kCacheFramesPerSecond, advanceCacheFrame, this );
+	}
+}
+
+// static
+void ModelerView::advanceCacheFrame( void* data )
+{
+	ModelerView* view = static_cast< ModelerView* >( data );
+	view->m_cacheFrame = ( view->m_cacheFrame + 1 ) % view->m_pointCache.numFrames();
+	view->redraw();
+	Fl::repeat_timeout( 1.0 / kCacheFramesPerSecond, advanceCacheFrame, data );
+}
+
+void ModelerView::setMotionRunning( bool running )
+{
+	m_motionRunning = running;
+	Fl::remove_timeout( advanceMotionFrame, this );
+	if( running )
+	{
+		const double frameTime = m_motion.frameTime() > 0 ? m_motion.frameTime() : kDefaultMotionFrameTime;
+		Fl::add_timeout( frameTime, advanceMotionFrame, this );
+	}
+	cout << "BVH playback is now: " << m_motionRunning << endl;
+}
+
+// static
+void ModelerView::advanceMotionFrame( void* data )
+{
+	ModelerView* view = static_cast< ModelerView* >( data );
+	BvhReader& motion = view->m_motion;
+
+	// loop back to the start at the end of the motion
+	if( !motion.readFrame( view->m_motionChannels ) && !( motion.seekFrame( 0 ) && motion.readFrame( view->m_motionChannels ) ) )
+	{
+		view->setMotionRunning( false );
+		return;
+	}
+
+	retargetBvhFrame( motion, view->m_motionJoints, view->m_motionChannels, view->m_motionRotations );
+	for( unsigned j = 0; j < view->m_motionJoints.size(); j++ )
+	{
+		if( view->m_motionJoints[ j ] < 0 )
+		{
+			continue;
+		}
+		const Vector3f angles = rigJointAngles( view->m_motionRotations[ j ] );
+		for( int axis = 0; axis < 3; axis++ )
+		{
+			ModelerApplication::Instance()->SetControlValue( j * 3 + axis, angles[ axis ] );
+		}
+	}
+
+	view->update();
+	view->redraw();
+
+	const double frameTime = motion.frameTime() > 0 ? motion.frameTime() : kDefaultMotionFrameTime;
+	Fl::repeat_timeout( frameTime, advanceMotionFrame, data );
+}
+
 int ModelerView::handle( int event )
 {
     unsigned eventCoordX = Fl::event_x();
@@ -58,6 +314,16 @@ int ModelerView::handle( int event )
 			switch (eventButton)
 			{
 				case FL_LEFT_MOUSE:
+					if (eventState & FL_CTRL)
+					{
+						pick( eventCoordX, eventCoordY );
+						break;
+					}
+					if ((eventState & FL_SHIFT) && m_drawSkeleton && m_pickedJoint >= 0)
+					{
+						m_draggingJoint = true;
+						break;
+					}
 					m_camera->MouseClick( Camera::LEFT, eventCoordX, eventCoordY );
 					break;
 
@@ -74,12 +340,22 @@ int ModelerView::handle( int event )
 
 	case FL_DRAG:
 		{
+			if (m_draggingJoint)
+			{
+				dragJoint( eventCoordX, eventCoordY );
+				break;
+			}
 			m_camera->MouseDrag(eventCoordX, eventCoordY);
 		}
 		break;
 
     case FL_RELEASE:
 		{
+			if (m_draggingJoint)
+			{
+				m_draggingJoint = false;
+				break;
+			}
             m_camera->MouseRelease(eventCoordX, eventCoordY);
 		}
 		break;	
@@ -93,6 +369,50 @@ int ModelerView::handle( int event )
 				m_drawAxes = !m_drawAxes;
 				cout << "drawAxes is now: " << m_drawAxes << endl;
 			}
+			else if( ( key == 'c' || key == 'p' || key == FL_Left || key == FL_Right ) && !m_pointCache.isOpen() )
+			{
+				cout << "no point cache, load one with -cache FILE" << endl;
+			}
+			else if( key == 'm' )
+			{
+				if( m_motion.isOpen() )
+				{
+					setMotionRunning( !m_motionRunning );
+				}
+				else
+				{
+					cout << "no BVH motion, load one with -bvh FILE MAP" << endl;
+				}
+			}
+			else if( ( key == 's' || key == 'c' || key == 'p' || key == FL_Left || key == FL_Right ) && !m_meshLoaded )
+			{
+				cout << "the mesh is still loading" << endl;
+			}
+			else if( key == 'c' )
+			{
+				setCachePlayback( !m_playingCache );
+			}
+			else if( key == 'p' )
+			{
+				// play / pause, starting playback if needed
+				if( !m_playingCache )
+				{
+					setCachePlayback( true );
+				}
+				setCacheRunning( !m_cacheRunning );
+			}
+			else if( key == FL_Left || key == FL_Right )
+			{
+				// scrub one frame at a time
+				if( !m_playingCache )
+				{
+					setCachePlayback( true );
+				}
+				setCacheRunning( false );
+				const unsigned numFrames = m_pointCache.numFrames();
+				m_cacheFrame = ( m_cacheFrame + ( key == FL_Left ? numFrames - 1 : 1 ) ) % numFrames;
+				cout << "point cache frame " << m_cacheFrame << endl;
+			}
 			else if( key == 's' )
 			{
 				m_drawSkeleton = !m_drawSkeleton;
@@ -118,13 +438,13 @@ void ModelerView::update()
 	// Update the bone to world transforms for SSD.
 	model.updateCurrentJointToWorldTransforms();
 
-	// update the mesh given the new skeleton
-	model.updateMesh();
+	// The mesh is skinned in draw(), only when it is shown and on screen.
 }
 
 void ModelerView::updateJoints()
 {
-	for(unsigned int jointNo = 0; jointNo < 18; jointNo++)
+	// kNumRigJoints, or none if loadModel() rejected the rig
+	for(unsigned int jointNo = 0; jointNo < model.numJoints(); jointNo++)
 	{
 		float rx = VAL( jointNo * 3 );
 		float ry = VAL( jointNo * 3 + 1 );
@@ -132,6 +452,12 @@ void ModelerView::updateJoints()
 
 		model.setJointTransform(jointNo, rx, ry, rz);
 	}
+
+	// main() adds the morph target sliders after the joints'
+	for(unsigned int target = 0; target < model.numMorphTargets(); target++)
+	{
+		model.setMorphWeight(target, VAL( kNumRigJoints * 3 + target ));
+	}
 }
 
 // Call the draw function of the parent.  This sets up the
@@ -189,7 +515,198 @@ void ModelerView::draw()
     	drawAxes();
     }
 
+    // show the point cache frame instead of skinning
+    if( !m_drawSkeleton && m_playingCache )
+    {
+        if( (int)m_cacheFrame != m_shownCacheFrame )
+        {
+            if( model.showCachedFrame( m_pointCache, m_cacheFrame ) )
+            {
+                m_shownCacheFrame = m_cacheFrame;
+            }
+            else
+            {
+                setCachePlayback( false );
+            }
+        }
+    }
+    // update the mesh given the new skeleton, unless it is culled
+    else if( !m_drawSkeleton )
+    {
+        model.selectLevelOfDetail( m_camera->viewMatrix(), m_camera->projectionMatrix(), h() );
+        model.updateMeshIfVisible( Frustum( m_camera->projectionMatrix() * m_camera->viewMatrix() ) );
+    }
+
     model.draw( m_camera->viewMatrix(), m_drawSkeleton );
+
+    drawPick();
+
+    if( !m_meshLoaded )
+    {
+        drawLoadProgress();
+    }
+
+    // Queue the finished back buffer for recording (no-op unless recording)
+    m_recorder.capture( w(), h() );
+}
+
+void ModelerView::pixelRay( int x, int y, Vector3f& origin, Vector3f& direction )
+{
+	// Unproject the pixel center on the near and far planes
+	const Matrix4f inverseViewProjection = ( m_camera->projectionMatrix() * m_camera->viewMatrix() ).inverse();
+	const float ndcX = 2.0f * ( x + 0.5f ) / w() - 1.0f;
+	const float ndcY = 1.0f - 2.0f * ( y + 0.5f ) / h();
+
+	const Vector4f nearPoint = inverseViewProjection * Vector4f( ndcX, ndcY, -1, 1 );
+	const Vector4f farPoint = inverseViewProjection * Vector4f( ndcX, ndcY, 1, 1 );
+	origin = nearPoint.xyz() / nearPoint.w();
+	direction = farPoint.xyz() / farPoint.w() - origin;
+}
+
+void ModelerView::pick( int x, int y )
+{
+	Vector3f origin, direction;
+	pixelRay( x, y, origin, direction );
+
+	m_pickedJoint = -1;
+	m_pickedVertex = -1;
+
+	if( m_drawSkeleton )
+	{
+		m_pickedJoint = model.pickJoint( origin, direction );
+		if( m_pickedJoint >= 0 )
+		{
+			cout << "picked joint " << m_pickedJoint << endl;
+		}
+	}
+	else if( !m_playingCache )
+	{
+		// the mesh BVH is not refit to point cache frames
+		SkeletalModel::MeshPick hit;
+		if( model.pickMesh( origin, direction, hit ) )
+		{
+			m_pickedVertex = hit.vertex;
+			cout << "picked vertex " << hit.vertex << " (face " << hit.face << ", joint " << hit.joint << ") at "
+				<< hit.point.x() << " " << hit.point.y() << " " << hit.point.z() << endl;
+		}
+	}
+}
+
+void ModelerView::dragJoint( int x, int y )
+{
+	const unsigned kChainJoints = 2;
+	const unsigned kMaxIterations = 16;
+	const float kTolerance = 1e-4f;
+
+	const unsigned base = m_inverseKinematics.chainBase( m_pickedJoint, kChainJoints );
+	if( base == (unsigned)m_pickedJoint )
+	{
+		return;
+	}
+
+	// target: the point of the ray nearest to the joint
+	Vector3f origin, direction;
+	pixelRay( x, y, origin, direction );
+	const Vector3f joint = model.jointPosition( m_pickedJoint );
+	const float t = Vector3f::dot( joint - origin, direction ) / direction.absSquared();
+	InverseKinematics::Goal goal = { base, (unsigned)m_pickedJoint, origin + t * direction };
+
+	vector< Vector3f > angles( model.numJoints() );
+	for( unsigned j = 0; j < model.numJoints(); j++ )
+	{
+		angles[ j ] = Vector3f( VAL( j * 3 ), VAL( j * 3 + 1 ), VAL( j * 3 + 2 ) );
+	}
+
+	InverseKinematics::Result result;
+	if( !m_inverseKinematics.solve( InverseKinematics::kFABRIK, goal, angles, kMaxIterations, kTolerance, result ) )
+	{
+		return;
+	}
+
+	for( int j = m_inverseKinematics.parent( m_pickedJoint ); ; j = m_inverseKinematics.parent( j ) )
+	{
+		for( int axis = 0; axis < 3; axis++ )
+		{
+			ModelerApplication::Instance()->SetControlValue( j * 3 + axis, angles[ j ][ axis ] );
+		}
+		if( j == (int)base )
+		{
+			break;
+		}
+	}
+
+	update();
+}
+
+void ModelerView::drawPick()
+{
+	Vector3f position;
+	if( m_drawSkeleton && m_pickedJoint >= 0 )
+	{
+		position = model.jointPosition( m_pickedJoint );
+	}
+	else if( !m_drawSkeleton && m_pickedVertex >= 0 )
+	{
+		position = model.mesh().currentVertices[ m_pickedVertex ];
+	}
+	else
+	{
+		return;
+	}
+
+	// drawn on top of everything, following the pose
+	glDisable( GL_LIGHTING );
+	glDisable( GL_DEPTH_TEST );
+	glLoadMatrixf( m_camera->viewMatrix().getElements() );
+	glPointSize( 8.0f );
+	glColor3f( 1, 1, 0 );
+	glBegin( GL_POINTS );
+	glVertex3f( position.x(), position.y(), position.z() );
+	glEnd();
+	glPointSize( 1.0f );
+	glEnable( GL_DEPTH_TEST );
+	glEnable( GL_LIGHTING );
+}
+
+void ModelerView::drawLoadProgress()
+{
+	const float fraction = m_loadProgress.fraction;
+	char label[ 128 ];
+	snprintf( label, sizeof( label ), "Loading mesh: %s (%d%%)", m_loadProgress.stage.load(), (int)( 100 * fraction ) );
+
+	// in window pixels, along the bottom
+	glDisable( GL_LIGHTING );
+	glDisable( GL_DEPTH_TEST );
+	glMatrixMode( GL_PROJECTION );
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho( 0, w(), 0, h(), -1, 1 );
+	glMatrixMode( GL_MODELVIEW );
+	glPushMatrix();
+	glLoadIdentity();
+
+	const float left = 10.0f;
+	const float right = w() - 10.0f;
+	const float bottom = 10.0f;
+	const float top = 22.0f;
+	glColor3f( 0.3f, 0.3f, 0.3f );
+	glRectf( left, bottom, right, top );
+	glColor3f( 0.2f, 0.7f, 0.2f );
+	glRectf( left, bottom, left + fraction * ( right - left ), top );
+
+	glColor3f( 1, 1, 1 );
+	glRasterPos2f( left, top + 6.0f );
+	for( const char* c = label; *c; c++ )
+	{
+		glutBitmapCharacter( GLUT_BITMAP_HELVETICA_12, *c );
+	}
+
+	glPopMatrix();
+	glMatrixMode( GL_PROJECTION );
+	glPopMatrix();
+	glMatrixMode( GL_MODELVIEW );
+	glEnable( GL_DEPTH_TEST );
+	glEnable( GL_LIGHTING );
 }
 
 void ModelerView::drawAxes()
@@ -13,11 +13,15 @@
 
 #include <FL/Fl_Gl_Window.H>
 #include <GL/gl.h>
+#include <thread>
 
 class Camera;
 class ModelerView;
 
 #include "SkeletalModel.h"
+#include "FrameRecorder.h"
+#include "InverseKinematics.h"
+#include "BvhReader.h"
 
 using namespace std;
 
@@ -38,11 +42,81 @@ public:
 	void updateJoints();
 	void drawAxes();
 
+	// Ray through the center of window pixel (x, y), in world space.
+	void pixelRay( int x, int y, Vector3f& origin, Vector3f& direction );
+
+	// Casts a ray through window pixel (x, y) and selects the joint
+	// (skeleton view) or mesh vertex under it.
+	void pick( int x, int y );
+	void drawPick();
+
+	// Moves the picked joint towards the ray through pixel (x, y) by
+	// inverse kinematics on its parent and grandparent, and writes their
+	// new angles to the sliders.
+	void dragJoint( int x, int y );
+
+	// While the mesh loads: a bar with the load progress, and the timer
+	// callback that redraws it and hands the mesh over once it is loaded.
+	void drawLoadProgress();
+	static void pollLoad( void* view );
+
+	// Point cache playback: enters or leaves it, starts or stops the
+	// timer callback that advances m_cacheFrame.
+	void setCachePlayback( bool playing );
+	void setCacheRunning( bool running );
+	static void advanceCacheFrame( void* view );
+
+	// BVH motion playback: the timer callback that reads the next frame
+	// and writes its joint angles to the sliders.
+	void setMotionRunning( bool running );
+	static void advanceMotionFrame( void* view );
+
     Camera *m_camera;
 	SkeletalModel model;
 
 	bool m_drawAxes;
 	bool m_drawSkeleton;		// if false, the mesh is drawn instead.
+
+	// selected with Ctrl + left click, -1 if none
+	int m_pickedJoint;
+	int m_pickedVertex;
+
+	// the model's skeleton, for Shift + left dragging the picked joint
+	InverseKinematics m_inverseKinematics;
+	bool m_draggingJoint;
+
+	// captures every drawn frame while recording
+	FrameRecorder m_recorder;
+
+	// loadModel() loads the skeleton into model and the whole model into
+	// m_loadingModel on m_loadThread; the mesh view is available once
+	// pollLoad() has moved the mesh over
+	SkeletalModel m_loadingModel;
+	LoadProgress m_loadProgress;
+	std::thread m_loadThread;
+	bool m_meshLoaded;
+
+	// Loaded with -cache FILE. While m_playingCache, the mesh view shows
+	// m_cacheFrame of the cache instead of skinning the mesh for the
+	// sliders. m_shownCacheFrame is the frame in the mesh, -1 if none.
+	PointCache m_pointCache;
+	bool m_playingCache;
+	bool m_cacheRunning;
+	unsigned m_cacheFrame;
+	int m_shownCacheFrame;
+
+	// Opened with -bvh FILE MAP: m_motionJoints[ j ] is the BVH joint
+	// driving rig joint j, -1 if none.
+	BvhReader m_motion;
+	vector< int > m_motionJoints;
+	vector< float > m_motionChannels;
+	vector< Quat4f > m_motionRotations;
+	bool m_motionRunning;
+
+	// With -ring NAME, created once the mesh is loaded: every skinned
+	// frame of the mesh is published to shared memory NAME.
+	string m_frameRingName;
+	FrameRingWriter m_frameRing;
 };
 
 
@@ -0,0 +1,51 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Small fork/join helpers on top of std::thread.
+
+// Number of threads to use when the caller asks for 0 ("all of them").
+inline unsigned defaultThreadCount()
+{
+	const unsigned n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+// Calls f( thread ) for thread = 0 .. numThreads - 1, each on its own
+// thread (0 runs on the calling thread), and waits for all of them.
+template< typename Function >
+void runOnThreads( unsigned numThreads, Function f )
+{
+	std::vector< std::thread > threads;
+	for( unsigned t = 1; t < numThreads; ++t )
+	{
+		threads.push_back( std::thread( f, t ) );
+	}
+
+	f( 0 );
+
+	for( unsigned t = 0; t < threads.size(); ++t )
+	{
+		threads[ t ].join();
+	}
+}
+
+// Splits [0, count) into numThreads contiguous ranges and calls
+// f( begin, end ) for each range in parallel.
+template< typename Function >
+void parallelFor( unsigned count, unsigned numThreads, Function f )
+{
+	numThreads = std::max( 1u, std::min( numThreads, count ) );
+
+	runOnThreads( numThreads, [&]( unsigned t )
+	{
+		const unsigned begin = (unsigned)( (unsigned long long)count * t / numThreads );
+		const unsigned end = (unsigned)( (unsigned long long)count * ( t + 1 ) / numThreads );
+		f( begin, end );
+	} );
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,208 @@
+#include "PointCache.h"
+
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FrameCodec.h"
+
+using namespace std;
+
+namespace
+{
+	const unsigned kVersion = 2;
+
+	// magic, version, vertex count, frame count, index offset, layout hash
+	const size_t kHeaderSize = 4 + 3 * sizeof(unsigned) + 2 * sizeof(unsigned long long);
+}
+
+PointCacheWriter::PointCacheWriter( const char* filename, unsigned numVertices, unsigned long long layoutHash ) :
+	m_file(fopen(filename, "wb")),
+	m_numVertices(numVertices),
+	m_bytesWritten(0)
+{
+	if (!m_file)
+	{
+		std::cerr << "Error: File could not be opened [in PointCacheWriter()]!" << std::endl;
+		return;
+	}
+
+	// the frame count and index offset are filled in by finish()
+	const unsigned header[ 3 ] = { kVersion, numVertices, 0 };
+	const unsigned long long indexOffset = 0;
+	fwrite("SSDC", 1, 4, m_file);
+	fwrite(header, sizeof(header), 1, m_file);
+	fwrite(&indexOffset, sizeof(indexOffset), 1, m_file);
+	fwrite(&layoutHash, sizeof(layoutHash), 1, m_file);
+	m_bytesWritten = kHeaderSize;
+}
+
+PointCacheWriter::~PointCacheWriter()
+{
+	finish();
+}
+
+bool PointCacheWriter::isOpen() const
+{
+	return m_file != NULL;
+}
+
+bool PointCacheWriter::write( const vector< Vector3f >& vertices )
+{
+	if (!m_file || vertices.size() != m_numVertices)
+	{
+		std::cerr << "Error: Frame of " << vertices.size() << " vertices for a cache of " << m_numVertices
+			<< " [in PointCacheWriter::write()]!" << std::endl;
+		return false;
+	}
+
+	m_encoded.clear();
+	encodeFrame(vertices, m_encoded);
+	if (fwrite(&m_encoded[0], 1, m_encoded.size(), m_file) != m_encoded.size())
+	{
+		std::cerr << "Error: Could not write frame [in PointCacheWriter::write()]!" << std::endl;
+		return false;
+	}
+
+	m_offsets.push_back(m_bytesWritten);
+	m_bytesWritten += m_encoded.size();
+	return true;
+}
+
+bool PointCacheWriter::finish()
+{
+	if (!m_file)
+	{
+		return false;
+	}
+
+	const unsigned long long indexOffset = m_bytesWritten;
+	m_offsets.push_back(indexOffset);
+	fwrite(&m_offsets[0], sizeof(unsigned long long), m_offsets.size(), m_file);
+	m_bytesWritten += m_offsets.size() * sizeof(unsigned long long);
+	m_offsets.pop_back();
+
+	const unsigned numFrames = m_offsets.size();
+	fseek(m_file, 4 + 2 * sizeof(unsigned), SEEK_SET);
+	fwrite(&numFrames, sizeof(numFrames), 1, m_file);
+	fwrite(&indexOffset, sizeof(indexOffset), 1, m_file);
+
+	const bool ok = !ferror(m_file);
+	fclose(m_file);
+	m_file = NULL;
+	if (!ok)
+	{
+		std::cerr << "Error: Could not write the point cache [in PointCacheWriter::finish()]!" << std::endl;
+	}
+	return ok;
+}
+
+PointCache::PointCache() :
+	m_data(nullptr),
+	m_size(0),
+	m_numVertices(0),
+	m_numFrames(0),
+	m_layoutHash(0),
+	m_index(nullptr)
+{
+}
+
+PointCache::~PointCache()
+{
+	close();
+}
+
+bool PointCache::open( const char* filename )
+{
+	close();
+
+	const int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		std::cerr << "Error: File could not be opened [in PointCache::open()]!" << std::endl;
+		return false;
+	}
+
+	struct stat status;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &status) == 0 && (size_t)status.st_size >= kHeaderSize)
+	{
+		data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "Error: " << filename << " could not be mapped [in PointCache::open()]!" << std::endl;
+		return false;
+	}
+	m_data = static_cast< const unsigned char* >(data);
+	m_size = status.st_size;
+
+	unsigned header[ 3 ];
+	unsigned long long indexOffset;
+	memcpy(header, m_data + 4, sizeof(header));
+	memcpy(&indexOffset, m_data + 4 + sizeof(header), sizeof(indexOffset));
+	memcpy(&m_layoutHash, m_data + 4 + sizeof(header) + sizeof(indexOffset), sizeof(m_layoutHash));
+	m_numVertices = header[1];
+	m_numFrames = header[2];
+	m_index = m_data + indexOffset;
+
+	// the index must fit, and its offsets must run in order from the
+	// header to the index; playback needs at least one frame
+	bool valid = memcmp(m_data, "SSDC", 4) == 0 && header[0] == kVersion && m_numFrames > 0 && indexOffset >= kHeaderSize &&
+		indexOffset <= m_size && (m_size - indexOffset) / sizeof(unsigned long long) > m_numFrames &&
+		frameOffset(0) == kHeaderSize && frameOffset(m_numFrames) == indexOffset;
+	for (unsigned f = 0; valid && f < m_numFrames; f++)
+	{
+		valid = frameOffset(f) <= frameOffset(f + 1);
+	}
+
+	if (!valid)
+	{
+		std::cerr << "Error: " << filename << " is not a point cache [in PointCache::open()]!" << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void PointCache::close()
+{
+	if (m_data)
+	{
+		munmap(const_cast< unsigned char* >(m_data), m_size);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_numVertices = 0;
+	m_numFrames = 0;
+	m_layoutHash = 0;
+	m_index = nullptr;
+}
+
+unsigned long long PointCache::frameOffset( unsigned frame ) const
+{
+	// the index is not necessarily aligned
+	unsigned long long offset;
+	memcpy(&offset, m_index + frame * sizeof(offset), sizeof(offset));
+	return offset;
+}
+
+size_t PointCache::frameSize( unsigned frame ) const
+{
+	return frame < m_numFrames ? frameOffset(frame + 1) - frameOffset(frame) : 0;
+}
+
+bool PointCache::readFrame( unsigned frame, vector< Vector3f >& vertices ) const
+{
+	if (frame >= m_numFrames)
+	{
+		return false;
+	}
+
+	const size_t size = frameSize(frame);
+	return decodeFrame(m_data + frameOffset(frame), size, vertices) == size && vertices.size() == m_numVertices;
+}
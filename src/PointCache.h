@@ -0,0 +1,99 @@
+#ifndef POINT_CACHE_H
+#define POINT_CACHE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <vecmath.h>
+
+// Baked animation: the deformed vertex positions of every frame, so that
+// playback decodes a frame instead of posing and skinning the model.
+//
+// File layout:
+//   "SSDC", uint32 version, uint32 vertex count, uint32 frame count,
+//   uint64 file offset of the index, uint64 layout hash of the baked
+//   mesh (Mesh::computeLayoutHash()), so a cache is only played on a
+//   mesh with the same vertices in the same order
+//   the frames, each written by encodeFrame() (delta coded and quantized
+//   to 16 bits against the frame's AABB, see FrameCodec.h)
+//   the index: uint64 file offset of each frame, then of the index itself
+// The index makes every frame directly addressable, for scrubbing.
+
+// Writes a point cache one frame at a time. finish() (or the destructor)
+// appends the index and fills in the header.
+class PointCacheWriter
+{
+public:
+
+	// layoutHash is the baked mesh's Mesh::computeLayoutHash().
+	PointCacheWriter( const char* filename, unsigned numVertices, unsigned long long layoutHash );
+	~PointCacheWriter();
+
+	PointCacheWriter( const PointCacheWriter& ) = delete;
+	PointCacheWriter& operator = ( const PointCacheWriter& ) = delete;
+
+	bool isOpen() const;
+
+	// Returns false if vertices is not one frame of the mesh or the
+	// write failed.
+	bool write( const std::vector< Vector3f >& vertices );
+
+	// Returns false if the cache could not be completed.
+	bool finish();
+
+	unsigned framesWritten() const { return m_offsets.size(); }
+	size_t bytesWritten() const { return m_bytesWritten; }
+
+private:
+
+	FILE* m_file;
+	unsigned m_numVertices;
+	std::vector< unsigned long long > m_offsets;
+	std::vector< unsigned char > m_encoded;
+	size_t m_bytesWritten;
+};
+
+// Read only view of a point cache. The file is memory mapped, so frames
+// are paged in as they are first played and then decoded straight from
+// the page cache, in any order.
+class PointCache
+{
+public:
+
+	PointCache();
+	~PointCache();
+
+	PointCache( const PointCache& ) = delete;
+	PointCache& operator = ( const PointCache& ) = delete;
+
+	// Closes the open cache, if any, first. Returns false, leaving the
+	// cache closed, if the file is missing, malformed or has no frames.
+	bool open( const char* filename );
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+	unsigned numVertices() const { return m_numVertices; }
+	unsigned numFrames() const { return m_numFrames; }
+	unsigned long long layoutHash() const { return m_layoutHash; }
+
+	// Encoded size of frame, in bytes.
+	size_t frameSize( unsigned frame ) const;
+
+	// Decodes frame into vertices. Returns false if frame is out of range
+	// or its data is corrupt.
+	bool readFrame( unsigned frame, std::vector< Vector3f >& vertices ) const;
+
+private:
+
+	// file offset of frame (numFrames() for the end of the last frame)
+	unsigned long long frameOffset( unsigned frame ) const;
+
+	const unsigned char* m_data;
+	size_t m_size;
+	unsigned m_numVertices;
+	unsigned m_numFrames;
+	unsigned long long m_layoutHash;
+	const unsigned char* m_index;
+};
+
+#endif // POINT_CACHE_H
@@ -0,0 +1,452 @@
+#include "PoseCorrectives.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+const float PoseCorrectives::kMinWeight = 1e-3f;
+
+namespace
+{
+	// Angle of the rotation taking a to b: trace( a^T b ) = 1 + 2 cos( angle )
+	float rotationDistance( const Matrix3f& a, const Matrix3f& b )
+	{
+		float trace = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				trace += a(i, j) * b(i, j);
+			}
+		}
+		return acosf(std::max(-1.0f, std::min(1.0f, 0.5f * (trace - 1))));
+	}
+
+	Matrix3f eulerRotation( const Vector3f& angles )
+	{
+		// same order as SkeletalModel::setJointTransform()
+		return Matrix3f::rotateX(angles.x()) * Matrix3f::rotateY(angles.y()) * Matrix3f::rotateZ(angles.z());
+	}
+}
+
+PoseCorrectives::PoseCorrectives()
+{
+}
+
+bool PoseCorrectives::load( const char* filename, unsigned numVertices, unsigned numJoints )
+{
+	clear();
+
+	ifstream inputFile(filename);
+	if (!inputFile)
+	{
+		cerr << "Error: File could not be opened [in PoseCorrectives::load()]!" << endl;
+		return false;
+	}
+
+	string keyword;
+	while (inputFile >> keyword)
+	{
+		unsigned joint, numShapes;
+		string kernelName;
+		float radius;
+		if (keyword != "driver" || !(inputFile >> joint >> kernelName >> radius >> numShapes) ||
+			joint >= numJoints || (kernelName != "linear" && kernelName != "gaussian") || radius <= 0)
+		{
+			cerr << "Error: bad driver in " << filename << " [in PoseCorrectives::load()]!" << endl;
+			clear();
+			return false;
+		}
+		const Kernel kernel = (kernelName == "linear") ? kLinear : kGaussian;
+
+		for (unsigned k = 0; k < numShapes; k++)
+		{
+			float rX, rY, rZ;
+			unsigned count;
+			if (!(inputFile >> keyword >> rX >> rY >> rZ >> count) || keyword != "shape")
+			{
+				cerr << "Error: bad shape in " << filename << " [in PoseCorrectives::load()]!" << endl;
+				clear();
+				return false;
+			}
+
+			vector< unsigned > vertices(count);
+			vector< Vector3f > offsets(count);
+			for (unsigned i = 0; i < count; i++)
+			{
+				float x, y, z;
+				if (!(inputFile >> vertices[i] >> x >> y >> z) || vertices[i] >= numVertices)
+				{
+					cerr << "Error: bad offset in " << filename << " [in PoseCorrectives::load()]!" << endl;
+					clear();
+					return false;
+				}
+				offsets[i] = Vector3f(x, y, z);
+			}
+
+			if (!addShape(joint, kernel, radius, Vector3f(rX, rY, rZ), vertices, offsets))
+			{
+				cerr << "Error: bad shape target in " << filename << " [in PoseCorrectives::load()]!" << endl;
+				clear();
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void PoseCorrectives::save( const char* filename ) const
+{
+	ofstream outputFile(filename);
+	if (!outputFile)
+	{
+		cerr << "Error: File could not be opened [in PoseCorrectives::save()]!" << endl;
+		return;
+	}
+
+	// enough digits to read back the same floats
+	outputFile << setprecision(9);
+	for (const Driver& driver : m_drivers)
+	{
+		const unsigned m = driver.vertices.size();
+		outputFile << "driver " << driver.joint << ' ' << (driver.kernel == kLinear ? "linear" : "gaussian") << ' '
+			<< driver.radius << ' ' << driver.targets.size() << '\n';
+
+		for (unsigned k = 0; k < driver.targets.size(); k++)
+		{
+			// only the vertices this shape moves
+			const float* x = &driver.offsets[3 * k * m];
+			const float* y = x + m;
+			const float* z = y + m;
+
+			unsigned count = 0;
+			for (unsigned i = 0; i < m; i++)
+			{
+				count += (x[i] != 0 || y[i] != 0 || z[i] != 0);
+			}
+
+			const Vector3f& angles = driver.angles[k];
+			outputFile << "shape " << angles.x() << ' ' << angles.y() << ' ' << angles.z() << ' ' << count << '\n';
+			for (unsigned i = 0; i < m; i++)
+			{
+				if (x[i] != 0 || y[i] != 0 || z[i] != 0)
+				{
+					outputFile << driver.vertices[i] << ' ' << x[i] << ' ' << y[i] << ' ' << z[i] << '\n';
+				}
+			}
+		}
+	}
+}
+
+bool PoseCorrectives::addShape( unsigned joint, Kernel kernel, float radius, const Vector3f& targetAngles,
+	const vector< unsigned >& vertices, const vector< Vector3f >& offsets )
+{
+	unsigned d = 0;
+	while (d < m_drivers.size() && m_drivers[d].joint != joint)
+	{
+		d++;
+	}
+	const bool newDriver = (d == m_drivers.size());
+	if (newDriver)
+	{
+		m_drivers.push_back(Driver());
+		m_drivers[d].joint = joint;
+		m_drivers[d].kernel = kernel;
+		m_drivers[d].radius = radius;
+	}
+	Driver& driver = m_drivers[d];
+
+	// restored if the new target makes the interpolation singular
+	const Driver previous = newDriver ? Driver() : driver;
+
+	// Merge the shape's vertices into the driver's union and lay the
+	// offsets of all its shapes out again over the new union.
+	vector< unsigned > merged = vertices;
+	merged.insert(merged.end(), driver.vertices.begin(), driver.vertices.end());
+	sort(merged.begin(), merged.end());
+	merged.erase(unique(merged.begin(), merged.end()), merged.end());
+
+	const unsigned numShapes = driver.targets.size();
+	const unsigned oldSize = driver.vertices.size();
+	const unsigned newSize = merged.size();
+
+	vector< float > laidOut(3 * (numShapes + 1) * newSize, 0.0f);
+	for (unsigned i = 0; i < oldSize; i++)
+	{
+		const unsigned n = lower_bound(merged.begin(), merged.end(), driver.vertices[i]) - merged.begin();
+		for (unsigned row = 0; row < 3 * numShapes; row++)
+		{
+			laidOut[row * newSize + n] = driver.offsets[row * oldSize + i];
+		}
+	}
+	for (unsigned i = 0; i < vertices.size(); i++)
+	{
+		const unsigned n = lower_bound(merged.begin(), merged.end(), vertices[i]) - merged.begin();
+		for (int a = 0; a < 3; a++)
+		{
+			laidOut[(3 * numShapes + a) * newSize + n] += offsets[i][a];
+		}
+	}
+
+	driver.vertices.swap(merged);
+	driver.offsets.swap(laidOut);
+	driver.angles.push_back(targetAngles);
+	driver.targets.push_back(eulerRotation(targetAngles));
+
+	if (!solveInterpolation(driver))
+	{
+		if (newDriver)
+		{
+			m_drivers.pop_back();
+		}
+		else
+		{
+			driver = previous;
+		}
+		return false;
+	}
+	return true;
+}
+
+void PoseCorrectives::remapVertices( const vector< unsigned >& remap )
+{
+	for (Driver& driver : m_drivers)
+	{
+		const unsigned m = driver.vertices.size();
+
+		// new position of each union entry, sorted by new vertex index
+		vector< unsigned > order(m);
+		for (unsigned i = 0; i < m; i++)
+		{
+			order[i] = i;
+		}
+		sort(order.begin(), order.end(),
+			[&]( unsigned a, unsigned b ) { return remap[driver.vertices[a]] < remap[driver.vertices[b]]; });
+
+		vector< unsigned > vertices(m);
+		vector< float > offsets(driver.offsets.size());
+		for (unsigned i = 0; i < m; i++)
+		{
+			vertices[i] = remap[driver.vertices[order[i]]];
+			for (unsigned row = 0; row < 3 * driver.targets.size(); row++)
+			{
+				offsets[row * m + i] = driver.offsets[row * m + order[i]];
+			}
+		}
+
+		driver.vertices.swap(vertices);
+		driver.offsets.swap(offsets);
+	}
+}
+
+unsigned PoseCorrectives::numShapes() const
+{
+	unsigned count = 0;
+	for (const Driver& driver : m_drivers)
+	{
+		count += driver.targets.size();
+	}
+	return count;
+}
+
+unsigned PoseCorrectives::numOffsets() const
+{
+	unsigned count = 0;
+	for (const Driver& driver : m_drivers)
+	{
+		count += driver.targets.size() * driver.vertices.size();
+	}
+	return count;
+}
+
+float PoseCorrectives::kernel( const Driver& driver, float angle ) const
+{
+	const float r = angle / driver.radius;
+	if (driver.kernel == kLinear)
+	{
+		return std::max(0.0f, 1 - r);
+	}
+	return expf(-r * r);
+}
+
+bool PoseCorrectives::solveInterpolation( Driver& driver )
+{
+	// Samples are the rest pose and the targets. For each shape k, find
+	// coefficients c with sum_i c_i kernel( |sample_s - sample_i| ) = 1 if
+	// s is shape k's target and 0 otherwise: solve Phi C = E for all shapes
+	// at once by Gaussian elimination with partial pivoting.
+	const unsigned numShapes = driver.targets.size();
+	const unsigned n = numShapes + 1;
+
+	vector< Matrix3f > samples(1, Matrix3f::identity());
+	samples.insert(samples.end(), driver.targets.begin(), driver.targets.end());
+
+	// n rows of [ Phi | E ]
+	const unsigned width = n + numShapes;
+	vector< double > system(n * width, 0.0);
+	for (unsigned s = 0; s < n; s++)
+	{
+		for (unsigned i = 0; i < n; i++)
+		{
+			system[s * width + i] = kernel(driver, rotationDistance(samples[s], samples[i]));
+		}
+		if (s > 0)
+		{
+			system[s * width + n + s - 1] = 1;
+		}
+	}
+
+	driver.interpolation.assign(n * numShapes, 0.0f);
+	driver.maxWeights.assign(numShapes, 0.0f);
+
+	for (unsigned col = 0; col < n; col++)
+	{
+		unsigned pivot = col;
+		for (unsigned row = col + 1; row < n; row++)
+		{
+			if (fabs(system[row * width + col]) > fabs(system[pivot * width + col]))
+			{
+				pivot = row;
+			}
+		}
+		if (fabs(system[pivot * width + col]) < 1e-9)
+		{
+			cerr << "Error: targets of driver joint " << driver.joint << " coincide [in PoseCorrectives::solveInterpolation()]!" << endl;
+			return false;
+		}
+		for (unsigned c = 0; c < width; c++)
+		{
+			swap(system[col * width + c], system[pivot * width + c]);
+		}
+
+		for (unsigned row = 0; row < n; row++)
+		{
+			if (row == col || system[row * width + col] == 0)
+			{
+				continue;
+			}
+			const double factor = system[row * width + col] / system[col * width + col];
+			for (unsigned c = col; c < width; c++)
+			{
+				system[row * width + c] -= factor * system[col * width + c];
+			}
+		}
+	}
+
+	// kernels are within [ 0, 1 ], so |weight k| <= sum_i |c_ik|
+	for (unsigned i = 0; i < n; i++)
+	{
+		for (unsigned k = 0; k < numShapes; k++)
+		{
+			const float c = system[i * width + n + k] / system[i * width + i];
+			driver.interpolation[i * numShapes + k] = c;
+			driver.maxWeights[k] += fabsf(c);
+		}
+	}
+	return true;
+}
+
+bool PoseCorrectives::evaluate( const vector< Matrix3f >& jointRotations, vector< Vector3f >& offsets,
+	vector< unsigned >* written ) const
+{
+	bool anyActive = false;
+
+	vector< float > weights;
+
+	for (const Driver& driver : m_drivers)
+	{
+		if (driver.vertices.empty())
+		{
+			continue;
+		}
+
+		const unsigned numShapes = driver.targets.size();
+		const Matrix3f& rotation = jointRotations[driver.joint];
+
+		weights.assign(numShapes, 0.0f);
+		for (unsigned i = 0; i <= numShapes; i++)
+		{
+			const float angle = (i == 0) ? rotationDistance(Matrix3f::identity(), rotation) : rotationDistance(driver.targets[i - 1], rotation);
+			const float phi = kernel(driver, angle);
+			if (phi == 0)
+			{
+				continue;
+			}
+			for (unsigned k = 0; k < numShapes; k++)
+			{
+				weights[k] += driver.interpolation[i * numShapes + k] * phi;
+			}
+		}
+
+		// Add the active shapes straight to the driver's vertices: few
+		// shapes are active at once, so summing them first would cost a
+		// pass to clear the sums and one to add them to offsets
+		const unsigned m = driver.vertices.size();
+		const unsigned* vertices = &driver.vertices[0];
+		bool active = false;
+		for (unsigned k = 0; k < numShapes; k++)
+		{
+			const float w = weights[k];
+			if (fabsf(w) < kMinWeight)
+			{
+				continue;
+			}
+			active = true;
+
+			const float* x = &driver.offsets[3 * k * m];
+			const float* y = x + m;
+			const float* z = y + m;
+			float* out = offsets[0];
+			for (unsigned i = 0; i < m; i++)
+			{
+				// all loads before the stores, which could alias the shape
+				float* offset = out + 3 * vertices[i];
+				const float ox = offset[0] + w * x[i];
+				const float oy = offset[1] + w * y[i];
+				const float oz = offset[2] + w * z[i];
+				offset[0] = ox;
+				offset[1] = oy;
+				offset[2] = oz;
+			}
+		}
+
+		if (active)
+		{
+			anyActive = true;
+			// past as many entries as offsets, clearing all of it is cheaper
+			// than clearing the list, which then need not grow
+			if (written && written->size() < offsets.size())
+			{
+				written->insert(written->end(), driver.vertices.begin(), driver.vertices.end());
+			}
+		}
+	}
+
+	return anyActive;
+}
+
+void PoseCorrectives::computeOffsetBounds( unsigned numVertices, vector< float >& bounds ) const
+{
+	bounds.assign(numVertices, 0.0f);
+
+	for (const Driver& driver : m_drivers)
+	{
+		const unsigned m = driver.vertices.size();
+		for (unsigned k = 0; k < driver.targets.size(); k++)
+		{
+			const float* x = &driver.offsets[3 * k * m];
+			const float* y = x + m;
+			const float* z = y + m;
+			for (unsigned i = 0; i < m; i++)
+			{
+				bounds[driver.vertices[i]] += driver.maxWeights[k] * sqrtf(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+			}
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef POSE_CORRECTIVES_H
+#define POSE_CORRECTIVES_H
+
+#include <vector>
+#include <vecmath.h>
+
+// Pose-space deformation: corrective shapes added to the bind positions
+// before skinning, to fix what linear blend skinning gets wrong (collapsing
+// elbows and knees, candy-wrapping twists).
+//
+// Shapes are grouped by the joint whose local rotation drives them. Each
+// shape stores the vertex offsets that are fully applied when the driver
+// joint has the shape's target rotation, and only for the vertices it
+// moves. The shape weights are interpolated from the distance (angle)
+// between the current rotation and each target with a radial basis
+// function through the targets and the rest pose, so every shape has
+// weight 1 at its own target and 0 at the rest pose and the other targets.
+// With the linear kernel and a radius no larger than the angle between
+// any two targets, each weight is a tent falling from 1 at the target to 0
+// at radius away, and a driver at rest costs nothing.
+//
+// The offsets of a driver's shapes are stored over the union of their
+// vertices, one contiguous array per shape and axis, so each active shape
+// is added with plain multiply-adds over float arrays.
+//
+// File format (text):
+//     driver JOINT linear|gaussian RADIUS NUMSHAPES
+//     shape RX RY RZ NUMOFFSETS
+//     VERTEX DX DY DZ
+//     ...
+// where RX RY RZ are the target angles as passed to
+// SkeletalModel::setJointTransform() and RADIUS is in radians.
+class PoseCorrectives
+{
+public:
+
+	enum Kernel
+	{
+		kLinear,
+		kGaussian
+	};
+
+	PoseCorrectives();
+
+	// Returns false and leaves the set empty if the file cannot be read or
+	// refers to joints or vertices out of range.
+	bool load( const char* filename, unsigned numVertices, unsigned numJoints );
+	void save( const char* filename ) const;
+
+	// Adds a shape to the driver of joint, creating it with the given
+	// kernel and radius if it does not exist yet. Returns false, leaving
+	// the set as it was, if the target coincides with the rest pose or
+	// another target of the driver.
+	bool addShape( unsigned joint, Kernel kernel, float radius, const Vector3f& targetAngles,
+		const std::vector< unsigned >& vertices, const std::vector< Vector3f >& offsets );
+
+	void clear() { m_drivers.clear(); }
+
+	// Renumbers vertices after the mesh was reordered (remap[ old ] = new).
+	void remapVertices( const std::vector< unsigned >& remap );
+
+	bool empty() const { return m_drivers.empty(); }
+	unsigned numShapes() const;
+	unsigned numOffsets() const;
+
+	// Adds the shapes that are active for the given local joint rotations
+	// to offsets, which has one entry per mesh vertex, touching only the
+	// vertices of the active drivers; if written is given, they are
+	// appended to it until it has as many entries as offsets. Returns false
+	// if no shape is active and offsets was left alone.
+	bool evaluate( const std::vector< Matrix3f >& jointRotations, std::vector< Vector3f >& offsets,
+		std::vector< unsigned >* written = nullptr ) const;
+
+	// Upper bound of the length of each vertex's total offset over all poses.
+	void computeOffsetBounds( unsigned numVertices, std::vector< float >& bounds ) const;
+
+	// shapes whose weight is smaller than this in magnitude are skipped
+	static const float kMinWeight;
+
+private:
+
+	struct Driver
+	{
+		unsigned joint;
+		Kernel kernel;
+		float radius;
+
+		// per shape
+		std::vector< Vector3f > angles;
+		std::vector< Matrix3f > targets;
+		std::vector< float > maxWeights;
+
+		// (numShapes + 1) x numShapes: the weight of shape k is
+		// sum_i interpolation[ i * numShapes + k ] * kernel( distance to sample i ),
+		// where sample 0 is the rest pose and sample k + 1 is shape k's target
+		std::vector< float > interpolation;
+
+		// sorted union of the shapes' vertices, and the offsets of shape k
+		// along axis a in offsets[ ( 3 * k + a ) * vertices.size(), ... )
+		std::vector< unsigned > vertices;
+		std::vector< float > offsets;
+	};
+
+	float kernel( const Driver& driver, float angle ) const;
+	// Returns false if the samples coincide and there is no solution.
+	bool solveInterpolation( Driver& driver );
+
+	std::vector< Driver > m_drivers;
+};
+
+#endif // POSE_CORRECTIVES_H
@@ -0,0 +1,169 @@
+#include "PoseStream.h"
+#include "FrameCodec.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+PoseStreamReader::PoseStreamReader( const char* filename, unsigned numJoints ) :
+	m_file(filename),
+	m_jointAngles(numJoints, Vector3f(0, 0, 0)),
+	m_seenDelimiter(false)
+{
+	if (!m_file)
+	{
+		std::cerr << "Error: File could not be opened [in PoseStreamReader()]!" << std::endl;
+	}
+}
+
+bool PoseStreamReader::isOpen() const
+{
+	return m_file.is_open();
+}
+
+bool PoseStreamReader::readFrame( vector< Vector3f >& jointAngles )
+{
+	bool hasContent = false;
+
+	std::string line;
+	while (std::getline(m_file, line))
+	{
+		std::istringstream iss(line);
+
+		std::string token;
+		if (!(iss >> token))
+		{
+			continue; // blank line
+		}
+
+		if (token.compare(0, 5, "frame") == 0)
+		{
+			// Nothing before the first delimiter is not a frame,
+			// but an empty frame between two delimiters repeats the last pose.
+			const bool endsFrame = hasContent || m_seenDelimiter;
+			m_seenDelimiter = true;
+
+			if (endsFrame)
+			{
+				jointAngles = m_jointAngles;
+				return true;
+			}
+			continue;
+		}
+
+		unsigned control;
+		float value;
+		std::istringstream controlStream(token);
+		if (!(controlStream >> control) || !(iss >> value))
+		{
+			std::cerr << "Warning: skipping malformed pose line: " << line << std::endl;
+			continue;
+		}
+
+		if (control < 3 * m_jointAngles.size())
+		{
+			m_jointAngles[control / 3][control % 3] = value;
+		}
+		hasContent = true;
+	}
+
+	if (hasContent)
+	{
+		jointAngles = m_jointAngles;
+		return true;
+	}
+	return false;
+}
+
+FrameWriter::FrameWriter( const char* filename, unsigned numVertices, size_t queueCapacity ) :
+	m_file(fopen(filename, "wb")),
+	m_queue(queueCapacity),
+	m_framesWritten(0),
+	m_bytesWritten(0),
+	m_failed(false)
+{
+	if (!m_file)
+	{
+		std::cerr << "Error: File could not be opened [in FrameWriter()]!" << std::endl;
+		return;
+	}
+
+	const unsigned header[ 2 ] = { 1, numVertices }; // version, vertex count
+	if (fwrite("SSDF", 1, 4, m_file) != 4 || fwrite(header, sizeof(header), 1, m_file) != 1)
+	{
+		std::cerr << "Error: Could not write the header [in FrameWriter()]!" << std::endl;
+		fclose(m_file);
+		m_file = NULL;
+		return;
+	}
+	m_bytesWritten = 4 + sizeof(header);
+
+	m_thread = std::thread(&FrameWriter::run, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+	finish();
+}
+
+bool FrameWriter::isOpen() const
+{
+	return m_file != NULL;
+}
+
+bool FrameWriter::write( vector< Vector3f > vertices )
+{
+	// run() closes the queue when a write fails
+	return m_queue.push(std::move(vertices));
+}
+
+bool FrameWriter::finish()
+{
+	m_queue.close();
+
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	if (!m_file)
+	{
+		return false;
+	}
+
+	bool ok = !m_failed && !ferror(m_file);
+	ok = (fclose(m_file) == 0) && ok;
+	m_file = NULL;
+	if (!ok)
+	{
+		std::cerr << "Error: Could not write the frames [in FrameWriter::finish()]!" << std::endl;
+	}
+	return ok;
+}
+
+void FrameWriter::run()
+{
+	vector< Vector3f > vertices;
+	vector< unsigned char > encoded;
+
+	while (m_queue.pop(vertices))
+	{
+		encoded.clear();
+		encodeFrame(vertices, encoded);
+
+		const unsigned size = encoded.size();
+		if (fwrite(&size, sizeof(size), 1, m_file) != 1 || fwrite(&encoded[0], 1, size, m_file) != size)
+		{
+			// the rest would be lost too; closing the queue makes write()
+			// stop waiting for this thread
+			m_failed = true;
+			m_queue.close();
+			return;
+		}
+
+		m_framesWritten++;
+		m_bytesWritten += sizeof(size) + size;
+	}
+}
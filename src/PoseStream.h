@@ -0,0 +1,79 @@
+#ifndef POSE_STREAM_H
+#define POSE_STREAM_H
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <vecmath.h>
+
+#include "BoundedQueue.h"
+
+// Incremental reader for multi-frame pose files.
+//
+// The format extends the .pos files written by "Save Position File":
+// each line is "control value", where control c drives joint c / 3 and
+// axis c % 3 (the same mapping as ModelerView::updateJoints()).
+// A line starting with "frame" separates two frames. Controls that are
+// not listed in a frame keep their value from the previous frame.
+// A plain .pos file is read as a single frame.
+class PoseStreamReader
+{
+public:
+
+	PoseStreamReader( const char* filename, unsigned numJoints );
+
+	bool isOpen() const;
+
+	// Reads the next frame as (rX, rY, rZ) per joint.
+	// Returns false at the end of the file.
+	bool readFrame( std::vector< Vector3f >& jointAngles );
+
+private:
+
+	std::ifstream m_file;
+	std::vector< Vector3f > m_jointAngles;
+	bool m_seenDelimiter;
+};
+
+// Compresses frames of deformed vertices with encodeFrame() and appends
+// them to a file on a background thread. write() blocks while
+// queueCapacity frames are waiting, so a slow disk throttles the producer
+// instead of growing memory.
+//
+// File layout: "SSDF", uint32 version, uint32 vertex count,
+// then for each frame a uint32 byte count followed by the encoded frame.
+class FrameWriter
+{
+public:
+
+	FrameWriter( const char* filename, unsigned numVertices, size_t queueCapacity = 8 );
+	~FrameWriter();
+
+	bool isOpen() const;
+
+	// Queues a frame. Returns false, dropping it, once a frame could not
+	// be written or after finish().
+	bool write( std::vector< Vector3f > vertices );
+
+	// Waits until every queued frame is on disk and closes the file.
+	// Returns false if a frame could not be written.
+	bool finish();
+
+	unsigned framesWritten() const { return m_framesWritten; }
+	size_t bytesWritten() const { return m_bytesWritten; }
+
+private:
+
+	void run();
+
+	FILE* m_file;
+	BoundedQueue< std::vector< Vector3f > > m_queue;
+	std::thread m_thread;
+
+	unsigned m_framesWritten;
+	size_t m_bytesWritten;
+	bool m_failed;
+};
+
+#endif // POSE_STREAM_H
@@ -1,26 +1,268 @@
 #include "SkeletalModel.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "GltfImport.h"
+#include "Parallel.h"
 
 #include <FL/Fl.H>
 #include <fstream>  // For file I/O
 #include <string>   // For std::string
 #include <iostream> // degugging
+#include <cmath>
+#include <cfloat>
+#include <thread>
 
 using namespace std;
 
-void SkeletalModel::load(const char *skeletonFile, const char *meshFile, const char *attachmentsFile)
+const float SkeletalModel::kFullDetailPixels = 400.0f;
+
+// Joints whose skinning matrix has a 3x3 part this close to orthonormal
+// transform normals by that part instead of its inverse transpose.
+const float kRigidTolerance = 1e-4f;
+
+// Fills the mesh's influence buckets from the cache next to its attachment
+// file, or builds them and writes the cache if it is missing or stale.
+void bucketMeshInfluences(Mesh& mesh, const char* attachmentsFile)
 {
-	loadSkeleton(skeletonFile);
+	const string cacheFile = string(attachmentsFile) + ".influences";
+	const bool cached = mesh.loadInfluenceBuckets(cacheFile.c_str(), attachmentsFile);
+	if (!cached && mesh.bucketInfluences())
+	{
+		mesh.saveInfluenceBuckets(cacheFile.c_str(), attachmentsFile);
+	}
+
+	cout << "influence buckets" << (cached ? " (cached)" : "") << ":";
+	for (const InfluenceBucket& bucket : mesh.influenceBuckets)
+	{
+		cout << ' ' << bucket.vertices.size() << " x " << bucket.maxInfluences;
+	}
+	cout << '\n';
+}
+
+SkeletalModel::SkeletalModel() :
+	m_rootJoint(nullptr),
+	m_activeLevelOfDetail(0),
+	m_fusedSkinning(true),
+	m_frameRing(nullptr),
+	m_meshLayoutHash(0),
+	m_meshOutOfDate(true),
+	m_meshBoundsValid(false)
+{
+}
+
+void SkeletalModel::load(const char *skeletonFile, const char *meshFile, const char *attachmentsFile, const LoadOptions& options)
+{
+	// rough share of the load time done after each step
+	auto report = [&]( float fraction, const char* stage )
+	{
+		if (options.progress)
+		{
+			options.progress->stage = stage;
+			options.progress->fraction = fraction;
+		}
+	};
+	report(0.0f, "reading files");
 
+	if (isGltfFile(skeletonFile))
+	{
+		// skeleton, mesh and weights all come from the one file
+		vector<int> parents;
+		vector<Vector3f> offsets;
+		if (!loadGltf(skeletonFile, parents, offsets, m_mesh))
+		{
+			if (options.progress)
+			{
+				options.progress->done = true;
+			}
+			return;
+		}
+		buildSkeleton(parents, offsets);
+		m_skeletonGeometry.build(m_jointParents);
+	}
+	else
+	{
+		// The three files are independent, so the mesh and the attachments
+		// are parsed on threads of their own (each splitting its file across
+		// more threads) while this one reads the skeleton.
+		std::thread meshThread([&]() { m_mesh.load(meshFile); });
+		std::thread attachmentsThread([&]() { m_mesh.loadAttachments(attachmentsFile, 0); });
 
-	m_mesh.load(meshFile);
-	m_mesh.loadAttachments(attachmentsFile, m_joints.size());
+		loadSkeleton(skeletonFile);
+		m_skeletonGeometry.build(m_jointParents);
+
+		meshThread.join();
+		attachmentsThread.join();
+
+		// weights without a mesh (it could not be read) have nothing to
+		// apply to, and would index its missing vertices
+		if (m_mesh.bindVertices.empty())
+		{
+			m_mesh.attachments.clear();
+		}
+	}
+
+	if (!m_mesh.attachments.empty() && m_mesh.attachments[0].size() != m_joints.size())
+	{
+		std::cerr << "Error: " << attachmentsFile << " has weights for " << m_mesh.attachments[0].size() << " joints, "
+			<< skeletonFile << " has " << m_joints.size() << " [in SkeletalModel::load()]!" << std::endl;
+		for (vector<float>& weights : m_mesh.attachments)
+		{
+			weights.resize(m_joints.size(), 0.0f);
+		}
+	}
+	report(0.5f, "bucketing influences");
+	bucketMeshInfluences(m_mesh, attachmentsFile);
+
+	report(0.55f, "loading shapes");
+	m_poseCorrectives.clear();
+	if (!options.correctivesFile.empty() &&
+		m_poseCorrectives.load(options.correctivesFile.c_str(), m_mesh.bindVertices.size(), m_joints.size()))
+	{
+		cout << "pose correctives: " << m_poseCorrectives.numShapes() << " shapes, "
+			<< m_poseCorrectives.numOffsets() << " stored offsets" << '\n';
+	}
+
+	for (const string& morphTargetFile : options.morphTargetFiles)
+	{
+		if (m_mesh.loadMorphTarget(morphTargetFile.c_str()))
+		{
+			const MorphTarget& target = m_mesh.morphTargets.back();
+			cout << "morph target " << target.name << ": " << target.deltas.size() / 3 << " stored offsets in "
+				<< target.runStarts.size() << " runs" << '\n';
+		}
+	}
+	m_morphWeights.assign(m_mesh.morphTargets.size(), 0.0f);
+
+	report(0.6f, "levels of detail");
+	m_levelsOfDetail.clear();
+	m_activeLevelOfDetail = 0;
+	if (options.levelsOfDetail > 0)
+	{
+		loadLevelsOfDetail(meshFile, attachmentsFile, options.levelsOfDetail);
+	}
+
+	report(0.7f, "optimizing layout");
+	if (options.optimizeMeshLayout)
+	{
+		const unsigned numVertices = m_mesh.bindVertices.size();
+		const float acmrBefore = computeACMR(m_mesh.faces, numVertices, 32);
+		const unsigned switchesBefore = countDominantJointSwitches(m_mesh);
+
+		vector<unsigned> remap;
+		optimizeMeshLayout(m_mesh, &remap);
+		m_poseCorrectives.remapVertices(remap);
+
+		cout << "mesh layout optimized:\n";
+		cout << "  ACMR (FIFO 32): " << acmrBefore << " -> " << computeACMR(m_mesh.faces, numVertices, 32) << '\n';
+		cout << "  dominant joint switches: " << switchesBefore << " -> " << countDominantJointSwitches(m_mesh) << '\n';
+
+		for (unsigned i = 0; i < m_levelsOfDetail.size(); i++)
+		{
+			optimizeMeshLayout(m_levelsOfDetail[i]);
+		}
+	}
+
+	// identifies this vertex order to point caches
+	m_meshLayoutHash = m_mesh.computeLayoutHash();
+
+	report(0.8f, "quantizing");
+	if (options.quantizedWeightBits != 0)
+	{
+		m_mesh.quantize(options.quantizedWeightBits, options.quantizePositions);
+
+		for (unsigned i = 0; i < m_levelsOfDetail.size(); i++)
+		{
+			m_levelsOfDetail[i].quantize(options.quantizedWeightBits, options.quantizePositions);
+		}
+	}
+
+	if (options.skinNormals && options.quantizedWeightBits != 0)
+	{
+		std::cerr << "Error: normals are only skinned with float weights, ignoring them [in SkeletalModel::load()]!" << std::endl;
+	}
+	else if (options.skinNormals)
+	{
+		m_mesh.computeBindNormals();
+		for (unsigned i = 0; i < m_levelsOfDetail.size(); i++)
+		{
+			m_levelsOfDetail[i].computeBindNormals();
+		}
+	}
 
 	computeBindWorldToJointTransforms();
 	updateCurrentJointToWorldTransforms();
 
+	report(0.85f, "building BVH");
+	m_meshBVH.build(m_mesh.currentVertices, m_mesh.faces);
+	computeJointBounds();
+
+	if (options.quantizedWeightBits != 0)
+	{
+		reportQuantizationError();
+	}
+
 	cout << "m_joints.size: " << m_joints.size() << '\n';
 	cout << "root transformation:\n";
 	m_rootJoint->transform.print();
+
+	report(1.0f, "done");
+	if (options.progress)
+	{
+		options.progress->done = true;
+	}
+}
+
+void SkeletalModel::loadSkeletonOnly(const char* skeletonFile)
+{
+	loadSkeleton(skeletonFile);
+	m_skeletonGeometry.build(m_jointParents);
+	m_activeLevelOfDetail = 0;
+
+	computeBindWorldToJointTransforms();
+	updateCurrentJointToWorldTransforms();
+}
+
+void SkeletalModel::clearSkeleton()
+{
+	for (Joint* joint : m_joints)
+	{
+		delete joint;
+	}
+	m_joints.clear();
+	m_jointParents.clear();
+	m_rootJoint = nullptr;
+	m_skeletonGeometry.build(m_jointParents);
+}
+
+bool SkeletalModel::takeMesh(SkeletalModel& other)
+{
+	if (other.m_joints.size() != m_joints.size())
+	{
+		std::cerr << "Error: the loaded model has " << other.m_joints.size() << " joints, this one " << m_joints.size()
+			<< " [in SkeletalModel::takeMesh()]!" << std::endl;
+		return false;
+	}
+	if (other.m_mesh.bindVertices.empty())
+	{
+		std::cerr << "Error: the loaded model has no mesh [in SkeletalModel::takeMesh()]!" << std::endl;
+		return false;
+	}
+
+	m_mesh = std::move(other.m_mesh);
+	m_levelsOfDetail = std::move(other.m_levelsOfDetail);
+	m_activeLevelOfDetail = 0;
+	m_poseCorrectives = std::move(other.m_poseCorrectives);
+	m_morphWeights = std::move(other.m_morphWeights);
+	m_meshBVH = std::move(other.m_meshBVH);
+	m_jointBoundsMin = std::move(other.m_jointBoundsMin);
+	m_jointBoundsMax = std::move(other.m_jointBoundsMax);
+	m_minWeightSum = other.m_minWeightSum;
+	m_maxWeightSum = other.m_maxWeightSum;
+	m_meshLayoutHash = other.m_meshLayoutHash;
+
+	// skinned for this model's pose on the next draw
+	m_meshOutOfDate = true;
+	return true;
 }
 
 void SkeletalModel::draw(Matrix4f cameraMatrix, bool skeletonVisible)
@@ -33,9 +275,8 @@ void SkeletalModel::draw(Matrix4f cameraMatrix, bool skeletonVisible)
 
 	if( skeletonVisible )
 	{
-		drawJoints();
-
-		drawSkeleton();
+		// Joint spheres and bone boxes in a single draw call
+		m_skeletonGeometry.draw(m_matrixStack.top(), m_joints);
 	}
 	else
 	{
@@ -43,7 +284,7 @@ void SkeletalModel::draw(Matrix4f cameraMatrix, bool skeletonVisible)
 		glLoadMatrixf(m_matrixStack.top().getElements());
 
 		// Tell the mesh to draw itself.
-		m_mesh.draw();
+		activeMesh().draw();
 	}
 }
 
@@ -51,6 +292,17 @@ void SkeletalModel::loadSkeleton( const char* filename )
 {
 	// Load the skeleton from file here.
 
+	if (isGltfFile(filename))
+	{
+		vector<int> parents;
+		vector<Vector3f> offsets;
+		if (loadGltfSkeleton(filename, parents, offsets))
+		{
+			buildSkeleton(parents, offsets);
+		}
+		return;
+	}
+
 	std::ifstream inputFile(filename);
 	if (!inputFile) 
 	{
@@ -76,6 +328,7 @@ void SkeletalModel::loadSkeleton( const char* filename )
 		);
 
 		m_joints.push_back(root);
+		m_jointParents.push_back(-1);
 		m_rootJoint = root;
 	}
 
@@ -97,6 +350,27 @@ void SkeletalModel::loadSkeleton( const char* filename )
 
 		// Add to list of joints
 		m_joints.push_back(joint);
+		m_jointParents.push_back(i);
+	}
+}
+
+void SkeletalModel::buildSkeleton(const vector<int>& parents, const vector<Vector3f>& offsets)
+{
+	for (unsigned j = 0; j < parents.size(); j++)
+	{
+		Joint* joint = new Joint();
+		joint->transform = Matrix4f::translation(offsets[j]);
+
+		if (parents[j] < 0)
+		{
+			m_rootJoint = joint;
+		}
+		else
+		{
+			m_joints[parents[j]]->children.push_back(joint);
+		}
+		m_joints.push_back(joint);
+		m_jointParents.push_back(parents[j]);
 	}
 }
 
@@ -279,11 +553,379 @@ void SkeletalModel::updateCurrentJointToWorldTransforms()
 	// Clear camera matrix
 	m_matrixStack.clear();
 
-	cout << "Should only see I matrices printed!\n";
 	if (m_rootJoint != nullptr)
 	{
 		updateCurrentJointToWorldTransformsHelper(m_rootJoint, m_matrixStack);
 	}
+
+	m_skeletonGeometry.invalidate();
+	m_meshOutOfDate = true;
+}
+
+// bindOffsets, if given, holds one offset per vertex (pose-space
+// correctives) added to the bind positions before skinning.
+void skinDense(const Mesh& mesh, const std::vector<Matrix4f>& palette, std::vector<Vector3f>& currentVertices,
+	const std::vector<Vector3f>* bindOffsets = nullptr)
+{
+	const std::vector<Vector3f>& bindVertices = mesh.bindVertices;
+
+	for (unsigned i = 0; i < bindVertices.size(); i++)
+	{
+		// Current vertex (v)
+		const Vector4f v(bindOffsets ? bindVertices[i] + (*bindOffsets)[i] : bindVertices[i], 1);
+		Vector3f weightedPostionOfVertex(0,0,0);
+		// Weights for current vertex
+		const vector<float>& weights = mesh.attachments[i];
+
+		for (unsigned j = 0; j < palette.size(); j++)
+		{
+			// += T * B * v
+			weightedPostionOfVertex += weights[j] * (palette[j] * v).xyz();
+		}
+
+		currentVertices[i] = weightedPostionOfVertex;
+	}
+}
+
+// Same as skinDense() but reads the compact encoding built by Mesh::quantize(),
+// decoding weights (and positions, if quantized) on the fly.
+template< typename Packed >
+void skinPacked(const Mesh& mesh, const std::vector<Packed>& influences, float weightScale,
+	const std::vector<Matrix4f>& palette, std::vector<Vector3f>& currentVertices, const std::vector<Vector3f>* bindOffsets)
+{
+	const bool decodePositions = !mesh.quantizedPositions.empty();
+	const Vector3f& origin = mesh.quantizedOrigin;
+	const Vector3f& scale = mesh.quantizedScale;
+
+	for (unsigned i = 0; i < influences.size(); i++)
+	{
+		Vector4f v;
+		if (decodePositions)
+		{
+			const unsigned short* q = mesh.quantizedPositions[i].xyz;
+			v = Vector4f(origin.x() + q[0] * scale.x(), origin.y() + q[1] * scale.y(), origin.z() + q[2] * scale.z(), 1);
+		}
+		else
+		{
+			v = Vector4f(mesh.bindVertices[i], 1);
+		}
+		if (bindOffsets)
+		{
+			v = v + Vector4f((*bindOffsets)[i], 0);
+		}
+
+		const Packed& influence = influences[i];
+		Vector3f weightedPostionOfVertex(0,0,0);
+
+		for (unsigned k = 0; k < 4; k++)
+		{
+			weightedPostionOfVertex += (influence.weights[k] * weightScale) * (palette[influence.joints[k]] * v).xyz();
+		}
+
+		currentVertices[i] = weightedPostionOfVertex;
+	}
+}
+
+// Adds weight * (palette matrix * (x, y, z, 1)) to sum. The matrices are
+// column major and affine, so only their top three rows are read.
+inline void addInfluence(const float* m, float weight, float x, float y, float z, float* sum)
+{
+	sum[0] += weight * (m[0] * x + m[4] * y + m[8] * z + m[12]);
+	sum[1] += weight * (m[1] * x + m[5] * y + m[9] * z + m[13]);
+	sum[2] += weight * (m[2] * x + m[6] * y + m[10] * z + m[14]);
+}
+
+// Skins the vertices of one bucket built by Mesh::bucketInfluences().
+// N is the bucket's number of influences per vertex; the loop over them
+// has a fixed length, so the compiler unrolls it, and padded influences
+// cost a multiply by zero instead of a branch.
+template< unsigned N >
+void skinBucket(const Mesh& mesh, const InfluenceBucket& bucket, const std::vector<Matrix4f>& palette,
+	std::vector<Vector3f>& currentVertices, const std::vector<Vector3f>* bindOffsets)
+{
+	for (unsigned n = 0; n < bucket.vertices.size(); n++)
+	{
+		const unsigned i = bucket.vertices[n];
+		const Vector3f v = bindOffsets ? mesh.bindVertices[i] + (*bindOffsets)[i] : mesh.bindVertices[i];
+		const unsigned char* joints = &bucket.joints[N * n];
+		const float* weights = &bucket.weights[N * n];
+
+		float sum[ 3 ] = { 0, 0, 0 };
+		for (unsigned k = 0; k < N; k++)
+		{
+			addInfluence(palette[joints[k]], weights[k], v.x(), v.y(), v.z(), sum);
+		}
+		currentVertices[i] = Vector3f(sum[0], sum[1], sum[2]);
+	}
+}
+
+// The bucket past kInfluenceBucketSizes, for vertices with more influences.
+void skinBucketAny(const Mesh& mesh, const InfluenceBucket& bucket, const std::vector<Matrix4f>& palette,
+	std::vector<Vector3f>& currentVertices, const std::vector<Vector3f>* bindOffsets)
+{
+	const unsigned count = bucket.maxInfluences;
+	for (unsigned n = 0; n < bucket.vertices.size(); n++)
+	{
+		const unsigned i = bucket.vertices[n];
+		const Vector3f v = bindOffsets ? mesh.bindVertices[i] + (*bindOffsets)[i] : mesh.bindVertices[i];
+		const unsigned char* joints = &bucket.joints[count * n];
+		const float* weights = &bucket.weights[count * n];
+
+		float sum[ 3 ] = { 0, 0, 0 };
+		for (unsigned k = 0; k < count; k++)
+		{
+			addInfluence(palette[joints[k]], weights[k], v.x(), v.y(), v.z(), sum);
+		}
+		currentVertices[i] = Vector3f(sum[0], sum[1], sum[2]);
+	}
+}
+
+typedef void (*SkinBucketKernel)(const Mesh&, const InfluenceBucket&, const std::vector<Matrix4f>&,
+	std::vector<Vector3f>&, const std::vector<Vector3f>*);
+
+// one kernel per entry of kInfluenceBucketSizes, then the generic one
+const SkinBucketKernel kSkinBucketKernels[ kNumInfluenceBucketSizes + 1 ] =
+{
+	skinBucket< 1 >, skinBucket< 2 >, skinBucket< 4 >, skinBucket< 8 >, skinBucketAny
+};
+
+// Adds weight * (normal matrix * (x, y, z)) to sum, reading the 3x3 part
+// of the column major matrix.
+inline void addNormalInfluence(const float* m, float weight, float x, float y, float z, float* sum)
+{
+	sum[0] += weight * (m[0] * x + m[4] * y + m[8] * z);
+	sum[1] += weight * (m[1] * x + m[5] * y + m[9] * z);
+	sum[2] += weight * (m[2] * x + m[6] * y + m[10] * z);
+}
+
+inline Vector3f normalizedSum(const float* sum)
+{
+	const float length = sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+	const float scale = length > 0 ? 1.0f / length : 0.0f;
+	return Vector3f(sum[0] * scale, sum[1] * scale, sum[2] * scale);
+}
+
+// Fused deformation of one bucket: per vertex, reads the joints, weights,
+// bind position and bind normal once and writes the skinned position and
+// normal, growing the box (boxMin/boxMax) by the position as it goes.
+// N is the bucket's number of influences like in skinBucket(); N = 0 is
+// the bucket past kInfluenceBucketSizes, with the count from the bucket.
+template< unsigned N >
+void skinBucketFused(const Mesh& mesh, const InfluenceBucket& bucket, const std::vector<Matrix4f>& palette,
+	const std::vector<Matrix4f>& normalPalette, std::vector<Vector3f>& currentVertices, std::vector<Vector3f>& currentNormals,
+	const std::vector<Vector3f>* bindOffsets, float* boxMin, float* boxMax)
+{
+	const unsigned count = N ? N : bucket.maxInfluences;
+	float lo[ 3 ] = { boxMin[0], boxMin[1], boxMin[2] };
+	float hi[ 3 ] = { boxMax[0], boxMax[1], boxMax[2] };
+
+	for (unsigned n = 0; n < bucket.vertices.size(); n++)
+	{
+		const unsigned i = bucket.vertices[n];
+		const Vector3f v = bindOffsets ? mesh.bindVertices[i] + (*bindOffsets)[i] : mesh.bindVertices[i];
+		const Vector3f& normal = mesh.bindNormals[i];
+		const unsigned char* joints = &bucket.joints[count * n];
+		const float* weights = &bucket.weights[count * n];
+
+		float sum[ 3 ] = { 0, 0, 0 };
+		float normalSum[ 3 ] = { 0, 0, 0 };
+		for (unsigned k = 0; k < count; k++)
+		{
+			addInfluence(palette[joints[k]], weights[k], v.x(), v.y(), v.z(), sum);
+			addNormalInfluence(normalPalette[joints[k]], weights[k], normal.x(), normal.y(), normal.z(), normalSum);
+		}
+		currentVertices[i] = Vector3f(sum[0], sum[1], sum[2]);
+		currentNormals[i] = normalizedSum(normalSum);
+
+		for (unsigned c = 0; c < 3; c++)
+		{
+			lo[c] = std::min(lo[c], sum[c]);
+			hi[c] = std::max(hi[c], sum[c]);
+		}
+	}
+
+	for (unsigned c = 0; c < 3; c++)
+	{
+		boxMin[c] = lo[c];
+		boxMax[c] = hi[c];
+	}
+}
+
+// Just the normals of skinBucketFused(), for skinning them in a pass of
+// their own.
+template< unsigned N >
+void skinBucketNormals(const Mesh& mesh, const InfluenceBucket& bucket, const std::vector<Matrix4f>& normalPalette,
+	std::vector<Vector3f>& currentNormals)
+{
+	const unsigned count = N ? N : bucket.maxInfluences;
+	for (unsigned n = 0; n < bucket.vertices.size(); n++)
+	{
+		const unsigned i = bucket.vertices[n];
+		const Vector3f& normal = mesh.bindNormals[i];
+		const unsigned char* joints = &bucket.joints[count * n];
+		const float* weights = &bucket.weights[count * n];
+
+		float normalSum[ 3 ] = { 0, 0, 0 };
+		for (unsigned k = 0; k < count; k++)
+		{
+			addNormalInfluence(normalPalette[joints[k]], weights[k], normal.x(), normal.y(), normal.z(), normalSum);
+		}
+		currentNormals[i] = normalizedSum(normalSum);
+	}
+}
+
+typedef void (*SkinBucketFusedKernel)(const Mesh&, const InfluenceBucket&, const std::vector<Matrix4f>&,
+	const std::vector<Matrix4f>&, std::vector<Vector3f>&, std::vector<Vector3f>&, const std::vector<Vector3f>*, float*, float*);
+typedef void (*SkinBucketNormalsKernel)(const Mesh&, const InfluenceBucket&, const std::vector<Matrix4f>&,
+	std::vector<Vector3f>&);
+
+const SkinBucketFusedKernel kSkinBucketFusedKernels[ kNumInfluenceBucketSizes + 1 ] =
+{
+	skinBucketFused< 1 >, skinBucketFused< 2 >, skinBucketFused< 4 >, skinBucketFused< 8 >, skinBucketFused< 0 >
+};
+
+const SkinBucketNormalsKernel kSkinBucketNormalsKernels[ kNumInfluenceBucketSizes + 1 ] =
+{
+	skinBucketNormals< 1 >, skinBucketNormals< 2 >, skinBucketNormals< 4 >, skinBucketNormals< 8 >, skinBucketNormals< 0 >
+};
+
+// Skins the positions and normals of a mesh with influence buckets and
+// bind normals and returns the box around the positions, in one sweep
+// over the vertices if fused, else in one sweep for each result.
+void skinMeshWithNormals(Mesh& mesh, const std::vector<Matrix4f>& palette, const std::vector<Matrix4f>& normalPalette,
+	const std::vector<Vector3f>* bindOffsets, bool fused, Vector3f& boxMin, Vector3f& boxMax)
+{
+	float lo[ 3 ] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float hi[ 3 ] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	const unsigned numBuckets = mesh.influenceBuckets.size();
+
+	if (fused)
+	{
+		for (unsigned b = 0; b < numBuckets; b++)
+		{
+			kSkinBucketFusedKernels[std::min(b, kNumInfluenceBucketSizes)](mesh, mesh.influenceBuckets[b], palette,
+				normalPalette, mesh.currentVertices, mesh.currentNormals, bindOffsets, lo, hi);
+		}
+	}
+	else
+	{
+		for (unsigned b = 0; b < numBuckets; b++)
+		{
+			kSkinBucketKernels[std::min(b, kNumInfluenceBucketSizes)](mesh, mesh.influenceBuckets[b], palette,
+				mesh.currentVertices, bindOffsets);
+		}
+		for (unsigned b = 0; b < numBuckets; b++)
+		{
+			kSkinBucketNormalsKernels[std::min(b, kNumInfluenceBucketSizes)](mesh, mesh.influenceBuckets[b], normalPalette,
+				mesh.currentNormals);
+		}
+		for (const Vector3f& v : mesh.currentVertices)
+		{
+			for (unsigned c = 0; c < 3; c++)
+			{
+				lo[c] = std::min(lo[c], v[c]);
+				hi[c] = std::max(hi[c], v[c]);
+			}
+		}
+	}
+
+	boxMin = Vector3f(lo[0], lo[1], lo[2]);
+	boxMax = Vector3f(hi[0], hi[1], hi[2]);
+}
+
+void skinMesh(const Mesh& mesh, const std::vector<Matrix4f>& palette, std::vector<Vector3f>& currentVertices,
+	const std::vector<Vector3f>* bindOffsets = nullptr)
+{
+	if (!mesh.packedInfluences8.empty())
+	{
+		skinPacked(mesh, mesh.packedInfluences8, 1.0f / 255.0f, palette, currentVertices, bindOffsets);
+	}
+	else if (!mesh.packedInfluences16.empty())
+	{
+		skinPacked(mesh, mesh.packedInfluences16, 1.0f / 65535.0f, palette, currentVertices, bindOffsets);
+	}
+	else if (!mesh.influenceBuckets.empty())
+	{
+		for (unsigned b = 0; b < mesh.influenceBuckets.size(); b++)
+		{
+			kSkinBucketKernels[std::min(b, kNumInfluenceBucketSizes)](mesh, mesh.influenceBuckets[b], palette,
+				currentVertices, bindOffsets);
+		}
+	}
+	else
+	{
+		skinDense(mesh, palette, currentVertices, bindOffsets);
+	}
+}
+
+bool SkeletalModel::computeBindOffsets(const std::vector<Matrix3f>& jointRotations, std::vector<Vector3f>& offsets,
+	std::vector<unsigned>* written) const
+{
+	// overlapping shapes list vertices more than once, and past the
+	// vertex count clearing everything is cheaper
+	if (written && offsets.size() == m_mesh.bindVertices.size() && written->size() < offsets.size())
+	{
+		for (unsigned i : *written)
+		{
+			offsets[i] = Vector3f(0, 0, 0);
+		}
+	}
+	else
+	{
+		offsets.assign(m_mesh.bindVertices.size(), Vector3f(0, 0, 0));
+	}
+	if (written)
+	{
+		written->clear();
+	}
+
+	const bool morphed = m_mesh.accumulateMorphTargets(m_morphWeights, offsets, written);
+	const bool corrected = m_poseCorrectives.evaluate(jointRotations, offsets, written);
+	return morphed || corrected;
+}
+
+void SkeletalModel::setMorphWeight(unsigned target, float weight)
+{
+	m_morphWeights[target] = weight;
+	m_meshOutOfDate = true;
+}
+
+void SkeletalModel::computeSkinningPalette()
+{
+	// The per-joint part of SSD only depends on the skeleton, so
+	// combine T * B once per joint instead of once per vertex.
+	m_skinningPalette.resize(m_joints.size());
+
+	for (unsigned j = 0; j < m_joints.size(); j++)
+	{
+		const Joint* joint = m_joints[j];
+		// Current pose joint to world (T) * Bind pose world to joint (B)
+		m_skinningPalette[j] = joint->currentJointToWorldTransform * joint->bindWorldToJointTransform;
+	}
+}
+
+void SkeletalModel::computeNormalPalette()
+{
+	m_normalPalette.resize(m_skinningPalette.size());
+
+	for (unsigned j = 0; j < m_skinningPalette.size(); j++)
+	{
+		// The inverse transpose of a rotation is the rotation itself,
+		// so only joints that scale or shear need the inverse.
+		const Matrix3f m = m_skinningPalette[j].getSubmatrix3x3(0, 0);
+		const Matrix3f mTm = m.transposed() * m;
+		float error = 0;
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				error = std::max(error, fabs(mTm(r, c) - (r == c ? 1.0f : 0.0f)));
+			}
+		}
+
+		m_normalPalette[j] = Matrix4f::identity();
+		m_normalPalette[j].setSubmatrix3x3(0, 0, error < kRigidTolerance ? m : m.inverse().transposed());
+	}
 }
 
 void SkeletalModel::updateMesh()
@@ -294,31 +936,546 @@ void SkeletalModel::updateMesh()
 	// You will need both the bind pose world --> joint transforms.
 	// and the current joint --> world transforms.
 
-	const std::vector<Vector3f>& bindVertices = m_mesh.bindVertices;
-	std::vector<Vector3f>& currentVertices = m_mesh.currentVertices;
+	computeSkinningPalette();
 
-	for (unsigned i = 0; i < bindVertices.size(); i++)
+	// Sum the active morph targets and corrective shapes,
+	// which are authored for the full mesh
+	bool offset = false;
+	if (m_activeLevelOfDetail == 0 && (!m_mesh.morphTargets.empty() || !m_poseCorrectives.empty()))
 	{
-		// Current vertex (v)
-		const Vector3f& v = bindVertices[i];
-		Vector3f weightedPostionOfVertex(0,0,0);
-		// Weights for current vertex
-		const vector<float>& weights = m_mesh.attachments[i];
-
-		// for (const Joint* joint : m_joints)
+		m_jointRotations.resize(m_joints.size());
 		for (unsigned j = 0; j < m_joints.size(); j++)
 		{
-			const Joint* joint = m_joints[j];
-			// Bind pose world to joint (B)
-			const Matrix4f& B = joint->bindWorldToJointTransform;
-			// Current pose joint to world (T)
-			const Matrix4f& T = joint->currentJointToWorldTransform;
+			m_jointRotations[j] = m_joints[j]->transform.getSubmatrix3x3(0, 0);
+		}
+		offset = computeBindOffsets(m_jointRotations, m_bindOffsets, &m_bindOffsetVertices);
+	}
 
-			// += T * B * v
-			weightedPostionOfVertex += weights[j] * ((T * B) * Vector4f(v,1)).xyz();
+	Mesh& mesh = activeMesh();
+	const std::vector<Vector3f>* bindOffsets = offset ? &m_bindOffsets : nullptr;
+	m_meshBoundsValid = !mesh.bindNormals.empty() && !mesh.influenceBuckets.empty();
+	if (m_meshBoundsValid)
+	{
+		// the offsets move the positions only; the normals stay those of the bind pose
+		computeNormalPalette();
+		skinMeshWithNormals(mesh, m_skinningPalette, m_normalPalette, bindOffsets, m_fusedSkinning,
+			m_meshBoundsMin, m_meshBoundsMax);
+	}
+	else
+	{
+		skinMesh(mesh, m_skinningPalette, mesh.currentVertices, bindOffsets);
+		if (!mesh.bindNormals.empty())
+		{
+			mesh.computeCurrentNormals();
 		}
+	}
 
-		currentVertices[i] = weightedPostionOfVertex;
+	// only the full mesh is pickable
+	if (m_activeLevelOfDetail == 0 && m_meshBVH.refit(m_mesh.currentVertices))
+	{
+		cout << "mesh BVH rebuilt after refit degraded it" << '\n';
+	}
+
+	if (m_frameRing && mesh.currentVertices.size() == m_frameRing->numVertices())
+	{
+		m_frameRing->publish(mesh.currentVertices);
+	}
+
+	m_meshOutOfDate = false;
+}
+
+bool SkeletalModel::showCachedFrame(const PointCache& cache, unsigned frame)
+{
+	if (cache.numVertices() != m_mesh.bindVertices.size())
+	{
+		std::cerr << "Error: the point cache has " << cache.numVertices() << " vertices, the mesh " << m_mesh.bindVertices.size()
+			<< " [in SkeletalModel::showCachedFrame()]!" << std::endl;
+		return false;
+	}
+	if (cache.layoutHash() != m_meshLayoutHash)
+	{
+		std::cerr << "Error: the point cache was baked for another mesh or vertex order (see skinbake -optimize)"
+			<< " [in SkeletalModel::showCachedFrame()]!" << std::endl;
+		return false;
+	}
+
+	if (!cache.readFrame(frame, m_cachedVertices))
+	{
+		std::cerr << "Error: could not read frame " << frame << " of the point cache [in SkeletalModel::showCachedFrame()]!" << std::endl;
+		return false;
+	}
+
+	m_activeLevelOfDetail = 0;
+	m_mesh.currentVertices.swap(m_cachedVertices);
+	if (!m_mesh.bindNormals.empty())
+	{
+		m_mesh.computeCurrentNormals();
+	}
+
+	// the joints did not make this mesh, and the BVH is not refit to it
+	m_meshOutOfDate = true;
+	m_meshBoundsValid = false;
+	return true;
+}
+
+bool SkeletalModel::meshBounds(Vector3f& boxMin, Vector3f& boxMax) const
+{
+	boxMin = m_meshBoundsMin;
+	boxMax = m_meshBoundsMax;
+	return m_meshBoundsValid;
+}
+
+bool SkeletalModel::updateMeshIfVisible(const Frustum& frustum)
+{
+	if (!m_meshOutOfDate)
+	{
+		return true;
+	}
+
+	Vector3f boxMin, boxMax;
+	computeInstanceBounds(boxMin, boxMax);
+	if (!frustum.intersects(boxMin, boxMax))
+	{
+		return false;
+	}
+
+	updateMesh();
+	return true;
+}
+
+void SkeletalModel::loadLevelsOfDetail(const char* meshFile, const char* attachmentsFile, unsigned count)
+{
+	m_levelsOfDetail.resize(count);
+
+	for (unsigned level = 1; level <= count; level++)
+	{
+		Mesh& lod = m_levelsOfDetail[level - 1];
+		const string lodMeshFile = levelOfDetailFileName(meshFile, level);
+		const string lodAttachmentsFile = levelOfDetailFileName(attachmentsFile, level);
+
+		if (!isGltfFile(meshFile) && ifstream(lodMeshFile.c_str()) && ifstream(lodAttachmentsFile.c_str()))
+		{
+			lod.load(lodMeshFile.c_str());
+			lod.loadAttachments(lodAttachmentsFile.c_str(), m_joints.size());
+			bucketMeshInfluences(lod, lodAttachmentsFile.c_str());
+		}
+		else
+		{
+			// each level from the previous one, with a quarter of its faces
+			const Mesh& finer = levelOfDetailMesh(level - 1);
+			simplifyMesh(finer, finer.faces.size() / 4, lod);
+			lod.bucketInfluences();
+		}
+
+		if (lod.attachments.size() != lod.bindVertices.size())
+		{
+			std::cerr << "Error: level of detail " << level << " has " << lod.attachments.size() << " attachments for "
+				<< lod.bindVertices.size() << " vertices [in loadLevelsOfDetail()]!" << std::endl;
+			m_levelsOfDetail.resize(level - 1);
+			return;
+		}
+
+		cout << "level of detail " << level << ": " << lod.bindVertices.size() << " vertices, " << lod.faces.size() << " faces\n";
+	}
+}
+
+void SkeletalModel::setLevelOfDetail(unsigned level)
+{
+	level = std::min(level, numLevelsOfDetail() - 1);
+	if (level != m_activeLevelOfDetail)
+	{
+		m_activeLevelOfDetail = level;
+		m_meshOutOfDate = true;
+	}
+}
+
+unsigned SkeletalModel::selectLevelOfDetail(const Matrix4f& viewMatrix, const Matrix4f& projectionMatrix, int viewportHeight)
+{
+	Vector3f boxMin, boxMax;
+	computeInstanceBounds(boxMin, boxMax);
+
+	// projected height of the bounding sphere
+	const Vector3f center = 0.5f * (boxMin + boxMax);
+	const float radius = 0.5f * (boxMax - boxMin).abs();
+	const float depth = -(viewMatrix * Vector4f(center, 1)).z();
+
+	unsigned level = 0;
+	if (depth > radius)
+	{
+		const float pixels = radius * projectionMatrix(1, 1) * viewportHeight / depth;
+		float threshold = kFullDetailPixels;
+		while (level + 1 < numLevelsOfDetail() && pixels < threshold)
+		{
+			level++;
+			threshold *= 0.5f;
+		}
+	}
+
+	setLevelOfDetail(level);
+	return level;
+}
+
+void SkeletalModel::computeJointBounds()
+{
+	const unsigned numJoints = m_joints.size();
+	m_jointBoundsMin.assign(numJoints, Vector3f(FLT_MAX, FLT_MAX, FLT_MAX));
+	m_jointBoundsMax.assign(numJoints, Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+
+	// weights that sum to 1 keep skinned vertices inside the boxes;
+	// the range also covers the renormalized quantized weights
+	m_minWeightSum = 1;
+	m_maxWeightSum = 1;
+
+	// quantized bind positions are off by up to half a step per axis
+	float pad = 0;
+
+	// corrective shapes move bind positions of the full mesh by up to this
+	vector<float> offsetBounds;
+	m_poseCorrectives.computeOffsetBounds(m_mesh.bindVertices.size(), offsetBounds);
+
+	// every level of detail may be the one being skinned
+	for (unsigned level = 0; level < numLevelsOfDetail(); level++)
+	{
+		const Mesh& mesh = levelOfDetailMesh(level);
+		if (!mesh.quantizedPositions.empty())
+		{
+			// The padding is in world units; the bind transforms are
+			// rigid, so pad by its length on every axis.
+			pad = std::max(pad, (0.5f * mesh.quantizedScale).abs());
+		}
+
+		for (unsigned i = 0; i < mesh.attachments.size(); i++)
+		{
+			const vector<float>& weights = mesh.attachments[i];
+			const Vector4f v(mesh.bindVertices[i], 1);
+			// the bind transforms are rigid, so the offset sphere keeps its radius
+			const float r = (level == 0) ? offsetBounds[i] : 0;
+
+			float sum = 0;
+			for (unsigned j = 0; j < weights.size() && j < numJoints; j++)
+			{
+				if (weights[j] <= 0)
+				{
+					continue;
+				}
+				sum += weights[j];
+
+				// bind position in joint j's bind space
+				const Vector3f p = (m_joints[j]->bindWorldToJointTransform * v).xyz();
+				for (int k = 0; k < 3; k++)
+				{
+					m_jointBoundsMin[j][k] = std::min(m_jointBoundsMin[j][k], p[k] - r);
+					m_jointBoundsMax[j][k] = std::max(m_jointBoundsMax[j][k], p[k] + r);
+				}
+			}
+
+			m_minWeightSum = std::min(m_minWeightSum, sum);
+			m_maxWeightSum = std::max(m_maxWeightSum, sum);
+		}
+	}
+
+	for (unsigned j = 0; j < numJoints; j++)
+	{
+		if (m_jointBoundsMin[j].x() <= m_jointBoundsMax[j].x())
+		{
+			m_jointBoundsMin[j] -= Vector3f(pad, pad, pad);
+			m_jointBoundsMax[j] += Vector3f(pad, pad, pad);
+		}
 	}
 }
 
+void SkeletalModel::computeInstanceBounds(Vector3f& boxMin, Vector3f& boxMax) const
+{
+	float lo[ 3 ] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float hi[ 3 ] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (unsigned j = 0; j < m_jointBoundsMin.size(); j++)
+	{
+		const Vector3f& jointMin = m_jointBoundsMin[j];
+		const Vector3f& jointMax = m_jointBoundsMax[j];
+		if (jointMin.x() > jointMax.x())
+		{
+			continue;
+		}
+
+		// Transform the box as center and half extents:
+		// c' = T c, e' = |R| e
+		const Matrix4f& T = m_joints[j]->currentJointToWorldTransform;
+		const Vector3f center = 0.5f * (jointMin + jointMax);
+		const Vector3f extent = 0.5f * (jointMax - jointMin);
+
+		for (int r = 0; r < 3; r++)
+		{
+			const float c = T(r, 0) * center[0] + T(r, 1) * center[1] + T(r, 2) * center[2] + T(r, 3);
+			const float e = fabsf(T(r, 0)) * extent[0] + fabsf(T(r, 1)) * extent[1] + fabsf(T(r, 2)) * extent[2];
+			lo[r] = std::min(lo[r], c - e);
+			hi[r] = std::max(hi[r], c + e);
+		}
+	}
+
+	// weight sums other than 1 scale vertices towards or away from the origin
+	for (int r = 0; r < 3; r++)
+	{
+		const float scaledLo = std::min(m_minWeightSum * lo[r], m_maxWeightSum * lo[r]);
+		const float scaledHi = std::max(m_minWeightSum * hi[r], m_maxWeightSum * hi[r]);
+		lo[r] = scaledLo;
+		hi[r] = scaledHi;
+	}
+
+	// Morph targets move a bind position by at most the weighted sum of
+	// their longest offsets, and skinning scales that by the weight sum
+	float morphPad = 0;
+	for (unsigned s = 0; s < m_morphWeights.size(); s++)
+	{
+		morphPad += fabsf(m_morphWeights[s]) * m_mesh.morphTargets[s].maxDelta;
+	}
+	morphPad *= m_maxWeightSum;
+	for (int r = 0; r < 3; r++)
+	{
+		lo[r] -= morphPad;
+		hi[r] += morphPad;
+	}
+
+	boxMin = Vector3f(lo[0], lo[1], lo[2]);
+	boxMax = Vector3f(hi[0], hi[1], hi[2]);
+}
+
+bool SkeletalModel::pickMesh(const Vector3f& origin, const Vector3f& direction, MeshPick& pick) const
+{
+	MeshBVH::RayHit hit;
+	if (m_activeLevelOfDetail != 0 || !m_meshBVH.raycast(m_mesh.currentVertices, origin, direction, hit))
+	{
+		return false;
+	}
+
+	const Tuple3u& face = m_mesh.faces[hit.face];
+	const float barycentric[ 3 ] = { 1.0f - hit.u - hit.v, hit.u, hit.v };
+
+	// the corner with the largest barycentric weight is the nearest one
+	unsigned corner = 0;
+	for (unsigned k = 1; k < 3; k++)
+	{
+		if (barycentric[k] > barycentric[corner])
+		{
+			corner = k;
+		}
+	}
+
+	pick.point = origin + hit.t * direction;
+	pick.t = hit.t;
+	pick.face = hit.face;
+	pick.vertex = face[corner];
+
+	pick.joint = -1;
+	if (pick.vertex < m_mesh.attachments.size())
+	{
+		const vector<float>& weights = m_mesh.attachments[pick.vertex];
+		float bestWeight = 0;
+		for (unsigned j = 0; j < weights.size(); j++)
+		{
+			if (weights[j] > bestWeight)
+			{
+				bestWeight = weights[j];
+				pick.joint = j;
+			}
+		}
+	}
+
+	return true;
+}
+
+int SkeletalModel::pickJoint(const Vector3f& origin, const Vector3f& direction) const
+{
+	// same radius as the spheres drawn by drawJoints()
+	const float radius = 0.025f;
+	const float a = Vector3f::dot(direction, direction);
+
+	int best = -1;
+	float bestT = 1e30f;
+
+	for (unsigned j = 0; j < m_joints.size(); j++)
+	{
+		const Vector3f offset = origin - jointPosition(j);
+		const float b = Vector3f::dot(offset, direction);
+		const float c = Vector3f::dot(offset, offset) - radius * radius;
+		const float discriminant = b * b - a * c;
+		if (discriminant < 0)
+		{
+			continue;
+		}
+
+		const float t = (-b - sqrtf(discriminant)) / a;
+		if (t >= 0 && t < bestT)
+		{
+			bestT = t;
+			best = j;
+		}
+	}
+
+	return best;
+}
+
+void SkeletalModel::reportQuantizationError()
+{
+	// Skin a fixed test pose with both the float reference and the
+	// quantized data, then restore the current pose.
+	std::vector<Matrix4f> savedTransforms;
+	for (unsigned j = 0; j < m_joints.size(); j++)
+	{
+		savedTransforms.push_back(m_joints[j]->transform);
+		setJointTransform(j, 0.5f, 0.3f * (j % 3), -0.4f);
+	}
+	updateCurrentJointToWorldTransforms();
+	computeSkinningPalette();
+
+	std::vector<Vector3f> quantized(m_mesh.bindVertices.size());
+	std::vector<Vector3f> reference(m_mesh.bindVertices.size());
+	skinMesh(m_mesh, m_skinningPalette, quantized);
+	skinDense(m_mesh, m_skinningPalette, reference);
+
+	float maxError = 0;
+	double sumError = 0;
+	for (unsigned i = 0; i < reference.size(); i++)
+	{
+		const float e = (quantized[i] - reference[i]).abs();
+		maxError = std::max(maxError, e);
+		sumError += e;
+	}
+	cout << "  skinned error in test pose: max " << maxError << ", mean " << sumError / reference.size() << '\n';
+
+	for (unsigned j = 0; j < m_joints.size(); j++)
+	{
+		m_joints[j]->transform = savedTransforms[j];
+	}
+	updateCurrentJointToWorldTransforms();
+}
+
+void SkeletalModel::computePosePalette(const std::vector<Vector3f>& jointAngles, std::vector<Matrix4f>& palette) const
+{
+	std::vector<Matrix4f> jointToWorld(m_joints.size());
+	palette.resize(m_joints.size());
+
+	for (unsigned j = 0; j < m_joints.size(); j++)
+	{
+		// Same local transform setJointTransform() would produce
+		Matrix4f local = m_joints[j]->transform;
+		const Vector3f& r = jointAngles[j];
+		local.setSubmatrix3x3(0,0, Matrix3f::rotateX(r.x()) * Matrix3f::rotateY(r.y()) * Matrix3f::rotateZ(r.z()));
+
+		// Parents come first, so their world transform is already known
+		const int parent = m_jointParents[j];
+		jointToWorld[j] = (parent < 0) ? local : jointToWorld[parent] * local;
+
+		palette[j] = jointToWorld[j] * m_joints[j]->bindWorldToJointTransform;
+	}
+}
+
+void SkeletalModel::skinPoses(const std::vector< std::vector<Vector3f> >& poses, std::vector< std::vector<Vector3f> >& deformedVertices,
+	unsigned numThreads) const
+{
+	const unsigned numPoses = poses.size();
+	const unsigned numJoints = m_joints.size();
+	const unsigned numVertices = m_mesh.bindVertices.size();
+
+	for (unsigned k = 0; k < numPoses; k++)
+	{
+		if (poses[k].size() != numJoints)
+		{
+			std::cerr << "Error: pose " << k << " has " << poses[k].size() << " joints, expected " << numJoints << " [in skinPoses()]!" << std::endl;
+			return;
+		}
+	}
+
+	// One palette per pose, flattened to the top 3 rows of each matrix
+	// (row major, 12 floats per joint) so the inner loop is plain arithmetic.
+	std::vector<float> palettes(numPoses * numJoints * 12);
+	std::vector<Matrix4f> palette;
+	for (unsigned k = 0; k < numPoses; k++)
+	{
+		computePosePalette(poses[k], palette);
+
+		for (unsigned j = 0; j < numJoints; j++)
+		{
+			float* m = &palettes[(k * numJoints + j) * 12];
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					m[r * 4 + c] = palette[j](r, c);
+				}
+			}
+		}
+	}
+
+	deformedVertices.resize(numPoses);
+	for (unsigned k = 0; k < numPoses; k++)
+	{
+		deformedVertices[k].resize(numVertices);
+	}
+
+	// Sum of the active morph targets (at their current weights) and
+	// corrective shapes for each pose (empty if none)
+	std::vector< std::vector<Vector3f> > bindOffsets(numPoses);
+	if (!m_mesh.morphTargets.empty() || !m_poseCorrectives.empty())
+	{
+		std::vector<Matrix3f> jointRotations(numJoints);
+		for (unsigned k = 0; k < numPoses; k++)
+		{
+			for (unsigned j = 0; j < numJoints; j++)
+			{
+				const Vector3f& r = poses[k][j];
+				jointRotations[j] = Matrix3f::rotateX(r.x()) * Matrix3f::rotateY(r.y()) * Matrix3f::rotateZ(r.z());
+			}
+			if (!computeBindOffsets(jointRotations, bindOffsets[k]))
+			{
+				bindOffsets[k].clear();
+			}
+		}
+	}
+
+	parallelFor(numVertices, numThreads ? numThreads : defaultThreadCount(), [&](unsigned begin, unsigned end)
+	{
+		// Non-zero influences of the current vertex
+		std::vector<unsigned> joints(numJoints);
+		std::vector<float> weights(numJoints);
+
+		for (unsigned i = begin; i < end; i++)
+		{
+			const Vector3f& v = m_mesh.bindVertices[i];
+
+			unsigned count = 0;
+			const vector<float>& attachment = m_mesh.attachments[i];
+			for (unsigned j = 0; j < numJoints; j++)
+			{
+				if (attachment[j] != 0)
+				{
+					joints[count] = j;
+					weights[count] = attachment[j];
+					count++;
+				}
+			}
+
+			for (unsigned k = 0; k < numPoses; k++)
+			{
+				const float* posePalette = &palettes[k * numJoints * 12];
+				const Vector3f p = bindOffsets[k].empty() ? v : v + bindOffsets[k][i];
+				const float x = p.x();
+				const float y = p.y();
+				const float z = p.z();
+				float px = 0, py = 0, pz = 0;
+
+				for (unsigned n = 0; n < count; n++)
+				{
+					// += w * (T * B) * v
+					const float* m = posePalette + joints[n] * 12;
+					const float w = weights[n];
+					px += w * (m[0] * x + m[1] * y + m[2]  * z + m[3]);
+					py += w * (m[4] * x + m[5] * y + m[6]  * z + m[7]);
+					pz += w * (m[8] * x + m[9] * y + m[10] * z + m[11]);
+				}
+
+				deformedVertices[k][i] = Vector3f(px, py, pz);
+			}
+		}
+	});
+}
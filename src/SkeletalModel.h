@@ -17,29 +17,103 @@
 #include <GL/glut.h>
 #include <FL/gl.h>
 #endif
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <map>
 #include <vector>
 #include <sstream>
+#include <string>
 #include <vecmath.h>
 
 #include "tuple.h"
 #include "Joint.h"
 #include "Mesh.h"
 #include "MatrixStack.h"
+#include "SkeletonGeometry.h"
+#include "MeshBVH.h"
+#include "Frustum.h"
+#include "PoseCorrectives.h"
+#include "PointCache.h"
+#include "FrameRing.h"
+
+// How far SkeletalModel::load() got, for showing progress while it runs
+// on another thread. stage names the current step (a string literal).
+struct LoadProgress
+{
+	LoadProgress() : fraction(0.0f), stage("starting"), done(false) {}
+
+	std::atomic< float > fraction; // 0 to 1
+	std::atomic< const char* > stage;
+	std::atomic< bool > done;
+};
+
+// Optional processing applied by SkeletalModel::load(),
+// selected from the command line in ModelerView::loadModel().
+struct LoadOptions
+{
+	LoadOptions() : optimizeMeshLayout(false), quantizedWeightBits(0), quantizePositions(false), levelsOfDetail(0),
+		skinNormals(false), progress(nullptr) {}
+
+	// reorder vertices and faces for cache locality (see MeshOptimizer.h)
+	bool optimizeMeshLayout;
+
+	// skin from the compact encoding built by Mesh::quantize():
+	// 0 (off), 8 or 16 bit weights, optionally with 16 bit positions
+	int quantizedWeightBits;
+	bool quantizePositions;
+
+	// number of coarser meshes to use when the model is small on screen,
+	// read from MESH.lodN.obj / ATTACH.lodN.attach if present (see the
+	// skinlod tool), otherwise simplified at load (see MeshSimplifier.h)
+	unsigned levelsOfDetail;
+
+	// pose-space corrective shapes to add before skinning the full mesh
+	// (see PoseCorrectives.h and the skinpsd tool); empty for none
+	std::string correctivesFile;
+
+	// OBJ files with the mesh's vertices in other shapes, loaded as
+	// morph targets (see Mesh::loadMorphTarget())
+	std::vector< std::string > morphTargetFiles;
+
+	// compute vertex normals for every level of detail and skin them with
+	// the positions (see SkeletalModel::updateMesh()); not combined with
+	// quantizedWeightBits
+	bool skinNormals;
+
+	// if set, updated as load() goes and marked done at the end
+	LoadProgress* progress;
+};
 
 class SkeletalModel
 {
 public:
+	SkeletalModel();
+
 	// Already-implemented utility functions that call the code you will write.
-	void load(const char *skeletonFile, const char *meshFile, const char *attachmentsFile);
+	void load(const char *skeletonFile, const char *meshFile, const char *attachmentsFile, const LoadOptions& options = LoadOptions());
 	void draw(Matrix4f cameraMatrix, bool drawSkeleton);
 
+	// Loads just the skeleton, ready to pose and draw in the skeleton view,
+	// e.g. while a model with the mesh loads on another thread.
+	void loadSkeletonOnly( const char* skeletonFile );
+
+	// Deletes the joints, leaving a model with no skeleton, e.g. after
+	// loadSkeletonOnly() read one the caller cannot use.
+	void clearSkeleton();
+
+	// Moves the mesh, its levels of detail, shapes and acceleration data
+	// out of other, a model loaded from the same skeleton file. Returns
+	// false, leaving both models alone, if other's skeleton differs or it
+	// has no mesh (its load failed).
+	bool takeMesh( SkeletalModel& other );
+
 	// Part 1: Understanding Hierarchical Modeling
 
 	// 1.1. Implement method to load a skeleton.
 	// This method should compute m_rootJoint and populate m_joints.
+	// load() and loadSkeleton() also read the skeleton, mesh and weights
+	// from a .glb or .gltf file given as all three files (see GltfImport.h).
 	void loadSkeleton( const char* filename );
 
 	// 1.1. Implement this method with a recursive helper to draw a sphere at each joint.
@@ -48,6 +122,9 @@ public:
 	// 1.2. Implement this method a recursive helper to draw a box between each pair of joints
 	void drawSkeleton( );
 
+	// draw() uses m_skeletonGeometry instead of the two methods above,
+	// which draw the same picture one GLUT primitive at a time.
+
 	// 1.3. Implement this method to handle changes to your skeleton given
 	// changes in the slider values
 	void setJointTransform( int jointIndex, float rX, float rY, float rZ );
@@ -69,18 +146,217 @@ public:
 	// given the current state of the skeleton.
 	// You will need both the bind pose world --> joint transforms.
 	// and the current joint --> world transforms.
+	// If the active mesh has normals (LoadOptions::skinNormals), skins them
+	// too and finds the box around the skinned positions, all in one sweep
+	// over the vertices: each vertex's weights, bind position and normal
+	// are read once for the three results.
 	void updateMesh();
 
+	// With setFusedSkinning(false), updateMesh() makes one pass over the
+	// vertices for the positions, one for the normals and one for the box
+	// instead, for comparing the two.
+	void setFusedSkinning( bool fused ) { m_fusedSkinning = fused; }
+
+	// From now on, updateMesh() also publishes the skinned positions to
+	// ring for other processes (see FrameRing.h), whenever the active
+	// level of detail has the ring's vertex count. The ring is not owned;
+	// nullptr stops publishing.
+	void setFrameRing( FrameRingWriter* ring ) { m_frameRing = ring; }
+
+	// Point cache playback: puts frame of cache (baked from this model's
+	// full mesh, see the skinbake tool) into the full mesh's current
+	// vertices instead of skinning them, and makes it the active level.
+	// The mesh then stays out of date, so the next updateMeshIfVisible()
+	// skins it from the joints again. Returns false, leaving the mesh
+	// alone, if the cache does not match the mesh or the frame is missing.
+	bool showCachedFrame( const PointCache& cache, unsigned frame );
+
+	// Box around the active mesh from the last updateMesh(), exact unlike
+	// computeInstanceBounds(). Returns false if that updateMesh() did not
+	// skin normals and so found no box.
+	bool meshBounds( Vector3f& boxMin, Vector3f& boxMax ) const;
+
+	// Morph target weights, 0 for all targets after load(). updateMesh()
+	// and skinPoses() add the targets with non-zero weights to the bind
+	// positions of the full mesh before skinning.
+	unsigned numMorphTargets() const { return m_mesh.morphTargets.size(); }
+	float morphWeight( unsigned target ) const { return m_morphWeights[ target ]; }
+	void setMorphWeight( unsigned target, float weight );
+
+	// Pose-space correctives loaded with the mesh, if any. updateMesh()
+	// and skinPoses() add the active shapes to the bind positions of the
+	// full mesh before skinning; coarser levels of detail skip them.
+	const PoseCorrectives& poseCorrectives() const { return m_poseCorrectives; }
+
+	// Batched evaluation for offline use.
+	// Each pose holds one (rX, rY, rZ) triple per joint, with the same meaning
+	// as the arguments of setJointTransform(). Fills deformedVertices[k] with
+	// the skinned mesh for poses[k]. The current pose of the model is untouched.
+	// Iterates vertex-major so each vertex's bind position and weights are
+	// read once and applied to all K palettes. The vertices are split
+	// across numThreads threads (0: one per hardware thread).
+	void skinPoses( const std::vector< std::vector< Vector3f > >& poses, std::vector< std::vector< Vector3f > >& deformedVertices,
+		unsigned numThreads = 1 ) const;
+
+	// Computes T * B for every joint for the given per-joint Euler angles
+	// by walking m_jointParents, without modifying the joints.
+	void computePosePalette( const std::vector< Vector3f >& jointAngles, std::vector< Matrix4f >& palette ) const;
+
+	// Picking against the current pose. pickMesh() finds the first
+	// triangle hit by the ray (using m_meshBVH, refitted by updateMesh()
+	// while the full detail mesh is active, otherwise the pick fails)
+	// and reports the hit triangle's vertex nearest to the hit point and
+	// that vertex's most weighted joint. pickJoint() returns the joint
+	// whose sphere in the skeleton view is hit first, or -1.
+	struct MeshPick
+	{
+		Vector3f point;
+		float t;
+		unsigned face;
+		unsigned vertex;
+		int joint;
+	};
+	bool pickMesh( const Vector3f& origin, const Vector3f& direction, MeshPick& pick ) const;
+	int pickJoint( const Vector3f& origin, const Vector3f& direction ) const;
+
+	// Conservative world space box around the skinned mesh in the current
+	// pose, from the per-joint bind boxes and the current joint transforms.
+	// Costs O(joints) and does not need updateMesh() to have run.
+	void computeInstanceBounds( Vector3f& boxMin, Vector3f& boxMax ) const;
+
+	// Calls updateMesh() if the joints moved since the mesh was last
+	// skinned and the instance bounds intersect the frustum. A culled
+	// model stays out of date until it is visible again.
+	// Returns true if the mesh is up to date.
+	bool updateMeshIfVisible( const Frustum& frustum );
+
+	// Level of detail: 0 is the full mesh, 1 .. numLevelsOfDetail() - 1
+	// have about a quarter of the faces of the previous level each.
+	// updateMesh() and draw() use the active level.
+	unsigned numLevelsOfDetail() const { return m_levelsOfDetail.size() + 1; }
+	unsigned levelOfDetail() const { return m_activeLevelOfDetail; }
+	const Mesh& levelOfDetailMesh( unsigned level ) const { return level == 0 ? m_mesh : m_levelsOfDetail[ level - 1 ]; }
+	void setLevelOfDetail( unsigned level );
+
+	// Picks and activates the level of detail for the model's projected
+	// size: full detail from kFullDetailPixels high, then one level
+	// coarser each time the size halves.
+	unsigned selectLevelOfDetail( const Matrix4f& viewMatrix, const Matrix4f& projectionMatrix, int viewportHeight );
+
+	static const float kFullDetailPixels;
+
+	// Ray and closest point queries over the current mesh
+	const MeshBVH& meshBVH() const { return m_meshBVH; }
+
+	unsigned numJoints() const { return m_joints.size(); }
+	Vector3f jointPosition( unsigned jointIndex ) const { return m_joints[ jointIndex ]->currentJointToWorldTransform.getCol( 3 ).xyz(); }
+	int jointParent( unsigned jointIndex ) const { return m_jointParents[ jointIndex ]; } // -1 for the root
+	// position relative to the parent joint (world position for the root), fixed by the skeleton file
+	Vector3f jointOffset( unsigned jointIndex ) const { return m_joints[ jointIndex ]->transform.getCol( 3 ).xyz(); }
+	const Matrix4f& jointBindWorldToJoint( unsigned jointIndex ) const { return m_joints[ jointIndex ]->bindWorldToJointTransform; }
+	unsigned numVertices() const { return m_mesh.bindVertices.size(); }
+	const Mesh& mesh() const { return m_mesh; }
+	// Mesh::computeLayoutHash() of the full mesh as loaded, recorded by point caches
+	unsigned long long meshLayoutHash() const { return m_meshLayoutHash; }
+
 private:
 
+	// Adds joints at offsets from their parents (parents before children).
+	void buildSkeleton( const std::vector< int >& parents, const std::vector< Vector3f >& offsets );
+
+	// Fills m_skinningPalette with T * B for each joint.
+	void computeSkinningPalette();
+
+	// Fills m_normalPalette from m_skinningPalette.
+	void computeNormalPalette();
+
+	// Fills offsets with the active morph targets and corrective shapes
+	// for the given local joint rotations. Returns false if there are none.
+	// If written is given, offsets is a buffer kept from the last call,
+	// zero but at the vertices written lists: only those are cleared (all
+	// of offsets if written has as many entries), and written is refilled
+	// with the vertices set now.
+	bool computeBindOffsets( const std::vector< Matrix3f >& jointRotations, std::vector< Vector3f >& offsets,
+		std::vector< unsigned >* written = nullptr ) const;
+
+	// Prints the skinned error of the quantized mesh against the float data.
+	void reportQuantizationError();
+
+	// Fills m_jointBoundsMin/Max and the weight sum range from all
+	// levels of detail.
+	void computeJointBounds();
+
+	// Loads or generates count levels of detail below m_mesh.
+	void loadLevelsOfDetail( const char* meshFile, const char* attachmentsFile, unsigned count );
+
+	Mesh& activeMesh() { return m_activeLevelOfDetail == 0 ? m_mesh : m_levelsOfDetail[ m_activeLevelOfDetail - 1 ]; }
+
 	// pointer to the root joint
 	Joint* m_rootJoint;
 	// the list of joints.
 	std::vector< Joint* > m_joints;
+	// index of each joint's parent in m_joints, -1 for the root.
+	// Parents always come before their children.
+	std::vector< int > m_jointParents;
 
 	Mesh m_mesh;
 
+	// coarser versions of m_mesh, level 1 first
+	std::vector< Mesh > m_levelsOfDetail;
+	unsigned m_activeLevelOfDetail;
+
+	// per-joint skinning matrices, current joint to world * bind world to joint
+	std::vector< Matrix4f > m_skinningPalette;
+	// per joint, the inverse transpose of the 3x3 part of its skinning
+	// matrix, which transforms normals, in a Matrix4f with no translation
+	std::vector< Matrix4f > m_normalPalette;
+	bool m_fusedSkinning;
+
+	// see setFrameRing()
+	FrameRingWriter* m_frameRing;
+
+	// corrective shapes over m_mesh, driven by the joints' local rotations
+	PoseCorrectives m_poseCorrectives;
+	std::vector< Matrix3f > m_jointRotations;
+	// one weight per morph target of m_mesh
+	std::vector< float > m_morphWeights;
+
+	// summed active morph targets and corrective shapes,
+	// added to m_mesh.bindVertices while skinning; zero but at
+	// m_bindOffsetVertices
+	std::vector< Vector3f > m_bindOffsets;
+	std::vector< unsigned > m_bindOffsetVertices;
+
+	// frame decoded by showCachedFrame(), swapped into m_mesh
+	std::vector< Vector3f > m_cachedVertices;
+	unsigned long long m_meshLayoutHash;
+
 	MatrixStack m_matrixStack;
+
+	// cached spheres and boxes for the skeleton view, drawn in one batch
+	SkeletonGeometry m_skeletonGeometry;
+
+	// over m_mesh.currentVertices, built on the bind pose
+	MeshBVH m_meshBVH;
+
+	// Per joint, the box around the bind positions of the vertices it
+	// influences, in that joint's bind space (empty if min > max).
+	// A skinned vertex is a weighted sum of its influences' transformed
+	// bind positions, so it lies inside the union of these boxes once
+	// transformed, scaled by its weight sum, which is within
+	// [ m_minWeightSum, m_maxWeightSum ].
+	std::vector< Vector3f > m_jointBoundsMin;
+	std::vector< Vector3f > m_jointBoundsMax;
+	float m_minWeightSum;
+	float m_maxWeightSum;
+
+	// set when the joints moved after the last updateMesh()
+	bool m_meshOutOfDate;
+
+	// see meshBounds()
+	bool m_meshBoundsValid;
+	Vector3f m_meshBoundsMin;
+	Vector3f m_meshBoundsMax;
 };
 
 #endif
@@ -0,0 +1,282 @@
+#include "SkeletonGeometry.h"
+
+#include <cmath>
+#include <iostream>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979f
+#endif
+
+using namespace std;
+
+namespace
+{
+	// Same sizes as the unbatched drawJoints() / drawSkeleton()
+	const float kJointRadius = 0.025f;
+	const int kSphereSlices = 12;
+	const int kSphereStacks = 12;
+	const float kBoneWidth = 0.025f;
+
+	// Floats per GL_N3F_V3F vertex
+	const int kStride = 6;
+
+	struct Shape
+	{
+		vector< GLfloat > vertices; // GL_N3F_V3F
+		vector< GLuint > indices;
+
+		unsigned numVertices() const { return vertices.size() / kStride; }
+	};
+
+	void addVertex( Shape& shape, float nx, float ny, float nz, float px, float py, float pz )
+	{
+		const GLfloat v[ kStride ] = { nx, ny, nz, px, py, pz };
+		shape.vertices.insert(shape.vertices.end(), v, v + kStride);
+	}
+
+	// The sphere glutSolidSphere( 0.025f, 12, 12 ) draws, as an indexed mesh
+	Shape buildSphere()
+	{
+		Shape sphere;
+
+		for (int i = 0; i <= kSphereStacks; i++)
+		{
+			const float phi = (float)M_PI * i / kSphereStacks;
+			for (int j = 0; j <= kSphereSlices; j++)
+			{
+				const float theta = 2.0f * (float)M_PI * j / kSphereSlices;
+				const float nx = sinf(phi) * cosf(theta);
+				const float ny = sinf(phi) * sinf(theta);
+				const float nz = cosf(phi);
+				addVertex(sphere, nx, ny, nz, kJointRadius * nx, kJointRadius * ny, kJointRadius * nz);
+			}
+		}
+
+		for (int i = 0; i < kSphereStacks; i++)
+		{
+			for (int j = 0; j < kSphereSlices; j++)
+			{
+				const GLuint a = i * (kSphereSlices + 1) + j;
+				const GLuint b = a + kSphereSlices + 1;
+
+				// the triangles touching the poles are degenerate
+				if (i != 0)
+				{
+					const GLuint t[ 3 ] = { a, b, a + 1 };
+					sphere.indices.insert(sphere.indices.end(), t, t + 3);
+				}
+				if (i != kSphereStacks - 1)
+				{
+					const GLuint t[ 3 ] = { a + 1, b, b + 1 };
+					sphere.indices.insert(sphere.indices.end(), t, t + 3);
+				}
+			}
+		}
+
+		return sphere;
+	}
+
+	// Unit box spanning [-0.5, 0.5] in x and y and [0, 1] in z, so that
+	// scaling z by the bone length makes it reach from parent to child.
+	Shape buildBox()
+	{
+		Shape box;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int side = -1; side <= 1; side += 2)
+			{
+				const int u = (axis + 1) % 3;
+				const int v = (axis + 2) % 3;
+				const float corners[ 4 ][ 2 ] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+
+				const GLuint first = box.numVertices();
+				for (int c = 0; c < 4; c++)
+				{
+					// counterclockwise seen from outside
+					const int k = (side > 0) ? c : 3 - c;
+					float n[ 3 ] = { 0, 0, 0 };
+					float p[ 3 ];
+					n[axis] = (float)side;
+					p[axis] = 0.5f * side;
+					p[u] = corners[k][0];
+					p[v] = corners[k][1];
+					addVertex(box, n[0], n[1], n[2], p[0], p[1], p[2] + 0.5f);
+				}
+
+				const GLuint t[ 6 ] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+				box.indices.insert(box.indices.end(), t, t + 6);
+			}
+		}
+
+		return box;
+	}
+
+	const Shape& sphereShape()
+	{
+		static const Shape sphere = buildSphere();
+		return sphere;
+	}
+
+	const Shape& boxShape()
+	{
+		static const Shape box = buildBox();
+		return box;
+	}
+
+	// Writes shape transformed by position' = linear * p + translation and
+	// normal' = normalMatrix * n (matrices are 3x3 column major) to out.
+	void transformShape( const Shape& shape, const float* normalMatrix, const float* linear,
+		const float* translation, GLfloat* out )
+	{
+		const GLfloat* in = &shape.vertices[0];
+		const unsigned numFloats = shape.vertices.size();
+
+		for (unsigned i = 0; i < numFloats; i += kStride)
+		{
+			const GLfloat* n = in + i;
+			const GLfloat* p = in + i + 3;
+			GLfloat* o = out + i;
+
+			for (int r = 0; r < 3; r++)
+			{
+				o[r] = normalMatrix[r] * n[0] + normalMatrix[3 + r] * n[1] + normalMatrix[6 + r] * n[2];
+				o[3 + r] = linear[r] * p[0] + linear[3 + r] * p[1] + linear[6 + r] * p[2] + translation[r];
+			}
+		}
+	}
+}
+
+SkeletonGeometry::SkeletonGeometry() :
+	m_dirty(true),
+	m_displayList(0)
+{
+}
+
+void SkeletonGeometry::build( const vector< int >& parents )
+{
+	m_parents = parents;
+
+	const Shape& sphere = sphereShape();
+	const Shape& box = boxShape();
+
+	const unsigned numJoints = parents.size();
+	const unsigned numBones = numJoints > 0 ? numJoints - 1 : 0;
+
+	m_vertices.assign((numJoints * sphere.numVertices() + numBones * box.numVertices()) * kStride, 0.0f);
+	m_indices.clear();
+	m_indices.reserve(numJoints * sphere.indices.size() + numBones * box.indices.size());
+
+	// one sphere per joint
+	for (unsigned j = 0; j < numJoints; j++)
+	{
+		const GLuint base = j * sphere.numVertices();
+		for (unsigned i = 0; i < sphere.indices.size(); i++)
+		{
+			m_indices.push_back(base + sphere.indices[i]);
+		}
+	}
+
+	// one box per non-root joint, from its parent to it
+	for (unsigned b = 0; b < numBones; b++)
+	{
+		const GLuint base = numJoints * sphere.numVertices() + b * box.numVertices();
+		for (unsigned i = 0; i < box.indices.size(); i++)
+		{
+			m_indices.push_back(base + box.indices[i]);
+		}
+	}
+
+	m_dirty = true;
+}
+
+void SkeletonGeometry::update( const vector< Joint* >& joints )
+{
+	const Shape& sphere = sphereShape();
+	const Shape& box = boxShape();
+
+	const unsigned numJoints = m_parents.size();
+	GLfloat* sphereOut = &m_vertices[0];
+	GLfloat* boxOut = sphereOut + numJoints * sphere.vertices.size();
+
+	for (unsigned j = 0; j < numJoints; j++)
+	{
+		const Matrix4f& world = joints[j]->currentJointToWorldTransform;
+		Matrix3f rotation = world.getSubmatrix3x3(0, 0);
+		const Vector3f translation = world.getCol(3).xyz();
+
+		transformShape(sphere, rotation, rotation, translation, sphereOut + j * sphere.vertices.size());
+
+		const int parent = m_parents[j];
+		if (parent < 0)
+		{
+			continue;
+		}
+
+		// Bone frame in the parent's space: z along the offset to this
+		// joint, scaled to its length, x and y scaled to the bone width.
+		const Vector3f offset = joints[j]->transform.getCol(3).xyz();
+		const float length = offset.abs();
+
+		Vector3f z(0, 0, 1);
+		if (length > 0)
+		{
+			z = offset / length;
+		}
+		// any vector not parallel to z gives the other two axes
+		const Vector3f reference = (fabsf(z.z()) < 0.99f) ? Vector3f(0, 0, 1) : Vector3f(0, 1, 0);
+		const Vector3f y = Vector3f::cross(z, reference).normalized();
+		const Vector3f x = Vector3f::cross(y, z);
+
+		const Matrix4f& parentWorld = joints[parent]->currentJointToWorldTransform;
+		const Matrix3f parentRotation = parentWorld.getSubmatrix3x3(0, 0);
+		Matrix3f boneRotation = parentRotation * Matrix3f(x, y, z);
+		Matrix3f boneLinear = boneRotation * Matrix3f(
+			kBoneWidth, 0, 0,
+			0, kBoneWidth, 0,
+			0, 0, length);
+		const Vector3f boneTranslation = parentWorld.getCol(3).xyz();
+
+		// bones are stored in joint order, skipping the root (joint 0)
+		transformShape(box, boneRotation, boneLinear, boneTranslation, boxOut + (j - 1) * box.vertices.size());
+	}
+}
+
+void SkeletonGeometry::draw( const Matrix4f& cameraMatrix, const vector< Joint* >& joints )
+{
+	if (m_indices.empty())
+	{
+		return;
+	}
+
+	if (joints.size() != m_parents.size())
+	{
+		std::cerr << "Error: skeleton geometry was built for a different skeleton [in SkeletonGeometry::draw()]!" << std::endl;
+		return;
+	}
+
+	glLoadMatrixf(cameraMatrix);
+
+	// The arrays are copied into a display list when the pose changes, so
+	// redrawing an unchanged pose sends nothing but the list name.
+	if (m_dirty || m_displayList == 0)
+	{
+		update(joints);
+
+		if (m_displayList == 0)
+		{
+			m_displayList = glGenLists(1);
+		}
+
+		glNewList(m_displayList, GL_COMPILE);
+		glInterleavedArrays(GL_N3F_V3F, 0, &m_vertices[0]);
+		glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, &m_indices[0]);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glEndList();
+
+		m_dirty = false;
+	}
+
+	glCallList(m_displayList);
+}
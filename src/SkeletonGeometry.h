@@ -0,0 +1,56 @@
+#ifndef SKELETON_GEOMETRY_H
+#define SKELETON_GEOMETRY_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <GL/gl.h>
+
+#include <vector>
+#include <vecmath.h>
+
+#include "Joint.h"
+
+// Batched drawing of the skeleton view: a sphere at every joint and a box
+// from every joint to each of its children.
+//
+// The sphere and box are tessellated once. build() lays out one copy of
+// each per joint/bone in a single vertex array and fixes the index buffer;
+// when the pose changes, all joint spheres and bone frames are computed in
+// one pass over the joints in parent-before-child order and compiled with
+// a single glDrawElements call into a display list. Redrawing a pose that
+// has not changed only calls that list.
+class SkeletonGeometry
+{
+public:
+
+	SkeletonGeometry();
+
+	// Sets up buffers for a skeleton given the parent of each joint
+	// (-1 for the root; parents must come before their children).
+	void build( const std::vector< int >& parents );
+
+	// Call whenever the joints' currentJointToWorldTransform change.
+	void invalidate() { m_dirty = true; }
+
+	// Draws all joints and bones with the given modelview matrix.
+	void draw( const Matrix4f& cameraMatrix, const std::vector< Joint* >& joints );
+
+private:
+
+	void update( const std::vector< Joint* >& joints );
+
+	std::vector< int > m_parents;
+
+	// GL_N3F_V3F interleaved: all joint spheres, then all bone boxes
+	std::vector< GLfloat > m_vertices;
+	std::vector< GLuint > m_indices;
+
+	bool m_dirty;
+
+	// compiled from the arrays above by the last draw() after a change
+	GLuint m_displayList;
+};
+
+#endif // SKELETON_GEOMETRY_H
@@ -0,0 +1,119 @@
+#ifndef SKIN_PROTOCOL_H
+#define SKIN_PROTOCOL_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Binary protocol of the skinning service (skinserver) over a Unix domain
+// stream socket. Header only, so clients need neither the rig code nor GL.
+//
+// Every message starts with a header of four uint32 values; integers and
+// floats are in the host's byte order, as both ends share the machine.
+// A client sends requests on a connection one after the other and reads
+// each response before sending the next:
+//
+//   kSkinInfo     -> header { count = number of rigs }, then per rig
+//                    uint32 joints, uint32 vertices
+//   kSkinPose     -> rig, count = joints of the rig, then count x (rX, rY, rZ)
+//                    float angles as for SkeletalModel::setJointTransform();
+//                    header { count = vertices }, then count x (x, y, z) floats
+//   kSkinShutdown -> header { count = 0 }, and the server stops
+//
+// A failed request gets a header with a non-zero status and count 0.
+
+const unsigned kSkinRequestMagic = 0x51445353;  // "SSDQ"
+const unsigned kSkinResponseMagic = 0x52445353; // "SSDR"
+
+enum SkinRequestType
+{
+	kSkinInfo = 1,
+	kSkinPose = 2,
+	kSkinShutdown = 3
+};
+
+enum SkinStatus
+{
+	kSkinOk = 0,
+	kSkinBadRequest = 1,
+	kSkinUnknownRig = 2,
+	kSkinWrongJointCount = 3
+};
+
+struct SkinRequestHeader
+{
+	unsigned magic;
+	unsigned type; // SkinRequestType
+	unsigned rig;
+	unsigned count;
+};
+
+struct SkinResponseHeader
+{
+	unsigned magic;
+	unsigned status; // SkinStatus
+	unsigned count;
+	unsigned reserved;
+};
+
+// Reads or writes exactly size bytes, retrying short transfers.
+// Returns false on error or if the peer closed the connection.
+inline bool readFully( int fd, void* data, size_t size )
+{
+	char* p = static_cast< char* >( data );
+	while( size > 0 )
+	{
+		const ssize_t n = read( fd, p, size );
+		if( n < 0 && errno == EINTR )
+		{
+			continue;
+		}
+		if( n <= 0 )
+		{
+			return false;
+		}
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+inline bool writeFully( int fd, const void* data, size_t size )
+{
+	const char* p = static_cast< const char* >( data );
+	while( size > 0 )
+	{
+		// no SIGPIPE if the peer went away
+		const ssize_t n = send( fd, p, size, MSG_NOSIGNAL );
+		if( n < 0 && errno == EINTR )
+		{
+			continue;
+		}
+		if( n <= 0 )
+		{
+			return false;
+		}
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+// Fills address for the socket path. Returns false if it is too long.
+inline bool skinSocketAddress( const std::string& path, sockaddr_un& address )
+{
+	memset( &address, 0, sizeof( address ) );
+	address.sun_family = AF_UNIX;
+	if( path.size() >= sizeof( address.sun_path ) )
+	{
+		return false;
+	}
+	memcpy( address.sun_path, path.c_str(), path.size() + 1 );
+	return true;
+}
+
+#endif // SKIN_PROTOCOL_H
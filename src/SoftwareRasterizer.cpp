@@ -0,0 +1,299 @@
+#include "SoftwareRasterizer.h"
+#include "Parallel.h"
+#include "bitmap.h"
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+	// Lighting from ModelerView::draw(), in eye space:
+	// GL_LIGHT0 at (3, 3, 5) with white diffuse and specular,
+	// default global ambient 0.2, material ambient/diffuse 0.4,
+	// specular 0.6, shininess 50, infinite viewer.
+	const float kLightPosition[ 3 ] = { 3.0f, 3.0f, 5.0f };
+	const float kAmbient = 0.2f * 0.4f;
+	const float kDiffuse = 0.4f;
+	const float kSpecular = 0.6f;
+	const float kShininess = 50.0f;
+
+	// Triangles closer than this (clip w) are dropped instead of clipped.
+	// Camera::projectionMatrix() uses the same near plane.
+	const float kNearW = 0.1f;
+
+	inline float edge( float ax, float ay, float bx, float by, float px, float py )
+	{
+		return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+	}
+
+	inline unsigned char shade( const float* n, const float* p )
+	{
+		float l[ 3 ] = { kLightPosition[0] - p[0], kLightPosition[1] - p[1], kLightPosition[2] - p[2] };
+		const float lengthL = sqrtf(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]);
+		l[0] /= lengthL;
+		l[1] /= lengthL;
+		l[2] /= lengthL;
+
+		float c = kAmbient;
+
+		const float nDotL = n[0] * l[0] + n[1] * l[1] + n[2] * l[2];
+		if (nDotL > 0)
+		{
+			c += kDiffuse * nDotL;
+
+			// half vector with the viewer at (0, 0, +inf)
+			float h[ 3 ] = { l[0], l[1], l[2] + 1.0f };
+			const float lengthH = sqrtf(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]);
+			const float nDotH = (n[0] * h[0] + n[1] * h[1] + n[2] * h[2]) / lengthH;
+			if (nDotH > 0)
+			{
+				c += kSpecular * powf(nDotH, kShininess);
+			}
+		}
+
+		return (unsigned char)(std::min(c, 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer( int width, int height, unsigned numThreads ) :
+	m_width(width),
+	m_height(height),
+	m_tilesX((width + kTileSize - 1) / kTileSize),
+	m_tilesY((height + kTileSize - 1) / kTileSize),
+	m_numThreads(numThreads ? numThreads : defaultThreadCount()),
+	m_color(3 * width * height, 0),
+	m_depth(width * height, FLT_MAX)
+{
+	m_bins.resize(m_numThreads);
+	for (unsigned t = 0; t < m_numThreads; t++)
+	{
+		m_bins[t].resize(m_tilesX * m_tilesY);
+	}
+}
+
+void SoftwareRasterizer::render( const vector< Vector3f >& vertices, const vector< Tuple3u >& faces,
+	const Matrix4f& viewMatrix, const Matrix4f& projectionMatrix )
+{
+	m_screenVertices.resize(vertices.size());
+	m_faceNormals.resize(3 * faces.size());
+
+	const float* view = viewMatrix;
+	const float* projection = projectionMatrix;
+
+	// 1. vertex transform
+	parallelFor(vertices.size(), m_numThreads, [&]( unsigned begin, unsigned end )
+	{
+		transformVertices(begin, end, vertices, view, projection);
+	});
+
+	// 2. triangle setup and binning, each thread into its own bins
+	runOnThreads(m_numThreads, [&]( unsigned t )
+	{
+		const unsigned begin = (unsigned)((unsigned long long)faces.size() * t / m_numThreads);
+		const unsigned end = (unsigned)((unsigned long long)faces.size() * (t + 1) / m_numThreads);
+		binTriangles(t, begin, end, faces);
+	});
+
+	// 3. rasterize tiles, handed out dynamically since their cost varies a lot
+	std::atomic< unsigned > nextTile(0);
+	const unsigned numTiles = m_tilesX * m_tilesY;
+	runOnThreads(m_numThreads, [&]( unsigned )
+	{
+		for (unsigned tile = nextTile++; tile < numTiles; tile = nextTile++)
+		{
+			rasterizeTile(tile, faces);
+		}
+	});
+}
+
+void SoftwareRasterizer::transformVertices( unsigned begin, unsigned end, const vector< Vector3f >& vertices,
+	const float* view, const float* projection )
+{
+	// matrices are column major: m[ col * 4 + row ]
+	for (unsigned i = begin; i < end; i++)
+	{
+		const float* v = vertices[i];
+		ScreenVertex& s = m_screenVertices[i];
+
+		for (int r = 0; r < 3; r++)
+		{
+			s.eye[r] = view[r] * v[0] + view[4 + r] * v[1] + view[8 + r] * v[2] + view[12 + r];
+		}
+
+		float clip[ 4 ];
+		for (int r = 0; r < 4; r++)
+		{
+			clip[r] = projection[r] * s.eye[0] + projection[4 + r] * s.eye[1] + projection[8 + r] * s.eye[2] + projection[12 + r];
+		}
+
+		s.invW = (clip[3] > kNearW) ? 1.0f / clip[3] : 0.0f;
+		s.x = (clip[0] * s.invW * 0.5f + 0.5f) * m_width;
+		s.y = (clip[1] * s.invW * 0.5f + 0.5f) * m_height;
+		s.z = clip[2] * s.invW;
+	}
+}
+
+void SoftwareRasterizer::binTriangles( unsigned thread, unsigned begin, unsigned end, const vector< Tuple3u >& faces )
+{
+	vector< vector< unsigned > >& bins = m_bins[thread];
+	for (unsigned tile = 0; tile < bins.size(); tile++)
+	{
+		bins[tile].clear();
+	}
+
+	for (unsigned t = begin; t < end; t++)
+	{
+		const ScreenVertex& a = m_screenVertices[faces[t][0]];
+		const ScreenVertex& b = m_screenVertices[faces[t][1]];
+		const ScreenVertex& c = m_screenVertices[faces[t][2]];
+
+		// behind or crossing the near plane
+		if (a.invW == 0 || b.invW == 0 || c.invW == 0)
+		{
+			continue;
+		}
+
+		// face normal in eye space, like Mesh::draw()
+		const float e1[ 3 ] = { b.eye[0] - a.eye[0], b.eye[1] - a.eye[1], b.eye[2] - a.eye[2] };
+		const float e2[ 3 ] = { c.eye[0] - a.eye[0], c.eye[1] - a.eye[1], c.eye[2] - a.eye[2] };
+		float* n = &m_faceNormals[3 * t];
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0)
+		{
+			continue;
+		}
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+
+		// screen bounding box --> covered tiles
+		const float minX = std::min(a.x, std::min(b.x, c.x));
+		const float maxX = std::max(a.x, std::max(b.x, c.x));
+		const float minY = std::min(a.y, std::min(b.y, c.y));
+		const float maxY = std::max(a.y, std::max(b.y, c.y));
+		if (maxX < 0 || maxY < 0 || minX >= m_width || minY >= m_height)
+		{
+			continue;
+		}
+
+		const int tileX0 = std::max(0, (int)minX / kTileSize);
+		const int tileX1 = std::min(m_tilesX - 1, (int)maxX / kTileSize);
+		const int tileY0 = std::max(0, (int)minY / kTileSize);
+		const int tileY1 = std::min(m_tilesY - 1, (int)maxY / kTileSize);
+
+		for (int ty = tileY0; ty <= tileY1; ty++)
+		{
+			for (int tx = tileX0; tx <= tileX1; tx++)
+			{
+				bins[ty * m_tilesX + tx].push_back(t);
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::rasterizeTile( unsigned tile, const vector< Tuple3u >& faces )
+{
+	const int x0 = (tile % m_tilesX) * kTileSize;
+	const int y0 = (tile / m_tilesX) * kTileSize;
+	const int x1 = std::min(x0 + (int)kTileSize, m_width);
+	const int y1 = std::min(y0 + (int)kTileSize, m_height);
+
+	// clear this tile
+	for (int y = y0; y < y1; y++)
+	{
+		std::fill(m_color.begin() + 3 * (y * m_width + x0), m_color.begin() + 3 * (y * m_width + x1), (unsigned char)0);
+		std::fill(m_depth.begin() + y * m_width + x0, m_depth.begin() + y * m_width + x1, FLT_MAX);
+	}
+
+	for (unsigned thread = 0; thread < m_numThreads; thread++)
+	{
+		const vector< unsigned >& bin = m_bins[thread][tile];
+
+		for (unsigned i = 0; i < bin.size(); i++)
+		{
+			const unsigned t = bin[i];
+			const ScreenVertex& a = m_screenVertices[faces[t][0]];
+			const ScreenVertex& b = m_screenVertices[faces[t][1]];
+			const ScreenVertex& c = m_screenVertices[faces[t][2]];
+			const float* n = &m_faceNormals[3 * t];
+
+			float area = edge(a.x, a.y, b.x, b.y, c.x, c.y);
+			if (area == 0)
+			{
+				continue;
+			}
+			// both windings are drawn (no culling in ModelerView either)
+			const float sign = (area > 0) ? 1.0f : -1.0f;
+			const float invArea = 1.0f / (area * sign);
+
+			// triangle bounding box clipped to the tile
+			const int minX = std::max(x0, (int)floorf(std::min(a.x, std::min(b.x, c.x))));
+			const int maxX = std::min(x1 - 1, (int)ceilf(std::max(a.x, std::max(b.x, c.x))));
+			const int minY = std::max(y0, (int)floorf(std::min(a.y, std::min(b.y, c.y))));
+			const int maxY = std::min(y1 - 1, (int)ceilf(std::max(a.y, std::max(b.y, c.y))));
+
+			for (int y = minY; y <= maxY; y++)
+			{
+				const float py = y + 0.5f;
+				for (int x = minX; x <= maxX; x++)
+				{
+					const float px = x + 0.5f;
+
+					// barycentric weights, positive inside
+					const float w0 = sign * edge(b.x, b.y, c.x, c.y, px, py);
+					const float w1 = sign * edge(c.x, c.y, a.x, a.y, px, py);
+					const float w2 = sign * edge(a.x, a.y, b.x, b.y, px, py);
+					if (w0 < 0 || w1 < 0 || w2 < 0)
+					{
+						continue;
+					}
+
+					const float b0 = w0 * invArea;
+					const float b1 = w1 * invArea;
+					const float b2 = w2 * invArea;
+
+					// NDC depth is affine in screen space
+					const float z = b0 * a.z + b1 * b.z + b2 * c.z;
+					float& depth = m_depth[y * m_width + x];
+					if (z >= depth)
+					{
+						continue;
+					}
+					depth = z;
+
+					// eye position needs perspective correct weights
+					const float p0 = b0 * a.invW;
+					const float p1 = b1 * b.invW;
+					const float p2 = b2 * c.invW;
+					const float invSum = 1.0f / (p0 + p1 + p2);
+					const float p[ 3 ] =
+					{
+						(p0 * a.eye[0] + p1 * b.eye[0] + p2 * c.eye[0]) * invSum,
+						(p0 * a.eye[1] + p1 * b.eye[1] + p2 * c.eye[1]) * invSum,
+						(p0 * a.eye[2] + p1 * b.eye[2] + p2 * c.eye[2]) * invSum
+					};
+
+					const unsigned char grey = shade(n, p);
+					unsigned char* rgb = &m_color[3 * (y * m_width + x)];
+					rgb[0] = rgb[1] = rgb[2] = grey;
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::save( const char* filename ) const
+{
+	// writeBMP() takes non-const pointers and reads whole 4-byte padded rows
+	std::string name = filename;
+	std::vector< unsigned char > pixels(m_color.size() + 3);
+	std::copy(m_color.begin(), m_color.end(), pixels.begin());
+	writeBMP(&name[0], m_width, m_height, &pixels[0]);
+}
@@ -0,0 +1,69 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <vector>
+#include <vecmath.h>
+
+#include "Mesh.h"
+
+// CPU renderer for machines without a GPU or a display.
+//
+// Draws a triangle mesh the way ModelerView::draw() does: the same view
+// and projection matrices, one white point light at (3, 3, 5) in eye
+// space and the same grey Phong material, lit per pixel with the face
+// normal (like Mesh::draw()). Triangles are binned into 64x64 pixel
+// tiles and the tiles are rasterized in parallel, each with its own
+// slice of the depth buffer, so no locking is needed.
+class SoftwareRasterizer
+{
+public:
+
+	// numThreads = 0 uses one thread per hardware thread
+	SoftwareRasterizer( int width, int height, unsigned numThreads = 0 );
+
+	void render( const std::vector< Vector3f >& vertices, const std::vector< Tuple3u >& faces,
+		const Matrix4f& viewMatrix, const Matrix4f& projectionMatrix );
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+
+	// RGB, rows from bottom to top (the layout glReadPixels returns)
+	const unsigned char* pixels() const { return &m_color[ 0 ]; }
+
+	// Writes the last rendered image with writeBMP()
+	void save( const char* filename ) const;
+
+private:
+
+	enum { kTileSize = 64 };
+
+	struct ScreenVertex
+	{
+		float x, y;     // window coordinates in pixels
+		float z;        // normalized device depth
+		float invW;     // 1 / clip w, for perspective correct interpolation
+		float eye[ 3 ]; // eye space position
+	};
+
+	void transformVertices( unsigned begin, unsigned end, const std::vector< Vector3f >& vertices,
+		const float* view, const float* projection );
+	void binTriangles( unsigned thread, unsigned begin, unsigned end, const std::vector< Tuple3u >& faces );
+	void rasterizeTile( unsigned tile, const std::vector< Tuple3u >& faces );
+
+	int m_width;
+	int m_height;
+	int m_tilesX;
+	int m_tilesY;
+	unsigned m_numThreads;
+
+	std::vector< unsigned char > m_color;
+	std::vector< float > m_depth;
+
+	std::vector< ScreenVertex > m_screenVertices;
+	// eye space unit face normal per triangle
+	std::vector< float > m_faceNormals;
+	// m_bins[ thread ][ tile ] = triangles binned by that thread
+	std::vector< std::vector< std::vector< unsigned > > > m_bins;
+};
+
+#endif // SOFTWARE_RASTERIZER_H
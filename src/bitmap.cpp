@@ -94,8 +94,12 @@ unsigned char *readBMP(char *fname, int &width, int &height)
     return data;
 }
 
-void writeBMP(char *iname, int width, int height, unsigned char *data)
+bool writeBMP(char *iname, int width, int height, unsigned char *data)
 {
+    // Local headers so frames can be written from several threads
+    BMP_BITMAPFILEHEADER bmfh;
+    BMP_BITMAPINFOHEADER bmih;
+
     int bytes, pad;
     bytes = width * 3;
     pad = (bytes % 4) ? 4 - (bytes % 4) : 0;
@@ -125,6 +129,8 @@ void writeBMP(char *iname, int width, int height, unsigned char *data)
 
     // "w+b", not "wb" -- Eugene
     FILE *foo = fopen(iname, "w+b");
+    if (foo == NULL)
+	return false;
 
     //      fwrite(&bmfh, sizeof(BMP_BITMAPFILEHEADER), 1, foo);
     fwrite(&(bmfh.bfType), 2, 1, foo);
@@ -149,5 +155,7 @@ void writeBMP(char *iname, int width, int height, unsigned char *data)
 
     delete[]scanline;
 
-    fclose(foo);
+    // fwrite() errors are sticky, checked once here
+    const bool written = !ferror(foo);
+    return fclose(foo) == 0 && written;
 }
@@ -40,7 +40,8 @@ typedef struct
 
 // global I/O routines
 extern unsigned char *readBMP (char *fname, int &width, int &height);
-extern void writeBMP (char *iname, int width, int height,
+// returns false if the file could not be written
+extern bool writeBMP (char *iname, int width, int height,
                       unsigned char *data);
 
 #endif
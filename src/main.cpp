@@ -17,6 +17,7 @@
 
 #include "modelerapp.h"
 #include "ModelerView.h"
+#include "JointNames.h"
 
 using namespace std;
 
@@ -24,8 +25,21 @@ int main( int argc, char* argv[] )
 {
 	if( argc < 2 )
 	{
-		cout << "Usage: " << argv[ 0 ] << " PREFIX" << endl;
+		cout << "Usage: " << argv[ 0 ] << " PREFIX [-optimize] [-quantize8 | -quantize16] [-quantizepos] [-lod] [-psd] [-morph FILE] [-normals] [-cache FILE] [-bvh FILE MAP] [-ring NAME]..." << endl;
 		cout << "For example, if you're trying to load data/cheb.skel, data/cheb.obj, and data/cheb.attach, run with: " << argv[ 0 ] << " data/cheb" << endl;
+		cout << "PREFIX can also be a .glb or .gltf file with a skinned mesh." << endl;
+		cout << "  -optimize   reorder the mesh for vertex cache and skinning locality" << endl;
+		cout << "  -quantize8  skin from 4 influences with 8 bit weights (-quantize16: 16 bit)" << endl;
+		cout << "  -quantizepos  also store bind positions as 16 bit offsets in the AABB" << endl;
+		cout << "  -lod        switch to coarser meshes when the model is small on screen" << endl;
+		cout << "  -psd        add the pose-space corrective shapes in PREFIX.correctives" << endl;
+		cout << "  -morph FILE add a morph target (an OBJ with the mesh's vertices moved) with a slider" << endl;
+		cout << "  -normals    shade smoothly with vertex normals skinned along with the positions" << endl;
+		cout << "  -cache FILE play back a point cache baked by skinbake ('c' on/off, 'p' play/pause, arrows scrub)" << endl;
+		cout << "  -bvh FILE MAP  play the BVH motion FILE on the joints named in the joint map MAP ('m' play/pause)" << endl;
+		cout << "  -ring NAME  publish every skinned frame of the mesh to the shared memory ring NAME (see skinringreader)" << endl;
+		cout << "In the viewer, Ctrl + left click selects the joint or mesh vertex under the cursor." << endl;
+		cout << "Shift + left drag then moves a selected joint by turning its parent and grandparent." << endl;
 		return -1;
 	}
 
@@ -39,26 +53,44 @@ int main( int argc, char* argv[] )
     // - step size for slider
     // - initial slider value
 
-	const int NUM_JOINTS = 18;
+	const int NUM_JOINTS = kNumRigJoints;
 
-	ModelerControl controls[ NUM_JOINTS*3 ];
-	string jointNames[NUM_JOINTS]={ "Root", "Chest", "Waist", "Neck", "Right hip", "Right leg", "Right knee", "Right foot", "Left hip", "Left leg", "Left knee", "Left foot", "Right collarbone", "Right shoulder", "Right elbow", "Left collarbone", "Left shoulder", "Left elbow" };
+	// morph target files, loaded by ModelerView::loadModel()
+	vector< string > morphTargetFiles;
+	for( int i = 2; i + 1 < argc; i++ )
+	{
+		if( string( argv[ i ] ) == "-morph" )
+		{
+			morphTargetFiles.push_back( argv[ ++i ] );
+		}
+	}
+
+	vector< ModelerControl > controls( NUM_JOINTS*3 + morphTargetFiles.size() );
 	for(unsigned int i = 0; i < NUM_JOINTS; i++)
 	{
 		char buf[255];
-		sprintf(buf, "%s X", jointNames[i].c_str());
+		sprintf(buf, "%s X", kRigJointNames[i]);
 		controls[i*3] = ModelerControl(buf, -M_PI, M_PI, 0.1f, 0);
-		sprintf(buf, "%s Y", jointNames[i].c_str());
+		sprintf(buf, "%s Y", kRigJointNames[i]);
 		controls[i*3+1] = ModelerControl(buf, -M_PI, M_PI, 0.1f, 0);
-		sprintf(buf, "%s Z", jointNames[i].c_str());
+		sprintf(buf, "%s Z", kRigJointNames[i]);
 		controls[i*3+2] = ModelerControl(buf, -M_PI, M_PI, 0.1f, 0);
 	}
 
+	// one weight slider per morph target, after the joints
+	for( unsigned int i = 0; i < morphTargetFiles.size(); i++ )
+	{
+		string name = morphTargetFiles[ i ];
+		name = name.substr( name.find_last_of( "/\\" ) + 1 );
+		name = name.substr( 0, name.find_last_of( '.' ) );
+		controls[NUM_JOINTS*3 + i] = ModelerControl(("Morph " + name).c_str(), 0, 1, 0.01f, 0);
+	}
+
     ModelerApplication::Instance()->Init
 	(
 		argc, argv,
-		controls,
-		NUM_JOINTS*3
+		&controls[ 0 ],
+		controls.size()
 	);
 
     // Run the modeler application.
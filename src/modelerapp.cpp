@@ -149,6 +149,9 @@ int ModelerApplication::Run()
     Fl::visual(FL_RGB | FL_DOUBLE);
     m_ui->show();
 
+    // Start the redraw loop used while animating
+    Fl::add_timeout(0, ModelerApplication::RedrawLoop, NULL);
+
     return Fl::run();
 }
 
@@ -191,3 +194,13 @@ void ModelerApplication::SliderCallback(Fl_Slider *, void *)
 	ModelerApplication::Instance()->m_ui->m_modelerView->update();
     ModelerApplication::Instance()->m_ui->m_modelerView->redraw();
 }
+
+void ModelerApplication::RedrawLoop(void*)
+{
+    // Redraw at the target frame rate while Animate is enabled
+    // (every redraw is also captured while recording frames)
+    if (ModelerApplication::Instance()->m_animating)
+	ModelerApplication::Instance()->m_ui->m_modelerView->redraw();
+
+    Fl::repeat_timeout(1.0 / 30.0, ModelerApplication::RedrawLoop, NULL);
+}
@@ -50,6 +50,46 @@ void ModelerUserInterface::cb_Save(Fl_Menu_* o, void* v) {
   ((ModelerUserInterface*)(o->parent()->user_data()))->cb_Save_i(o,v);
 }
 
+inline void ModelerUserInterface::cb_m_controlsRecordMenu_i(Fl_Menu_*, void*) {
+  if (m_modelerView->m_recorder.recording())
+{
+	m_modelerView->make_current();
+	m_modelerView->m_recorder.stop();
+}
+else
+{
+	char *filename = NULL;
+	filename = fl_file_chooser("Record Frames (name.bmp or name.ppm)", "*.{bmp,ppm}", NULL);
+
+	if (filename)
+	{
+		// name_00000.bmp, name_00001.bmp, ...
+		std::string prefix = filename;
+		std::string extension = "bmp";
+		size_t dot = prefix.rfind('.');
+		if (dot != std::string::npos && dot > prefix.find_last_of("/\\") + 1)
+		{
+			extension = prefix.substr(dot + 1);
+			prefix = prefix.substr(0, dot);
+		}
+		if (extension != "ppm")
+		{
+			extension = "bmp";
+		}
+
+		m_modelerView->m_recorder.start(prefix, extension);
+	}
+};
+
+if (m_modelerView->m_recorder.recording())
+	m_controlsRecordMenu->set();
+else
+	m_controlsRecordMenu->clear();
+}
+void ModelerUserInterface::cb_m_controlsRecordMenu(Fl_Menu_* o, void* v) {
+  ((ModelerUserInterface*)(o->parent()->user_data()))->cb_m_controlsRecordMenu_i(o,v);
+}
+
 inline void ModelerUserInterface::cb_Open_i(Fl_Menu_*, void*) {
   char *filename = NULL;
 	filename = fl_file_chooser("Open .pos File", "*.pos", NULL);
@@ -122,7 +162,8 @@ void ModelerUserInterface::cb_m_controlsAnimOnMenu(Fl_Menu_* o, void* v) {
 
 Fl_Menu_Item ModelerUserInterface::menu_m_controlsMenuBar[] = {
  {"File", 0,  0, 0, 64, 0, 0, 14, 56},
- {"Save Bitmap File", 0,  (Fl_Callback*)ModelerUserInterface::cb_Save, 0, 128, 0, 0, 14, 56},
+ {"Save Bitmap File", 0,  (Fl_Callback*)ModelerUserInterface::cb_Save, 0, 0, 0, 0, 14, 56},
+ {"Record Frames", 0,  (Fl_Callback*)ModelerUserInterface::cb_m_controlsRecordMenu, 0, 130, 0, 0, 14, 56},
  {"Open Position File", 0,  (Fl_Callback*)ModelerUserInterface::cb_Open, 0, 0, 0, 0, 14, 56},
  {"Save Position File", 0,  (Fl_Callback*)ModelerUserInterface::cb_Save1, 0, 128, 0, 0, 14, 56},
  {"Exit", 0,  (Fl_Callback*)ModelerUserInterface::cb_Exit, 0, 0, 0, 0, 14, 56},
@@ -132,7 +173,8 @@ Fl_Menu_Item ModelerUserInterface::menu_m_controlsMenuBar[] = {
  {0,0,0,0,0,0,0,0,0},
  {0,0,0,0,0,0,0,0,0}
 };
-Fl_Menu_Item* ModelerUserInterface::m_controlsAnimOnMenu = ModelerUserInterface::menu_m_controlsMenuBar + 7;
+Fl_Menu_Item* ModelerUserInterface::m_controlsRecordMenu = ModelerUserInterface::menu_m_controlsMenuBar + 2;
+Fl_Menu_Item* ModelerUserInterface::m_controlsAnimOnMenu = ModelerUserInterface::menu_m_controlsMenuBar + 8;
 
 inline void ModelerUserInterface::cb_m_controlsBrowser_i(Fl_Browser*, void*) {
   for (int i=0; i<ModelerApplication::Instance()->m_numControls; i++) {
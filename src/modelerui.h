@@ -30,6 +30,11 @@ public:
 private:
   inline void cb_Save_i(Fl_Menu_*, void*);
   static void cb_Save(Fl_Menu_*, void*);
+public:
+  static Fl_Menu_Item *m_controlsRecordMenu;
+private:
+  inline void cb_m_controlsRecordMenu_i(Fl_Menu_*, void*);
+  static void cb_m_controlsRecordMenu(Fl_Menu_*, void*);
   inline void cb_Open_i(Fl_Menu_*, void*);
   static void cb_Open(Fl_Menu_*, void*);
   inline void cb_Save1_i(Fl_Menu_*, void*);
@@ -0,0 +1,149 @@
+// Offline point cache baking.
+//
+// Plays the multi-frame pose file POSES through SkeletalModel, setting the
+// joints and skinning the full mesh as the viewer does every frame, and
+// writes each deformed mesh to the point cache OUTPUT (see PointCache.h),
+// which the viewer plays back with -cache OUTPUT instead of skinning.
+// The cache records the baked vertex order, and the viewer refuses it
+// if run with a different -optimize than the bake.
+// Then reads the cache back, in order and in random order as when
+// scrubbing, and reports the cost per frame against skinning it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "PoseStream.h"
+#include "PointCache.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+// Decodes the frames of cache in the given order, returning the mean
+// milliseconds per frame.
+static double timePlayback( const PointCache& cache, const vector< unsigned >& order, vector< Vector3f >& vertices )
+{
+	Clock::time_point start = Clock::now();
+	for( unsigned f = 0; f < order.size(); f++ )
+	{
+		cache.readFrame( order[ f ], vertices );
+	}
+	return millisecondsSince( start ) / order.size();
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 4 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX POSES OUTPUT [-optimize]" << endl;
+		cout << "Skins every frame of the multi-frame pose file POSES with the rig PREFIX.skel/.obj/.attach" << endl;
+		cout << "and writes the deformed meshes to the point cache OUTPUT." << endl;
+		return -1;
+	}
+
+	string prefix = argv[ 1 ];
+	string skeletonFile = prefix + ".skel";
+	string meshFile = prefix + ".obj";
+	string attachmentsFile = prefix + ".attach";
+
+	LoadOptions options;
+	options.optimizeMeshLayout = ( argc > 4 && strcmp( argv[ 4 ], "-optimize" ) == 0 );
+
+	SkeletalModel model;
+	model.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str(), options );
+
+	PoseStreamReader reader( argv[ 2 ], model.numJoints() );
+	PointCacheWriter writer( argv[ 3 ], model.numVertices(), model.meshLayoutHash() );
+	if( !reader.isOpen() || !writer.isOpen() )
+	{
+		return -1;
+	}
+
+	double skinningTime = 0;
+	Clock::time_point start = Clock::now();
+
+	vector< Vector3f > pose;
+	while( reader.readFrame( pose ) )
+	{
+		Clock::time_point skinStart = Clock::now();
+		for( unsigned j = 0; j < pose.size(); j++ )
+		{
+			model.setJointTransform( j, pose[ j ].x(), pose[ j ].y(), pose[ j ].z() );
+		}
+		model.updateCurrentJointToWorldTransforms();
+		model.updateMesh();
+		skinningTime += millisecondsSince( skinStart );
+
+		if( !writer.write( model.mesh().currentVertices ) )
+		{
+			return -1;
+		}
+	}
+
+	const unsigned frames = writer.framesWritten();
+	if( !writer.finish() || frames == 0 )
+	{
+		cerr << "Error: No frames baked [in main()]!" << endl;
+		// PointCache::open() would reject the empty cache anyway
+		remove( argv[ 3 ] );
+		return -1;
+	}
+
+	cout << frames << " frames baked in " << millisecondsSince( start ) / 1000.0 << " s, " << writer.bytesWritten() << " bytes ("
+		<< writer.bytesWritten() / frames << " per frame, " << model.numVertices() * 12 << " uncompressed)" << endl;
+
+	PointCache cache;
+	if( !cache.open( argv[ 3 ] ) )
+	{
+		return -1;
+	}
+	if( cache.numVertices() != model.numVertices() || cache.layoutHash() != model.meshLayoutHash() )
+	{
+		cerr << "Error: The cache read back does not match the baked mesh [in main()]!" << endl;
+		cache.close();
+		remove( argv[ 3 ] );
+		return -1;
+	}
+
+	// the last frame against the mesh skinned for it
+	vector< Vector3f > vertices;
+	cache.readFrame( frames - 1, vertices );
+	float maxError = 0;
+	for( unsigned i = 0; i < vertices.size(); i++ )
+	{
+		maxError = max( maxError, ( vertices[ i ] - model.mesh().currentVertices[ i ] ).abs() );
+	}
+	Vector3f boxMin, boxMax;
+	model.computeInstanceBounds( boxMin, boxMax );
+	cout << "max error of the last frame: " << maxError / ( boxMax - boxMin ).abs() << " of the bounding box diagonal" << endl;
+
+	// twice in order, the first pass paging the file in
+	vector< unsigned > order( frames );
+	for( unsigned f = 0; f < frames; f++ )
+	{
+		order[ f ] = f;
+	}
+	timePlayback( cache, order, vertices );
+	const double sequentialTime = timePlayback( cache, order, vertices );
+
+	std::shuffle( order.begin(), order.end(), mt19937( 1 ) );
+	const double randomTime = timePlayback( cache, order, vertices );
+
+	const double skinningFrameTime = skinningTime / frames;
+	cout << "per frame: skinning " << skinningFrameTime << " ms, playback " << sequentialTime << " ms in order ("
+		<< model.numVertices() * 12 / sequentialTime / 1e6 << " GB/s decoded), " << randomTime << " ms in random order" << endl;
+
+	return 0;
+}
@@ -0,0 +1,156 @@
+// Deformation benchmark.
+//
+// Skins PREFIX in a sequence of random poses three ways: positions only
+// (the viewer's default), and positions, vertex normals and the mesh box
+// with one pass over the vertices for each of them or with the fused pass
+// (see SkeletalModel::updateMesh()). Prints the cost per frame of each and
+// checks that the two ways of computing all three agree.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "GltfImport.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+// angles of the random poses, in radians
+static const float kPoseAngle = 0.5f;
+
+static void setPose( SkeletalModel& model, const vector< Vector3f >& pose )
+{
+	for( unsigned j = 0; j < pose.size(); j++ )
+	{
+		model.setJointTransform( j, pose[ j ].x(), pose[ j ].y(), pose[ j ].z() );
+	}
+	model.updateCurrentJointToWorldTransforms();
+}
+
+// Skins every pose and returns the mean milliseconds per frame.
+static double timeFrames( SkeletalModel& model, const vector< vector< Vector3f > >& poses )
+{
+	Clock::time_point start = Clock::now();
+	for( unsigned f = 0; f < poses.size(); f++ )
+	{
+		setPose( model, poses[ f ] );
+		model.updateMesh();
+	}
+	return millisecondsSince( start ) / poses.size();
+}
+
+static float maxDistance( const vector< Vector3f >& a, const vector< Vector3f >& b )
+{
+	float distance = 0;
+	for( unsigned i = 0; i < a.size(); i++ )
+	{
+		distance = max( distance, ( a[ i ] - b[ i ] ).abs() );
+	}
+	return distance;
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX [-frames N]" << endl;
+		cout << "Times skinning PREFIX.skel/.obj/.attach with and without fusing the positions, normals and bounds." << endl;
+		cout << "PREFIX can also be a .glb or .gltf file with a skinned mesh." << endl;
+		return -1;
+	}
+
+	string prefix = argv[ 1 ];
+	string skeletonFile = prefix + ".skel";
+	string meshFile = prefix + ".obj";
+	string attachmentsFile = prefix + ".attach";
+	if( isGltfFile( prefix.c_str() ) )
+	{
+		skeletonFile = meshFile = attachmentsFile = prefix;
+	}
+
+	unsigned numFrames = 200;
+	if( argc > 3 && strcmp( argv[ 2 ], "-frames" ) == 0 )
+	{
+		numFrames = max( 1, atoi( argv[ 3 ] ) );
+	}
+
+	SkeletalModel positionsOnly;
+	positionsOnly.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str() );
+
+	LoadOptions options;
+	options.skinNormals = true;
+	SkeletalModel model;
+	model.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str(), options );
+
+	mt19937 random( 1 );
+	uniform_real_distribution< float > angle( -kPoseAngle, kPoseAngle );
+	vector< vector< Vector3f > > poses( numFrames, vector< Vector3f >( model.numJoints() ) );
+	for( unsigned f = 0; f < numFrames; f++ )
+	{
+		for( unsigned j = 0; j < model.numJoints(); j++ )
+		{
+			poses[ f ][ j ] = Vector3f( angle( random ), angle( random ), angle( random ) );
+		}
+	}
+
+	// warm up the caches and the palettes once
+	setPose( positionsOnly, poses[ 0 ] );
+	positionsOnly.updateMesh();
+	setPose( model, poses[ 0 ] );
+	model.updateMesh();
+
+	cout << model.numVertices() << " vertices, " << numFrames << " frames" << endl;
+
+	const double positionsTime = timeFrames( positionsOnly, poses );
+	cout << "positions only:                     " << positionsTime << " ms per frame" << endl;
+
+	model.setFusedSkinning( false );
+	const double separateTime = timeFrames( model, poses );
+	cout << "positions, normals, box, separate:  " << separateTime << " ms per frame" << endl;
+
+	model.setFusedSkinning( true );
+	const double fusedTime = timeFrames( model, poses );
+	cout << "positions, normals, box, fused:     " << fusedTime << " ms per frame ("
+		<< separateTime / fusedTime << "x)" << endl;
+
+	// Both ways in the last pose, and the box against the vertices and the
+	// conservative instance bounds
+	const Mesh& mesh = model.mesh();
+	Vector3f fusedMin, fusedMax;
+	model.meshBounds( fusedMin, fusedMax );
+	const vector< Vector3f > fusedVertices = mesh.currentVertices;
+	const vector< Vector3f > fusedNormals = mesh.currentNormals;
+
+	model.setFusedSkinning( false );
+	model.updateMesh();
+	Vector3f separateMin, separateMax;
+	model.meshBounds( separateMin, separateMax );
+
+	Vector3f instanceMin, instanceMax;
+	model.computeInstanceBounds( instanceMin, instanceMax );
+	bool inside = true;
+	for( int c = 0; c < 3; c++ )
+	{
+		inside = inside && instanceMin[ c ] <= fusedMin[ c ] && fusedMax[ c ] <= instanceMax[ c ];
+	}
+
+	cout << "fused vs separate: positions " << maxDistance( fusedVertices, mesh.currentVertices )
+		<< ", normals " << maxDistance( fusedNormals, mesh.currentNormals )
+		<< ", box " << max( ( fusedMin - separateMin ).abs(), ( fusedMax - separateMax ).abs() ) << endl;
+	cout << "positions vs positions only: " << maxDistance( fusedVertices, positionsOnly.mesh().currentVertices ) << endl;
+	cout << "box " << ( inside ? "inside" : "NOT inside" ) << " the instance bounds, diagonal "
+		<< ( fusedMax - fusedMin ).abs() << " vs " << ( instanceMax - instanceMin ).abs() << endl;
+
+	return 0;
+}
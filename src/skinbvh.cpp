@@ -0,0 +1,116 @@
+// BVH motion capture import.
+//
+// Reads the Biovision BVH file BVH frame by frame (see BvhReader.h), maps
+// its joints to the rig's with the joint map MAP, and writes the rig's
+// joint angles per frame to the multi-frame pose file OUTPUT, which
+// skinbake and skinstream play back. The viewer plays BVH files directly
+// with -bvh BVH MAP.
+// Reports the parse throughput, and the cost of seeking back and forward.
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BvhReader.h"
+#include "JointNames.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 4 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " BVH MAP OUTPUT" << endl;
+		cout << "Converts the BVH motion BVH to the multi-frame pose file OUTPUT, driving the rig joints" << endl;
+		cout << "named in the joint map MAP (lines of \"Rig joint name = BVH joint name\")." << endl;
+		return -1;
+	}
+
+	Clock::time_point start = Clock::now();
+	BvhReader bvh;
+	if( !bvh.open( argv[ 1 ] ) )
+	{
+		return -1;
+	}
+	const double headerTime = millisecondsSince( start );
+
+	vector< string > rigJointNames( kRigJointNames, kRigJointNames + kNumRigJoints );
+	vector< int > bvhJoints;
+	loadBvhJointMap( argv[ 2 ], bvh, rigJointNames, bvhJoints );
+
+	ofstream output( argv[ 3 ] );
+	if( !output )
+	{
+		cerr << "Error: File could not be opened [in main()]!" << endl;
+		return -1;
+	}
+
+	cout << bvh.numJoints() << " joints, " << bvh.numChannels() << " channels, " << bvh.numFrames() << " frames declared, "
+		<< bvh.frameTime() << " s per frame, hierarchy read in " << headerTime << " ms" << endl;
+
+	// parsing alone, then parsing, retargeting and writing
+	vector< float > channels;
+	start = Clock::now();
+	while( bvh.readFrame( channels ) )
+	{
+	}
+	const double parseTime = millisecondsSince( start );
+	const unsigned frames = bvh.nextFrame();
+
+	bvh.seekFrame( 0 );
+	vector< Quat4f > rotations;
+	start = Clock::now();
+	for( unsigned f = 0; bvh.readFrame( channels ); f++ )
+	{
+		retargetBvhFrame( bvh, bvhJoints, channels, rotations );
+		output << "frame " << f << "\n";
+		for( unsigned j = 0; j < bvhJoints.size(); j++ )
+		{
+			if( bvhJoints[ j ] < 0 )
+			{
+				continue;
+			}
+			const Vector3f angles = rigJointAngles( rotations[ j ] );
+			for( int axis = 0; axis < 3; axis++ )
+			{
+				output << j * 3 + axis << " " << angles[ axis ] << "\n";
+			}
+		}
+	}
+	output.close();
+	const double convertTime = millisecondsSince( start );
+
+	if( frames == 0 )
+	{
+		cerr << "Error: No frames read [in main()]!" << endl;
+		return -1;
+	}
+	if( frames != bvh.numFrames() )
+	{
+		cerr << "Warning: " << frames << " frames read, " << bvh.numFrames() << " declared" << endl;
+	}
+
+	// every frame start is known now: seeking is a lookup
+	start = Clock::now();
+	for( unsigned f = 0; f < frames; f += 97 )
+	{
+		bvh.seekFrame( f );
+		bvh.readFrame( channels );
+	}
+	const double seekTime = millisecondsSince( start ) / ( ( frames + 96 ) / 97 );
+
+	const double megabytes = bvh.fileSize() / 1e6;
+	cout << frames << " frames parsed in " << parseTime << " ms (" << megabytes / ( parseTime / 1000.0 ) << " MB/s), converted in "
+		<< convertTime << " ms; seek and read of one frame " << seekTime * 1000.0 << " us" << endl;
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+// Load generator for the skinning service.
+//
+// Connects to a skinserver on the Unix domain socket SOCKET, asks it for
+// its rigs, then runs -clients N connections at once, each sending
+// -requests M random poses of rig -rig R one after the other and waiting
+// for every response (a closed loop). Reports the throughput and the
+// request latency percentiles; with -shutdown, stops the server at the end.
+// Needs only SkinProtocol.h.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "SkinProtocol.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+static int connectTo( const char* path )
+{
+	sockaddr_un address;
+	const int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( fd < 0 || !skinSocketAddress( path, address ) ||
+		connect( fd, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) != 0 )
+	{
+		cerr << "Error: Could not connect to " << path << ": " << strerror( errno ) << " [in connectTo()]!" << endl;
+		if( fd >= 0 )
+		{
+			close( fd );
+		}
+		return -1;
+	}
+	return fd;
+}
+
+// Sends a request with payload and reads the response header.
+static bool request( int fd, unsigned type, unsigned rig, unsigned count, const void* payload, size_t size,
+	SkinResponseHeader& response )
+{
+	const SkinRequestHeader header = { kSkinRequestMagic, type, rig, count };
+	return writeFully( fd, &header, sizeof( header ) ) && ( size == 0 || writeFully( fd, payload, size ) ) &&
+		readFully( fd, &response, sizeof( response ) ) && response.magic == kSkinResponseMagic;
+}
+
+// Runs one client's closed loop, appending each request's latency in ms.
+// Returns false on the first failed request.
+static bool runClient( const char* path, unsigned rig, unsigned numJoints, unsigned numVertices, unsigned numRequests,
+	unsigned seed, vector< double >& latencies )
+{
+	const int fd = connectTo( path );
+	if( fd < 0 )
+	{
+		return false;
+	}
+
+	std::mt19937 random( seed );
+	std::uniform_real_distribution< float > angle( -0.5f, 0.5f );
+	vector< float > pose( 3 * numJoints );
+	vector< float > vertices( 3 * numVertices );
+
+	bool ok = true;
+	for( unsigned i = 0; i < numRequests && ok; i++ )
+	{
+		for( unsigned k = 0; k < pose.size(); k++ )
+		{
+			pose[ k ] = angle( random );
+		}
+
+		Clock::time_point start = Clock::now();
+		SkinResponseHeader response;
+		ok = request( fd, kSkinPose, rig, numJoints, &pose[ 0 ], pose.size() * sizeof( float ), response ) &&
+			response.status == kSkinOk && response.count == numVertices &&
+			readFully( fd, &vertices[ 0 ], vertices.size() * sizeof( float ) );
+		latencies.push_back( millisecondsSince( start ) );
+	}
+	if( !ok )
+	{
+		cerr << "Error: A skin request failed [in runClient()]!" << endl;
+	}
+
+	close( fd );
+	return ok;
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " SOCKET [-clients N] [-requests M] [-rig R] [-shutdown]" << endl;
+		cout << "Sends M random poses of rig R from each of N connections to the skinserver on SOCKET" << endl;
+		cout << "and reports throughput and latency; -shutdown stops the server afterwards." << endl;
+		return -1;
+	}
+
+	unsigned numClients = 1;
+	unsigned numRequests = 200;
+	unsigned rig = 0;
+	bool stopServer = false;
+	for( int i = 2; i < argc; i++ )
+	{
+		if( strcmp( argv[ i ], "-clients" ) == 0 && i + 1 < argc )
+		{
+			numClients = max( 1, atoi( argv[ ++i ] ) );
+		}
+		else if( strcmp( argv[ i ], "-requests" ) == 0 && i + 1 < argc )
+		{
+			numRequests = max( 1, atoi( argv[ ++i ] ) );
+		}
+		else if( strcmp( argv[ i ], "-rig" ) == 0 && i + 1 < argc )
+		{
+			rig = max( 0, atoi( argv[ ++i ] ) );
+		}
+		else if( strcmp( argv[ i ], "-shutdown" ) == 0 )
+		{
+			stopServer = true;
+		}
+	}
+
+	const int fd = connectTo( argv[ 1 ] );
+	if( fd < 0 )
+	{
+		return -1;
+	}
+	SkinResponseHeader response;
+	if( !request( fd, kSkinInfo, 0, 0, NULL, 0, response ) || response.status != kSkinOk )
+	{
+		cerr << "Error: No answer to the info request [in main()]!" << endl;
+		return -1;
+	}
+	vector< unsigned > sizes( 2 * response.count );
+	if( !sizes.empty() && !readFully( fd, &sizes[ 0 ], sizes.size() * sizeof( unsigned ) ) )
+	{
+		cerr << "Error: Truncated info response [in main()]!" << endl;
+		return -1;
+	}
+	for( unsigned r = 0; r < response.count; r++ )
+	{
+		cout << "rig " << r << ": " << sizes[ 2 * r ] << " joints, " << sizes[ 2 * r + 1 ] << " vertices" << endl;
+	}
+	if( rig >= response.count )
+	{
+		cerr << "Error: The server has no rig " << rig << " [in main()]!" << endl;
+		return -1;
+	}
+	const unsigned numJoints = sizes[ 2 * rig ];
+	const unsigned numVertices = sizes[ 2 * rig + 1 ];
+
+	vector< vector< double > > latencies( numClients );
+	vector< char > succeeded( numClients, 0 );
+	vector< std::thread > clients;
+	Clock::time_point start = Clock::now();
+	for( unsigned c = 0; c < numClients; c++ )
+	{
+		clients.push_back( std::thread( [&, c]() {
+			succeeded[ c ] = runClient( argv[ 1 ], rig, numJoints, numVertices, numRequests, c + 1, latencies[ c ] );
+		} ) );
+	}
+	for( unsigned c = 0; c < numClients; c++ )
+	{
+		clients[ c ].join();
+	}
+	const double seconds = millisecondsSince( start ) / 1000.0;
+
+	vector< double > all;
+	for( unsigned c = 0; c < numClients; c++ )
+	{
+		all.insert( all.end(), latencies[ c ].begin(), latencies[ c ].end() );
+	}
+	sort( all.begin(), all.end() );
+	if( !all.empty() )
+	{
+		double sum = 0;
+		for( unsigned i = 0; i < all.size(); i++ )
+		{
+			sum += all[ i ];
+		}
+		const double megabytes = double( all.size() ) * numVertices * 3 * sizeof( float ) / ( 1024.0 * 1024.0 );
+		cout << all.size() << " requests from " << numClients << " clients in " << seconds << " s: "
+			<< all.size() / seconds << " requests/s, " << megabytes / seconds << " MB/s of vertices" << endl;
+		cout << "latency (ms): mean " << sum / all.size() << ", p50 " << all[ all.size() / 2 ]
+			<< ", p90 " << all[ all.size() * 9 / 10 ] << ", p99 " << all[ all.size() * 99 / 100 ]
+			<< ", max " << all.back() << endl;
+	}
+
+	if( stopServer )
+	{
+		request( fd, kSkinShutdown, 0, 0, NULL, 0, response );
+	}
+	close( fd );
+
+	return count( succeeded.begin(), succeeded.end(), 1 ) == int( numClients ) ? 0 : -1;
+}
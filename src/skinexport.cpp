@@ -0,0 +1,72 @@
+// Binary glTF export.
+//
+// Loads the rig PREFIX.skel/.obj/.attach and writes it to OUTPUT as a .glb
+// (see GltfExport.h): the skeleton as nodes, the mesh with 4 joint
+// influences per vertex, and, if a multi-frame pose file POSES is given,
+// its frames as an animation at FPS frames per second (30 by default).
+// Reports the time taken by the export alone.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "PoseStream.h"
+#include "GltfExport.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 3 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX OUTPUT [POSES [FPS]]" << endl;
+		cout << "Writes the rig PREFIX.skel/.obj/.attach to the binary glTF file OUTPUT," << endl;
+		cout << "with the frames of the multi-frame pose file POSES as an animation." << endl;
+		return -1;
+	}
+
+	string prefix = argv[ 1 ];
+	string skeletonFile = prefix + ".skel";
+	string meshFile = prefix + ".obj";
+	string attachmentsFile = prefix + ".attach";
+
+	SkeletalModel model;
+	model.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str() );
+
+	vector< vector< Vector3f > > poses;
+	if( argc > 3 )
+	{
+		PoseStreamReader reader( argv[ 3 ], model.numJoints() );
+		if( !reader.isOpen() )
+		{
+			return -1;
+		}
+		vector< Vector3f > pose;
+		while( reader.readFrame( pose ) )
+		{
+			poses.push_back( pose );
+		}
+	}
+	const float framesPerSecond = ( argc > 4 ) ? atof( argv[ 4 ] ) : 30.0f;
+
+	Clock::time_point start = Clock::now();
+	if( !saveGlb( argv[ 2 ], model, poses, 1.0f / framesPerSecond ) )
+	{
+		return -1;
+	}
+
+	cout << "exported " << model.numJoints() << " joints, " << model.numVertices() << " vertices, " << model.mesh().faces.size()
+		<< " faces and " << poses.size() << " frames in " << millisecondsSince( start ) << " ms" << endl;
+
+	return 0;
+}
@@ -0,0 +1,247 @@
+// Inverse kinematics benchmark.
+//
+// Poses a batch of characters of PREFIX.skel at random and gives each one
+// goal per limb: a leaf joint, moved by its parent and grandparent, with a
+// target taken from another random pose of that limb so it can be reached.
+// Solves the batch with CCD and FABRIK, on one thread and on all of them,
+// and prints the cost per goal and how well the solves converged, then
+// how close the results get for smaller iteration budgets.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "InverseKinematics.h"
+#include "Parallel.h"
+#include "SkeletalModel.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+// joints each limb goal may rotate
+static const unsigned kChainJoints = 2;
+
+// angles of the random poses, in radians
+static const float kPoseAngle = 0.5f;
+static const float kLimbAngle = 1.0f;
+
+// convergence tolerance relative to the skeleton's size
+static const float kTolerance = 1e-3f;
+
+struct Summary
+{
+	double meanIterations;
+	double meanDistance;
+	float maxDistance;
+	double converged; // fraction within tolerance
+};
+
+static Summary summarize( const vector< InverseKinematics::Task >& tasks, float tolerance )
+{
+	Summary summary = { 0, 0, 0, 0 };
+	unsigned count = 0;
+	for( unsigned t = 0; t < tasks.size(); t++ )
+	{
+		for( unsigned g = 0; g < tasks[ t ].results.size(); g++ )
+		{
+			const InverseKinematics::Result& result = tasks[ t ].results[ g ];
+			summary.meanIterations += result.iterations;
+			summary.meanDistance += result.distance;
+			summary.maxDistance = max( summary.maxDistance, result.distance );
+			summary.converged += ( result.distance <= tolerance );
+			count++;
+		}
+	}
+	summary.meanIterations /= count;
+	summary.meanDistance /= count;
+	summary.converged /= count;
+	return summary;
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX [-characters N] [-iterations N] [-threads N]" << endl;
+		cout << "Benchmarks the CCD and FABRIK solvers on limb goals for random poses of PREFIX.skel." << endl;
+		return -1;
+	}
+
+	unsigned numCharacters = 10000;
+	unsigned maxIterations = 32;
+	unsigned numThreads = 0;
+	for( int i = 2; i + 1 < argc; i++ )
+	{
+		if( strcmp( argv[ i ], "-characters" ) == 0 )
+		{
+			numCharacters = atoi( argv[ ++i ] );
+		}
+		else if( strcmp( argv[ i ], "-iterations" ) == 0 )
+		{
+			maxIterations = atoi( argv[ ++i ] );
+		}
+		else if( strcmp( argv[ i ], "-threads" ) == 0 )
+		{
+			numThreads = atoi( argv[ ++i ] );
+		}
+	}
+	if( numThreads == 0 )
+	{
+		numThreads = defaultThreadCount();
+	}
+
+	string skeletonFile = string( argv[ 1 ] ) + ".skel";
+	SkeletalModel model;
+	model.loadSkeleton( skeletonFile.c_str() );
+	const unsigned numJoints = model.numJoints();
+	if( numJoints == 0 )
+	{
+		cerr << "Error: No joints in " << skeletonFile << " [in main()]!" << endl;
+		return -1;
+	}
+
+	vector< int > parents( numJoints );
+	vector< Vector3f > offsets( numJoints );
+	vector< bool > isLeaf( numJoints, true );
+	float size = 0;
+	for( unsigned j = 0; j < numJoints; j++ )
+	{
+		parents[ j ] = model.jointParent( j );
+		offsets[ j ] = model.jointOffset( j );
+		if( parents[ j ] >= 0 )
+		{
+			isLeaf[ parents[ j ] ] = false;
+			size += offsets[ j ].abs();
+		}
+	}
+
+	InverseKinematics ik;
+	ik.setSkeleton( parents, offsets );
+	const float tolerance = kTolerance * size;
+
+	// limbs: leaves and up to kChainJoints ancestors below the root
+	vector< unsigned > effectors, bases;
+	for( unsigned j = 0; j < numJoints; j++ )
+	{
+		const unsigned base = ik.chainBase( j, kChainJoints );
+		if( !isLeaf[ j ] || base == j )
+		{
+			continue;
+		}
+		effectors.push_back( j );
+		bases.push_back( base );
+	}
+
+	mt19937 random( 1 );
+	uniform_real_distribution< float > poseAngle( -kPoseAngle, kPoseAngle );
+	uniform_real_distribution< float > limbAngle( -kLimbAngle, kLimbAngle );
+
+	vector< vector< Vector3f > > startPoses( numCharacters, vector< Vector3f >( numJoints ) );
+	vector< InverseKinematics::Task > startTasks( numCharacters );
+	for( unsigned c = 0; c < numCharacters; c++ )
+	{
+		vector< Vector3f >& pose = startPoses[ c ];
+		for( unsigned j = 0; j < numJoints; j++ )
+		{
+			pose[ j ] = Vector3f( poseAngle( random ), poseAngle( random ), poseAngle( random ) );
+		}
+
+		vector< Vector3f > targetPose = pose;
+		for( unsigned l = 0; l < effectors.size(); l++ )
+		{
+			for( int j = parents[ effectors[ l ] ]; ; j = parents[ j ] )
+			{
+				targetPose[ j ] = Vector3f( limbAngle( random ), limbAngle( random ), limbAngle( random ) );
+				if( j == (int)bases[ l ] )
+				{
+					break;
+				}
+			}
+
+			InverseKinematics::Goal goal = { bases[ l ], effectors[ l ], ik.jointPosition( targetPose, effectors[ l ] ) };
+			startTasks[ c ].goals.push_back( goal );
+		}
+	}
+
+	const double numGoals = double( numCharacters ) * effectors.size();
+	cout << numCharacters << " characters, " << effectors.size() << " limb goals each, up to " << maxIterations
+		<< " iterations, tolerance " << tolerance << " (" << kTolerance << " of the skeleton)" << endl;
+
+	const char* names[ 2 ] = { "CCD", "FABRIK" };
+	const InverseKinematics::Method methods[ 2 ] = { InverseKinematics::kCCD, InverseKinematics::kFABRIK };
+	for( int m = 0; m < 2; m++ )
+	{
+		cout << names[ m ] << ":" << endl;
+
+		vector< vector< Vector3f > > poses;
+		vector< InverseKinematics::Task > tasks;
+		const unsigned threadCounts[ 2 ] = { 1, numThreads };
+		for( int t = 0; t < ( numThreads > 1 ? 2 : 1 ); t++ )
+		{
+			poses = startPoses;
+			tasks = startTasks;
+			for( unsigned c = 0; c < numCharacters; c++ )
+			{
+				tasks[ c ].jointAngles = &poses[ c ];
+			}
+
+			Clock::time_point start = Clock::now();
+			ik.solve( methods[ m ], tasks, maxIterations, tolerance, threadCounts[ t ] );
+			const double milliseconds = millisecondsSince( start );
+			cout << "  " << threadCounts[ t ] << " threads: " << milliseconds << " ms, "
+				<< 1000.0 * milliseconds / numGoals << " us per goal" << endl;
+		}
+
+		const Summary summary = summarize( tasks, tolerance );
+		cout << "  " << 100.0 * summary.converged << "% converged, mean " << summary.meanIterations << " iterations, distance mean "
+			<< summary.meanDistance / size << " max " << summary.maxDistance / size << " of the skeleton" << endl;
+
+		// The angles drive SkeletalModel like the sliders do.
+		float maxDisagreement = 0;
+		for( unsigned c = 0; c < min( numCharacters, 100u ); c++ )
+		{
+			for( unsigned j = 0; j < numJoints; j++ )
+			{
+				const Vector3f& r = poses[ c ][ j ];
+				model.setJointTransform( j, r.x(), r.y(), r.z() );
+			}
+			model.updateCurrentJointToWorldTransforms();
+			for( unsigned g = 0; g < tasks[ c ].goals.size(); g++ )
+			{
+				const InverseKinematics::Goal& goal = tasks[ c ].goals[ g ];
+				const float distance = ( model.jointPosition( goal.effectorJoint ) - goal.target ).abs();
+				maxDisagreement = max( maxDisagreement, fabs( distance - tasks[ c ].results[ g ].distance ) );
+			}
+		}
+		cout << "  SkeletalModel agrees with the reported distances to " << maxDisagreement / size << " of the skeleton" << endl;
+
+		// convergence by budget
+		cout << "  by budget:";
+		for( unsigned budget = 1; budget < maxIterations; budget *= 2 )
+		{
+			poses = startPoses;
+			tasks = startTasks;
+			for( unsigned c = 0; c < numCharacters; c++ )
+			{
+				tasks[ c ].jointAngles = &poses[ c ];
+			}
+			ik.solve( methods[ m ], tasks, budget, tolerance, numThreads );
+
+			const Summary budgetSummary = summarize( tasks, tolerance );
+			cout << " " << budget << ": " << 100.0 * budgetSummary.converged << "% (" << budgetSummary.meanDistance / size << ")";
+		}
+		cout << endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,119 @@
+// Offline level of detail generation.
+//
+// Simplifies PREFIX.obj with its skinning weights into coarser meshes and
+// writes them next to the rig as PREFIX.lod1.obj / PREFIX.lod1.attach,
+// PREFIX.lod2.obj, ..., which the viewer loads with -lod instead of
+// simplifying at startup. Then reports, for a test pose, how far each
+// skinned level is from the skinned full mesh.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "MeshSimplifier.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX [-levels N]" << endl;
+		cout << "Writes N (default 3) simplified levels of detail of PREFIX.obj/.attach" << endl;
+		cout << "to PREFIX.lod1.obj/.attach, PREFIX.lod2.obj/.attach, ..." << endl;
+		return -1;
+	}
+
+	string prefix = argv[ 1 ];
+	string skeletonFile = prefix + ".skel";
+	string meshFile = prefix + ".obj";
+	string attachmentsFile = prefix + ".attach";
+
+	unsigned numLevels = 3;
+	if( argc > 3 && strcmp( argv[ 2 ], "-levels" ) == 0 )
+	{
+		numLevels = atoi( argv[ 3 ] );
+	}
+
+	SkeletalModel model;
+	model.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str() );
+
+	// Each level is simplified from the previous one to a quarter of its faces
+	Mesh finer = model.levelOfDetailMesh( 0 );
+	for( unsigned level = 1; level <= numLevels; level++ )
+	{
+		Mesh coarser;
+		Clock::time_point start = Clock::now();
+		simplifyMesh( finer, finer.faces.size() / 4, coarser );
+		const double milliseconds = millisecondsSince( start );
+
+		coarser.save( levelOfDetailFileName( meshFile, level ).c_str() );
+		coarser.saveAttachments( levelOfDetailFileName( attachmentsFile, level ).c_str() );
+
+		cout << "level " << level << ": " << coarser.bindVertices.size() << " vertices, "
+			<< coarser.faces.size() << " faces, simplified in " << milliseconds << " ms" << endl;
+
+		finer = coarser;
+	}
+
+	// Reload with the files just written and compare in a test pose
+	LoadOptions options;
+	options.levelsOfDetail = numLevels;
+	SkeletalModel withLevels;
+	withLevels.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str(), options );
+
+	for( unsigned j = 0; j < withLevels.numJoints(); j++ )
+	{
+		withLevels.setJointTransform( j, 0.5f, 0.3f * ( j % 3 ), -0.4f );
+	}
+	withLevels.updateCurrentJointToWorldTransforms();
+
+	Vector3f boxMin, boxMax;
+	withLevels.computeInstanceBounds( boxMin, boxMax );
+	const float size = ( boxMax - boxMin ).abs();
+
+	cout << "distance of skinned vertices to the skinned full mesh in a test pose"
+		<< " (relative to the bounding box diagonal):" << endl;
+
+	// level 0 last, so the full mesh and its BVH are current for the queries
+	for( unsigned level = withLevels.numLevelsOfDetail(); level-- > 0; )
+	{
+		withLevels.setLevelOfDetail( level );
+		Clock::time_point start = Clock::now();
+		withLevels.updateMesh();
+		cout << "level " << level << ": skinned " << withLevels.levelOfDetailMesh( level ).bindVertices.size()
+			<< " vertices in " << millisecondsSince( start ) << " ms" << endl;
+	}
+
+	const Mesh& full = withLevels.levelOfDetailMesh( 0 );
+	for( unsigned level = 1; level < withLevels.numLevelsOfDetail(); level++ )
+	{
+		const vector< Vector3f >& vertices = withLevels.levelOfDetailMesh( level ).currentVertices;
+		float maxDistance = 0;
+		double sumDistance = 0;
+		for( unsigned i = 0; i < vertices.size(); i++ )
+		{
+			MeshBVH::ClosestPoint closest;
+			if( withLevels.meshBVH().closestPoint( full.currentVertices, vertices[ i ], closest ) )
+			{
+				maxDistance = max( maxDistance, closest.distance );
+				sumDistance += closest.distance;
+			}
+		}
+		cout << "level " << level << ": max " << maxDistance / size << ", mean "
+			<< ( vertices.empty() ? 0 : sumDistance / vertices.size() / size ) << endl;
+	}
+
+	return 0;
+}
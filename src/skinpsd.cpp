@@ -0,0 +1,312 @@
+// Offline baking of pose-space corrective shapes.
+//
+// For every joint below the root, poses the rig with only that joint bent
+// by each of kBendAngles about each of its local axes, both ways, and stores
+// as a corrective shape the bind space offsets that take linear blend skinning
+// to dual quaternion skinning (Kavan et al., "Skinning with Dual
+// Quaternions"), which keeps the volume of bent joints and twists. The
+// shapes are written to PREFIX.correctives for the viewer's -psd option.
+// Then compares both skinnings, with and without the correctives, in poses
+// between the sampled ones.
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+// Bends of the sampled poses. The error of linear blend skinning grows
+// faster than linearly with the bend, so one sample per direction
+// overcorrects smaller bends. Their spacing is the radius of the linear
+// kernel, so each shape fades out at the neighbouring samples.
+static const int kNumBends = 2;
+static const float kBendAngles[ kNumBends ] = { 0.25f * M_PI, 0.5f * M_PI };
+static const float kKernelRadius = 0.25f * M_PI;
+
+// offsets shorter than this fraction of the bounding box diagonal are dropped
+static const float kMinOffset = 1e-4f;
+
+// Rigid transform as a unit dual quaternion real + eps * dual
+struct DualQuaternion
+{
+	Quat4f real;
+	Quat4f dual;
+};
+
+static DualQuaternion toDualQuaternion( const Matrix4f& m )
+{
+	DualQuaternion q;
+	q.real = Quat4f::fromRotationMatrix( m.getSubmatrix3x3( 0, 0 ) );
+	q.real.normalize();
+	q.dual = 0.5f * ( Quat4f( 0, m( 0, 3 ), m( 1, 3 ), m( 2, 3 ) ) * q.real );
+	return q;
+}
+
+// Dual quaternion skinning of mesh for one pose
+static void skinDualQuaternions( const Mesh& mesh, const vector< Matrix4f >& palette, vector< Vector3f >& skinned )
+{
+	vector< DualQuaternion > transforms( palette.size() );
+	for( unsigned j = 0; j < palette.size(); j++ )
+	{
+		transforms[ j ] = toDualQuaternion( palette[ j ] );
+	}
+
+	skinned.resize( mesh.bindVertices.size() );
+	for( unsigned i = 0; i < mesh.bindVertices.size(); i++ )
+	{
+		const vector< float >& weights = mesh.attachments[ i ];
+
+		// blend in the hemisphere of the most weighted joint
+		unsigned pivot = 0;
+		for( unsigned j = 1; j < weights.size(); j++ )
+		{
+			if( weights[ j ] > weights[ pivot ] )
+			{
+				pivot = j;
+			}
+		}
+
+		Quat4f real( 0, 0, 0, 0 );
+		Quat4f dual( 0, 0, 0, 0 );
+		for( unsigned j = 0; j < weights.size(); j++ )
+		{
+			if( weights[ j ] == 0 )
+			{
+				continue;
+			}
+			const float w = ( Quat4f::dot( transforms[ j ].real, transforms[ pivot ].real ) < 0 ) ? -weights[ j ] : weights[ j ];
+			real = real + w * transforms[ j ].real;
+			dual = dual + w * transforms[ j ].dual;
+		}
+
+		const float length = real.abs();
+		real = ( 1.0f / length ) * real;
+		dual = ( 1.0f / length ) * dual;
+
+		const Vector3f translation = 2.0f * ( dual * real.conjugated() ).xyz();
+		skinned[ i ] = Matrix3f::rotation( real ) * mesh.bindVertices[ i ] + translation;
+	}
+}
+
+// Prints the distances of both models' skinned meshes to dual quaternion
+// skinning over the poses, relative to size.
+static void compare( const string& name, const vector< vector< Vector3f > >& poses,
+	const SkeletalModel& plain, const SkeletalModel& corrected, float size )
+{
+	vector< vector< Vector3f > > withoutCorrectives, withCorrectives;
+	plain.skinPoses( poses, withoutCorrectives );
+	corrected.skinPoses( poses, withCorrectives );
+
+	float maxWithout = 0, maxWith = 0;
+	double sumWithout = 0, sumWith = 0;
+	vector< Matrix4f > palette;
+	vector< Vector3f > reference;
+	for( unsigned k = 0; k < poses.size(); k++ )
+	{
+		plain.computePosePalette( poses[ k ], palette );
+		skinDualQuaternions( plain.mesh(), palette, reference );
+
+		for( unsigned i = 0; i < reference.size(); i++ )
+		{
+			const float without = ( withoutCorrectives[ k ][ i ] - reference[ i ] ).abs() / size;
+			const float with = ( withCorrectives[ k ][ i ] - reference[ i ] ).abs() / size;
+			maxWithout = max( maxWithout, without );
+			maxWith = max( maxWith, with );
+			sumWithout += without;
+			sumWith += with;
+		}
+	}
+
+	const double count = double( poses.size() ) * plain.numVertices();
+	cout << name << " (" << poses.size() << " poses):" << endl;
+	cout << "  without correctives: max " << maxWithout << ", mean " << sumWithout / count << endl;
+	cout << "  with correctives:    max " << maxWith << ", mean " << sumWith / count << endl;
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX" << endl;
+		cout << "Bakes corrective shapes taking PREFIX.skel/.obj/.attach from linear blend to" << endl;
+		cout << "dual quaternion skinning and writes them to PREFIX.correctives." << endl;
+		return -1;
+	}
+
+	string prefix = argv[ 1 ];
+	string skeletonFile = prefix + ".skel";
+	string meshFile = prefix + ".obj";
+	string attachmentsFile = prefix + ".attach";
+	string correctivesFile = prefix + ".correctives";
+
+	SkeletalModel model;
+	model.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str() );
+
+	const Mesh& mesh = model.mesh();
+	const unsigned numJoints = model.numJoints();
+	const unsigned numVertices = model.numVertices();
+
+	Vector3f boxMin, boxMax;
+	model.computeInstanceBounds( boxMin, boxMax );
+	const float size = ( boxMax - boxMin ).abs();
+
+	// joint 0 is the root, which moves the whole mesh rigidly
+	Clock::time_point start = Clock::now();
+	vector< vector< Vector3f > > poses;
+	vector< unsigned > poseJoints;
+	for( unsigned j = 1; j < numJoints; j++ )
+	{
+		for( int axis = 0; axis < 3; axis++ )
+		{
+			for( int sign = -1; sign <= 1; sign += 2 )
+			{
+				for( int bend = 0; bend < kNumBends; bend++ )
+				{
+					vector< Vector3f > pose( numJoints, Vector3f( 0, 0, 0 ) );
+					pose[ j ][ axis ] = sign * kBendAngles[ bend ];
+					poses.push_back( pose );
+					poseJoints.push_back( j );
+				}
+			}
+		}
+	}
+
+	vector< vector< Vector3f > > linear;
+	model.skinPoses( poses, linear );
+
+	PoseCorrectives correctives;
+	vector< Matrix4f > palette;
+	vector< Vector3f > reference;
+	for( unsigned k = 0; k < poses.size(); k++ )
+	{
+		model.computePosePalette( poses[ k ], palette );
+		skinDualQuaternions( mesh, palette, reference );
+
+		vector< unsigned > vertices;
+		vector< Vector3f > offsets;
+		for( unsigned i = 0; i < numVertices; i++ )
+		{
+			const Vector3f difference = reference[ i ] - linear[ k ][ i ];
+			if( difference.abs() < kMinOffset * size )
+			{
+				continue;
+			}
+
+			// bind space offset d with sum_j w_j R_j d = difference
+			Matrix3f blended( 0.0f );
+			const vector< float >& weights = mesh.attachments[ i ];
+			for( unsigned j = 0; j < numJoints; j++ )
+			{
+				if( weights[ j ] != 0 )
+				{
+					Matrix3f rotation = palette[ j ].getSubmatrix3x3( 0, 0 );
+					for( int r = 0; r < 3; r++ )
+					{
+						for( int c = 0; c < 3; c++ )
+						{
+							blended( r, c ) += weights[ j ] * rotation( r, c );
+						}
+					}
+				}
+			}
+
+			bool singular = false;
+			const Matrix3f inverse = blended.inverse( &singular, 1e-6f );
+			if( !singular )
+			{
+				vertices.push_back( i );
+				offsets.push_back( inverse * difference );
+			}
+		}
+
+		if( !vertices.empty() && !correctives.addShape( poseJoints[ k ], PoseCorrectives::kLinear, kKernelRadius,
+			poses[ k ][ poseJoints[ k ] ], vertices, offsets ) )
+		{
+			return -1;
+		}
+	}
+	const double bakeMilliseconds = millisecondsSince( start );
+
+	correctives.save( correctivesFile.c_str() );
+	cout << "baked " << correctives.numShapes() << " shapes from " << poses.size() << " poses in " << bakeMilliseconds << " ms: "
+		<< correctives.numOffsets() << " stored offsets (dense: " << correctives.numShapes() * numVertices << ")" << endl;
+	cout << "wrote " << correctivesFile << endl;
+
+	// Compare against dual quaternion skinning with and without the
+	// correctives: the sampled poses, single joints bent between the
+	// samples, then random poses of all joints.
+	LoadOptions options;
+	options.correctivesFile = correctivesFile;
+	SkeletalModel corrected;
+	corrected.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str(), options );
+
+	cout << "distance to dual quaternion skinning, relative to the bounding box diagonal:" << endl;
+
+	compare( "sampled poses", poses, model, corrected, size );
+
+	vector< vector< Vector3f > > betweenPoses = poses;
+	for( unsigned k = 0; k < betweenPoses.size(); k++ )
+	{
+		betweenPoses[ k ][ poseJoints[ k ] ] = 0.75f * betweenPoses[ k ][ poseJoints[ k ] ];
+	}
+	compare( "single joints bent 3/4 as far", betweenPoses, model, corrected, size );
+
+	mt19937 random( 1 );
+	uniform_real_distribution< float > angle( -kBendAngles[ 0 ], kBendAngles[ 0 ] );
+	vector< vector< Vector3f > > testPoses( 20, vector< Vector3f >( numJoints, Vector3f( 0, 0, 0 ) ) );
+	for( unsigned k = 0; k < testPoses.size(); k++ )
+	{
+		for( unsigned j = 1; j < numJoints; j++ )
+		{
+			testPoses[ k ][ j ] = Vector3f( angle( random ), angle( random ), angle( random ) );
+		}
+	}
+
+	compare( "random poses", testPoses, model, corrected, size );
+
+	// Cost of the correction layer in updateMesh()
+	const int kRepeats = 20;
+	double plainMilliseconds = 0, correctedMilliseconds = 0;
+	for( unsigned k = 0; k < testPoses.size(); k++ )
+	{
+		for( unsigned j = 0; j < numJoints; j++ )
+		{
+			const Vector3f& r = testPoses[ k ][ j ];
+			model.setJointTransform( j, r.x(), r.y(), r.z() );
+			corrected.setJointTransform( j, r.x(), r.y(), r.z() );
+		}
+		model.updateCurrentJointToWorldTransforms();
+		corrected.updateCurrentJointToWorldTransforms();
+
+		start = Clock::now();
+		for( int n = 0; n < kRepeats; n++ )
+		{
+			model.updateMesh();
+		}
+		plainMilliseconds += millisecondsSince( start );
+
+		start = Clock::now();
+		for( int n = 0; n < kRepeats; n++ )
+		{
+			corrected.updateMesh();
+		}
+		correctedMilliseconds += millisecondsSince( start );
+	}
+	const double runs = double( testPoses.size() ) * kRepeats;
+	cout << "updateMesh(): " << plainMilliseconds / runs << " ms without correctives, "
+		<< correctedMilliseconds / runs << " ms with" << endl;
+
+	return 0;
+}
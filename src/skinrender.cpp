@@ -0,0 +1,121 @@
+// Headless rendering with the CPU rasterizer: no GPU or display needed.
+//
+// Renders the rig in its bind pose, or every frame of a multi-frame pose
+// file, with the viewer's default camera and lighting, and writes BMPs.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "SoftwareRasterizer.h"
+#include "PoseStream.h"
+#include "camera.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 3 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX OUTPUT.bmp [-poses FILE] [-size W H] [-threads N]" << endl;
+		cout << "Renders PREFIX.skel/.obj/.attach without a display. With -poses every frame" << endl;
+		cout << "of the pose file is rendered to OUTPUT_00000.bmp, OUTPUT_00001.bmp, ..." << endl;
+		return -1;
+	}
+
+	string prefix = argv[ 1 ];
+	string output = argv[ 2 ];
+	const char* posesFile = NULL;
+	int width = 1920;
+	int height = 1080;
+	unsigned numThreads = 0;
+
+	for( int i = 3; i < argc; i++ )
+	{
+		if( strcmp( argv[ i ], "-poses" ) == 0 && i + 1 < argc )
+		{
+			posesFile = argv[ ++i ];
+		}
+		else if( strcmp( argv[ i ], "-size" ) == 0 && i + 2 < argc )
+		{
+			width = max( 1, atoi( argv[ ++i ] ) );
+			height = max( 1, atoi( argv[ ++i ] ) );
+		}
+		else if( strcmp( argv[ i ], "-threads" ) == 0 && i + 1 < argc )
+		{
+			// 0 for the default
+			numThreads = max( 0, atoi( argv[ ++i ] ) );
+		}
+		else
+		{
+			cerr << "Warning: unknown option " << argv[ i ] << endl;
+		}
+	}
+
+	SkeletalModel model;
+	model.load( ( prefix + ".skel" ).c_str(), ( prefix + ".obj" ).c_str(), ( prefix + ".attach" ).c_str() );
+
+	// Same camera as a freshly opened ModelerView
+	Camera camera;
+	camera.SetDimensions( width, height );
+	camera.SetDistance( 2 );
+	camera.SetCenter( Vector3f( 0.5, 0.5, 0.5 ) );
+	camera.SetViewport( 0, 0, width, height );
+	camera.SetPerspective( 50.0f );
+
+	SoftwareRasterizer rasterizer( width, height, numThreads );
+
+	if( posesFile == NULL )
+	{
+		rasterizer.render( model.mesh().currentVertices, model.mesh().faces, camera.viewMatrix(), camera.projectionMatrix() );
+		rasterizer.save( output.c_str() );
+		return 0;
+	}
+
+	PoseStreamReader reader( posesFile, model.numJoints() );
+	if( !reader.isOpen() )
+	{
+		return -1;
+	}
+
+	if( output.size() > 4 && output.compare( output.size() - 4, 4, ".bmp" ) == 0 )
+	{
+		output.resize( output.size() - 4 );
+	}
+
+	vector< Vector3f > pose;
+	unsigned frame = 0;
+	double renderTime = 0;
+
+	while( reader.readFrame( pose ) )
+	{
+		for( unsigned j = 0; j < pose.size(); j++ )
+		{
+			model.setJointTransform( j, pose[ j ].x(), pose[ j ].y(), pose[ j ].z() );
+		}
+		model.updateCurrentJointToWorldTransforms();
+		model.updateMesh();
+
+		Clock::time_point start = Clock::now();
+		rasterizer.render( model.mesh().currentVertices, model.mesh().faces, camera.viewMatrix(), camera.projectionMatrix() );
+		renderTime += std::chrono::duration< double >( Clock::now() - start ).count();
+
+		char filename[ 1024 ];
+		snprintf( filename, sizeof( filename ), "%s_%05u.bmp", output.c_str(), frame );
+		rasterizer.save( filename );
+		frame++;
+	}
+
+	cout << frame << " frames at " << width << "x" << height << ", "
+		<< ( frame ? 1000.0 * renderTime / frame : 0 ) << " ms per frame to rasterize" << endl;
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+// Shared memory frame ring throughput test.
+//
+// Loads the rig PREFIX (PREFIX.skel/.obj/.attach, or a .glb or .gltf
+// file), creates the frame ring NAME (see FrameRing.h) and skins -frames N
+// random poses with SkeletalModel::updateMesh() three ways: without the
+// ring, publishing every frame to it, and publishing the last frame again
+// without skinning. Prints the cost per frame of each, so the cost of
+// publishing shows. Run skinringreader NAME alongside to measure the
+// readers' side; -wait S gives them S seconds to attach first, and -fps F
+// paces the publishing passes.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "GltfImport.h"
+#include "FrameRing.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+// angles of the random poses, in radians
+static const float kPoseAngle = 0.5f;
+
+static void setPose( SkeletalModel& model, const vector< Vector3f >& pose )
+{
+	for( unsigned j = 0; j < pose.size(); j++ )
+	{
+		model.setJointTransform( j, pose[ j ].x(), pose[ j ].y(), pose[ j ].z() );
+	}
+	model.updateCurrentJointToWorldTransforms();
+}
+
+// Runs frame( f ) for every frame, paced to framesPerSecond if it is not
+// zero, and returns the mean milliseconds per frame spent in it.
+template< typename Frame >
+static double timeFrames( unsigned numFrames, double framesPerSecond, Frame frame )
+{
+	double time = 0;
+	Clock::time_point passStart = Clock::now();
+	for( unsigned f = 0; f < numFrames; f++ )
+	{
+		if( framesPerSecond > 0 )
+		{
+			std::this_thread::sleep_until( passStart + std::chrono::duration_cast< Clock::duration >(
+				std::chrono::duration< double >( f / framesPerSecond ) ) );
+		}
+		Clock::time_point start = Clock::now();
+		frame( f );
+		time += millisecondsSince( start );
+	}
+	return time / numFrames;
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 3 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX NAME [-frames N] [-slots N] [-wait S] [-fps F]" << endl;
+		cout << "Skins N random poses of the rig PREFIX.skel/.obj/.attach (or a .glb/.gltf file) and publishes" << endl;
+		cout << "them to the shared memory ring NAME, timing the skinning with and without publishing." << endl;
+		return -1;
+	}
+
+	unsigned numFrames = 1000;
+	unsigned numSlots = 8;
+	double waitSeconds = 0;
+	double framesPerSecond = 0;
+	for( int i = 3; i + 1 < argc; i++ )
+	{
+		if( strcmp( argv[ i ], "-frames" ) == 0 )
+		{
+			numFrames = max( 1, atoi( argv[ ++i ] ) );
+		}
+		else if( strcmp( argv[ i ], "-slots" ) == 0 )
+		{
+			numSlots = max( 2, atoi( argv[ ++i ] ) );
+		}
+		else if( strcmp( argv[ i ], "-wait" ) == 0 )
+		{
+			waitSeconds = atof( argv[ ++i ] );
+		}
+		else if( strcmp( argv[ i ], "-fps" ) == 0 )
+		{
+			framesPerSecond = atof( argv[ ++i ] );
+		}
+	}
+
+	string prefix = argv[ 1 ];
+	const bool gltf = isGltfFile( prefix.c_str() );
+	string skeletonFile = gltf ? prefix : prefix + ".skel";
+	string meshFile = gltf ? prefix : prefix + ".obj";
+	string attachmentsFile = gltf ? prefix : prefix + ".attach";
+
+	SkeletalModel model;
+	model.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str() );
+
+	FrameRingWriter ring;
+	if( !ring.create( argv[ 2 ], model.numVertices(), numSlots ) )
+	{
+		return -1;
+	}
+
+	std::mt19937 random( 1 );
+	std::uniform_real_distribution< float > angle( -kPoseAngle, kPoseAngle );
+	vector< vector< Vector3f > > poses( numFrames, vector< Vector3f >( model.numJoints() ) );
+	for( unsigned f = 0; f < numFrames; f++ )
+	{
+		for( unsigned j = 0; j < model.numJoints(); j++ )
+		{
+			poses[ f ][ j ] = Vector3f( angle( random ), angle( random ), angle( random ) );
+		}
+	}
+
+	const size_t frameBytes = size_t( model.numVertices() ) * 3 * sizeof( float );
+	cout << "ring " << argv[ 2 ] << ": " << numSlots << " slots of " << model.numVertices() << " vertices ("
+		<< frameBytes << " bytes per frame)" << endl;
+	if( waitSeconds > 0 )
+	{
+		std::this_thread::sleep_for( std::chrono::duration< double >( waitSeconds ) );
+	}
+
+	const double skinTime = timeFrames( numFrames, 0, [&]( unsigned f )
+	{
+		setPose( model, poses[ f ] );
+		model.updateMesh();
+	} );
+
+	model.setFrameRing( &ring );
+	const double publishedSkinTime = timeFrames( numFrames, framesPerSecond, [&]( unsigned f )
+	{
+		setPose( model, poses[ f ] );
+		model.updateMesh();
+	} );
+	model.setFrameRing( nullptr );
+
+	const vector< Vector3f >& vertices = model.mesh().currentVertices;
+	const double publishTime = timeFrames( numFrames, framesPerSecond, [&]( unsigned )
+	{
+		ring.publish( vertices );
+	} );
+
+	cout << "skinning:              " << skinTime << " ms per frame" << endl;
+	cout << "skinning + publishing: " << publishedSkinTime << " ms per frame" << endl;
+	cout << "publishing:            " << publishTime << " ms per frame, "
+		<< frameBytes / ( 1024.0 * 1024.0 ) / ( publishTime / 1000.0 ) << " MB/s" << endl;
+	cout << ring.framesPublished() << " frames published" << endl;
+
+	ring.close();
+	return 0;
+}
@@ -0,0 +1,163 @@
+// Example reader of a shared memory frame ring (see FrameRing.h).
+//
+// Follows the ring NAME published by the viewer (-ring NAME) or by
+// skinringbench, reading each new frame in place: it finds the frame's
+// box, the way a renderer would upload it or a recorder would encode it,
+// then checks that the writer did not overwrite the frame meanwhile.
+// Stops after -frames N frames or when the writer closes the ring, and
+// reports the frames read, lost and torn, the read rate and the latency
+// from publishing to the end of reading.
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "FrameRing.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince( Clock::time_point start )
+{
+	return std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+// how long to wait for the writer to create the ring
+static const double kOpenTimeoutSeconds = 10.0;
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " NAME [-frames N]" << endl;
+		cout << "Reads the frames published to the shared memory ring NAME until N have been read" << endl;
+		cout << "or the writer closes it, and reports the read rate and latency." << endl;
+		return -1;
+	}
+
+	unsigned long long maxFrames = 0;
+	for( int i = 2; i + 1 < argc; i++ )
+	{
+		if( strcmp( argv[ i ], "-frames" ) == 0 )
+		{
+			maxFrames = strtoull( argv[ ++i ], NULL, 10 );
+		}
+	}
+
+	FrameRingReader ring;
+	Clock::time_point openStart = Clock::now();
+	while( !ring.open( argv[ 1 ] ) )
+	{
+		if( secondsSince( openStart ) > kOpenTimeoutSeconds )
+		{
+			cerr << "Error: No frame ring " << argv[ 1 ] << " [in main()]!" << endl;
+			return -1;
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+	}
+	const unsigned numVertices = ring.numVertices();
+	const unsigned numSlots = ring.numSlots();
+	cout << "ring " << argv[ 1 ] << ": " << numSlots << " slots of " << numVertices << " vertices" << endl;
+
+	// start with the next frame to be published
+	unsigned long long next = ring.framesPublished();
+	unsigned long long framesRead = 0;
+	unsigned long long framesLost = 0;
+	unsigned long long framesTorn = 0;
+	vector< double > latencies;
+	float boxMin[ 3 ] = { 0, 0, 0 };
+	float boxMax[ 3 ] = { 0, 0, 0 };
+
+	Clock::time_point start;
+	bool started = false;
+	while( maxFrames == 0 || framesRead < maxFrames )
+	{
+		const unsigned long long published = ring.framesPublished();
+		if( next >= published )
+		{
+			if( ring.isClosed() )
+			{
+				break;
+			}
+			std::this_thread::yield();
+			continue;
+		}
+		if( !started )
+		{
+			start = Clock::now();
+			started = true;
+		}
+
+		// frames more than a ring behind are gone, and the writer may
+		// already be filling the slot of the oldest one
+		if( published - next >= numSlots )
+		{
+			framesLost += published - numSlots + 1 - next;
+			next = published - numSlots + 1;
+		}
+
+		const float* vertices = ring.frame( next );
+		if( !vertices )
+		{
+			framesLost++;
+			next++;
+			continue;
+		}
+
+		float lo[ 3 ] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float hi[ 3 ] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for( unsigned i = 0; i < numVertices; i++ )
+		{
+			for( unsigned c = 0; c < 3; c++ )
+			{
+				lo[ c ] = min( lo[ c ], vertices[ 3 * i + c ] );
+				hi[ c ] = max( hi[ c ], vertices[ 3 * i + c ] );
+			}
+		}
+
+		if( ring.isValid( next ) )
+		{
+			const unsigned long long now = std::chrono::duration_cast< std::chrono::nanoseconds >(
+				Clock::now().time_since_epoch() ).count();
+			latencies.push_back( ( now - ring.publishTime( next ) ) * 1e-6 );
+			memcpy( boxMin, lo, sizeof( lo ) );
+			memcpy( boxMax, hi, sizeof( hi ) );
+			framesRead++;
+		}
+		else
+		{
+			framesTorn++;
+		}
+		next++;
+	}
+	const double seconds = framesRead ? secondsSince( start ) : 0;
+
+	cout << framesRead << " frames read, " << framesLost << " lost, " << framesTorn << " torn";
+	if( framesRead > 0 && seconds > 0 )
+	{
+		sort( latencies.begin(), latencies.end() );
+		double sum = 0;
+		for( unsigned i = 0; i < latencies.size(); i++ )
+		{
+			sum += latencies[ i ];
+		}
+		cout << " in " << seconds << " s: " << framesRead / seconds << " frames/s, "
+			<< framesRead * numVertices * 3 * sizeof( float ) / ( 1024.0 * 1024.0 ) / seconds << " MB/s" << endl;
+		cout << "latency (ms): mean " << sum / latencies.size() << ", p50 " << latencies[ latencies.size() / 2 ]
+			<< ", p99 " << latencies[ latencies.size() * 99 / 100 ] << ", max " << latencies.back() << endl;
+		cout << "last box: ( " << boxMin[ 0 ] << " " << boxMin[ 1 ] << " " << boxMin[ 2 ] << " ) to ( "
+			<< boxMax[ 0 ] << " " << boxMax[ 1 ] << " " << boxMax[ 2 ] << " )" << endl;
+	}
+	else
+	{
+		cout << endl;
+	}
+
+	return 0;
+}
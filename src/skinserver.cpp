@@ -0,0 +1,391 @@
+// Skinning service.
+//
+// Keeps the rigs PREFIX... (each PREFIX.skel/.obj/.attach, or a .glb or
+// .gltf file) loaded and serves skin requests from other processes over
+// the Unix domain socket SOCKET (see SkinProtocol.h), so pipeline tools
+// can deform meshes without linking the rig code, FLTK or GL; skinclient
+// is a load generator for it.
+//
+// Each connection has a thread of its own. Requests for one rig that
+// arrive while it is busy are queued and then skinned together, up to
+// -batch N poses at a time, by one pass of SkeletalModel::skinPoses() over
+// the vertices split across -threads N threads. Runs until a client sends
+// a shutdown request, then prints how the requests were batched.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "GltfImport.h"
+#include "Parallel.h"
+#include "SkinProtocol.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+// One rig and the thread that skins its queued poses in batches.
+class RigServer
+{
+public:
+
+	RigServer( const SkeletalModel& model, unsigned maxBatch, unsigned numThreads ) :
+		m_model( model ),
+		m_maxBatch( maxBatch ),
+		m_numThreads( numThreads ),
+		m_stopping( false ),
+		m_requests( 0 ),
+		m_batches( 0 ),
+		m_largestBatch( 0 ),
+		m_skinningTime( 0 )
+	{
+		m_thread = std::thread( [this]() { run(); } );
+	}
+
+	~RigServer()
+	{
+		stop();
+	}
+
+	// Queues pose and waits until it has been skinned into vertices.
+	// The buffers are swapped, not copied. Returns false if the server
+	// stopped first.
+	bool skin( vector< Vector3f >& pose, vector< Vector3f >& vertices )
+	{
+		Pending pending = { &pose, &vertices, false };
+
+		std::unique_lock< std::mutex > lock( m_mutex );
+		if( m_stopping )
+		{
+			return false;
+		}
+		m_pending.push_back( &pending );
+		m_requested.notify_one();
+		m_finished.wait( lock, [&]() { return pending.done || m_stopping; } );
+		return pending.done;
+	}
+
+	// Skins what is queued and ends the thread.
+	void stop()
+	{
+		{
+			std::lock_guard< std::mutex > lock( m_mutex );
+			m_stopping = true;
+			m_requested.notify_one();
+		}
+		if( m_thread.joinable() )
+		{
+			m_thread.join();
+		}
+	}
+
+	void printStatistics( const string& name ) const
+	{
+		cout << name << ": " << m_requests << " requests in " << m_batches << " batches (mean "
+			<< ( m_batches ? double( m_requests ) / m_batches : 0.0 ) << ", largest " << m_largestBatch << "), "
+			<< ( m_requests ? m_skinningTime / m_requests : 0.0 ) << " ms of skinning per request" << endl;
+	}
+
+private:
+
+	struct Pending
+	{
+		vector< Vector3f >* pose;
+		vector< Vector3f >* vertices;
+		bool done;
+	};
+
+	void run()
+	{
+		vector< Pending* > batch;
+		vector< vector< Vector3f > > poses;
+		vector< vector< Vector3f > > deformed;
+
+		std::unique_lock< std::mutex > lock( m_mutex );
+		for( ; ; )
+		{
+			m_requested.wait( lock, [this]() { return m_stopping || !m_pending.empty(); } );
+			if( m_pending.empty() )
+			{
+				break;
+			}
+
+			// everything queued so far, up to the batch size
+			const unsigned size = std::min< size_t >( m_pending.size(), m_maxBatch );
+			batch.assign( m_pending.begin(), m_pending.begin() + size );
+			m_pending.erase( m_pending.begin(), m_pending.begin() + size );
+			lock.unlock();
+
+			poses.resize( size );
+			for( unsigned k = 0; k < size; k++ )
+			{
+				poses[ k ].swap( *batch[ k ]->pose );
+			}
+			Clock::time_point start = Clock::now();
+			m_model.skinPoses( poses, deformed, m_numThreads );
+			const double time = millisecondsSince( start );
+
+			lock.lock();
+			for( unsigned k = 0; k < size; k++ )
+			{
+				poses[ k ].swap( *batch[ k ]->pose );
+				deformed[ k ].swap( *batch[ k ]->vertices );
+				batch[ k ]->done = true;
+			}
+			m_requests += size;
+			m_batches++;
+			m_largestBatch = std::max( m_largestBatch, size );
+			m_skinningTime += time;
+			m_finished.notify_all();
+		}
+		m_finished.notify_all();
+	}
+
+	const SkeletalModel& m_model;
+	const unsigned m_maxBatch;
+	const unsigned m_numThreads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_requested;
+	std::condition_variable m_finished;
+	std::deque< Pending* > m_pending;
+	bool m_stopping;
+	std::thread m_thread;
+
+	// guarded by m_mutex
+	unsigned m_requests;
+	unsigned m_batches;
+	unsigned m_largestBatch;
+	double m_skinningTime;
+};
+
+// State shared by the connection threads.
+struct Service
+{
+	vector< unique_ptr< SkeletalModel > > models;
+	vector< unique_ptr< RigServer > > rigs;
+	int listenSocket;
+	std::atomic< bool > stopping;
+
+	// open connections, each served by a detached thread that removes
+	// its own; on exit they are shut down and waited for
+	std::mutex connectionsMutex;
+	std::condition_variable connectionsClosed;
+	set< int > connections;
+};
+
+static bool respond( int fd, unsigned status, unsigned count, const void* data = NULL, size_t size = 0 )
+{
+	const SkinResponseHeader header = { kSkinResponseMagic, status, count, 0 };
+	return writeFully( fd, &header, sizeof( header ) ) && ( size == 0 || writeFully( fd, data, size ) );
+}
+
+// Serves the requests on connection fd until the client disconnects.
+static void serveConnection( int fd, Service& service )
+{
+	vector< Vector3f > pose;
+	vector< Vector3f > vertices;
+
+	SkinRequestHeader request;
+	while( readFully( fd, &request, sizeof( request ) ) && request.magic == kSkinRequestMagic )
+	{
+		if( request.type == kSkinInfo )
+		{
+			vector< unsigned > sizes;
+			for( unsigned r = 0; r < service.models.size(); r++ )
+			{
+				sizes.push_back( service.models[ r ]->numJoints() );
+				sizes.push_back( service.models[ r ]->numVertices() );
+			}
+			if( !respond( fd, kSkinOk, service.models.size(), &sizes[ 0 ], sizes.size() * sizeof( unsigned ) ) )
+			{
+				break;
+			}
+		}
+		else if( request.type == kSkinPose )
+		{
+			// the angles are read even for a bad rig, to stay in step
+			// with the stream; a count this large is not a pose at all
+			if( request.count > 65536 )
+			{
+				respond( fd, kSkinBadRequest, 0 );
+				break;
+			}
+			pose.resize( request.count );
+			if( request.count > 0 && !readFully( fd, &pose[ 0 ], request.count * sizeof( Vector3f ) ) )
+			{
+				break;
+			}
+
+			bool sent;
+			if( request.rig >= service.rigs.size() )
+			{
+				sent = respond( fd, kSkinUnknownRig, 0 );
+			}
+			else if( request.count != service.models[ request.rig ]->numJoints() )
+			{
+				sent = respond( fd, kSkinWrongJointCount, 0 );
+			}
+			else if( service.rigs[ request.rig ]->skin( pose, vertices ) )
+			{
+				sent = respond( fd, kSkinOk, vertices.size(), &vertices[ 0 ], vertices.size() * sizeof( Vector3f ) );
+			}
+			else
+			{
+				break;
+			}
+			if( !sent )
+			{
+				break;
+			}
+		}
+		else if( request.type == kSkinShutdown )
+		{
+			respond( fd, kSkinOk, 0 );
+			service.stopping = true;
+			// wakes the accept() in main()
+			shutdown( service.listenSocket, SHUT_RDWR );
+			break;
+		}
+		else
+		{
+			respond( fd, kSkinBadRequest, 0 );
+			break;
+		}
+	}
+
+	std::lock_guard< std::mutex > lock( service.connectionsMutex );
+	service.connections.erase( fd );
+	close( fd );
+	service.connectionsClosed.notify_all();
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 3 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " SOCKET PREFIX... [-batch N] [-threads N]" << endl;
+		cout << "Serves skinning requests for the rigs PREFIX.skel/.obj/.attach (or .glb/.gltf files)" << endl;
+		cout << "over the Unix domain socket SOCKET; see SkinProtocol.h and skinclient." << endl;
+		return -1;
+	}
+
+	unsigned maxBatch = 16;
+	unsigned numThreads = 0;
+	vector< string > prefixes;
+	for( int i = 2; i < argc; i++ )
+	{
+		if( strcmp( argv[ i ], "-batch" ) == 0 && i + 1 < argc )
+		{
+			maxBatch = max( 1, atoi( argv[ ++i ] ) );
+		}
+		else if( strcmp( argv[ i ], "-threads" ) == 0 && i + 1 < argc )
+		{
+			numThreads = max( 0, atoi( argv[ ++i ] ) );
+		}
+		else
+		{
+			prefixes.push_back( argv[ i ] );
+		}
+	}
+	numThreads = numThreads ? numThreads : defaultThreadCount();
+	if( prefixes.empty() )
+	{
+		cerr << "Error: No rigs to serve [in main()]!" << endl;
+		return -1;
+	}
+
+	Service service;
+	service.stopping = false;
+	for( unsigned r = 0; r < prefixes.size(); r++ )
+	{
+		const string& prefix = prefixes[ r ];
+		const bool gltf = isGltfFile( prefix.c_str() );
+		string skeletonFile = gltf ? prefix : prefix + ".skel";
+		string meshFile = gltf ? prefix : prefix + ".obj";
+		string attachmentsFile = gltf ? prefix : prefix + ".attach";
+
+		service.models.push_back( unique_ptr< SkeletalModel >( new SkeletalModel() ) );
+		service.models.back()->load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str() );
+		if( service.models.back()->numVertices() == 0 )
+		{
+			cerr << "Error: " << prefix << " has no mesh [in main()]!" << endl;
+			return -1;
+		}
+		service.rigs.push_back( unique_ptr< RigServer >( new RigServer( *service.models.back(), maxBatch, numThreads ) ) );
+	}
+
+	sockaddr_un address;
+	service.listenSocket = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( !skinSocketAddress( argv[ 1 ], address ) || service.listenSocket < 0 )
+	{
+		cerr << "Error: Could not create the socket " << argv[ 1 ] << " [in main()]!" << endl;
+		return -1;
+	}
+	// a socket file left by a server that did not shut down cleanly
+	unlink( argv[ 1 ] );
+	if( bind( service.listenSocket, reinterpret_cast< sockaddr* >( &address ), sizeof( address ) ) != 0 ||
+		listen( service.listenSocket, 128 ) != 0 )
+	{
+		cerr << "Error: Could not listen on " << argv[ 1 ] << ": " << strerror( errno ) << " [in main()]!" << endl;
+		return -1;
+	}
+
+	cout << "serving " << prefixes.size() << " rigs on " << argv[ 1 ] << ", batches of up to " << maxBatch << " poses on "
+		<< numThreads << " threads" << endl;
+
+	while( !service.stopping )
+	{
+		const int fd = accept( service.listenSocket, NULL, NULL );
+		if( fd < 0 )
+		{
+			if( errno == EINTR || errno == ECONNABORTED )
+			{
+				continue;
+			}
+			break;
+		}
+
+		// detached, so a long running server keeps no threads of
+		// connections that have ended
+		std::lock_guard< std::mutex > lock( service.connectionsMutex );
+		service.connections.insert( fd );
+		std::thread( serveConnection, fd, std::ref( service ) ).detach();
+	}
+
+	// end the connections still open, then the rig threads
+	{
+		std::unique_lock< std::mutex > lock( service.connectionsMutex );
+		for( int fd : service.connections )
+		{
+			shutdown( fd, SHUT_RDWR );
+		}
+		service.connectionsClosed.wait( lock, [&]() { return service.connections.empty(); } );
+	}
+	for( unsigned r = 0; r < service.rigs.size(); r++ )
+	{
+		service.rigs[ r ]->stop();
+		service.rigs[ r ]->printStatistics( prefixes[ r ] );
+	}
+
+	close( service.listenSocket );
+	unlink( argv[ 1 ] );
+	return 0;
+}
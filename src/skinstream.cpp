@@ -0,0 +1,136 @@
+// Offline streaming skinning: poses in, compressed deformed meshes out.
+//
+// A reader thread parses the multi-frame pose file, the main thread skins
+// batches of poses with SkeletalModel::skinPoses(), and a FrameWriter
+// thread compresses and writes the frames. Both hand-offs go through
+// bounded queues, so memory use is independent of the sequence length.
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SkeletalModel.h"
+#include "PoseStream.h"
+#include "BoundedQueue.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince( Clock::time_point start )
+{
+	return std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 4 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " PREFIX POSES OUTPUT [-optimize]" << endl;
+		cout << "Skins every frame of the multi-frame pose file POSES with the rig PREFIX.skel/.obj/.attach" << endl;
+		cout << "and writes the compressed deformed meshes to OUTPUT." << endl;
+		return -1;
+	}
+
+	string prefix = argv[ 1 ];
+	string skeletonFile = prefix + ".skel";
+	string meshFile = prefix + ".obj";
+	string attachmentsFile = prefix + ".attach";
+
+	LoadOptions options;
+	options.optimizeMeshLayout = ( argc > 4 && strcmp( argv[ 4 ], "-optimize" ) == 0 );
+
+	SkeletalModel model;
+	model.load( skeletonFile.c_str(), meshFile.c_str(), attachmentsFile.c_str(), options );
+
+	PoseStreamReader reader( argv[ 2 ], model.numJoints() );
+	FrameWriter writer( argv[ 3 ], model.numVertices() );
+	if( !reader.isOpen() || !writer.isOpen() )
+	{
+		return -1;
+	}
+
+	// Stage 1: parse poses ahead of the skinning stage
+	BoundedQueue< vector< Vector3f > > poses( 64 );
+	std::thread readerThread( [&]()
+	{
+		vector< Vector3f > pose;
+		while( reader.readFrame( pose ) && poses.push( pose ) )
+		{
+		}
+		poses.close();
+	} );
+
+	// Stage 2: skin in batches, hand frames to the writer
+	const unsigned batchSize = 16;
+	vector< vector< Vector3f > > batch;
+	vector< vector< Vector3f > > deformed;
+
+	double skinningTime = 0;
+	double writerWaitTime = 0;
+	Clock::time_point start = Clock::now();
+
+	bool done = false;
+	while( !done )
+	{
+		batch.clear();
+		vector< Vector3f > pose;
+		while( batch.size() < batchSize )
+		{
+			if( !poses.pop( pose ) )
+			{
+				done = true;
+				break;
+			}
+			batch.push_back( pose );
+		}
+
+		if( batch.empty() )
+		{
+			break;
+		}
+
+		Clock::time_point skinStart = Clock::now();
+		model.skinPoses( batch, deformed );
+		skinningTime += secondsSince( skinStart );
+
+		Clock::time_point writeStart = Clock::now();
+		bool writing = true;
+		for( unsigned k = 0; k < deformed.size() && writing; k++ )
+		{
+			writing = writer.write( std::move( deformed[ k ] ) );
+		}
+		writerWaitTime += secondsSince( writeStart );
+
+		if( !writing )
+		{
+			// finish() reports the error; stop the reader too
+			poses.close();
+			break;
+		}
+	}
+
+	readerThread.join();
+
+	Clock::time_point finishStart = Clock::now();
+	const bool written = writer.finish();
+	writerWaitTime += secondsSince( finishStart );
+	if( !written )
+	{
+		return -1;
+	}
+
+	const double totalTime = secondsSince( start );
+	const unsigned frames = writer.framesWritten();
+
+	cout << frames << " frames, " << writer.bytesWritten() << " bytes ("
+		<< ( frames ? writer.bytesWritten() / frames : 0 ) << " per frame, "
+		<< model.numVertices() * 12 << " uncompressed)" << endl;
+	cout << "total " << totalTime << " s, " << ( totalTime > 0 ? frames / totalTime : 0 ) << " frames/s" << endl;
+	cout << "  skinning " << skinningTime << " s, waiting on writer " << writerWaitTime << " s" << endl;
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+// Offline automatic skinning weights.
+//
+// Computes bone heat weights (see BoneHeat.h) for the mesh of an OBJ file
+// bound to the skeleton of a .skel file in its bind pose, and writes them
+// as an .attach file for Mesh::loadAttachments().
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BoneHeat.h"
+#include "MeshOptimizer.h"
+#include "SkeletalModel.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince( Clock::time_point start )
+{
+	return 1000.0 * std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 4 )
+	{
+		cout << "Usage: " << argv[ 0 ] << " SKEL OBJ OUTPUT [-threads N]" << endl;
+		cout << "Computes bone heat skinning weights for the OBJ mesh and the SKEL skeleton" << endl;
+		cout << "and writes them to the attachment file OUTPUT." << endl;
+		return -1;
+	}
+
+	unsigned numThreads = 0;
+	for( int i = 4; i + 1 < argc; i++ )
+	{
+		if( strcmp( argv[ i ], "-threads" ) == 0 )
+		{
+			numThreads = atoi( argv[ ++i ] );
+		}
+	}
+
+	Clock::time_point start = Clock::now();
+	SkeletalModel model;
+	model.loadSkeleton( argv[ 1 ] );
+	model.updateCurrentJointToWorldTransforms();
+	if( model.numJoints() == 0 )
+	{
+		cerr << "Error: No joints in " << argv[ 1 ] << " [in main()]!" << endl;
+		return -1;
+	}
+
+	Mesh mesh;
+	mesh.load( argv[ 2 ] );
+	if( mesh.bindVertices.empty() )
+	{
+		cerr << "Error: No vertices in " << argv[ 2 ] << " [in main()]!" << endl;
+		return -1;
+	}
+
+	vector< Vector3f > jointPositions( model.numJoints() );
+	vector< int > jointParents( model.numJoints() );
+	for( unsigned j = 0; j < model.numJoints(); j++ )
+	{
+		jointPositions[ j ] = model.jointPosition( j );
+		jointParents[ j ] = model.jointParent( j );
+	}
+	const double loadMilliseconds = millisecondsSince( start );
+
+	// The solver walks the mesh hundreds of times per joint, so give it
+	// the cache friendly vertex order, and write the weights back in the
+	// order of the OBJ file.
+	start = Clock::now();
+	vector< unsigned > remap;
+	optimizeMeshLayout( mesh, &remap );
+	const double layoutMilliseconds = millisecondsSince( start );
+
+	start = Clock::now();
+	BoneHeatStats stats;
+	vector< vector< float > > attachments;
+	computeBoneHeatWeights( mesh, jointPositions, jointParents, attachments, stats, numThreads );
+	const double solveMilliseconds = millisecondsSince( start );
+
+	mesh.attachments.resize( attachments.size() );
+	for( unsigned i = 0; i < remap.size(); i++ )
+	{
+		mesh.attachments[ i ].swap( attachments[ remap[ i ] ] );
+	}
+	mesh.saveAttachments( argv[ 3 ] );
+
+	cout << mesh.bindVertices.size() << " vertices, " << mesh.faces.size() << " faces, "
+		<< model.numJoints() << " joints (" << stats.numBones << " bones), loaded in " << loadMilliseconds << " ms, reordered in " << layoutMilliseconds << " ms" << endl;
+	cout << "weights in " << solveMilliseconds << " ms: visibility " << 1000.0 * stats.visibilitySeconds
+		<< " ms, assembly " << 1000.0 * stats.assemblySeconds << " ms, solve " << 1000.0 * stats.solveSeconds << " ms" << endl;
+	cout << stats.invisibleVertices << " vertices see no bone; at most " << stats.maxIterations
+		<< " conjugate gradient iterations, residual " << stats.maxResidual << endl;
+	cout << "wrote " << argv[ 3 ] << endl;
+
+	return 0;
+}
@@ -3,20 +3,23 @@
 
 #include <cstdio>
 
+#include "Vector3f.h"
+#include "Vector4f.h"
+
 class Matrix2f;
 class Matrix3f;
 class Quat4f;
-class Vector3f;
-class Vector4f;
 
 // 4x4 Matrix, stored in column major order (OpenGL style)
+// Trivially copyable; element access, products and the simple builders
+// are inline below, the rest is in Matrix4f.cpp.
 class Matrix4f
 {
 public:
 
     // Fill a 4x4 matrix with "fill".  Default to 0.
-	Matrix4f( float fill = 0.f );
-	Matrix4f( float m00, float m01, float m02, float m03,
+	constexpr Matrix4f( float fill = 0.f );
+	constexpr Matrix4f( float m00, float m01, float m02, float m03,
 		float m10, float m11, float m12, float m13,
 		float m20, float m21, float m22, float m23,
 		float m30, float m31, float m32, float m33 );
@@ -25,19 +28,19 @@ public:
 	// otherwise, sets the rows
 	Matrix4f( const Vector4f& v0, const Vector4f& v1, const Vector4f& v2, const Vector4f& v3, bool setColumns = true );
 	
-	Matrix4f( const Matrix4f& rm ); // copy constructor
-	Matrix4f& operator = ( const Matrix4f& rm ); // assignment operator
+	Matrix4f( const Matrix4f& rm ) = default; // copy constructor
+	Matrix4f& operator = ( const Matrix4f& rm ) = default; // assignment operator
 	Matrix4f& operator/=(float d);
 	// no destructor necessary
 
-	const float& operator () ( int i, int j ) const;
+	constexpr const float& operator () ( int i, int j ) const;
 	float& operator () ( int i, int j );
 
-	Vector4f getRow( int i ) const;
+	constexpr Vector4f getRow( int i ) const;
 	void setRow( int i, const Vector4f& v );
 
 	// get column j (mod 4)
-	Vector4f getCol( int j ) const;
+	constexpr Vector4f getCol( int j ) const;
 	void setCol( int j, const Vector4f& v );
 
 	// gets the 2x2 submatrix of this matrix to m
@@ -65,13 +68,14 @@ public:
 	// ---- Utility ----
 	operator float* (); // automatic type conversion for GL
 	operator const float* () const; // automatic type conversion for GL
+	const float* getElements() const; // the 16 elements, column major, for glLoadMatrixf()
 	
 	void print();
 
 	static Matrix4f ones();
-	static Matrix4f identity();
-	static Matrix4f translation( float x, float y, float z );
-	static Matrix4f translation( const Vector3f& rTranslation );
+	static constexpr Matrix4f identity();
+	static constexpr Matrix4f translation( float x, float y, float z );
+	static constexpr Matrix4f translation( const Vector3f& rTranslation );
 	static Matrix4f rotateX( float radians );
 	static Matrix4f rotateY( float radians );
 	static Matrix4f rotateZ( float radians );
@@ -101,9 +105,203 @@ private:
 
 // Matrix-Vector multiplication
 // 4x4 * 4x1 ==> 4x1
-Vector4f operator * ( const Matrix4f& m, const Vector4f& v );
+constexpr Vector4f operator * ( const Matrix4f& m, const Vector4f& v );
 
 // Matrix-Matrix multiplication
 Matrix4f operator * ( const Matrix4f& x, const Matrix4f& y );
 
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+constexpr Matrix4f::Matrix4f( float fill ) :
+	m_elements{ fill, fill, fill, fill, fill, fill, fill, fill, fill, fill, fill, fill, fill, fill, fill, fill }
+{
+}
+
+constexpr Matrix4f::Matrix4f( float m00, float m01, float m02, float m03,
+	float m10, float m11, float m12, float m13,
+	float m20, float m21, float m22, float m23,
+	float m30, float m31, float m32, float m33 ) :
+	m_elements
+	{
+		m00, m10, m20, m30,
+		m01, m11, m21, m31,
+		m02, m12, m22, m32,
+		m03, m13, m23, m33
+	}
+{
+}
+
+inline Matrix4f::Matrix4f( const Vector4f& v0, const Vector4f& v1, const Vector4f& v2, const Vector4f& v3, bool setColumns )
+{
+	if( setColumns )
+	{
+		setCol( 0, v0 );
+		setCol( 1, v1 );
+		setCol( 2, v2 );
+		setCol( 3, v3 );
+	}
+	else
+	{
+		setRow( 0, v0 );
+		setRow( 1, v1 );
+		setRow( 2, v2 );
+		setRow( 3, v3 );
+	}
+}
+
+inline Matrix4f& Matrix4f::operator /= ( float d )
+{
+	for( int i = 0; i < 16; ++i )
+	{
+		m_elements[ i ] /= d;
+	}
+	return *this;
+}
+
+constexpr const float& Matrix4f::operator () ( int i, int j ) const
+{
+	return m_elements[ j * 4 + i ];
+}
+
+inline float& Matrix4f::operator () ( int i, int j )
+{
+	return m_elements[ j * 4 + i ];
+}
+
+constexpr Vector4f Matrix4f::getRow( int i ) const
+{
+	return Vector4f( m_elements[ i ], m_elements[ i + 4 ], m_elements[ i + 8 ], m_elements[ i + 12 ] );
+}
+
+inline void Matrix4f::setRow( int i, const Vector4f& v )
+{
+	m_elements[ i ] = v.x();
+	m_elements[ i + 4 ] = v.y();
+	m_elements[ i + 8 ] = v.z();
+	m_elements[ i + 12 ] = v.w();
+}
+
+constexpr Vector4f Matrix4f::getCol( int j ) const
+{
+	return Vector4f( m_elements[ 4 * j ], m_elements[ 4 * j + 1 ], m_elements[ 4 * j + 2 ], m_elements[ 4 * j + 3 ] );
+}
+
+inline void Matrix4f::setCol( int j, const Vector4f& v )
+{
+	int colStart = 4 * j;
+
+	m_elements[ colStart ] = v.x();
+	m_elements[ colStart + 1 ] = v.y();
+	m_elements[ colStart + 2 ] = v.z();
+	m_elements[ colStart + 3 ] = v.w();
+}
+
+inline void Matrix4f::transpose()
+{
+	float temp;
+
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int j = i + 1; j < 4; ++j )
+		{
+			temp = ( *this )( i, j );
+			( *this )( i, j ) = ( *this )( j, i );
+			( *this )( j, i ) = temp;
+		}
+	}
+}
+
+inline Matrix4f Matrix4f::transposed() const
+{
+	Matrix4f out;
+	for( int i = 0; i < 4; ++i )
+	{
+		for( int j = 0; j < 4; ++j )
+		{
+			out( j, i ) = ( *this )( i, j );
+		}
+	}
+
+	return out;
+}
+
+inline Matrix4f::operator float* ()
+{
+	return m_elements;
+}
+
+inline Matrix4f::operator const float* () const
+{
+	return m_elements;
+}
+
+inline const float* Matrix4f::getElements() const
+{
+	return m_elements;
+}
+
+// static
+constexpr Matrix4f Matrix4f::identity()
+{
+	return Matrix4f
+	(
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		0, 0, 0, 1
+	);
+}
+
+// static
+constexpr Matrix4f Matrix4f::translation( float x, float y, float z )
+{
+	return Matrix4f
+	(
+		1, 0, 0, x,
+		0, 1, 0, y,
+		0, 0, 1, z,
+		0, 0, 0, 1
+	);
+}
+
+// static
+constexpr Matrix4f Matrix4f::translation( const Vector3f& rTranslation )
+{
+	return Matrix4f
+	(
+		1, 0, 0, rTranslation.x(),
+		0, 1, 0, rTranslation.y(),
+		0, 0, 1, rTranslation.z(),
+		0, 0, 0, 1
+	);
+}
+
+constexpr Vector4f operator * ( const Matrix4f& m, const Vector4f& v )
+{
+	return Vector4f
+	(
+		m( 0, 0 ) * v[ 0 ] + m( 0, 1 ) * v[ 1 ] + m( 0, 2 ) * v[ 2 ] + m( 0, 3 ) * v[ 3 ],
+		m( 1, 0 ) * v[ 0 ] + m( 1, 1 ) * v[ 1 ] + m( 1, 2 ) * v[ 2 ] + m( 1, 3 ) * v[ 3 ],
+		m( 2, 0 ) * v[ 0 ] + m( 2, 1 ) * v[ 1 ] + m( 2, 2 ) * v[ 2 ] + m( 2, 3 ) * v[ 3 ],
+		m( 3, 0 ) * v[ 0 ] + m( 3, 1 ) * v[ 1 ] + m( 3, 2 ) * v[ 2 ] + m( 3, 3 ) * v[ 3 ]
+	);
+}
+
+inline Matrix4f operator * ( const Matrix4f& x, const Matrix4f& y )
+{
+	Matrix4f product;
+
+	for( int k = 0; k < 4; ++k )
+	{
+		for( int i = 0; i < 4; ++i )
+		{
+			product( i, k ) = x( i, 0 ) * y( 0, k ) + x( i, 1 ) * y( 1, k ) + x( i, 2 ) * y( 2, k ) + x( i, 3 ) * y( 3, k );
+		}
+	}
+
+	return product;
+}
+
 #endif // MATRIX4F_H
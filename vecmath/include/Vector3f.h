@@ -1,8 +1,13 @@
 #ifndef VECTOR_3F_H
 #define VECTOR_3F_H
 
+#include <cmath>
+
 class Vector2f;
 
+// Plain value type: trivially copyable (std::vector< Vector3f > grows with
+// memcpy), and everything but the Vector2f conversions and print() is
+// inline below, so arithmetic on it compiles to straight float math.
 class Vector3f
 {
 public:
@@ -12,42 +17,42 @@ public:
 	static const Vector3f RIGHT;
 	static const Vector3f FORWARD;
 
-    Vector3f( float f = 0.f );
-    Vector3f( float x, float y, float z );
+    constexpr Vector3f( float f = 0.f );
+    constexpr Vector3f( float x, float y, float z );
 
 	Vector3f( const Vector2f& xy, float z );
 	Vector3f( float x, const Vector2f& yz );
 
 	// copy constructors
-    Vector3f( const Vector3f& rv );
+    Vector3f( const Vector3f& rv ) = default;
 
 	// assignment operators
-    Vector3f& operator = ( const Vector3f& rv );
+    Vector3f& operator = ( const Vector3f& rv ) = default;
 
 	// no destructor necessary
 
 	// returns the ith element
-    const float& operator [] ( int i ) const;
+    constexpr const float& operator [] ( int i ) const;
     float& operator [] ( int i );
 
     float& x();
 	float& y();
 	float& z();
 
-	float x() const;
-	float y() const;
-	float z() const;
+	constexpr float x() const;
+	constexpr float y() const;
+	constexpr float z() const;
 
 	Vector2f xy() const;
 	Vector2f xz() const;
 	Vector2f yz() const;
 
-	Vector3f xyz() const;
-	Vector3f yzx() const;
-	Vector3f zxy() const;
+	constexpr Vector3f xyz() const;
+	constexpr Vector3f yzx() const;
+	constexpr Vector3f zxy() const;
 
 	float abs() const;
-    float absSquared() const;
+    constexpr float absSquared() const;
 
 	void normalize();
 	Vector3f normalized() const;
@@ -58,19 +63,19 @@ public:
 
 	// ---- Utility ----
     operator const float* () const; // automatic type conversion for OpenGL
-    operator float* (); // automatic type conversion for OpenGL 
-	void print() const;	
+    operator float* (); // automatic type conversion for OpenGL
+	void print() const;
 
 	Vector3f& operator += ( const Vector3f& v );
 	Vector3f& operator -= ( const Vector3f& v );
     Vector3f& operator *= ( float f );
 
-    static float dot( const Vector3f& v0, const Vector3f& v1 );
-	static Vector3f cross( const Vector3f& v0, const Vector3f& v1 );
-    
+    static constexpr float dot( const Vector3f& v0, const Vector3f& v1 );
+	static constexpr Vector3f cross( const Vector3f& v0, const Vector3f& v1 );
+
     // computes the linear interpolation between v0 and v1 by alpha \in [0,1]
 	// returns v0 * ( 1 - alpha ) * v1 * alpha
-	static Vector3f lerp( const Vector3f& v0, const Vector3f& v1, float alpha );
+	static constexpr Vector3f lerp( const Vector3f& v0, const Vector3f& v1, float alpha );
 
 	// computes the cubic catmull-rom interpolation between p0, p1, p2, p3
     // by t \in [0,1].  Guarantees that at t = 0, the result is p0 and
@@ -84,20 +89,227 @@ private:
 };
 
 // component-wise operators
-Vector3f operator + ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator - ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator * ( const Vector3f& v0, const Vector3f& v1 );
-Vector3f operator / ( const Vector3f& v0, const Vector3f& v1 );
+constexpr Vector3f operator + ( const Vector3f& v0, const Vector3f& v1 );
+constexpr Vector3f operator - ( const Vector3f& v0, const Vector3f& v1 );
+constexpr Vector3f operator * ( const Vector3f& v0, const Vector3f& v1 );
+constexpr Vector3f operator / ( const Vector3f& v0, const Vector3f& v1 );
 
 // unary negation
-Vector3f operator - ( const Vector3f& v );
+constexpr Vector3f operator - ( const Vector3f& v );
 
 // multiply and divide by scalar
-Vector3f operator * ( float f, const Vector3f& v );
-Vector3f operator * ( const Vector3f& v, float f );
-Vector3f operator / ( const Vector3f& v, float f );
+constexpr Vector3f operator * ( float f, const Vector3f& v );
+constexpr Vector3f operator * ( const Vector3f& v, float f );
+constexpr Vector3f operator / ( const Vector3f& v, float f );
+
+constexpr bool operator == ( const Vector3f& v0, const Vector3f& v1 );
+constexpr bool operator != ( const Vector3f& v0, const Vector3f& v1 );
+
+//////////////////////////////////////////////////////////////////////////
+// Inline definitions
+//////////////////////////////////////////////////////////////////////////
+
+constexpr Vector3f::Vector3f( float f ) :
+	m_elements{ f, f, f }
+{
+}
+
+constexpr Vector3f::Vector3f( float x, float y, float z ) :
+	m_elements{ x, y, z }
+{
+}
+
+constexpr const float& Vector3f::operator [] ( int i ) const
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector3f::operator [] ( int i )
+{
+	return m_elements[ i ];
+}
+
+inline float& Vector3f::x()
+{
+	return m_elements[ 0 ];
+}
+
+inline float& Vector3f::y()
+{
+	return m_elements[ 1 ];
+}
+
+inline float& Vector3f::z()
+{
+	return m_elements[ 2 ];
+}
+
+constexpr float Vector3f::x() const
+{
+	return m_elements[ 0 ];
+}
+
+constexpr float Vector3f::y() const
+{
+	return m_elements[ 1 ];
+}
+
+constexpr float Vector3f::z() const
+{
+	return m_elements[ 2 ];
+}
+
+constexpr Vector3f Vector3f::xyz() const
+{
+	return Vector3f( m_elements[ 0 ], m_elements[ 1 ], m_elements[ 2 ] );
+}
+
+constexpr Vector3f Vector3f::yzx() const
+{
+	return Vector3f( m_elements[ 1 ], m_elements[ 2 ], m_elements[ 0 ] );
+}
+
+constexpr Vector3f Vector3f::zxy() const
+{
+	return Vector3f( m_elements[ 2 ], m_elements[ 0 ], m_elements[ 1 ] );
+}
+
+inline float Vector3f::abs() const
+{
+	return std::sqrt( absSquared() );
+}
+
+constexpr float Vector3f::absSquared() const
+{
+	return m_elements[ 0 ] * m_elements[ 0 ] + m_elements[ 1 ] * m_elements[ 1 ] + m_elements[ 2 ] * m_elements[ 2 ];
+}
+
+inline void Vector3f::normalize()
+{
+	float norm = abs();
+	m_elements[ 0 ] /= norm;
+	m_elements[ 1 ] /= norm;
+	m_elements[ 2 ] /= norm;
+}
+
+inline Vector3f Vector3f::normalized() const
+{
+	float norm = abs();
+	return Vector3f( m_elements[ 0 ] / norm, m_elements[ 1 ] / norm, m_elements[ 2 ] / norm );
+}
 
-bool operator == ( const Vector3f& v0, const Vector3f& v1 );
-bool operator != ( const Vector3f& v0, const Vector3f& v1 );
+inline void Vector3f::negate()
+{
+	m_elements[ 0 ] = -m_elements[ 0 ];
+	m_elements[ 1 ] = -m_elements[ 1 ];
+	m_elements[ 2 ] = -m_elements[ 2 ];
+}
+
+inline Vector3f::operator const float* () const
+{
+	return m_elements;
+}
+
+inline Vector3f::operator float* ()
+{
+	return m_elements;
+}
+
+inline Vector3f& Vector3f::operator += ( const Vector3f& v )
+{
+	m_elements[ 0 ] += v.m_elements[ 0 ];
+	m_elements[ 1 ] += v.m_elements[ 1 ];
+	m_elements[ 2 ] += v.m_elements[ 2 ];
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator -= ( const Vector3f& v )
+{
+	m_elements[ 0 ] -= v.m_elements[ 0 ];
+	m_elements[ 1 ] -= v.m_elements[ 1 ];
+	m_elements[ 2 ] -= v.m_elements[ 2 ];
+	return *this;
+}
+
+inline Vector3f& Vector3f::operator *= ( float f )
+{
+	m_elements[ 0 ] *= f;
+	m_elements[ 1 ] *= f;
+	m_elements[ 2 ] *= f;
+	return *this;
+}
+
+// static
+constexpr float Vector3f::dot( const Vector3f& v0, const Vector3f& v1 )
+{
+	return v0[ 0 ] * v1[ 0 ] + v0[ 1 ] * v1[ 1 ] + v0[ 2 ] * v1[ 2 ];
+}
+
+// static
+constexpr Vector3f Vector3f::cross( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f
+		(
+			v0.y() * v1.z() - v0.z() * v1.y(),
+			v0.z() * v1.x() - v0.x() * v1.z(),
+			v0.x() * v1.y() - v0.y() * v1.x()
+		);
+}
+
+// static
+constexpr Vector3f Vector3f::lerp( const Vector3f& v0, const Vector3f& v1, float alpha )
+{
+	return alpha * ( v1 - v0 ) + v0;
+}
+
+constexpr Vector3f operator + ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f( v0[ 0 ] + v1[ 0 ], v0[ 1 ] + v1[ 1 ], v0[ 2 ] + v1[ 2 ] );
+}
+
+constexpr Vector3f operator - ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f( v0[ 0 ] - v1[ 0 ], v0[ 1 ] - v1[ 1 ], v0[ 2 ] - v1[ 2 ] );
+}
+
+constexpr Vector3f operator * ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f( v0[ 0 ] * v1[ 0 ], v0[ 1 ] * v1[ 1 ], v0[ 2 ] * v1[ 2 ] );
+}
+
+constexpr Vector3f operator / ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return Vector3f( v0[ 0 ] / v1[ 0 ], v0[ 1 ] / v1[ 1 ], v0[ 2 ] / v1[ 2 ] );
+}
+
+constexpr Vector3f operator - ( const Vector3f& v )
+{
+	return Vector3f( -v[ 0 ], -v[ 1 ], -v[ 2 ] );
+}
+
+constexpr Vector3f operator * ( float f, const Vector3f& v )
+{
+	return Vector3f( v[ 0 ] * f, v[ 1 ] * f, v[ 2 ] * f );
+}
+
+constexpr Vector3f operator * ( const Vector3f& v, float f )
+{
+	return Vector3f( v[ 0 ] * f, v[ 1 ] * f, v[ 2 ] * f );
+}
+
+constexpr Vector3f operator / ( const Vector3f& v, float f )
+{
+	return Vector3f( v[ 0 ] / f, v[ 1 ] / f, v[ 2 ] / f );
+}
+
+constexpr bool operator == ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return( v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z() );
+}
+
+constexpr bool operator != ( const Vector3f& v0, const Vector3f& v1 )
+{
+	return !( v0 == v1 );
+}
 
 #endif // VECTOR_3F_H
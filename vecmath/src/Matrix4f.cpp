@@ -11,132 +11,6 @@
 #include "Vector3f.h"
 #include "Vector4f.h"
 
-Matrix4f::Matrix4f( float fill )
-{
-	for( int i = 0; i < 16; ++i )
-	{
-		m_elements[ i ] = fill;
-	}
-}
-
-Matrix4f::Matrix4f( float m00, float m01, float m02, float m03,
-				   float m10, float m11, float m12, float m13,
-				   float m20, float m21, float m22, float m23,
-				   float m30, float m31, float m32, float m33 )
-{
-	m_elements[ 0 ] = m00;
-	m_elements[ 1 ] = m10;
-	m_elements[ 2 ] = m20;
-	m_elements[ 3 ] = m30;
-	
-	m_elements[ 4 ] = m01;
-	m_elements[ 5 ] = m11;
-	m_elements[ 6 ] = m21;
-	m_elements[ 7 ] = m31;
-
-	m_elements[ 8 ] = m02;
-	m_elements[ 9 ] = m12;
-	m_elements[ 10 ] = m22;
-	m_elements[ 11 ] = m32;
-
-	m_elements[ 12 ] = m03;
-	m_elements[ 13 ] = m13;
-	m_elements[ 14 ] = m23;
-	m_elements[ 15 ] = m33;
-}
-
-Matrix4f& Matrix4f::operator/=(float d)
-{
-	for(int ii=0;ii<16;ii++){
-		m_elements[ii]/=d;
-	}
-	return *this;
-}
-
-Matrix4f::Matrix4f( const Vector4f& v0, const Vector4f& v1, const Vector4f& v2, const Vector4f& v3, bool setColumns )
-{
-	if( setColumns )
-	{
-		setCol( 0, v0 );
-		setCol( 1, v1 );
-		setCol( 2, v2 );
-		setCol( 3, v3 );
-	}
-	else
-	{
-		setRow( 0, v0 );
-		setRow( 1, v1 );
-		setRow( 2, v2 );
-		setRow( 3, v3 );
-	}
-}
-
-Matrix4f::Matrix4f( const Matrix4f& rm )
-{
-	memcpy( m_elements, rm.m_elements, 16 * sizeof( float ) );
-}
-
-Matrix4f& Matrix4f::operator = ( const Matrix4f& rm )
-{
-	if( this != &rm )
-	{
-		memcpy( m_elements, rm.m_elements, 16 * sizeof( float ) );
-	}
-	return *this;
-}
-
-const float& Matrix4f::operator () ( int i, int j ) const
-{
-	return m_elements[ j * 4 + i ];
-}
-
-float& Matrix4f::operator () ( int i, int j )
-{
-	return m_elements[ j * 4 + i ];
-}
-
-Vector4f Matrix4f::getRow( int i ) const
-{
-	return Vector4f
-	(
-		m_elements[ i ],
-		m_elements[ i + 4 ],
-		m_elements[ i + 8 ],
-		m_elements[ i + 12 ]
-	);
-}
-
-void Matrix4f::setRow( int i, const Vector4f& v )
-{
-	m_elements[ i ] = v.x();
-	m_elements[ i + 4 ] = v.y();
-	m_elements[ i + 8 ] = v.z();
-	m_elements[ i + 12 ] = v.w();
-}
-
-Vector4f Matrix4f::getCol( int j ) const
-{
-	int colStart = 4 * j;
-
-	return Vector4f
-	(
-		m_elements[ colStart ],
-		m_elements[ colStart + 1 ],
-		m_elements[ colStart + 2 ],
-		m_elements[ colStart + 3 ]
-	);
-}
-
-void Matrix4f::setCol( int j, const Vector4f& v )
-{
-	int colStart = 4 * j;
-
-	m_elements[ colStart ] = v.x();
-	m_elements[ colStart + 1 ] = v.y();
-	m_elements[ colStart + 2 ] = v.z();
-	m_elements[ colStart + 3 ] = v.w();
-}
-
 Matrix2f Matrix4f::getSubmatrix2x2( int i0, int j0 ) const
 {
 	Matrix2f out;
@@ -291,46 +165,6 @@ Matrix4f Matrix4f::inverse( bool* pbIsSingular, float epsilon ) const
 	}
 }
 
-void Matrix4f::transpose()
-{
-	float temp;
-
-	for( int i = 0; i < 3; ++i )
-	{
-		for( int j = i + 1; j < 4; ++j )
-		{
-			temp = ( *this )( i, j );
-			( * this )( i, j ) = ( *this )( j, i );
-			( *this )( j, i ) = temp;
-		}
-	}
-}
-
-Matrix4f Matrix4f::transposed() const
-{
-	Matrix4f out;
-	for( int i = 0; i < 4; ++i )
-	{
-		for( int j = 0; j < 4; ++j )
-		{
-			out( j, i ) = ( *this )( i, j );
-		}
-	}
-
-	return out;
-}
-
-Matrix4f::operator float* ()
-{
-	return m_elements;
-}
-
-Matrix4f::operator const float* ()const
-{
-	return m_elements;
-}
-
-
 void Matrix4f::print()
 {
 	printf( "[ %.4f %.4f %.4f %.4f ]\n[ %.4f %.4f %.4f %.4f ]\n[ %.4f %.4f %.4f %.4f ]\n[ %.4f %.4f %.4f %.4f ]\n",
@@ -352,43 +186,6 @@ Matrix4f Matrix4f::ones()
 	return m;
 }
 
-// static
-Matrix4f Matrix4f::identity()
-{
-	Matrix4f m;
-	
-	m( 0, 0 ) = 1;
-	m( 1, 1 ) = 1;
-	m( 2, 2 ) = 1;
-	m( 3, 3 ) = 1;
-
-	return m;
-}
-
-// static
-Matrix4f Matrix4f::translation( float x, float y, float z )
-{
-	return Matrix4f
-	(
-		1, 0, 0, x,
-		0, 1, 0, y,
-		0, 0, 1, z,
-		0, 0, 0, 1
-	);
-}
-
-// static
-Matrix4f Matrix4f::translation( const Vector3f& rTranslation )
-{
-	return Matrix4f
-	(
-		1, 0, 0, rTranslation.x(),
-		0, 1, 0, rTranslation.y(),
-		0, 0, 1, rTranslation.z(),
-		0, 0, 0, 1
-	);
-}
-
 // static
 Matrix4f Matrix4f::rotateX( float radians )
 {
@@ -666,40 +463,3 @@ Matrix4f Matrix4f::infinitePerspectiveProjection( float fLeft, float fRight,
 
 	return projection;
 }
-
-//////////////////////////////////////////////////////////////////////////
-// Operators
-//////////////////////////////////////////////////////////////////////////
-
-Vector4f operator * ( const Matrix4f& m, const Vector4f& v )
-{
-	Vector4f output( 0, 0, 0, 0 );
-
-	for( int i = 0; i < 4; ++i )
-	{
-		for( int j = 0; j < 4; ++j )
-		{
-			output[ i ] += m( i, j ) * v[ j ];
-		}
-	}
-
-	return output;
-}
-
-Matrix4f operator * ( const Matrix4f& x, const Matrix4f& y )
-{
-	Matrix4f product; // zeroes
-
-	for( int i = 0; i < 4; ++i )
-	{
-		for( int j = 0; j < 4; ++j )
-		{
-			for( int k = 0; k < 4; ++k )
-			{
-				product( i, k ) += x( i, j ) * y( j, k );
-			}
-		}
-	}
-
-	return product;
-}